@@ -0,0 +1,67 @@
+#version 330 core
+
+// FXAA (console variant) on the scaled scene target, upscaling in the same pass.
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 uvScale;
+uniform vec2 uvMax;
+// set when the backbuffer is not sRGB and stores what is written
+uniform bool encodeSrgb;
+
+vec3 EncodeSrgb(vec3 color)
+{
+    color = clamp(color, 0.0, 1.0);
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
+}
+
+#define FXAA_REDUCE_MIN (1.0 / 128.0)
+#define FXAA_REDUCE_MUL (1.0 / 8.0)
+#define FXAA_SPAN_MAX   8.0
+
+// the target holds linear color, edges are found on (approximately) gamma encoded luma
+float Luma(vec3 color)
+{
+    return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+}
+
+vec3 Fetch(vec2 uv)
+{
+    return texture(source, min(uv, uvMax)).rgb;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    vec2 uv    = min(TexCoords * uvScale, uvMax);
+
+    vec3 rgbM = Fetch(uv);
+    float lumaNW = Luma(Fetch(uv + vec2(-1.0, -1.0) * texel));
+    float lumaNE = Luma(Fetch(uv + vec2( 1.0, -1.0) * texel));
+    float lumaSW = Luma(Fetch(uv + vec2(-1.0,  1.0) * texel));
+    float lumaSE = Luma(Fetch(uv + vec2( 1.0,  1.0) * texel));
+    float lumaM  = Luma(rgbM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * FXAA_REDUCE_MUL, FXAA_REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texel;
+
+    vec3 rgbA = 0.5 * (Fetch(uv + dir * (1.0 / 3.0 - 0.5)) +
+                       Fetch(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (Fetch(uv + dir * -0.5) +
+                                     Fetch(uv + dir *  0.5));
+
+    float lumaB = Luma(rgbB);
+    vec3 color = (lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB;
+    FragColor = vec4(encodeSrgb ? EncodeSrgb(color) : color, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec4 Color;
+
+// single channel coverage; graph and panel quads sample its solid cell
+uniform sampler2D atlas;
+
+void main()
+{
+    FragColor = vec4(Color.rgb, Color.a * texture(atlas, TexCoords).r);
+}
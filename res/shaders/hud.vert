@@ -0,0 +1,19 @@
+#version 330 core
+
+// Performance HUD: glyph and graph quads in window pixels, origin top left.
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec4 aColor;
+
+out vec2 TexCoords;
+out vec4 Color;
+
+uniform vec2 screenSize;
+
+void main()
+{
+    vec2 ndc    = aPos / screenSize * 2.0 - 1.0;
+    TexCoords   = aTexCoords;
+    Color       = aColor;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+}
@@ -0,0 +1,116 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in VS_OUT {
+    vec3 WorldPos;
+    vec2 TexCoords;
+    flat vec4 FramesA;
+    flat vec4 FramesB;
+    flat vec4 Weights;
+    flat vec3 DepthAxis;
+    flat mat3 NormalMatrix;
+    flat float Fade;
+} fs_in;
+
+uniform mat4  view;
+uniform mat4  viewProjection;
+uniform float frames;
+uniform bool  depthOnly; // shadow passes skip the shading
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform DirLight dirLight;
+
+#define ALPHA_CUTOFF 0.5
+
+// Cascaded shadow map (see CascadedShadowMap::BindForLighting);
+// MAX_CASCADES is injected from MAX_SHADOW_CASCADES (see CascadedShadowMap::ShaderDefines)
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4  lightSpaceMatrices[MAX_CASCADES];
+uniform float cascadeSplits[MAX_CASCADES];
+uniform int   cascadeCount; // 0 = shadows disabled
+
+// 4x4 ordered dither, the mesh uses the complement while crossfading (see model.frag)
+float Dither(vec2 pixel)
+{
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                      3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(pixel) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+float ShadowFactor(vec3 position, float viewDepth, vec3 normal, vec3 lightDir)
+{
+    if (cascadeCount == 0)
+        return 1.0;
+
+    int cascade = cascadeCount - 1;
+    for (int i = 0; i < cascadeCount; ++i)
+    {
+        if (viewDepth < cascadeSplits[i])
+        {
+            cascade = i;
+            break;
+        }
+    }
+
+    vec4 lightSpacePos = lightSpaceMatrices[cascade] * vec4(position, 1.0);
+    vec3 proj = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    if (proj.z > 1.0)
+        return 1.0;
+
+    // impostors are far away and coarse, one compare-filtered tap is enough
+    float bias = max(0.004 * (1.0 - dot(normal, lightDir)), 0.001);
+    return texture(shadowMap, vec4(proj.xy, float(cascade), proj.z - bias));
+}
+
+void main()
+{
+    if (Dither(gl_FragCoord.xy) >= fs_in.Fade)
+        discard;
+
+    vec2 uv[4] = vec2[4](fs_in.FramesA.xy, fs_in.FramesA.zw, fs_in.FramesB.xy, fs_in.FramesB.zw);
+    vec4 albedo      = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 atlasUV = (uv[i] + fs_in.TexCoords) / frames;
+        albedo      += fs_in.Weights[i] * texture(albedoAtlas, atlasUV);
+        normalDepth += fs_in.Weights[i] * texture(normalDepthAtlas, atlasUV);
+    }
+    if (albedo.a < ALPHA_CUTOFF)
+        discard;
+    // empty texels are all zero, dividing by coverage averages only the views that hit something
+    albedo.rgb  /= albedo.a;
+    normalDepth /= albedo.a;
+
+    // push the quad to the baked surface so depth tests and shadows see the real shape
+    vec3 position = fs_in.WorldPos + fs_in.DepthAxis * (normalDepth.a * 2.0 - 1.0);
+    vec4 clip     = viewProjection * vec4(position, 1.0);
+    gl_FragDepth  = clip.z / clip.w * 0.5 + 0.5;
+
+    if (depthOnly)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+
+    vec3 norm     = normalize(fs_in.NormalMatrix * (normalDepth.rgb * 2.0 - 1.0));
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff    = max(dot(norm, lightDir), 0.0);
+
+    float viewDepth = -(view * vec4(position, 1.0)).z;
+    float shadow    = ShadowFactor(position, viewDepth, norm, lightDir);
+
+    vec3 result = dirLight.ambient * albedo.rgb + shadow * dirLight.diffuse * diff * albedo.rgb;
+    FragColor = vec4(result, 1.0);
+}
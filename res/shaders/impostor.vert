@@ -0,0 +1,70 @@
+#version 330 core
+
+// Camera-facing quad of an octahedral impostor (see impostor.h)
+layout (location = 0) in vec2 aCorner;        // in [-1, 1]
+layout (location = 7) in mat4 aInstanceModel; // crossfade in the bottom row, see Renderer::SubmitImpostor
+
+uniform mat4  view;
+uniform mat4  viewProjection;
+// the viewer: a position (w = 1) for the camera, a direction towards the light (w = 0) for shadow passes
+uniform vec4  eye;
+uniform vec3  center;  // model-space bounding sphere
+uniform float radius;
+uniform float frames;  // views per side of the atlas
+
+out VS_OUT {
+    vec3 WorldPos;     // on the quad, the fragment moves it by the baked depth
+    vec2 TexCoords;    // within a view
+    flat vec4 FramesA; // atlas cells of the four views to blend, two per vector
+    flat vec4 FramesB;
+    flat vec4 Weights;
+    flat vec3 DepthAxis; // world-space offset for a baked depth of 1
+    flat mat3 NormalMatrix;
+    flat float Fade;
+} vs_out;
+
+vec2 SignNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit direction onto the octahedral square, inverse of OctahedronDecode in impostor.cpp
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(p.yx)) * SignNotZero(p);
+    return p;
+}
+
+void main()
+{
+    mat4 model = aInstanceModel;
+    vs_out.Fade = model[0][3];
+    model[0][3] = 0.0;
+
+    mat3 linear      = mat3(model);
+    vec3 worldCenter = (model * vec4(center, 1.0)).xyz;
+    vec3 toEye       = eye.w > 0.0 ? eye.xyz - worldCenter : eye.xyz;
+
+    // view direction in model space picks the views, the same basis the bake used orients the quad
+    vec3 local = normalize(inverse(linear) * toEye);
+    vec3 up    = abs(local.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, local));
+    up = cross(local, right);
+
+    vec2  grid = (OctEncode(local) * 0.5 + 0.5) * (frames - 1.0);
+    vec2  cell = clamp(floor(grid), vec2(0.0), vec2(frames - 2.0));
+    vec2  t    = clamp(grid - cell, 0.0, 1.0);
+    vs_out.FramesA = vec4(cell, cell + vec2(1.0, 0.0));
+    vs_out.FramesB = vec4(cell + vec2(0.0, 1.0), cell + vec2(1.0));
+    vs_out.Weights = vec4((1.0 - t.x) * (1.0 - t.y), t.x * (1.0 - t.y), (1.0 - t.x) * t.y, t.x * t.y);
+
+    vs_out.DepthAxis    = linear * local * radius;
+    vs_out.NormalMatrix = transpose(inverse(linear));
+    vs_out.TexCoords    = aCorner * 0.5 + 0.5;
+    vs_out.WorldPos     = worldCenter + linear * ((aCorner.x * right + aCorner.y * up) * radius);
+
+    gl_Position = viewProjection * vec4(vs_out.WorldPos, 1.0);
+}
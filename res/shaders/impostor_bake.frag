@@ -0,0 +1,60 @@
+#version 330 core
+
+// albedo (alpha is coverage) and model-space normal + depth of one atlas view
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+in VS_OUT {
+    vec3 Position;
+    vec3 Normal;
+    vec2 TexCoords;
+#ifdef HAS_NORMAL_MAP
+    vec3 Tangent;
+    vec3 Bitangent;
+#endif
+} fs_in;
+
+uniform vec3  center;        // of the bounding sphere
+uniform vec3  viewDirection; // from the center towards the view
+uniform float radius;
+
+#ifdef HAS_DIFFUSE_MAP
+uniform sampler2D texture_diffuse1;
+#endif
+#ifdef HAS_NORMAL_MAP
+uniform sampler2D texture_normal1;
+#endif
+
+#ifdef ALPHA_TEST
+#define ALPHA_CUTOFF 0.5
+#endif
+
+void main()
+{
+#ifdef HAS_DIFFUSE_MAP
+    vec4 albedo = texture(texture_diffuse1, fs_in.TexCoords);
+#else
+    vec4 albedo = vec4(1.0);
+#endif
+#ifdef ALPHA_TEST
+    if (albedo.a < ALPHA_CUTOFF)
+        discard;
+#endif
+
+    vec3 normal = normalize(fs_in.Normal);
+#ifdef HAS_NORMAL_MAP
+    // same tangent frame as model.frag
+    vec3 tangent   = normalize(fs_in.Tangent - normal * dot(normal, fs_in.Tangent));
+    vec3 bitangent = cross(normal, tangent);
+    if (dot(bitangent, fs_in.Bitangent) < 0.0)
+        bitangent = -bitangent;
+    vec3 tangentNormal = texture(texture_normal1, fs_in.TexCoords).xyz * 2.0 - 1.0;
+    normal = normalize(mat3(tangent, bitangent, normal) * tangentNormal);
+#endif
+
+    // 0.5 is the plane through the center, towards the view is larger
+    float depth = dot(fs_in.Position - center, viewDirection) / radius * 0.5 + 0.5;
+
+    Albedo      = vec4(albedo.rgb, 1.0);
+    NormalDepth = vec4(normal * 0.5 + 0.5, clamp(depth, 0.0, 1.0));
+}
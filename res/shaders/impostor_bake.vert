@@ -0,0 +1,41 @@
+#version 330 core
+
+// Renders a model into one view of its impostor atlas (see Impostor::Bake).
+// Feature defines are injected after #version by ShaderVariants, attribute
+// locations must match mesh.h.
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+// the mesh's node transform, everything is baked in model space
+layout (location = 7) in mat4 aInstanceModel;
+
+uniform mat4 viewProjection;
+
+out VS_OUT {
+    vec3 Position; // model space
+    vec3 Normal;
+    vec2 TexCoords;
+#ifdef HAS_NORMAL_MAP
+    vec3 Tangent;
+    vec3 Bitangent;
+#endif
+} vs_out;
+
+void main()
+{
+    mat4 model = aInstanceModel;
+
+    vec4 position = model * vec4(aPos, 1.0);
+    vs_out.Position  = position.xyz;
+    vs_out.Normal    = normalize(mat3(transpose(inverse(model))) * aNormal);
+    vs_out.TexCoords = aTexCoords;
+#ifdef HAS_NORMAL_MAP
+    vs_out.Tangent   = mat3(model) * aTangent;
+    vs_out.Bitangent = mat3(model) * aBitangent;
+#endif
+
+    gl_Position = viewProjection * position;
+}
@@ -6,6 +6,14 @@ in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+    float ViewDepth;
+#ifdef CROSSFADE
+    flat float Fade;
+#endif
+#ifdef HAS_NORMAL_MAP
+    vec3 Tangent;
+    vec3 Bitangent;
+#endif
 } fs_in;
 
 uniform vec3 viewPos;
@@ -20,52 +28,120 @@ struct DirLight {
 
 uniform DirLight dirLight;
 
-// Texture samplers (matching Mesh::BindTextures naming)
+// Material maps (matching Mesh::BindTextures naming). Only the maps the material
+// has are declared, the feature defines come from ShaderVariants.
+#ifdef HAS_DIFFUSE_MAP
 uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_diffuse2;
-uniform sampler2D texture_diffuse3;
-uniform sampler2D texture_diffuse4;
-
+#endif
+#ifdef HAS_SPECULAR_MAP
 uniform sampler2D texture_specular1;
-uniform sampler2D texture_specular2;
-uniform sampler2D texture_specular3;
-uniform sampler2D texture_specular4;
-
-// (normal/height maps are ignored for now, but you can add them later)
-
-vec3 SampleAlbedo()
+#endif
+#ifdef HAS_NORMAL_MAP
+uniform sampler2D texture_normal1;
+#endif
+
+#ifdef ALPHA_TEST
+#define ALPHA_CUTOFF 0.5
+#endif
+
+// Cascaded shadow map (see CascadedShadowMap::BindForLighting);
+// MAX_CASCADES is injected from MAX_SHADOW_CASCADES (see CascadedShadowMap::ShaderDefines)
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4  lightSpaceMatrices[MAX_CASCADES];
+uniform float cascadeSplits[MAX_CASCADES];
+uniform int   cascadeCount; // 0 = shadows disabled
+
+#ifdef CROSSFADE
+// the complement of the impostor's dither (see impostor.frag), so together they cover every pixel once
+float Dither(vec2 pixel)
 {
-    // Start with white; multiply in textures
-    vec3 color = vec3(1.0);
-
-    // Use first diffuse as primary; others can be blended in if needed
-    color *= texture(texture_diffuse1, fs_in.TexCoords).rgb;
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                      3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(pixel) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+#endif
 
-    // If you want to support multiple diffuse layers, you can blend:
-    // color = mix(color, texture(texture_diffuse2, fs_in.TexCoords).rgb, 0.5);
+vec4 SampleAlbedo()
+{
+#ifdef HAS_DIFFUSE_MAP
+    return texture(texture_diffuse1, fs_in.TexCoords);
+#else
+    return vec4(1.0);
+#endif
+}
 
-    return color;
+vec3 SurfaceNormal()
+{
+    vec3 normal = normalize(fs_in.Normal);
+#ifdef HAS_NORMAL_MAP
+    // Gram-Schmidt against the interpolated normal, keep the mesh's handedness
+    vec3  tangent    = normalize(fs_in.Tangent - normal * dot(normal, fs_in.Tangent));
+    vec3  bitangent  = cross(normal, tangent);
+    if (dot(bitangent, fs_in.Bitangent) < 0.0)
+        bitangent = -bitangent;
+    vec3  tangentNormal = texture(texture_normal1, fs_in.TexCoords).xyz * 2.0 - 1.0;
+    normal = normalize(mat3(tangent, bitangent, normal) * tangentNormal);
+#endif
+    return normal;
 }
 
-vec3 SampleSpecular()
+float ShadowFactor(vec3 normal, vec3 lightDir)
 {
-    // Basic: use first specular map if present, else fall back to white
-    vec3 spec = texture(texture_specular1, fs_in.TexCoords).rgb;
-    // If no specular texture is bound, this will usually be (0,0,0)
-    // and you can override with vec3(1.0) if you want a default.
-    return spec;
+    if (cascadeCount == 0)
+        return 1.0;
+
+    int cascade = cascadeCount - 1;
+    for (int i = 0; i < cascadeCount; ++i)
+    {
+        if (fs_in.ViewDepth < cascadeSplits[i])
+        {
+            cascade = i;
+            break;
+        }
+    }
+
+    vec4 lightSpacePos = lightSpaceMatrices[cascade] * vec4(fs_in.FragPos, 1.0);
+    vec3 proj = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+    if (proj.z > 1.0)
+        return 1.0;
+
+    float bias  = max(0.002 * (1.0 - dot(normal, lightDir)), 0.0005);
+    vec2  texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+
+    // 3x3 taps on top of the hardware 2x2 compare filter
+    float lit = 0.0;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            lit += texture(shadowMap, vec4(proj.xy + vec2(x, y) * texel, float(cascade), proj.z - bias));
+
+    return lit / 9.0;
 }
 
 void main()
 {
-    vec3 albedo = SampleAlbedo();
-    vec3 norm   = normalize(fs_in.Normal);
+#ifdef CROSSFADE
+    if (Dither(gl_FragCoord.xy) < fs_in.Fade)
+        discard;
+#endif
+
+    vec4 albedo = SampleAlbedo();
+#ifdef ALPHA_TEST
+    if (albedo.a < ALPHA_CUTOFF)
+        discard;
+#endif
+
+    vec3 norm = SurfaceNormal();
 
     // Directional light
     vec3 lightDir = normalize(-dirLight.direction);
     float diff = max(dot(norm, lightDir), 0.0);
 
-    // View direction
+    vec3 ambient = dirLight.ambient * albedo.rgb;
+    vec3 lit     = dirLight.diffuse * diff * albedo.rgb;
+
+    // without a specular map there is no highlight, skip the whole term
+#ifdef HAS_SPECULAR_MAP
     vec3 viewDir    = normalize(viewPos - fs_in.FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
 
@@ -73,12 +149,12 @@ void main()
     float specStrength = 1.0;
     float spec         = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
 
-    vec3 specularMap = SampleSpecular();
+    vec3 specularMap = texture(texture_specular1, fs_in.TexCoords).rgb;
+    lit += dirLight.specular * specStrength * spec * specularMap;
+#endif
 
-    vec3 ambient  = dirLight.ambient  * albedo;
-    vec3 diffuse  = dirLight.diffuse  * diff * albedo;
-    vec3 specular = dirLight.specular * specStrength * spec * specularMap;
+    float shadow = ShadowFactor(norm, lightDir);
 
-    vec3 result = ambient + diffuse + specular;
+    vec3 result = ambient + shadow * lit;
     FragColor = vec4(result, 1.0);
 }
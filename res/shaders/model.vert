@@ -1,6 +1,9 @@
 #version 330 core
 
-// Vertex attributes (must match mesh.h)
+// Feature defines (HAS_NORMAL_MAP, ...) are injected after #version by ShaderVariants
+
+// Vertex attributes (must match mesh.h). Skinned meshes are drawn from the
+// skinning pre-pass output, already posed in model space, so bone data is unused.
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
@@ -19,20 +22,41 @@ out VS_OUT {
     vec3 FragPos;    // world-space position
     vec3 Normal;     // world-space normal
     vec2 TexCoords;
+    float ViewDepth; // distance along the view axis, selects the shadow cascade
+#ifdef CROSSFADE
+    flat float Fade; // share of the pixels already handed to the impostor
+#endif
+#ifdef HAS_NORMAL_MAP
+    vec3 Tangent;    // world-space, orthogonalized per fragment
+    vec3 Bitangent;
+#endif
 } vs_out;
 
 void main()
 {
     mat4 model = aInstanceModel;
+#ifdef CROSSFADE
+    // the renderer passes the crossfade in the unused bottom row, see Renderer::Submit
+    vs_out.Fade = model[0][3];
+    model[0][3] = 0.0;
+#endif
 
     vec4 worldPos = model * vec4(aPos, 1.0);
     vs_out.FragPos = worldPos.xyz;
 
-    // normal matrix (ignoring bones for now; just use instance model)
+    // normal matrix from the instance model
     mat3 normalMatrix = mat3(transpose(inverse(model)));
     vs_out.Normal = normalize(normalMatrix * aNormal);
 
+#ifdef HAS_NORMAL_MAP
+    vs_out.Tangent   = mat3(model) * aTangent;
+    vs_out.Bitangent = mat3(model) * aBitangent;
+#endif
+
     vs_out.TexCoords = aTexCoords;
 
-    gl_Position = projection * view * worldPos;
+    vec4 viewPos = view * worldPos;
+    vs_out.ViewDepth = -viewPos.z;
+
+    gl_Position = projection * viewPos;
 }
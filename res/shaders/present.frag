@@ -0,0 +1,26 @@
+#version 330 core
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// fraction of the source that holds the rendered image, and the last texel center inside it
+uniform vec2 uvScale;
+uniform vec2 uvMax;
+// set when the backbuffer is not sRGB and stores what is written
+uniform bool encodeSrgb;
+
+vec3 EncodeSrgb(vec3 color)
+{
+    color = clamp(color, 0.0, 1.0);
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(0.0031308, color));
+}
+
+void main()
+{
+    // bilinear upscale, clamped so the unrendered part of the target never bleeds in
+    vec2 uv = min(TexCoords * uvScale, uvMax);
+    vec3 color = texture(source, uv).rgb;
+    FragColor = vec4(encodeSrgb ? EncodeSrgb(color) : color, 1.0);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth is written by the rasterizer, nothing to shade
+void main()
+{
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// Depth-only pass for shadow casters (attribute locations must match mesh.h)
+layout (location = 0) in vec3 aPos;
+layout (location = 7) in mat4 aInstanceModel;
+
+uniform mat4 viewProjection;
+
+void main()
+{
+    // crossfading instances carry their fade in the bottom row (see Renderer::Submit)
+    mat4 model = aInstanceModel;
+    model[0][3] = 0.0;
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,64 @@
+#version 330 core
+
+// Temporal resolve at output resolution. The scene was rendered with a sub-pixel
+// jittered projection; history is reprojected with the camera motion and clamped
+// to the current neighbourhood to reject stale samples.
+
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;      // current frame (scaled region)
+uniform sampler2D sourceDepth;
+uniform sampler2D history;     // previous resolve, output size
+
+uniform vec2  uvScale;
+uniform vec2  uvMax;
+uniform vec2  jitter;          // this frame's jitter in source uv
+uniform mat4  reprojection;    // previous viewProjection * inverse(current viewProjection), both unjittered
+uniform float blend;
+uniform bool  historyValid;
+
+vec3 Fetch(vec2 uv)
+{
+    return texture(source, clamp(uv, vec2(0.0), uvMax)).rgb;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    // where this pixel landed in the jittered image
+    vec2 uv = TexCoords * uvScale + jitter;
+
+    vec3 current = Fetch(uv);
+    vec3 minColor = current;
+    vec3 maxColor = current;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            vec3 neighbour = Fetch(uv + vec2(x, y) * texel);
+            minColor = min(minColor, neighbour);
+            maxColor = max(maxColor, neighbour);
+        }
+    }
+
+    if (!historyValid)
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    float depth = texture(sourceDepth, clamp(uv, vec2(0.0), uvMax)).r;
+    vec4 previous = reprojection * vec4(TexCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec2 previousUV = previous.xy / previous.w * 0.5 + 0.5;
+
+    if (any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0))))
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    vec3 past = clamp(texture(history, previousUV).rgb, minColor, maxColor);
+    FragColor = vec4(mix(past, current, blend), 1.0);
+}
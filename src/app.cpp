@@ -14,72 +14,340 @@ App::~App()
 int App::run()
 {
 
+    Log::Init();
     Window window = Window("Kobe", SCR_WIDTH, SCR_HEIGHT);
+    JobSystem::Init();
 
     Model  backpack("../res/models/backpack/backpack.obj");
-    Shader modelShader("../res/shaders/model.vert",
-                   "../res/shaders/model.frag");
+    // one program per combination of material features, see ShaderVariants
+    ShaderVariants modelShaders("../res/shaders/model.vert",
+                                "../res/shaders/model.frag",
+                                CascadedShadowMap::ShaderDefines());
+    Shader shadowShader("../res/shaders/shadow_depth.vert",
+                        "../res/shaders/shadow_depth.frag");
+    // far backpacks draw as a quad showing pre-rendered views of the model
+    ShaderVariants impostorBakeShaders("../res/shaders/impostor_bake.vert",
+                                       "../res/shaders/impostor_bake.frag");
+    Shader impostorShader("../res/shaders/impostor.vert",
+                          "../res/shaders/impostor.frag",
+                          CascadedShadowMap::ShaderDefines());
+    Impostor backpackImpostor(backpack, impostorBakeShaders);
     Camera camera = Camera();
+    CascadedShadowMap shadows;
+
+    // scene entities; the index keeps a BVH over their world bounds for culling
+    entt::registry registry;
+    SceneIndex     sceneIndex(registry);
+    // entities with an AnimatorComponent are posed every frame and drawn skinned
+    AnimationSystem animation(registry);
+
+    // static props are baked into merged world-space chunks instead of being submitted one by one
+    StaticBatcher staticBatches(registry);
+
+    const float nearPlane = 0.1f;
+    const float farPlane  = 100.0f;
+
+    // the world is registered as placements, their entities only exist in cells near the camera.
+    // Cells load out to the far plane so nothing visible is missing, and unload a cell later.
+    WorldStreamingSettings streaming;
+    streaming.LoadRadius   = farPlane;
+    streaming.UnloadRadius = farPlane + streaming.CellSize;
+    WorldStreamer world(registry, &staticBatches, streaming);
+    // the backpack stays resident, its impostor is baked from it
+    const uint32_t backpackAsset = world.AddResidentAsset(backpack, &modelShaders, &backpackImpostor);
+    // the same file again as a streamed asset, imported in the background when its cells come near
+    const uint32_t streamedAsset = world.AddAsset("../res/models/backpack/backpack.obj", &modelShaders,
+                                                  &backpackImpostor);
+
+    // example: 100 instances of the same model
+    for (int i = 0; i < 100; ++i)
+        world.AddPlacement(backpackAsset, glm::translate(glm::mat4(1.0f), glm::vec3(i * 2.0f, 0.0f, 0.0f)), true);
+    // and a row of streamed ones running away from the camera, far enough to stream in and out while walking
+    for (int i = 0; i < 64; ++i)
+        world.AddPlacement(streamedAsset, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -20.0f - i * 8.0f)), true);
+
+    // the scene renders offscreen at a dynamic scale and is anti-aliased on present,
+    // instead of multisampling the default framebuffer
+    SceneTargetSettings resolution;
+    resolution.SrgbBackbuffer = window.isSrgbBackbuffer();
+    SceneTarget sceneTarget(resolution);
+
+    // passes are declared every frame; render targets are pooled across frames
+    FrameGraph frameGraph;
+
+    FramePacingSettings pacing;
+    FramePacer pacer(pacing);
+    window.setSwapInterval(pacing.swapInterval);
+
+    // F3 shows frame times, renderer counters and memory over the frame
+    PerfHudSettings hudSettings;
+    PerfHud hud(hudSettings);
+
+    // F10 records every presented frame, F12 saves a screenshot; read back without stalling
+    ScreenCaptureSettings screenCaptureSettings;
+    ScreenCapture screenCapture(screenCaptureSettings);
+
+    const glm::vec3 lightDirection(-0.2f, -1.0f, -0.3f);
+
+    // Once after linking (material samplers are assigned by Mesh::BindTextures):
+    modelShaders.SetInitializer([lightDirection](const Shader& shader) {
+        // Set light params (example)
+        shader.setVec3("dirLight.direction", lightDirection);
+        shader.setVec3("dirLight.ambient",   glm::vec3(0.1f));
+        shader.setVec3("dirLight.diffuse",   glm::vec3(0.8f));
+        shader.setVec3("dirLight.specular",  glm::vec3(1.0f));
+    });
+    // the CROSSFADE variants too, the first backpack to fade out would otherwise compile them mid-frame
+    modelShaders.Preload(backpack, SHADER_FEATURE_CROSSFADE);
+
+    impostorShader.use();
+    impostorShader.setVec3("dirLight.direction", lightDirection);
+    impostorShader.setVec3("dirLight.ambient",   glm::vec3(0.1f));
+    impostorShader.setVec3("dirLight.diffuse",   glm::vec3(0.8f));
+    impostorShader.setVec3("dirLight.specular",  glm::vec3(1.0f));
 
-    // Once after linking:
-    modelShader.use();
-    modelShader.setInt("texture_diffuse1",  0);
-    modelShader.setInt("texture_diffuse2",  1);
-    modelShader.setInt("texture_diffuse3",  2);
-    modelShader.setInt("texture_diffuse4",  3);
-    modelShader.setInt("texture_specular1", 4);
-    modelShader.setInt("texture_specular2", 5);
-    modelShader.setInt("texture_specular3", 6);
-    modelShader.setInt("texture_specular4", 7);
-
-    // Set light params (example)
-    modelShader.setVec3("dirLight.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
-    modelShader.setVec3("dirLight.ambient",   glm::vec3(0.1f));
-    modelShader.setVec3("dirLight.diffuse",   glm::vec3(0.8f));
-    modelShader.setVec3("dirLight.specular",  glm::vec3(1.0f));
-
-    
-    glEnable(GL_DEPTH_TEST);
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 
 
+    // after warm-up the frame loop must not touch the heap (see FrameArena)
+    const int STEADY_STATE_FRAME  = 120;
+    int       frameIndex          = 0;
+    bool      reportedAllocations = false;
+
+    // visible entities per renderer submission context, the slices are submitted in parallel
+    const size_t SUBMIT_GRAIN = 256;
+
+    // the impostor is baked at load from the low texture mips, by this frame the
+    // backpacks near the camera have streamed in finer ones
+    const int IMPOSTOR_REBAKE_FRAME = 60;
+
+    // memory is dumped periodically; with MEMORY_BUDGETS=<file> set, the run fails
+    // if any high-water mark goes over its budget (used by CI)
+    const double  MEMORY_DUMP_INTERVAL = 30.0;
+    double        lastMemoryDump       = glfwGetTime();
+    MemoryBudgets budgets;
+    const char*   budgetPath           = std::getenv("MEMORY_BUDGETS");
+    bool          checkBudgets         = budgetPath && MemoryReport::LoadBudgets(budgetPath, budgets);
+
+    // camera position at the previous simulation step, for render interpolation
+    glm::vec3 previousCameraPosition = camera.Position;
+
     // game loop
-    while (!glfwWindowShouldClose(window.getGLFWwindow()))
+    while (!window.closed())
     {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // waits for the frame cap and the GPU first, so input is as fresh as possible
+        pacer.beginFrame();
 
-        glfwPollEvents();
+        uint64_t allocationsAtFrameStart = AllocationCounter::getThreadAllocations();
 
-        camera.Update(window);
+        window.pollEvents();
 
-        glm::mat4 view       = camera.GetViewMatrix();
+        // simulation runs at a fixed rate, rendering blends the last two states
+        while (pacer.step())
+        {
+            previousCameraPosition = camera.Position;
+            camera.Update(window, pacer.getFixedTimestep());
+        }
+        glm::vec3 eye = glm::mix(previousCameraPosition, camera.Position, pacer.getAlpha());
+        glm::vec3 cameraVelocity = (camera.Position - previousCameraPosition) / pacer.getFixedTimestep();
+
+        // F9 toggles recording the renderer's frames for the replay tool
+        if (window.isKeyPressed(GLFW_KEY_F9))
+        {
+            FrameCapture& capture = FrameCapture::Get();
+            if (capture.IsActive())
+                capture.Stop();
+            else
+                capture.Start("capture.ktrc");
+        }
+
+        if (window.isKeyPressed(GLFW_KEY_F10))
+        {
+            if (screenCapture.IsRecording())
+                screenCapture.StopRecording();
+            else
+                screenCapture.StartRecording("recording");
+        }
+        if (window.isKeyPressed(GLFW_KEY_F12))
+            screenCapture.Screenshot("screenshot.png");
+
+        hud.Update(window, pacer.getDeltaTime() * 1000.0f, sceneTarget.GetGpuTimeMs());
+
+        const int   outputWidth  = (int)window.getWidth();
+        const int   outputHeight = (int)window.getHeight();
+        const float aspect       = (float)outputWidth / (float)std::max(outputHeight, 1);
+
+        glm::mat4 view       = glm::lookAt(eye, eye + camera.Front, camera.Up);
         glm::mat4 projection = glm::perspective(
             glm::radians(camera.Zoom),
-            (float)SCR_WIDTH / (float)SCR_HEIGHT,
-            0.1f,
-            100.0f
+            aspect,
+            nearPlane,
+            farPlane
         );
 
-        modelShader.use();
-        modelShader.setVec3("viewPos", camera.Position);
+        // picks the render scale, TAA hands back a jittered projection
+        projection = sceneTarget.Begin(outputWidth, outputHeight, view, projection);
+
+        modelShaders.ForEach([&](const Shader& shader) {
+            shader.use();
+            shader.setVec3("viewPos", eye);
+        });
+
+        // cascades are placed first so their volumes can cull shadow casters too
+        shadows.Update(view, glm::radians(camera.Zoom), aspect,
+                       nearPlane, farPlane, lightDirection);
+
+        animation.Update(pacer.getDeltaTime());
+
+        // cells come and go before the batcher and the scene index see the registry
+        world.Update(eye, cameraVelocity);
+        staticBatches.Update();
+
+        if (frameIndex == IMPOSTOR_REBAKE_FRAME)
+            backpackImpostor.Bake();
 
         Renderer::BeginScene(view, projection);
+        Renderer::SetBonePalette(animation.GetPalette(), animation.GetPaletteSize());
+        staticBatches.Submit();
+
+        // submit whatever the camera or any cascade can see, whole subtrees are skipped at once
+        Frustum frusta[1 + MAX_SHADOW_CASCADES];
+        int     frustumCount = 0;
+        frusta[frustumCount++] = Frustum::FromMatrix(projection * view);
+        for (int i = 0; i < shadows.GetCascadeCount(); ++i)
+            frusta[frustumCount++] = Frustum::FromMatrix(shadows.GetLightSpaceMatrix(i));
+
+        sceneIndex.Update();
+        FrameVector<entt::entity> visible;
+        sceneIndex.Query(frusta, frustumCount, [&](entt::entity entity) {
+            if (registry.all_of<StaticBatchedComponent>(entity))
+                return;
+            if (const auto* animator = registry.try_get<AnimatorComponent>(entity))
+            {
+                const auto& renderable = registry.get<RenderableComponent>(entity);
+                const auto& transform  = registry.get<TransformComponent>(entity);
+                Renderer::SubmitSkinned(renderable.model, renderable.shaders, transform.Matrix,
+                                        animator->paletteOffset, animator->poseBounds);
+            }
+            else
+                visible.push_back(entity);
+        });
+
+        // the rest is submitted in slices of SUBMIT_GRAIN entities, each into its own context
+        const size_t sliceCount = (visible.size() + SUBMIT_GRAIN - 1) / SUBMIT_GRAIN;
+        Renderer::BeginContexts(sliceCount);
+        // one reference captured, so std::function keeps the closure inline instead of on the heap
+        struct SubmitInputs {
+            const FrameVector<entt::entity>& visible;
+            entt::registry&                  registry;
+            const glm::vec3&                 eye;
+            const glm::mat4&                 projection;
+            Shader&                          impostorShader;
+        } inputs{visible, registry, eye, projection, impostorShader};
+        JobSystem::ParallelFor(sliceCount, 1, [&inputs](size_t begin, size_t end) {
+            const auto& [visible, registry, eye, projection, impostorShader] = inputs;
+            for (size_t slice = begin; slice < end; ++slice)
+            {
+                Renderer::SubmissionContext& context = Renderer::GetContext(slice);
+                const size_t last = std::min(visible.size(), (slice + 1) * SUBMIT_GRAIN);
+                for (size_t i = slice * SUBMIT_GRAIN; i < last; ++i)
+                {
+                    const auto& renderable = registry.get<RenderableComponent>(visible[i]);
+                    const auto& transform  = registry.get<TransformComponent>(visible[i]);
+
+                    // between the two thresholds both draw, dithered against each other
+                    float fade = renderable.impostor
+                               ? renderable.impostor->Fade(transform.Matrix, eye, projection[1][1])
+                               : 0.0f;
+                    if (fade < 1.0f)
+                        context.Submit(renderable.model, renderable.shaders, transform.Matrix,
+                                       renderable.isStatic, fade);
+                    if (fade > 0.0f)
+                        context.SubmitImpostor(renderable.impostor, &impostorShader, transform.Matrix,
+                                               fade, renderable.isStatic);
+                }
+            }
+        });
+
+        FrameGraphTextureDesc shadowDesc;
+        shadowDesc.Width  = shadows.GetResolution();
+        shadowDesc.Height = shadows.GetResolution();
+        shadowDesc.Format = GL_DEPTH_COMPONENT32F;
+        FrameGraphResource shadowMap  = frameGraph.Import("shadow map", shadowDesc, shadows.GetDepthArray());
+        FrameGraphResource backbuffer = frameGraph.ImportBackbuffer(outputWidth, outputHeight);
 
-        // example: 100 instances of the same model
-        for (int i = 0; i < 100; ++i)
+        // shadow casters come from the same submissions as the main pass
+        frameGraph.AddPass("shadows",
+            [&](FrameGraph::Builder& builder) {
+                builder.Write(shadowMap, FrameGraphAccess::External);
+            },
+            [&](const FrameGraph::Context&) {
+                shadows.Render(shadowShader);
+            });
+
+        sceneTarget.AddPasses(frameGraph, backbuffer,
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(shadowMap);
+            },
+            [&]() {
+                modelShaders.ForEach([&](const Shader& shader) {
+                    shadows.BindForLighting(shader, 8);
+                });
+                shadows.BindForLighting(impostorShader, 8);
+                Renderer::EndScene();
+            });
+
+        frameGraph.Execute();
+
+        // captures get the presented image without the overlay
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        screenCapture.Capture(outputWidth, outputHeight);
+        // over the presented image, with the counters of the whole frame
+        hud.Draw(outputWidth, outputHeight);
+
+        TextureStreamer::Get().Update();
+
+        window.swapBuffers();
+        pacer.endFrame();
+        GpuMemory::EndFrame();
+
+        if (glfwGetTime() - lastMemoryDump >= MEMORY_DUMP_INTERVAL)
         {
-            glm::mat4 modelMat = glm::mat4(1.0f);
-            modelMat = glm::translate(modelMat, glm::vec3(i * 2.0f, 0.0f, 0.0f));
-            Renderer::Submit(&backpack, &modelShader, modelMat);
-        }
+            MemoryReport::Log(MemoryReport::Capture());
+            lastMemoryDump = glfwGetTime();
+
+            const MeshletCuller::Stats& meshlets = MeshletCuller::Get().GetStats();
+            if (meshlets.Triangles)
+                LOG_INFO("MESHLETS::%llu of %llu meshlets, %llu of %llu triangles survived culling",
+                         (unsigned long long)meshlets.VisibleMeshlets, (unsigned long long)meshlets.Meshlets,
+                         (unsigned long long)meshlets.VisibleTriangles, (unsigned long long)meshlets.Triangles);
 
-        Renderer::EndScene();
+            const WorldStreamer::Stats& streaming = world.GetStats();
+            LOG_INFO("STREAMING::%zu of %zu cells loaded, %zu waiting, %u loads pending, load %.1f ms avg %.1f ms max, "
+                     "%llu hitches (worst update %.2f ms)",
+                     streaming.LoadedCells, streaming.Cells, streaming.WaitingCells, streaming.PendingLoads,
+                     streaming.AverageLoadMs, streaming.MaxLoadMs, (unsigned long long)streaming.Hitches,
+                     streaming.MaxUpdateMs);
+        }
 
-        glfwSwapBuffers(window.getGLFWwindow());
-        
+        uint64_t frameAllocations = AllocationCounter::getThreadAllocations() - allocationsAtFrameStart;
+        if (++frameIndex > STEADY_STATE_FRAME && frameAllocations != 0 && !reportedAllocations)
+        {
+            LOG_WARN("WARNING::FRAME::%llu heap allocations in steady-state frame %d",
+                     (unsigned long long)frameAllocations, frameIndex);
+            reportedAllocations = true;
+        }
     }
 
-    glfwTerminate();
+    MemorySnapshot memory = MemoryReport::Capture();
+    MemoryReport::Log(memory);
+    int status = 0;
+    if (checkBudgets && !MemoryReport::CheckBudgets(memory, budgets))
+        status = 1;
+
+    // GL objects above are released as they go out of scope, window (and GLFW) last
+    JobSystem::Shutdown();
+    Log::Shutdown();
 
-    return 0;
+    return status;
 }
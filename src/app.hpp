@@ -11,9 +11,26 @@
 #include "gfx/shader.h"
 #include "gfx/renderer.h"
 #include "gfx/camera.h"
+#include "gfx/shadow_map.h"
+#include "gfx/scene_index.h"
+#include "gfx/static_batch.h"
+#include "gfx/world_streamer.h"
+#include "gfx/impostor.h"
+#include "gfx/animation.h"
+#include "gfx/scene_target.h"
+#include "gfx/frame_graph.h"
+#include "gfx/memory_report.h"
+#include "gfx/perf_hud.h"
+#include "gfx/screen_capture.h"
 #include "core/window.hpp"
+#include "core/job_system.hpp"
+#include "core/frame_pacer.hpp"
+#include "core/log.hpp"
+#include "core/alloc_counter.hpp"
 
 //STANDARD
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <filesystem>
 
@@ -0,0 +1,190 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    constexpr size_t TAG_COUNT = static_cast<size_t>(MemoryTag::Count);
+
+    // sits right in front of every block handed out, keeps the default 16 byte alignment
+    struct alignas(16) AllocationHeader
+    {
+        uint64_t  size;
+        MemoryTag tag;
+    };
+    static_assert(sizeof(AllocationHeader) == 16, "header must preserve malloc alignment");
+
+    thread_local uint64_t  s_ThreadAllocations = 0;
+    thread_local MemoryTag s_CurrentTag        = MemoryTag::General;
+    std::atomic<uint64_t>  s_TotalAllocations{0};
+
+    std::atomic<int64_t>   s_Bytes[TAG_COUNT];
+    std::atomic<int64_t>   s_PeakBytes[TAG_COUNT];
+    std::atomic<int64_t>   s_LiveAllocations[TAG_COUNT];
+
+    void AddBytes(MemoryTag tag, int64_t delta)
+    {
+        size_t  index = static_cast<size_t>(tag);
+        int64_t bytes = s_Bytes[index].fetch_add(delta, std::memory_order_relaxed) + delta;
+        if (delta <= 0)
+            return;
+
+        int64_t peak = s_PeakBytes[index].load(std::memory_order_relaxed);
+        while (bytes > peak && !s_PeakBytes[index].compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        {}
+    }
+
+    void* Record(void* block, size_t headerSize, std::size_t size)
+    {
+        ++s_ThreadAllocations;
+        s_TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        char* user = static_cast<char*>(block) + headerSize;
+        AllocationHeader* header = reinterpret_cast<AllocationHeader*>(user) - 1;
+        header->size = size;
+        header->tag  = s_CurrentTag;
+
+        s_LiveAllocations[static_cast<size_t>(header->tag)].fetch_add(1, std::memory_order_relaxed);
+        AddBytes(header->tag, static_cast<int64_t>(size));
+        return user;
+    }
+
+    // returns the start of the underlying block
+    void* Forget(void* p, size_t headerSize)
+    {
+        AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+        s_LiveAllocations[static_cast<size_t>(header->tag)].fetch_sub(1, std::memory_order_relaxed);
+        AddBytes(header->tag, -static_cast<int64_t>(header->size));
+        return static_cast<char*>(p) - headerSize;
+    }
+
+    void* CountedAlloc(std::size_t size)
+    {
+        void* p = std::malloc(sizeof(AllocationHeader) + size);
+        if (!p)
+            throw std::bad_alloc();
+        return Record(p, sizeof(AllocationHeader), size);
+    }
+
+    // over-aligned blocks reserve a whole alignment unit for the header
+    size_t AlignedHeaderSize(std::align_val_t alignment)
+    {
+        size_t align = static_cast<size_t>(alignment);
+        return align > sizeof(AllocationHeader) ? align : sizeof(AllocationHeader);
+    }
+
+    void* CountedAlignedAlloc(std::size_t size, std::align_val_t alignment)
+    {
+        std::size_t align  = static_cast<std::size_t>(alignment);
+        std::size_t header = AlignedHeaderSize(alignment);
+        std::size_t bytes  = (header + size + align - 1) / align * align;
+#ifdef _WIN32
+        void* p = _aligned_malloc(bytes, align);
+#else
+        void* p = std::aligned_alloc(align, bytes);
+#endif
+        if (!p)
+            throw std::bad_alloc();
+        return Record(p, header, size);
+    }
+
+    void CountedFree(void* p)
+    {
+        if (p)
+            std::free(Forget(p, sizeof(AllocationHeader)));
+    }
+
+    void CountedAlignedFree(void* p, std::align_val_t alignment)
+    {
+        if (!p)
+            return;
+        void* block = Forget(p, AlignedHeaderSize(alignment));
+#ifdef _WIN32
+        _aligned_free(block);
+#else
+        std::free(block);
+#endif
+    }
+}
+
+uint64_t AllocationCounter::getThreadAllocations()
+{
+    return s_ThreadAllocations;
+}
+
+uint64_t AllocationCounter::getTotalAllocations()
+{
+    return s_TotalAllocations.load(std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::getBytes(MemoryTag tag)
+{
+    int64_t bytes = s_Bytes[static_cast<size_t>(tag)].load(std::memory_order_relaxed);
+    return bytes > 0 ? static_cast<size_t>(bytes) : 0;
+}
+
+size_t AllocationCounter::getPeakBytes(MemoryTag tag)
+{
+    return static_cast<size_t>(s_PeakBytes[static_cast<size_t>(tag)].load(std::memory_order_relaxed));
+}
+
+size_t AllocationCounter::getLiveAllocations(MemoryTag tag)
+{
+    int64_t count = s_LiveAllocations[static_cast<size_t>(tag)].load(std::memory_order_relaxed);
+    return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+void AllocationCounter::resetPeaks()
+{
+    for (size_t i = 0; i < TAG_COUNT; ++i)
+        s_PeakBytes[i].store(s_Bytes[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void AllocationCounter::track(MemoryTag tag, int64_t deltaBytes)
+{
+    AddBytes(tag, deltaBytes);
+}
+
+MemoryTag AllocationCounter::getCurrentTag()
+{
+    return s_CurrentTag;
+}
+
+void AllocationCounter::setCurrentTag(MemoryTag tag)
+{
+    s_CurrentTag = tag;
+}
+
+const char* AllocationCounter::getTagName(MemoryTag tag)
+{
+    switch (tag)
+    {
+        case MemoryTag::General:  return "general";
+        case MemoryTag::Mesh:     return "mesh";
+        case MemoryTag::Texture:  return "texture";
+        case MemoryTag::Renderer: return "renderer";
+        case MemoryTag::Frame:    return "frame";
+        default:                  return "unknown";
+    }
+}
+
+// global replacements, every form forwards to the counted helpers
+void* operator new(std::size_t size)                                        { return CountedAlloc(size); }
+void* operator new[](std::size_t size)                                      { return CountedAlloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept        { try { return CountedAlloc(size); } catch (...) { return nullptr; } }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept      { try { return CountedAlloc(size); } catch (...) { return nullptr; } }
+void* operator new(std::size_t size, std::align_val_t align)                { return CountedAlignedAlloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align)              { return CountedAlignedAlloc(size, align); }
+
+void operator delete(void* p) noexcept                                      { CountedFree(p); }
+void operator delete[](void* p) noexcept                                    { CountedFree(p); }
+void operator delete(void* p, std::size_t) noexcept                         { CountedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept                       { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept               { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept             { CountedFree(p); }
+void operator delete(void* p, std::align_val_t align) noexcept              { CountedAlignedFree(p, align); }
+void operator delete[](void* p, std::align_val_t align) noexcept            { CountedAlignedFree(p, align); }
+void operator delete(void* p, std::size_t, std::align_val_t align) noexcept { CountedAlignedFree(p, align); }
+void operator delete[](void* p, std::size_t, std::align_val_t align) noexcept { CountedAlignedFree(p, align); }
@@ -0,0 +1,69 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+// STD. includes
+#include <cstddef>
+#include <cstdint>
+
+/// What a heap allocation is for. Allocations take the calling thread's current tag.
+enum class MemoryTag : uint8_t
+{
+    General,  ///< anything not inside a MemoryTagScope
+    Mesh,     ///< imported geometry and CPU vertex copies
+    Texture,  ///< decoded images and mip chains on their way to the GPU
+    Renderer, ///< per-frame renderer containers
+    Frame,    ///< frame arena blocks (malloc'd, tracked explicitly)
+    Count
+};
+
+/// Counts calls into the global operator new (hooked in alloc_counter.cpp).
+/// Used to check that a steady-state frame never touches the heap.
+/// Every allocation also carries a small header with its size and tag, so live
+/// and peak bytes are known per MemoryTag.
+class AllocationCounter
+{
+public:
+    /// Allocations made by the calling thread since it started.
+    static uint64_t getThreadAllocations();
+    /// Allocations made by every thread since startup.
+    static uint64_t getTotalAllocations();
+
+    /// Bytes currently allocated under a tag.
+    static size_t getBytes(MemoryTag tag);
+    /// Highest getBytes(tag) seen since startup or the last resetPeaks().
+    static size_t getPeakBytes(MemoryTag tag);
+    /// Number of live allocations under a tag.
+    static size_t getLiveAllocations(MemoryTag tag);
+    /// Restarts the high-water marks from the current byte counts.
+    static void resetPeaks();
+
+    /// Accounts memory that does not come from operator new (e.g. malloc'd blocks).
+    static void track(MemoryTag tag, int64_t deltaBytes);
+
+    /// The calling thread's current tag.
+    static MemoryTag getCurrentTag();
+    static const char* getTagName(MemoryTag tag);
+
+private:
+    friend class MemoryTagScope;
+    static void setCurrentTag(MemoryTag tag);
+};
+
+/// Tags the calling thread's allocations until the scope ends (scopes nest).
+class MemoryTagScope
+{
+public:
+    explicit MemoryTagScope(MemoryTag tag) : m_Previous(AllocationCounter::getCurrentTag())
+    {
+        AllocationCounter::setCurrentTag(tag);
+    }
+    ~MemoryTagScope() { AllocationCounter::setCurrentTag(m_Previous); }
+
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+private:
+    MemoryTag m_Previous;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "frame_arena.hpp"
+#include "alloc_counter.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+LinearArena::LinearArena(size_t initialSize)
+{
+    AddBlock(initialSize);
+}
+
+LinearArena::~LinearArena()
+{
+    for (const Block& block : m_Blocks)
+        std::free(block.data);
+    AllocationCounter::track(MemoryTag::Frame, -static_cast<int64_t>(m_Capacity));
+}
+
+void* LinearArena::Allocate(size_t size, size_t alignment)
+{
+    Block& block = m_Blocks.back();
+
+    uintptr_t base    = reinterpret_cast<uintptr_t>(block.data);
+    uintptr_t aligned = (base + m_Offset + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    size_t    offset  = aligned - base;
+
+    if (offset + size > block.size)
+    {
+        // chain a new block, Reset folds it into one big block next frame
+        AddBlock(std::max(block.size * 2, size + alignment));
+        return Allocate(size, alignment);
+    }
+
+    m_Offset = offset + size;
+    m_Used  += size;
+    return block.data + offset;
+}
+
+void LinearArena::Reset()
+{
+    m_HighWater = std::max(m_HighWater, m_Used);
+
+    if (m_Blocks.size() > 1)
+    {
+        size_t total = m_Capacity;
+        for (const Block& block : m_Blocks)
+            std::free(block.data);
+        m_Blocks.clear();
+        AllocationCounter::track(MemoryTag::Frame, -static_cast<int64_t>(m_Capacity));
+        m_Capacity = 0;
+        AddBlock(total);
+    }
+
+    m_Offset = 0;
+    m_Used   = 0;
+}
+
+void LinearArena::AddBlock(size_t size)
+{
+    char* data = static_cast<char*>(std::malloc(size));
+    if (!data)
+        throw std::bad_alloc();
+
+    m_Blocks.push_back(Block{ data, size });
+    m_Capacity += size;
+    AllocationCounter::track(MemoryTag::Frame, static_cast<int64_t>(size));
+    m_Offset    = 0;
+}
+
+namespace
+{
+    struct ArenaRegistry
+    {
+        std::mutex                mutex;
+        std::vector<LinearArena*> arenas;
+    };
+
+    // function local so static containers elsewhere can use frame arenas during static init
+    ArenaRegistry& GetRegistry()
+    {
+        static ArenaRegistry registry;
+        return registry;
+    }
+
+    // registers itself so ResetAll can reach every thread's arena
+    struct ThreadArena
+    {
+        LinearArena arena;
+
+        ThreadArena()
+        {
+            ArenaRegistry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.arenas.push_back(&arena);
+        }
+        ~ThreadArena()
+        {
+            ArenaRegistry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.arenas.erase(std::find(registry.arenas.begin(), registry.arenas.end(), &arena));
+        }
+    };
+}
+
+LinearArena& FrameArena::Get()
+{
+    thread_local ThreadArena threadArena;
+    return threadArena.arena;
+}
+
+void FrameArena::ResetAll()
+{
+    ArenaRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (LinearArena* arena : registry.arenas)
+        arena->Reset();
+}
@@ -0,0 +1,92 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+// STD. includes
+#include <cstddef>
+#include <map>
+#include <vector>
+
+/// A bump allocator. Individual frees are no-ops, everything is released at once by Reset.
+/// When a frame outgrows the current block another one is chained on, and the next Reset
+/// merges them into a single block, so a steady workload stops touching the heap.
+class LinearArena
+{
+public:
+    explicit LinearArena(size_t initialSize = 256 * 1024);
+    ~LinearArena();
+
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment);
+    /// Invalidates every allocation made since the last reset.
+    void  Reset();
+
+    /// Bytes handed out since the last reset.
+    inline size_t getUsed() const { return m_Used; }
+    /// Bytes reserved from the heap.
+    inline size_t getCapacity() const { return m_Capacity; }
+    /// Largest getUsed() seen at a reset.
+    inline size_t getHighWater() const { return m_HighWater; }
+
+private:
+    struct Block {
+        char*  data;
+        size_t size;
+    };
+
+    std::vector<Block> m_Blocks;
+    size_t m_Offset    = 0; // into m_Blocks.back()
+    size_t m_Used      = 0;
+    size_t m_Capacity  = 0;
+    size_t m_HighWater = 0;
+
+    void AddBlock(size_t size);
+};
+
+/// One arena per thread for data that only lives until the end of the current frame.
+class FrameArena
+{
+public:
+    /// The calling thread's arena, created on first use.
+    static LinearArena& Get();
+    /// Resets every thread's arena. Call at the frame boundary, when nobody holds frame data.
+    static void ResetAll();
+};
+
+/// STL allocator over a LinearArena. Default constructed instances use the calling
+/// thread's frame arena, so containers of containers pick it up automatically.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept : m_Arena(&FrameArena::Get()) {}
+    explicit ArenaAllocator(LinearArena& arena) noexcept : m_Arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_Arena(other.m_Arena) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_Arena->Allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return m_Arena == other.m_Arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return m_Arena != other.m_Arena; }
+
+private:
+    template <typename U> friend class ArenaAllocator;
+    LinearArena* m_Arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename K, typename V, typename Compare = std::less<K>>
+using FrameMap = std::map<K, V, Compare, ArenaAllocator<std::pair<const K, V>>>;
+
+#endif
@@ -0,0 +1,183 @@
+#include "frame_pacer.hpp"
+
+#include "log.hpp"
+
+// STD. includes
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    // blocking fence waits are retried in slices; after FENCE_WAIT_SLICES (a lost
+    // context or a hung GPU) the fence is given up on so the loop keeps running
+    constexpr GLuint64 FENCE_WAIT_NS     = 100 * 1000 * 1000;
+    constexpr int      FENCE_WAIT_SLICES = 20;
+    // the frame cap sleeps until this close to the deadline, then yields
+    constexpr double   SPIN_MARGIN_MS = 1.0;
+
+    inline double toMs(std::chrono::steady_clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+}
+
+Histogram::Histogram(double bucketMs, double maxMs)
+    : m_BucketMs(bucketMs), m_Buckets((size_t)std::ceil(maxMs / bucketMs) + 1, 0)
+{}
+
+void Histogram::record(double ms)
+{
+    size_t bucket = ms <= 0.0 ? 0 : (size_t)(ms / m_BucketMs);
+    bucket = std::min(bucket, m_Buckets.size() - 1);
+    ++m_Buckets[bucket];
+    ++m_Count;
+    m_Sum += ms;
+    m_Max  = std::max(m_Max, ms);
+}
+
+void Histogram::reset()
+{
+    std::fill(m_Buckets.begin(), m_Buckets.end(), 0);
+    m_Count = 0;
+    m_Sum   = 0.0;
+    m_Max   = 0.0;
+}
+
+double Histogram::getPercentile(double fraction) const
+{
+    if (m_Count == 0)
+        return 0.0;
+
+    uint64_t target = (uint64_t)std::ceil(std::clamp(fraction, 0.0, 1.0) * m_Count);
+    uint64_t seen   = 0;
+    for (size_t i = 0; i + 1 < m_Buckets.size(); ++i)
+    {
+        seen += m_Buckets[i];
+        if (seen >= std::max<uint64_t>(target, 1))
+            return (i + 1) * m_BucketMs;
+    }
+    return m_Max;
+}
+
+FramePacer::FramePacer(const FramePacingSettings& settings)
+{
+    configure(settings);
+}
+
+FramePacer::~FramePacer()
+{
+    for (size_t i = 0; i < m_InFlightCount; ++i)
+        glDeleteSync(m_InFlight[(m_InFlightHead + i) % MAX_FRAMES_IN_FLIGHT].fence);
+}
+
+void FramePacer::configure(const FramePacingSettings& settings)
+{
+    m_Settings = settings;
+    m_Settings.fixedTimestep    = std::max(settings.fixedTimestep, 1e-4);
+    m_Settings.maxStepsPerFrame = std::max(settings.maxStepsPerFrame, 1);
+}
+
+double FramePacer::beginFrame()
+{
+    Clock::time_point waitStart = Clock::now();
+
+    waitForCap();
+
+    // frame N may only start once frame N - maxFramesInFlight is off the GPU
+    size_t limit = MAX_FRAMES_IN_FLIGHT - 1;
+    if (m_Settings.maxFramesInFlight > 0)
+        limit = std::min<size_t>(m_Settings.maxFramesInFlight - 1, limit);
+    retireFrames(limit);
+
+    Clock::time_point now = Clock::now();
+    m_WaitTimes.record(toMs(now - waitStart));
+
+    if (m_Started)
+    {
+        m_DeltaTime = std::chrono::duration<double>(now - m_FrameStart).count();
+        m_FrameTimes.record(m_DeltaTime * 1000.0);
+    }
+    m_Started    = true;
+    m_FrameStart = now;
+    m_InputTime  = now; // the caller polls input right after this returns
+    ++m_FrameIndex;
+
+    // long stalls (loading, debugger) are dropped instead of simulated
+    m_Accumulator   += std::min(m_DeltaTime, m_Settings.fixedTimestep * m_Settings.maxStepsPerFrame);
+    m_StepsThisFrame = 0;
+
+    return m_DeltaTime;
+}
+
+bool FramePacer::step()
+{
+    if (m_Accumulator < m_Settings.fixedTimestep)
+        return false;
+
+    if (m_StepsThisFrame >= m_Settings.maxStepsPerFrame)
+    {
+        m_Accumulator = std::fmod(m_Accumulator, m_Settings.fixedTimestep);
+        return false;
+    }
+
+    m_Accumulator -= m_Settings.fixedTimestep;
+    ++m_StepsThisFrame;
+    return true;
+}
+
+void FramePacer::endFrame()
+{
+    if (m_InFlightCount == MAX_FRAMES_IN_FLIGHT)
+        retireFrames(MAX_FRAMES_IN_FLIGHT - 1);
+
+    InFlightFrame& frame = m_InFlight[(m_InFlightHead + m_InFlightCount) % MAX_FRAMES_IN_FLIGHT];
+    frame.fence     = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame.inputTime = m_InputTime;
+    ++m_InFlightCount;
+}
+
+void FramePacer::retireFrames(size_t limit)
+{
+    int slices = 0;
+    while (m_InFlightCount > 0)
+    {
+        InFlightFrame& frame = m_InFlight[m_InFlightHead];
+        bool mustWait = m_InFlightCount > limit;
+
+        GLenum status = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, mustWait ? FENCE_WAIT_NS : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            if (!mustWait)
+                break;
+            if (++slices < FENCE_WAIT_SLICES)
+                continue;
+            LOG_ERROR("ERROR::FRAME_PACER::Frame fence did not signal within %d ms, dropping it",
+                      int(FENCE_WAIT_SLICES * (FENCE_WAIT_NS / 1000000)));
+        }
+        slices = 0;
+
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+            m_Latencies.record(toMs(Clock::now() - frame.inputTime));
+
+        glDeleteSync(frame.fence);
+        m_InFlightHead = (m_InFlightHead + 1) % MAX_FRAMES_IN_FLIGHT;
+        --m_InFlightCount;
+    }
+}
+
+void FramePacer::waitForCap()
+{
+    if (!m_Started || m_Settings.frameCap <= 0.0)
+        return;
+
+    Clock::time_point deadline = m_FrameStart +
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_Settings.frameCap));
+
+    // sleep is coarse on most platforms, so only sleep for the bulk and yield for the rest
+    double remaining = toMs(deadline - Clock::now());
+    if (remaining > SPIN_MARGIN_MS)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining - SPIN_MARGIN_MS));
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
@@ -0,0 +1,130 @@
+#ifndef FRAME_PACER_HPP
+#define FRAME_PACER_HPP
+
+// STD. includes
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// GLAD
+#include <glad/glad.h>
+
+#define MAX_FRAMES_IN_FLIGHT 8
+
+/// Fixed-width buckets over [0, maxMs) plus one overflow bucket.
+/// Recording never allocates, so it is safe inside the frame loop.
+class Histogram
+{
+public:
+    explicit Histogram(double bucketMs = 0.25, double maxMs = 100.0);
+
+    void record(double ms);
+    void reset();
+
+    inline uint64_t getCount() const { return m_Count; }
+    inline double getMean() const { return m_Count ? m_Sum / m_Count : 0.0; }
+    inline double getMax() const { return m_Max; }
+    /// Upper edge of the bucket holding the given fraction (0..1) of samples.
+    double getPercentile(double fraction) const;
+
+    inline double getBucketWidth() const { return m_BucketMs; }
+    inline const std::vector<uint32_t>& getBuckets() const { return m_Buckets; }
+
+private:
+    double                m_BucketMs;
+    std::vector<uint32_t> m_Buckets; // last one collects everything >= maxMs
+    uint64_t              m_Count = 0;
+    double                m_Sum   = 0.0;
+    double                m_Max   = 0.0;
+};
+
+/// How the frame loop is paced.
+struct FramePacingSettings
+{
+    /// Length of one simulation step in seconds.
+    double fixedTimestep     = 1.0 / 120.0;
+    /// Simulation steps allowed per frame before time is dropped (avoids the spiral of death).
+    int    maxStepsPerFrame  = 8;
+    /// Passed to glfwSwapInterval, 0 disables vsync.
+    int    swapInterval      = 1;
+    /// Frames per second limit, 0 for none.
+    double frameCap          = 0.0;
+    /// Frames the CPU may queue ahead of the GPU, 0 for no limit (up to MAX_FRAMES_IN_FLIGHT).
+    /// 1 keeps input sampling right behind the GPU for the lowest latency.
+    int    maxFramesInFlight = 2;
+};
+
+/// Drives the frame loop: fixed-timestep simulation with render interpolation,
+/// an optional frame cap and a fence-based limit on how far the CPU runs ahead.
+///
+///     pacer.beginFrame();          // waits as needed, input is sampled after this
+///     while (pacer.step()) { ... } // simulate with getFixedTimestep()
+///     render(pacer.getAlpha());    // blend previous and current state
+///     swap; pacer.endFrame();
+class FramePacer
+{
+public:
+    explicit FramePacer(const FramePacingSettings& settings = FramePacingSettings());
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    /// Swap interval is applied by the window, the rest takes effect next frame.
+    void configure(const FramePacingSettings& settings);
+    inline const FramePacingSettings& getSettings() const { return m_Settings; }
+
+    /// Applies the frame cap and run-ahead limit, then starts the frame. Returns the real frame delta.
+    double beginFrame();
+    /// True while another fixed step is due this frame.
+    bool step();
+    /// Fences the frame just submitted. Call right after SwapBuffers.
+    void endFrame();
+
+    inline float getFixedTimestep() const { return (float)m_Settings.fixedTimestep; }
+    /// How far between the previous and the current simulation state this frame is rendered (0..1).
+    inline float getAlpha() const { return (float)(m_Accumulator / m_Settings.fixedTimestep); }
+    /// Real time the last frame took, in seconds.
+    inline float getDeltaTime() const { return (float)m_DeltaTime; }
+    inline uint64_t getFrameIndex() const { return m_FrameIndex; }
+
+    /// Time between consecutive beginFrame calls.
+    inline const Histogram& getFrameTimes() const { return m_FrameTimes; }
+    /// Input sampling to the GPU finishing that frame. Only frames whose fence was
+    /// observed are counted, the end is when the CPU noticed, not the exact GPU time.
+    inline const Histogram& getLatencies() const { return m_Latencies; }
+    /// Time spent in beginFrame waiting on the cap or the GPU.
+    inline const Histogram& getWaitTimes() const { return m_WaitTimes; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct InFlightFrame
+    {
+        GLsync            fence;
+        Clock::time_point inputTime;
+    };
+
+    FramePacingSettings       m_Settings;
+    InFlightFrame             m_InFlight[MAX_FRAMES_IN_FLIGHT]; // ring, oldest at m_InFlightHead
+    size_t                    m_InFlightHead  = 0;
+    size_t                    m_InFlightCount = 0;
+    Clock::time_point         m_FrameStart;
+    Clock::time_point         m_InputTime;
+    double                    m_Accumulator = 0.0;
+    double                    m_DeltaTime   = 0.0;
+    int                       m_StepsThisFrame = 0;
+    uint64_t                  m_FrameIndex  = 0;
+    bool                      m_Started     = false;
+
+    Histogram m_FrameTimes;
+    Histogram m_Latencies;
+    Histogram m_WaitTimes;
+
+    /// Retires signaled fences, blocking on the oldest ones while more than limit are queued.
+    /// A fence that stays unsignaled for FENCE_WAIT_SLICES waits is dropped with an error.
+    void retireFrames(size_t limit);
+    void waitForCap();
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // jobs in a ring that only grows, so queueing in the steady state does not allocate
+    struct Pool
+    {
+        std::vector<std::thread>           workers;
+        std::vector<std::function<void()>> queue;
+        size_t                             head  = 0;
+        size_t                             count = 0;
+        std::mutex                         mutex;
+        std::condition_variable            wake;
+        bool                               stopping = false;
+
+        void Push(std::function<void()>&& job)
+        {
+            if (count == queue.size())
+            {
+                std::vector<std::function<void()>> grown(std::max<size_t>(16, queue.size() * 2));
+                for (size_t i = 0; i < count; ++i)
+                    grown[i] = std::move(queue[(head + i) % queue.size()]);
+                queue.swap(grown);
+                head = 0;
+            }
+            queue[(head + count) % queue.size()] = std::move(job);
+            ++count;
+        }
+
+        std::function<void()> Pop()
+        {
+            std::function<void()> job = std::move(queue[head]);
+            queue[head] = nullptr;
+            head = (head + 1) % queue.size();
+            --count;
+            return job;
+        }
+    };
+
+    Pool                      s_Pool;
+    std::mutex                s_InitMutex;
+    std::atomic<unsigned int> s_WorkerCount{0};
+
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(s_Pool.mutex);
+                s_Pool.wake.wait(lock, [] { return s_Pool.stopping || s_Pool.count > 0; });
+                if (s_Pool.count == 0)
+                    return; // stopping and drained
+                job = s_Pool.Pop();
+            }
+            job();
+        }
+    }
+
+    // shared between the caller of ParallelFor and the helper jobs it spawns,
+    // helpers that start late simply find no chunks left. The last of them to let
+    // go puts it back on the free list, so ParallelFor reuses states instead of
+    // allocating one per call.
+    struct ParallelForState
+    {
+        std::atomic<size_t>     next{0};
+        std::atomic<size_t>     references{0};
+        size_t                  done = 0;
+        size_t                  chunks = 0;
+        size_t                  chunkSize = 0;
+        size_t                  count = 0;
+        std::mutex              mutex;
+        std::condition_variable finished;
+    };
+
+    std::mutex                                     s_StateMutex;
+    std::vector<std::unique_ptr<ParallelForState>> s_FreeStates;
+
+    ParallelForState* AcquireState()
+    {
+        std::lock_guard<std::mutex> lock(s_StateMutex);
+        if (s_FreeStates.empty())
+            return new ParallelForState();
+        ParallelForState* state = s_FreeStates.back().release();
+        s_FreeStates.pop_back();
+        return state;
+    }
+
+    void ReleaseState(ParallelForState* state)
+    {
+        if (--state->references != 0)
+            return;
+        std::lock_guard<std::mutex> lock(s_StateMutex);
+        s_FreeStates.emplace_back(state);
+    }
+
+    void RunChunks(ParallelForState& state, const std::function<void(size_t, size_t)>& fn)
+    {
+        size_t completed = 0;
+        for (size_t chunk = state.next++; chunk < state.chunks; chunk = state.next++)
+        {
+            size_t begin = chunk * state.chunkSize;
+            size_t end   = std::min(begin + state.chunkSize, state.count);
+            fn(begin, end);
+            ++completed;
+        }
+
+        if (completed)
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.done += completed;
+            if (state.done == state.chunks)
+                state.finished.notify_all();
+        }
+    }
+}
+
+void JobSystem::Init(unsigned int threadCount)
+{
+    std::lock_guard<std::mutex> initLock(s_InitMutex);
+    if (!s_Pool.workers.empty())
+        return;
+
+    if (threadCount == 0)
+    {
+        unsigned int hw = std::thread::hardware_concurrency();
+        threadCount = hw > 1 ? hw - 1 : 1;
+    }
+
+    s_Pool.stopping = false;
+    for (unsigned int i = 0; i < threadCount; ++i)
+        s_Pool.workers.emplace_back(WorkerLoop);
+    s_WorkerCount = threadCount;
+}
+
+void JobSystem::Shutdown()
+{
+    std::lock_guard<std::mutex> initLock(s_InitMutex);
+    {
+        std::lock_guard<std::mutex> lock(s_Pool.mutex);
+        s_Pool.stopping = true;
+    }
+    s_Pool.wake.notify_all();
+
+    for (auto& worker : s_Pool.workers)
+        worker.join();
+    s_Pool.workers.clear();
+    s_WorkerCount = 0;
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+    if (WorkerCount() == 0)
+        Init();
+
+    {
+        std::lock_guard<std::mutex> lock(s_Pool.mutex);
+        s_Pool.Push(std::move(job));
+    }
+    s_Pool.wake.notify_one();
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+    if (count == 0)
+        return;
+
+    unsigned int workers = WorkerCount();
+    grain = std::max<size_t>(grain, 1);
+
+    // not worth waking anyone up
+    if (workers == 0 || count <= grain)
+    {
+        fn(0, count);
+        return;
+    }
+
+    // a few chunks per thread so uneven work still balances
+    size_t threads   = workers + 1;
+    size_t chunkSize = std::max(grain, (count + threads * 4 - 1) / (threads * 4));
+
+    ParallelForState* state = AcquireState();
+    state->next      = 0;
+    state->done      = 0;
+    state->count     = count;
+    state->chunkSize = chunkSize;
+    state->chunks    = (count + chunkSize - 1) / chunkSize;
+
+    size_t helpers = std::min<size_t>(workers, state->chunks - 1);
+    state->references = helpers + 1;
+    // two pointers, small enough for std::function to keep inline
+    const std::function<void(size_t, size_t)>* body = &fn;
+    for (size_t i = 0; i < helpers; ++i)
+    {
+        Submit([state, body] {
+            RunChunks(*state, *body);
+            ReleaseState(state);
+        });
+    }
+
+    RunChunks(*state, fn);
+
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [state] { return state->done == state->chunks; });
+    }
+    ReleaseState(state);
+}
+
+unsigned int JobSystem::WorkerCount()
+{
+    return s_WorkerCount;
+}
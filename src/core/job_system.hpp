@@ -0,0 +1,29 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+// STD. includes
+#include <cstddef>
+#include <functional>
+
+/// A small fixed-size pool of worker threads shared by the engine.
+/// Jobs must not touch the GL context, only the main thread owns it.
+class JobSystem
+{
+public:
+    /// Starts the workers. 0 picks hardware_concurrency - 1 (at least one).
+    static void Init(unsigned int threadCount = 0);
+    /// Finishes every queued job and joins the workers.
+    static void Shutdown();
+
+    /// Queues a fire-and-forget job (starts the pool lazily if needed).
+    static void Submit(std::function<void()> job);
+
+    /// Runs fn(begin, end) over [0, count) split into chunks of at least grain items.
+    /// The calling thread takes part and the call returns once every chunk is done.
+    static void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    /// Number of worker threads (not counting the caller of ParallelFor).
+    static unsigned int WorkerCount();
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include "log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // how long the writer sleeps when nothing urgent arrives
+    constexpr std::chrono::milliseconds WRITER_INTERVAL(5);
+
+    struct Record
+    {
+        double     time;
+        Log::Level level;
+        uint32_t   thread;
+        char       text[LOG_MESSAGE_SIZE];
+    };
+
+    /// Single producer (the owning thread), single consumer (the writer thread).
+    class Ring
+    {
+    public:
+        explicit Ring(uint32_t thread) : m_Thread(thread) {}
+
+        /// Slot to format into, null when full.
+        Record* beginPush()
+        {
+            size_t head = m_Head.load(std::memory_order_relaxed);
+            if (head - m_Tail.load(std::memory_order_acquire) >= LOG_RING_CAPACITY)
+                return nullptr;
+            return &m_Records[head % LOG_RING_CAPACITY];
+        }
+        void endPush() { m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        /// Records [tail, head) are stable until the consumer pops them.
+        size_t available() const
+        {
+            return m_Head.load(std::memory_order_acquire) - m_Tail.load(std::memory_order_relaxed);
+        }
+        const Record& peek(size_t i) const { return m_Records[(m_Tail.load(std::memory_order_relaxed) + i) % LOG_RING_CAPACITY]; }
+        void pop(size_t count) { m_Tail.store(m_Tail.load(std::memory_order_relaxed) + count, std::memory_order_release); }
+
+        inline uint32_t getThread() const { return m_Thread; }
+
+    private:
+        Record              m_Records[LOG_RING_CAPACITY];
+        alignas(64) std::atomic<size_t> m_Head{0};
+        alignas(64) std::atomic<size_t> m_Tail{0};
+        uint32_t            m_Thread;
+    };
+
+    struct Writer
+    {
+        std::mutex                          mutex;   // rings list, output and the writer thread
+        std::condition_variable             wake;
+        std::vector<std::shared_ptr<Ring>>  rings;
+        std::thread                         thread;
+        FILE*                               out      = stdout;
+        bool                                stopping = false;
+        std::atomic<bool>                   running{false};
+        std::atomic<int>                    level{0};
+        std::atomic<uint64_t>               dropped{0};
+        uint64_t                            reportedDropped = 0;
+        std::atomic<uint32_t>               nextThread{0};
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        ~Writer() { stop(); }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!thread.joinable())
+                    return;
+                stopping = true;
+            }
+            wake.notify_one();
+            thread.join();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            running.store(false, std::memory_order_release);
+            if (out != stdout)
+            {
+                std::fclose(out);
+                out = stdout;
+            }
+        }
+    };
+
+    Writer& GetWriter()
+    {
+        static Writer writer;
+        return writer;
+    }
+
+    // owned jointly with the writer, so messages survive their thread exiting
+    thread_local std::shared_ptr<Ring> t_Ring;
+
+    Ring& ThreadRing()
+    {
+        if (!t_Ring)
+        {
+            Writer& writer = GetWriter();
+            t_Ring = std::make_shared<Ring>(writer.nextThread++);
+            std::lock_guard<std::mutex> lock(writer.mutex);
+            writer.rings.push_back(t_Ring);
+        }
+        return *t_Ring;
+    }
+
+    const char* LevelName(Log::Level level)
+    {
+        switch (level)
+        {
+            case Log::Level::Trace: return "TRACE";
+            case Log::Level::Debug: return "DEBUG";
+            case Log::Level::Info:  return "INFO ";
+            case Log::Level::Warn:  return "WARN ";
+            default:                return "ERROR";
+        }
+    }
+
+    struct Pending
+    {
+        const Record* record;
+        Ring*         ring;
+    };
+
+    // writes everything queued so far, called with writer.mutex held
+    void Drain(Writer& writer, std::vector<Pending>& batch)
+    {
+        batch.clear();
+        for (const auto& ring : writer.rings)
+        {
+            size_t count = ring->available();
+            for (size_t i = 0; i < count; ++i)
+                batch.push_back(Pending{ &ring->peek(i), ring.get() });
+        }
+        if (batch.empty())
+            return;
+
+        // each ring is already in order, this interleaves the threads
+        std::stable_sort(batch.begin(), batch.end(), [](const Pending& a, const Pending& b) {
+            return a.record->time < b.record->time;
+        });
+
+        for (const Pending& p : batch)
+        {
+            std::fprintf(writer.out, "[%10.4f][%s][t%u] %s\n",
+                         p.record->time, LevelName(p.record->level), p.record->thread, p.record->text);
+        }
+        uint64_t dropped = writer.dropped.load(std::memory_order_relaxed);
+        if (dropped != writer.reportedDropped)
+        {
+            std::fprintf(writer.out, "[LOG] %llu messages dropped, a ring was full\n",
+                         (unsigned long long)(dropped - writer.reportedDropped));
+            writer.reportedDropped = dropped;
+        }
+        std::fflush(writer.out);
+
+        for (const Pending& p : batch)
+            p.ring->pop(1);
+
+        // rings of exited threads go once they are empty
+        writer.rings.erase(std::remove_if(writer.rings.begin(), writer.rings.end(), [](const std::shared_ptr<Ring>& ring) {
+            return ring.use_count() == 1 && ring->available() == 0;
+        }), writer.rings.end());
+    }
+
+    void WriterLoop()
+    {
+        Writer& writer = GetWriter();
+        std::vector<Pending> batch;
+
+        std::unique_lock<std::mutex> lock(writer.mutex);
+        for (;;)
+        {
+            Drain(writer, batch);
+            if (writer.stopping)
+                break;
+            writer.wake.wait_for(lock, WRITER_INTERVAL);
+        }
+        Drain(writer, batch);
+    }
+}
+
+void Log::Init(const char* path)
+{
+    Writer& writer = GetWriter();
+    std::lock_guard<std::mutex> lock(writer.mutex);
+
+    if (path)
+    {
+        FILE* file = std::fopen(path, "w");
+        if (!file)
+        {
+            std::fprintf(stderr, "ERROR::LOG::Could not open %s, logging to stdout\n", path);
+        }
+        else
+        {
+            if (writer.out != stdout)
+                std::fclose(writer.out);
+            writer.out = file;
+        }
+    }
+
+    if (writer.running.load(std::memory_order_acquire))
+        return;
+
+    writer.stopping = false;
+    writer.thread   = std::thread(WriterLoop);
+    writer.running.store(true, std::memory_order_release);
+}
+
+void Log::Shutdown()
+{
+    GetWriter().stop();
+}
+
+void Log::SetLevel(Level level)
+{
+    GetWriter().level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool Log::IsEnabled(Level level)
+{
+    return static_cast<int>(level) >= GetWriter().level.load(std::memory_order_relaxed);
+}
+
+void Log::Write(Level level, const char* format, ...)
+{
+    Writer& writer = GetWriter();
+    if (static_cast<int>(level) < writer.level.load(std::memory_order_relaxed))
+        return;
+    if (!writer.running.load(std::memory_order_acquire))
+        Init();
+
+    Ring&   ring   = ThreadRing();
+    Record* record = ring.beginPush();
+    if (!record)
+    {
+        writer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    record->time   = std::chrono::duration<double>(std::chrono::steady_clock::now() - writer.start).count();
+    record->level  = level;
+    record->thread = ring.getThread();
+
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(record->text, LOG_MESSAGE_SIZE, format, args);
+    va_end(args);
+
+    ring.endPush();
+
+    // errors should reach the output even if the process dies right after
+    if (level >= Level::Error)
+        writer.wake.notify_one();
+}
+
+uint64_t Log::GetDroppedCount()
+{
+    return GetWriter().dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,89 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+// STD. includes
+#include <cstdint>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF   5
+
+/// Statements below LOG_LEVEL are removed by the preprocessor, arguments included.
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+/// Bytes of formatted text kept per message, longer messages are truncated.
+#define LOG_MESSAGE_SIZE  240
+/// Messages each thread can have queued before new ones are dropped.
+#define LOG_RING_CAPACITY 1024
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LOG_PRINTF_FORMAT(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#define LOG_PRINTF_FORMAT(fmt, args)
+#endif
+
+/// Asynchronous logger. Write formats printf-style straight into a per-thread
+/// single-producer ring, without locks or heap allocations (after the thread's
+/// first message). A background thread drains all rings in timestamp order to
+/// stdout or a file. When a ring is full the message is dropped and counted,
+/// the caller never waits on I/O.
+class Log
+{
+public:
+    enum class Level : uint8_t { Trace, Debug, Info, Warn, Error };
+
+    /// Starts the writer thread. path null writes to stdout. Called lazily by the first Write.
+    static void Init(const char* path = nullptr);
+    /// Writes everything still queued and stops the writer thread.
+    static void Shutdown();
+
+    /// Runtime filter on top of LOG_LEVEL.
+    static void SetLevel(Level level);
+    static bool IsEnabled(Level level);
+
+    static void Write(Level level, const char* format, ...) LOG_PRINTF_FORMAT(2, 3);
+
+    /// Messages lost to full rings since startup.
+    static uint64_t GetDroppedCount();
+};
+
+#if LOG_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) ::Log::Write(::Log::Level::Trace, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) ::Log::Write(::Log::Level::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) ::Log::Write(::Log::Level::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) ::Log::Write(::Log::Level::Warn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) ::Log::Write(::Log::Level::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif
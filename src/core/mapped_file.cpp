@@ -0,0 +1,112 @@
+#include "mapped_file.hpp"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+        HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart > 0
+                       ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)
+                       : nullptr;
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (view)
+        {
+            m_File    = file;
+            m_Mapping = mapping;
+            m_Data    = static_cast<const unsigned char*>(view);
+            m_Size    = static_cast<size_t>(size.QuadPart);
+            m_Mapped  = true;
+            return true;
+        }
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat info;
+        void* view = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+            view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (view != MAP_FAILED)
+        {
+            // read front to back, let the kernel read ahead
+            madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            m_Data   = static_cast<const unsigned char*>(view);
+            m_Size   = static_cast<size_t>(info.st_size);
+            m_Mapped = true;
+            return true;
+        }
+    }
+#endif
+
+    // no mapping (or an empty file): read it the plain way
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    m_Buffer.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    bool ok = std::fread(m_Buffer.data(), 1, m_Buffer.size(), file) == m_Buffer.size();
+    std::fclose(file);
+    if (!ok)
+    {
+        m_Buffer.clear();
+        return false;
+    }
+
+    // an empty file still counts as open
+    static const unsigned char empty = 0;
+    m_Data = m_Buffer.empty() ? &empty : m_Buffer.data();
+    m_Size = m_Buffer.size();
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_Mapped)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_Mapping);
+        CloseHandle(m_File);
+        m_File    = nullptr;
+        m_Mapping = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(m_Data), m_Size);
+#endif
+    }
+    m_Data   = nullptr;
+    m_Size   = 0;
+    m_Mapped = false;
+    std::vector<unsigned char>().swap(m_Buffer);
+}
@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+// STD. includes
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// Read-only view of a whole file. Memory-mapped where the platform supports it,
+/// so pages are read in on first touch and nothing is copied; otherwise the file
+/// is read into a buffer.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Maps path, closing whatever was open. False if it cannot be read.
+    bool open(const std::string& path);
+    void close();
+
+    inline bool isOpen() const { return m_Data != nullptr; }
+    inline const unsigned char* getData() const { return m_Data; }
+    inline size_t getSize() const { return m_Size; }
+
+private:
+    const unsigned char* m_Data = nullptr;
+    size_t               m_Size = 0;
+    bool                 m_Mapped = false;
+    std::vector<unsigned char> m_Buffer; // when not mapped
+#ifdef _WIN32
+    void* m_File    = nullptr;
+    void* m_Mapping = nullptr;
+#endif
+};
+
+#endif
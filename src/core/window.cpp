@@ -1,8 +1,11 @@
 #include "window.hpp"
 
-Window::Window(const char *title, int width, int height) : backgroundColor(glm::vec4(0, 0, 0, 1))
+#include "log.hpp"
+
+Window::Window(const char *title, int width, int height, int samples) : backgroundColor(glm::vec4(0, 0, 0, 1))
 {
     m_Title = title;
+    m_Samples = samples;
     m_Width = (float)width;
     m_Height = (float)height;
     if(!init())
@@ -45,13 +48,15 @@ bool Window::init()
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
 #endif
 
-    glfwWindowHint(GLFW_SAMPLES, 16);
+    glfwWindowHint(GLFW_SAMPLES, m_Samples);
+    // asked for, not guaranteed: the encoding actually granted is checked below
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 
     m_Window = glfwCreateWindow(m_Width, m_Height, m_Title, NULL, NULL);
     if(!m_Window)
     {
         glfwTerminate();
-        std::cerr << "ERROR::GLFW::Could not initialise GLFW Window" << '\n';
+        LOG_ERROR("ERROR::GLFW::Could not initialise GLFW Window");
         return false;
     }
     glfwMakeContextCurrent(m_Window);
@@ -68,15 +73,24 @@ bool Window::init()
     int status = gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
     // Print out some info about the graphics drivers
-    std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
-    std::cout << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
-    std::cout << "Vendor: " << glGetString(GL_VENDOR) << std::endl;
-    std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+    LOG_INFO("OpenGL version: %s", (const char*)glGetString(GL_VERSION));
+    LOG_INFO("GLSL version: %s", (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
+    LOG_INFO("Vendor: %s", (const char*)glGetString(GL_VENDOR));
+    LOG_INFO("Renderer: %s", (const char*)glGetString(GL_RENDERER));
 
-    glEnable(GL_BLEND);
+    // depth and blend state is set per pass by the frame graph
     glEnable(GL_MULTISAMPLE);
-    glEnable(GL_DEPTH_TEST);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // shading happens in linear space, color textures are sRGB and the default framebuffer encodes on write
+    glEnable(GL_FRAMEBUFFER_SRGB);
+    GLint encoding = GL_LINEAR;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+    m_SrgbBackbuffer = encoding == GL_SRGB;
+    if (!m_SrgbBackbuffer)
+        LOG_WARN("WARNING::WINDOW::The back buffer is not sRGB, the present pass encodes instead");
+
+    deltaTime  = 0.0f;
+    m_LastTime = (float)glfwGetTime();
     return true;
 }
 
@@ -155,13 +169,28 @@ void Window::clear() const
 }
 
 void Window::update() const
+{
+    pollEvents();
+    swapBuffers();
+}
+
+void Window::pollEvents() const
 {
     double currentTime = glfwGetTime(); deltaTime = currentTime - m_LastTime; m_LastTime = currentTime;
 
     glfwPollEvents();
+}
+
+void Window::swapBuffers() const
+{
     glfwSwapBuffers(m_Window);
 }
 
+void Window::setSwapInterval(int interval)
+{
+    glfwSwapInterval(interval);
+}
+
 bool Window::closed() const
 {
     return glfwWindowShouldClose(m_Window) == 1;
@@ -169,7 +198,7 @@ bool Window::closed() const
 
 void glfw_initialisation_error(int error, const char* description)
 {
-    std::cerr << "ERROR::GLFW::" << error << "::DESCRIPTION::" << description << std::endl;
+    LOG_ERROR("ERROR::GLFW::%d::DESCRIPTION::%s", error, description);
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -184,7 +213,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     // Window closing
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
     {
-        std::cout << "Escape Key Pressed..." << "Quiting..." <<'\n';
+        LOG_INFO("Escape Key Pressed...Quiting...");
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
 }
@@ -28,13 +28,20 @@ public:
     float deltaMouseX, deltaMouseY;
     mutable float deltaTime;
 public:
-    Window(const char *title, int width, int height);
+    /// samples: MSAA samples of the default framebuffer, 0 when the scene is resolved offscreen.
+    Window(const char *title, int width, int height, int samples = 0);
     ~Window();
 
     /// Clears the window screen blank.
     void clear() const;
-    /// Updates the window.
+    /// Updates the window: pollEvents() followed by swapBuffers().
     void update() const;
+    /// Refreshes deltaTime and processes pending input events.
+    void pollEvents() const;
+    /// Presents the back buffer.
+    void swapBuffers() const;
+    /// Number of vertical blanks to wait per swap, 0 disables vsync.
+    void setSwapInterval(int interval);
     /// Indicates the current state of the Window.
     bool closed() const;
 
@@ -44,6 +51,9 @@ public:
     inline float getHeight() const { return m_Height; }
     /// Gets the current window's pointer to it's native object.
     inline GLFWwindow* getGLFWwindow() const { return m_Window; }
+    /// Whether the back buffer encodes linear color to sRGB on write. When it does not,
+    /// whatever draws the final image has to encode it itself.
+    inline bool isSrgbBackbuffer() const { return m_SrgbBackbuffer; }
 
     /// Tells if a particular key on the keyboard was pressed or not.
     bool isKeyPressed(unsigned int keycode);
@@ -189,9 +199,11 @@ public:
 
 private:
     const char*		m_Title;
+    int             m_Samples;
     float m_Width,	m_Height;
     GLFWwindow*		m_Window;
     bool			m_Closed;
+    bool            m_SrgbBackbuffer = false;
 
     bool            m_HeldKeys[MAX_KEYS];
     bool            m_PressedKeys[MAX_KEYS];
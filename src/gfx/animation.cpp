@@ -0,0 +1,437 @@
+// animation.cpp
+#include "animation.h"
+
+#include "components.h"
+#include "mesh_import.h"
+
+#include "../core/job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <unordered_set>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // animators per ParallelFor chunk
+    constexpr size_t ANIMATOR_GRAIN = 16;
+
+    // per worker scratch, sized on first use and reused every frame
+    thread_local Pose t_Sampled;
+    thread_local Pose t_Blended;
+
+    void SetJoint(float* frame, int stride, int joint, const aiVector3D& t, const aiQuaternion& r, const aiVector3D& s)
+    {
+        const float values[Pose::STREAM_COUNT] = { t.x, t.y, t.z, r.x, r.y, r.z, r.w, s.x, s.y, s.z };
+        for (int stream = 0; stream < Pose::STREAM_COUNT; ++stream)
+            frame[stream * stride + joint] = values[stream];
+    }
+
+    // keep a node if it is a bone or has one below it
+    bool MarkNeeded(const aiNode* node, const std::unordered_map<std::string, aiMatrix4x4>& bones,
+                    std::unordered_set<const aiNode*>& needed)
+    {
+        bool keep = bones.count(node->mName.C_Str()) != 0;
+        for (unsigned int i = 0; i < node->mNumChildren; ++i)
+            keep |= MarkNeeded(node->mChildren[i], bones, needed);
+        if (keep)
+            needed.insert(node);
+        return keep;
+    }
+
+    void AddJoints(const aiNode* node, int parent, const std::unordered_map<std::string, aiMatrix4x4>& bones,
+                   const std::unordered_set<const aiNode*>& needed, Skeleton& skeleton,
+                   std::vector<aiMatrix4x4>& locals)
+    {
+        if (!needed.count(node))
+            return;
+
+        int joint = skeleton.JointCount();
+        std::string name = node->mName.C_Str();
+        auto bone = bones.find(name);
+
+        skeleton.Names.push_back(name);
+        skeleton.Parents.push_back(parent);
+        skeleton.InverseBind.push_back(bone != bones.end() ? MeshImport::ToMatrix(bone->second) : glm::mat4(1.0f));
+        skeleton.Radius.push_back(-1.0f);
+        skeleton.Index.emplace(name, joint);
+        locals.push_back(node->mTransformation);
+
+        for (unsigned int i = 0; i < node->mNumChildren; ++i)
+            AddJoints(node->mChildren[i], joint, bones, needed, skeleton, locals);
+    }
+
+    template<typename Key>
+    size_t FindKey(const Key* keys, unsigned int count, double time)
+    {
+        // last key at or before time
+        const Key* next = std::upper_bound(keys, keys + count, time,
+                                           [](double t, const Key& key) { return t < key.mTime; });
+        return next == keys ? 0 : static_cast<size_t>(next - keys - 1);
+    }
+
+    aiVector3D SampleVector(const aiVectorKey* keys, unsigned int count, double time, const aiVector3D& fallback)
+    {
+        if (count == 0)
+            return fallback;
+        size_t i = FindKey(keys, count, time);
+        if (i + 1 >= count)
+            return keys[i].mValue;
+
+        double span = keys[i + 1].mTime - keys[i].mTime;
+        float  t    = span > 0.0 ? static_cast<float>((time - keys[i].mTime) / span) : 0.0f;
+        t = std::clamp(t, 0.0f, 1.0f);
+        return keys[i].mValue + (keys[i + 1].mValue - keys[i].mValue) * t;
+    }
+
+    aiQuaternion SampleRotation(const aiQuatKey* keys, unsigned int count, double time, const aiQuaternion& fallback)
+    {
+        if (count == 0)
+            return fallback;
+        size_t i = FindKey(keys, count, time);
+        if (i + 1 >= count)
+            return keys[i].mValue;
+
+        double span = keys[i + 1].mTime - keys[i].mTime;
+        float  t    = span > 0.0 ? static_cast<float>((time - keys[i].mTime) / span) : 0.0f;
+        aiQuaternion result;
+        aiQuaternion::Interpolate(result, keys[i].mValue, keys[i + 1].mValue, std::clamp(t, 0.0f, 1.0f));
+        return result.Normalize();
+    }
+
+    // out = a + (b - a) * t over whole poses (joints is padded to a multiple of 4).
+    // out may alias a or b.
+    void Interpolate(const float* a, const float* b, float t, float* out, int joints)
+    {
+        static const Pose::Stream linear[] = { Pose::TX, Pose::TY, Pose::TZ, Pose::SX, Pose::SY, Pose::SZ };
+
+        const float* ax = a + Pose::RX * joints; const float* bx = b + Pose::RX * joints;
+        const float* ay = a + Pose::RY * joints; const float* by = b + Pose::RY * joints;
+        const float* az = a + Pose::RZ * joints; const float* bz = b + Pose::RZ * joints;
+        const float* aw = a + Pose::RW * joints; const float* bw = b + Pose::RW * joints;
+        float* ox = out + Pose::RX * joints;
+        float* oy = out + Pose::RY * joints;
+        float* oz = out + Pose::RZ * joints;
+        float* ow = out + Pose::RW * joints;
+
+#ifdef ANIMATION_SSE
+        const __m128 vt = _mm_set1_ps(t);
+        for (Pose::Stream stream : linear)
+        {
+            const float* sa = a + stream * joints;
+            const float* sb = b + stream * joints;
+            float*       so = out + stream * joints;
+            for (int j = 0; j < joints; j += 4)
+            {
+                __m128 va = _mm_loadu_ps(sa + j);
+                __m128 vb = _mm_loadu_ps(sb + j);
+                _mm_storeu_ps(so + j, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+            }
+        }
+
+        // four joints' rotations per iteration: flip b onto a's hemisphere, lerp, renormalize
+        const __m128 zero     = _mm_setzero_ps();
+        const __m128 one      = _mm_set1_ps(1.0f);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        for (int j = 0; j < joints; j += 4)
+        {
+            __m128 qax = _mm_loadu_ps(ax + j), qbx = _mm_loadu_ps(bx + j);
+            __m128 qay = _mm_loadu_ps(ay + j), qby = _mm_loadu_ps(by + j);
+            __m128 qaz = _mm_loadu_ps(az + j), qbz = _mm_loadu_ps(bz + j);
+            __m128 qaw = _mm_loadu_ps(aw + j), qbw = _mm_loadu_ps(bw + j);
+
+            __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qax, qbx), _mm_mul_ps(qay, qby)),
+                                    _mm_add_ps(_mm_mul_ps(qaz, qbz), _mm_mul_ps(qaw, qbw)));
+            __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), signMask);
+            qbx = _mm_xor_ps(qbx, flip);
+            qby = _mm_xor_ps(qby, flip);
+            qbz = _mm_xor_ps(qbz, flip);
+            qbw = _mm_xor_ps(qbw, flip);
+
+            __m128 rx = _mm_add_ps(qax, _mm_mul_ps(_mm_sub_ps(qbx, qax), vt));
+            __m128 ry = _mm_add_ps(qay, _mm_mul_ps(_mm_sub_ps(qby, qay), vt));
+            __m128 rz = _mm_add_ps(qaz, _mm_mul_ps(_mm_sub_ps(qbz, qaz), vt));
+            __m128 rw = _mm_add_ps(qaw, _mm_mul_ps(_mm_sub_ps(qbw, qaw), vt));
+
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+                                        _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+            __m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(length2));
+
+            _mm_storeu_ps(ox + j, _mm_mul_ps(rx, inverse));
+            _mm_storeu_ps(oy + j, _mm_mul_ps(ry, inverse));
+            _mm_storeu_ps(oz + j, _mm_mul_ps(rz, inverse));
+            _mm_storeu_ps(ow + j, _mm_mul_ps(rw, inverse));
+        }
+#else
+        for (Pose::Stream stream : linear)
+        {
+            const float* sa = a + stream * joints;
+            const float* sb = b + stream * joints;
+            float*       so = out + stream * joints;
+            for (int j = 0; j < joints; ++j)
+                so[j] = sa[j] + (sb[j] - sa[j]) * t;
+        }
+
+        for (int j = 0; j < joints; ++j)
+        {
+            float sign = ax[j] * bx[j] + ay[j] * by[j] + az[j] * bz[j] + aw[j] * bw[j] < 0.0f ? -1.0f : 1.0f;
+            float rx = ax[j] + (sign * bx[j] - ax[j]) * t;
+            float ry = ay[j] + (sign * by[j] - ay[j]) * t;
+            float rz = az[j] + (sign * bz[j] - az[j]) * t;
+            float rw = aw[j] + (sign * bw[j] - aw[j]) * t;
+            float inverse = 1.0f / std::sqrt(rx * rx + ry * ry + rz * rz + rw * rw);
+            ox[j] = rx * inverse;
+            oy[j] = ry * inverse;
+            oz[j] = rz * inverse;
+            ow[j] = rw * inverse;
+        }
+#endif
+    }
+}
+
+void Pose::Resize(int joints)
+{
+    JointCount = (joints + 3) & ~3;
+    Data.assign(size_t(STREAM_COUNT) * JointCount, 0.0f);
+    std::fill_n(Get(RW), JointCount, 1.0f);
+    std::fill_n(Get(SX), JointCount, 1.0f);
+    std::fill_n(Get(SY), JointCount, 1.0f);
+    std::fill_n(Get(SZ), JointCount, 1.0f);
+}
+
+int Skeleton::Find(const std::string& name) const
+{
+    auto it = Index.find(name);
+    return it != Index.end() ? it->second : -1;
+}
+
+Skeleton Animation::ImportSkeleton(const aiScene* scene)
+{
+    Skeleton skeleton;
+
+    std::unordered_map<std::string, aiMatrix4x4> bones;
+    for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+    {
+        const aiMesh* mesh = scene->mMeshes[m];
+        for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+            bones.emplace(mesh->mBones[b]->mName.C_Str(), mesh->mBones[b]->mOffsetMatrix);
+    }
+    if (bones.empty())
+        return skeleton;
+
+    std::unordered_set<const aiNode*> needed;
+    MarkNeeded(scene->mRootNode, bones, needed);
+
+    std::vector<aiMatrix4x4> locals;
+    AddJoints(scene->mRootNode, -1, bones, needed, skeleton, locals);
+
+    skeleton.BindPose.Resize(skeleton.JointCount());
+    for (int joint = 0; joint < skeleton.JointCount(); ++joint)
+    {
+        aiVector3D   scale, position;
+        aiQuaternion rotation;
+        locals[joint].Decompose(scale, rotation, position);
+        SetJoint(skeleton.BindPose.Data.data(), skeleton.BindPose.JointCount, joint, position, rotation, scale);
+    }
+
+    skeleton.BindPositions.resize(skeleton.JointCount());
+    for (int joint = 0; joint < skeleton.JointCount(); ++joint)
+        skeleton.BindPositions[joint] = glm::vec3(glm::inverse(skeleton.InverseBind[joint])[3]);
+
+    // the root's own transform is not part of the skin
+    skeleton.GlobalInverse = glm::inverse(MeshImport::ToMatrix(scene->mRootNode->mTransformation));
+    return skeleton;
+}
+
+AnimationClip Animation::ImportClip(const aiAnimation* animation, const Skeleton& skeleton)
+{
+    AnimationClip clip;
+    clip.Name       = animation->mName.C_Str();
+    clip.JointCount = skeleton.BindPose.JointCount;
+
+    double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+    clip.Duration   = static_cast<float>(animation->mDuration / ticksPerSecond);
+    clip.FrameCount = std::max(2, static_cast<int>(std::ceil(clip.Duration * ANIMATION_SAMPLE_RATE)) + 1);
+    clip.FrameRate  = clip.Duration > 0.0f ? (clip.FrameCount - 1) / clip.Duration : 0.0f;
+
+    // every frame starts out as the bind pose, animated joints are overwritten
+    const size_t frameFloats = skeleton.BindPose.Data.size();
+    clip.Frames.resize(frameFloats * clip.FrameCount);
+    for (int frame = 0; frame < clip.FrameCount; ++frame)
+        std::copy(skeleton.BindPose.Data.begin(), skeleton.BindPose.Data.end(), clip.Frames.begin() + frame * frameFloats);
+
+    const int stride = clip.JointCount;
+    for (unsigned int c = 0; c < animation->mNumChannels; ++c)
+    {
+        const aiNodeAnim* channel = animation->mChannels[c];
+        int joint = skeleton.Find(channel->mNodeName.C_Str());
+        if (joint < 0)
+            continue; // animates a node no mesh is skinned to
+
+        const float* bind = skeleton.BindPose.Data.data();
+        aiVector3D   bindPosition(bind[Pose::TX * stride + joint], bind[Pose::TY * stride + joint], bind[Pose::TZ * stride + joint]);
+        aiQuaternion bindRotation(bind[Pose::RW * stride + joint], bind[Pose::RX * stride + joint],
+                                  bind[Pose::RY * stride + joint], bind[Pose::RZ * stride + joint]);
+        aiVector3D   bindScale(bind[Pose::SX * stride + joint], bind[Pose::SY * stride + joint], bind[Pose::SZ * stride + joint]);
+
+        for (int frame = 0; frame < clip.FrameCount; ++frame)
+        {
+            double ticks = clip.FrameCount > 1 ? animation->mDuration * frame / (clip.FrameCount - 1) : 0.0;
+            SetJoint(clip.Frames.data() + frame * frameFloats, stride, joint,
+                     SampleVector(channel->mPositionKeys, channel->mNumPositionKeys, ticks, bindPosition),
+                     SampleRotation(channel->mRotationKeys, channel->mNumRotationKeys, ticks, bindRotation),
+                     SampleVector(channel->mScalingKeys, channel->mNumScalingKeys, ticks, bindScale));
+        }
+    }
+    return clip;
+}
+
+void Animation::MeasureRadii(Skeleton& skeleton, const Vertex* vertices, size_t count)
+{
+    if (skeleton.Empty())
+        return;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (int b = 0; b < MAX_BONE_INFLUENCE; ++b)
+        {
+            int joint = vertices[i].m_BoneIDs[b];
+            if (vertices[i].m_Weights[b] <= 0.0f || joint < 0 || joint >= skeleton.JointCount())
+                continue;
+            float distance = glm::length(vertices[i].Position - skeleton.BindPositions[joint]);
+            skeleton.Radius[joint] = std::max(skeleton.Radius[joint], distance);
+        }
+    }
+}
+
+void Animation::Sample(const AnimationClip& clip, float time, bool loop, Pose& out)
+{
+    if (out.JointCount != clip.JointCount)
+        out.Resize(clip.JointCount);
+
+    if (loop && clip.Duration > 0.0f)
+    {
+        time = std::fmod(time, clip.Duration);
+        if (time < 0.0f)
+            time += clip.Duration;
+    }
+
+    float frame = std::clamp(time * clip.FrameRate, 0.0f, float(clip.FrameCount - 1));
+    int   first = std::min(static_cast<int>(frame), clip.FrameCount - 2);
+    Interpolate(clip.Frame(first), clip.Frame(first + 1), frame - first, out.Data.data(), clip.JointCount);
+}
+
+void Animation::Blend(const Pose& a, const Pose& b, float weight, Pose& out)
+{
+    if (out.JointCount != a.JointCount)
+        out.Resize(a.JointCount);
+    Interpolate(a.Data.data(), b.Data.data(), weight, out.Data.data(), a.JointCount);
+}
+
+void Animation::ComputePalette(const Skeleton& skeleton, const Pose& pose, glm::mat4* modelSpace,
+                               glm::mat4* palette, AABB* bounds)
+{
+    const float* tx = pose.Get(Pose::TX); const float* ty = pose.Get(Pose::TY); const float* tz = pose.Get(Pose::TZ);
+    const float* rx = pose.Get(Pose::RX); const float* ry = pose.Get(Pose::RY);
+    const float* rz = pose.Get(Pose::RZ); const float* rw = pose.Get(Pose::RW);
+    const float* sx = pose.Get(Pose::SX); const float* sy = pose.Get(Pose::SY); const float* sz = pose.Get(Pose::SZ);
+
+    AABB box;
+    for (int j = 0; j < skeleton.JointCount(); ++j)
+    {
+        // rotation matrix from the unit quaternion, columns scaled
+        float x = rx[j], y = ry[j], z = rz[j], w = rw[j];
+        glm::mat4 local(
+            (1.0f - 2.0f * (y * y + z * z)) * sx[j], 2.0f * (x * y + w * z) * sx[j],          2.0f * (x * z - w * y) * sx[j],          0.0f,
+            2.0f * (x * y - w * z) * sy[j],          (1.0f - 2.0f * (x * x + z * z)) * sy[j], 2.0f * (y * z + w * x) * sy[j],          0.0f,
+            2.0f * (x * z + w * y) * sz[j],          2.0f * (y * z - w * x) * sz[j],          (1.0f - 2.0f * (x * x + y * y)) * sz[j], 0.0f,
+            tx[j],                                   ty[j],                                   tz[j],                                   1.0f);
+
+        int parent    = skeleton.Parents[j];
+        modelSpace[j] = parent < 0 ? local : modelSpace[parent] * local;
+        palette[j]    = skeleton.GlobalInverse * modelSpace[j] * skeleton.InverseBind[j];
+
+        // skinned vertices stay within the bind-pose radius of their (rigid) joints
+        if (skeleton.Radius[j] >= 0.0f)
+        {
+            glm::vec3 center = glm::vec3(palette[j] * glm::vec4(skeleton.BindPositions[j], 1.0f));
+            float     scale  = std::max({ glm::length(glm::vec3(palette[j][0])),
+                                          glm::length(glm::vec3(palette[j][1])),
+                                          glm::length(glm::vec3(palette[j][2])) });
+            glm::vec3 extent(skeleton.Radius[j] * scale);
+            box.Expand(center - extent);
+            box.Expand(center + extent);
+        }
+    }
+
+    if (bounds)
+        *bounds = box;
+}
+
+void AnimationSystem::Update(float deltaTime)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // advance playback and lay out this frame's palette
+    m_Entities.clear();
+    size_t joints = 0;
+    auto   view   = m_Registry.view<AnimatorComponent>();
+    for (entt::entity entity : view)
+    {
+        AnimatorComponent& animator = view.get<AnimatorComponent>(entity);
+        if (!animator.skeleton || !animator.clip || animator.skeleton->Empty())
+            continue;
+
+        animator.time      += deltaTime * animator.speed;
+        animator.blendTime += deltaTime * animator.speed;
+        // keep looping clocks small so they do not lose precision over a long session
+        if (animator.loop && animator.clip->Duration > 0.0f)
+            animator.time = std::fmod(animator.time, animator.clip->Duration);
+        if (animator.loop && animator.blendClip && animator.blendClip->Duration > 0.0f)
+            animator.blendTime = std::fmod(animator.blendTime, animator.blendClip->Duration);
+
+        animator.paletteOffset = static_cast<uint32_t>(joints);
+        joints += animator.skeleton->JointCount();
+        m_Entities.push_back(entity);
+    }
+
+    m_Palette.resize(joints);
+    m_ModelSpace.resize(joints);
+    m_PoseBounds.resize(m_Entities.size());
+
+    // sampling, blending and palettes touch nothing shared, animators go out in chunks
+    JobSystem::ParallelFor(m_Entities.size(), ANIMATOR_GRAIN, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const AnimatorComponent& animator = m_Registry.get<AnimatorComponent>(m_Entities[i]);
+
+            Animation::Sample(*animator.clip, animator.time, animator.loop, t_Sampled);
+            if (animator.blendClip && animator.blendWeight > 0.0f)
+            {
+                Animation::Sample(*animator.blendClip, animator.blendTime, animator.loop, t_Blended);
+                Animation::Blend(t_Sampled, t_Blended, animator.blendWeight, t_Sampled);
+            }
+
+            Animation::ComputePalette(*animator.skeleton, t_Sampled, &m_ModelSpace[animator.paletteOffset],
+                                      &m_Palette[animator.paletteOffset], &m_PoseBounds[i]);
+        }
+    });
+
+    // culling follows the pose: the scene index refits entities whose bounds are patched
+    for (size_t i = 0; i < m_Entities.size(); ++i)
+    {
+        entt::entity entity = m_Entities[i];
+        m_Registry.get<AnimatorComponent>(entity).poseBounds = m_PoseBounds[i];
+        if (m_PoseBounds[i].Valid() && m_Registry.all_of<BoundsComponent>(entity))
+            m_Registry.patch<BoundsComponent>(entity, [&](BoundsComponent& bounds) { bounds.Local = m_PoseBounds[i]; });
+    }
+
+    m_Stats.Instances = m_Entities.size();
+    m_Stats.Joints    = joints;
+    m_Stats.UpdateMs  = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,111 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <assimp/scene.h>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frustum.h"
+#include "mesh.h"
+
+#define ANIMATION_SAMPLE_RATE 30.0f // clips are resampled to this many frames per second
+
+// Local joint transforms of one pose as a structure of arrays: one stream per
+// component, each JointCount floats long. JointCount is padded to a multiple of 4
+// and padding joints hold the identity, so the SIMD kernels never need a tail.
+struct Pose {
+    enum Stream { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, STREAM_COUNT };
+
+    int                JointCount = 0; // padded
+    std::vector<float> Data;
+
+    void Resize(int joints);
+
+    float*       Get(Stream stream)       { return Data.data() + stream * JointCount; }
+    const float* Get(Stream stream) const { return Data.data() + stream * JointCount; }
+};
+
+// Joint hierarchy of a model: the nodes that are bones plus everything between them
+// and the root, parents always before their children.
+struct Skeleton {
+    std::vector<std::string> Names;
+    std::vector<int>         Parents;      // -1 for the root
+    std::vector<glm::mat4>   InverseBind;  // mesh space to joint space, identity for non-bones
+    std::vector<glm::vec3>   BindPositions; // joint origins in mesh space
+    std::vector<float>       Radius;       // furthest vertex it skins in bind pose, < 0 if none
+    Pose                     BindPose;     // node transforms as imported
+    glm::mat4                GlobalInverse = glm::mat4(1.0f);
+    std::unordered_map<std::string, int> Index;
+
+    int  JointCount() const { return static_cast<int>(Parents.size()); }
+    bool Empty()      const { return Parents.empty(); }
+    int  Find(const std::string& name) const;
+};
+
+// A clip resampled at ANIMATION_SAMPLE_RATE into whole poses, so sampling never
+// searches for keys: it interpolates two neighbouring frames.
+struct AnimationClip {
+    std::string        Name;
+    float              Duration   = 0.0f; // seconds
+    float              FrameRate  = 0.0f; // frames per second, FrameCount - 1 intervals span Duration
+    int                FrameCount = 0;
+    int                JointCount = 0;    // padded, same layout as Pose
+    std::vector<float> Frames;            // FrameCount poses back to back
+
+    const float* Frame(int index) const { return Frames.data() + size_t(index) * Pose::STREAM_COUNT * JointCount; }
+};
+
+namespace Animation
+{
+    // build the skeleton from every bone referenced by the scene's meshes, empty if none
+    Skeleton ImportSkeleton(const aiScene* scene);
+    AnimationClip ImportClip(const aiAnimation* animation, const Skeleton& skeleton);
+    // grow each joint's Radius to cover the vertices it influences (bone weights set)
+    void MeasureRadii(Skeleton& skeleton, const Vertex* vertices, size_t count);
+
+    // pose of clip at time seconds, wrapping around when looping
+    void Sample(const AnimationClip& clip, float time, bool loop, Pose& out);
+    // out = a * (1 - weight) + b * weight, rotations are normalized lerps along the shorter arc
+    void Blend(const Pose& a, const Pose& b, float weight, Pose& out);
+
+    // local pose to skinning matrices (count = skeleton joints). Also returns the
+    // object-space box the skinned vertices stay inside.
+    void ComputePalette(const Skeleton& skeleton, const Pose& pose, glm::mat4* modelSpace,
+                        glm::mat4* palette, AABB* bounds);
+}
+
+// Advances every AnimatorComponent, then samples, blends and builds skinning
+// palettes for all of them in parallel. Palettes for the whole frame live in one
+// array, each animator records where its joints start.
+class AnimationSystem
+{
+public:
+    struct Stats {
+        size_t Instances  = 0;
+        size_t Joints     = 0;
+        float  UpdateMs   = 0.0f;
+    };
+
+    explicit AnimationSystem(entt::registry& registry) : m_Registry(registry) {}
+
+    void Update(float deltaTime);
+
+    const glm::mat4* GetPalette()     const { return m_Palette.data(); }
+    size_t           GetPaletteSize() const { return m_Palette.size(); }
+    const Stats&     GetStats()       const { return m_Stats; }
+
+private:
+    entt::registry&           m_Registry;
+    std::vector<entt::entity> m_Entities;
+    std::vector<glm::mat4>    m_Palette;
+    std::vector<glm::mat4>    m_ModelSpace; // scratch, same layout as the palette
+    std::vector<AABB>         m_PoseBounds; // per entry of m_Entities
+    Stats                     m_Stats;
+};
+
+#endif
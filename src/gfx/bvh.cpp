@@ -0,0 +1,334 @@
+// bvh.cpp
+#include "bvh.h"
+
+namespace
+{
+    AABB Union(const AABB& a, const AABB& b)
+    {
+        AABB result;
+        result.Min = glm::min(a.Min, b.Min);
+        result.Max = glm::max(a.Max, b.Max);
+        return result;
+    }
+
+    float HalfArea(const AABB& box)
+    {
+        if (!box.Valid())
+            return 0.0f;
+        glm::vec3 d = box.Max - box.Min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    bool SameBounds(const AABB& a, const AABB& b)
+    {
+        return a.Min == b.Min && a.Max == b.Max;
+    }
+
+    struct Bin {
+        AABB     bounds;
+        uint32_t count = 0;
+    };
+}
+
+uint32_t BVH::Insert(const AABB& bounds, uint32_t userData)
+{
+    uint32_t proxy;
+    if (!m_FreeProxies.empty())
+    {
+        proxy = m_FreeProxies.back();
+        m_FreeProxies.pop_back();
+    }
+    else
+    {
+        proxy = static_cast<uint32_t>(m_Proxies.size());
+        m_Proxies.emplace_back();
+    }
+
+    Proxy& p   = m_Proxies[proxy];
+    p.bounds   = bounds;
+    p.userData = userData;
+    p.leaf     = INVALID;
+    p.slot     = static_cast<uint32_t>(m_Pending.size());
+    p.alive    = true;
+    m_Pending.push_back(proxy);
+    ++m_LiveCount;
+    return proxy;
+}
+
+void BVH::Remove(uint32_t proxy)
+{
+    Proxy& p = m_Proxies[proxy];
+    if (!p.alive)
+        return;
+
+    if (p.leaf == INVALID)
+    {
+        // still pending: swap-erase
+        uint32_t last = m_Pending.back();
+        m_Pending[p.slot]     = last;
+        m_Proxies[last].slot  = p.slot;
+        m_Pending.pop_back();
+    }
+    else
+    {
+        // leave a tombstone, the leaf shrinks on the next refit
+        m_Primitives[p.slot] = INVALID;
+        m_Moved.push_back(p.leaf);
+        ++m_Tombstones;
+    }
+
+    p.alive = false;
+    p.leaf  = INVALID;
+    p.slot  = INVALID;
+    m_FreeProxies.push_back(proxy);
+    --m_LiveCount;
+}
+
+void BVH::Move(uint32_t proxy, const AABB& bounds)
+{
+    Proxy& p = m_Proxies[proxy];
+    p.bounds = bounds;
+    if (p.leaf != INVALID)
+        m_Moved.push_back(p.leaf);
+}
+
+void BVH::Update()
+{
+    size_t pendingLimit = std::max(m_Settings.MaxPending, m_LiveCount / 16);
+    bool   firstBuild   = m_Nodes.empty() && !m_Pending.empty();
+    if (firstBuild || m_Pending.size() > pendingLimit || m_Tombstones > m_LiveCount / 4 + 16)
+    {
+        Rebuild();
+        return;
+    }
+
+    if (!m_Moved.empty())
+    {
+        // past a point one sweep over every node beats walking each path
+        if (m_Moved.size() * 8 > m_Nodes.size())
+        {
+            RefitAll();
+        }
+        else
+        {
+            for (uint32_t leaf : m_Moved)
+                RefitLeaf(leaf);
+        }
+        m_Moved.clear();
+        ++m_Refits;
+    }
+
+    if (++m_UpdateCount >= m_Settings.CostCheckPeriod)
+    {
+        m_UpdateCount = 0;
+        // pending proxies are tested flat, so they never wait longer than one period either
+        if (!m_Pending.empty() || ComputeCost() > m_BuiltCost * m_Settings.RebuildThreshold)
+            Rebuild();
+    }
+}
+
+void BVH::Rebuild()
+{
+    m_BuildRefs.clear();
+    m_BuildRefs.reserve(m_LiveCount);
+    for (uint32_t proxy = 0; proxy < m_Proxies.size(); ++proxy)
+    {
+        const Proxy& p = m_Proxies[proxy];
+        if (p.alive)
+            m_BuildRefs.push_back(BuildRef{ p.bounds, p.bounds.Center(), proxy });
+    }
+
+    m_Nodes.clear();
+    m_Nodes.reserve(2 * m_BuildRefs.size() / BVH_MAX_LEAF_SIZE + 1);
+    if (!m_BuildRefs.empty())
+        BuildNode(0, static_cast<uint32_t>(m_BuildRefs.size()), INVALID, 0);
+
+    m_Primitives.resize(m_BuildRefs.size());
+    for (uint32_t i = 0; i < m_BuildRefs.size(); ++i)
+        m_Primitives[i] = m_BuildRefs[i].proxy;
+
+    m_Pending.clear();
+    m_Moved.clear();
+    m_Tombstones  = 0;
+    m_UpdateCount = 0;
+    m_BuiltCost   = ComputeCost();
+    ++m_Rebuilds;
+}
+
+uint32_t BVH::BuildNode(uint32_t first, uint32_t count, uint32_t parent, int depth)
+{
+    uint32_t index = static_cast<uint32_t>(m_Nodes.size());
+    m_Nodes.push_back(Node{ AABB(), first, count, 0, parent });
+
+    BuildRef* refs = m_BuildRefs.data() + first;
+
+    AABB bounds, centroidBounds;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        bounds = Union(bounds, refs[i].bounds);
+        centroidBounds.Expand(refs[i].centroid);
+    }
+    m_Nodes[index].bounds = bounds;
+
+    auto makeLeaf = [&]() {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            m_Proxies[refs[i].proxy].leaf = index;
+            m_Proxies[refs[i].proxy].slot = first + i;
+        }
+        return index;
+    };
+
+    // the traversal stacks hold one entry per level
+    if (count <= BVH_MAX_LEAF_SIZE || depth >= BVH_STACK_SIZE - 2)
+        return makeLeaf();
+
+    // binned SAH along the axis the centroids spread most
+    glm::vec3 extent = centroidBounds.Max - centroidBounds.Min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    if (extent[axis] <= 0.0f)
+        return makeLeaf(); // every centroid coincides, nothing to split on
+
+    Bin   bins[BVH_SAH_BINS];
+    float scale = BVH_SAH_BINS / extent[axis];
+    auto  binOf = [&](const BuildRef& ref) {
+        int bin = static_cast<int>((ref.centroid[axis] - centroidBounds.Min[axis]) * scale);
+        return std::min(bin, BVH_SAH_BINS - 1);
+    };
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Bin& bin = bins[binOf(refs[i])];
+        bin.bounds = Union(bin.bounds, refs[i].bounds);
+        ++bin.count;
+    }
+
+    // sweep from the right to get the cost of every right side, then from the left
+    float    rightCost[BVH_SAH_BINS];
+    AABB     accumulated;
+    uint32_t accumulatedCount = 0;
+    for (int i = BVH_SAH_BINS - 1; i > 0; --i)
+    {
+        accumulated       = Union(accumulated, bins[i].bounds);
+        accumulatedCount += bins[i].count;
+        rightCost[i]      = HalfArea(accumulated) * accumulatedCount;
+    }
+
+    float bestCost  = FLT_MAX;
+    int   bestSplit = -1;
+    accumulated      = AABB();
+    accumulatedCount = 0;
+    for (int i = 0; i < BVH_SAH_BINS - 1; ++i)
+    {
+        accumulated       = Union(accumulated, bins[i].bounds);
+        accumulatedCount += bins[i].count;
+        float cost = HalfArea(accumulated) * accumulatedCount + rightCost[i + 1];
+        if (accumulatedCount > 0 && accumulatedCount < count && cost < bestCost)
+        {
+            bestCost  = cost;
+            bestSplit = i;
+        }
+    }
+
+    // a split must beat testing every primitive of a small enough leaf
+    float leafCost = HalfArea(bounds) * count;
+    if (bestSplit < 0 || (count <= 2 * BVH_MAX_LEAF_SIZE && bestCost >= leafCost))
+        return makeLeaf();
+
+    BuildRef* mid       = std::partition(refs, refs + count, [&](const BuildRef& ref) { return binOf(ref) <= bestSplit; });
+    uint32_t  leftCount = static_cast<uint32_t>(mid - refs);
+
+    BuildNode(first, leftCount, index, depth + 1);
+    uint32_t right = BuildNode(first + leftCount, count - leftCount, index, depth + 1);
+    m_Nodes[index].right = right;
+    return index;
+}
+
+void BVH::RefitLeaf(uint32_t index)
+{
+    Node& leaf = m_Nodes[index];
+    AABB  bounds;
+    for (uint32_t i = leaf.first; i < leaf.first + leaf.count; ++i)
+    {
+        if (m_Primitives[i] != INVALID)
+            bounds = Union(bounds, m_Proxies[m_Primitives[i]].bounds);
+    }
+    if (SameBounds(bounds, leaf.bounds))
+        return;
+    leaf.bounds = bounds;
+
+    // walk up until a parent's bounds come out unchanged
+    for (uint32_t parent = leaf.parent; parent != INVALID; parent = m_Nodes[parent].parent)
+    {
+        Node& node = m_Nodes[parent];
+        AABB  merged = Union(m_Nodes[parent + 1].bounds, m_Nodes[node.right].bounds);
+        if (SameBounds(merged, node.bounds))
+            break;
+        node.bounds = merged;
+    }
+}
+
+void BVH::RefitAll()
+{
+    // children always come after their parent, so one reverse sweep is bottom-up
+    for (size_t i = m_Nodes.size(); i-- > 0;)
+    {
+        Node& node = m_Nodes[i];
+        if (node.right != 0)
+        {
+            node.bounds = Union(m_Nodes[i + 1].bounds, m_Nodes[node.right].bounds);
+            continue;
+        }
+
+        AABB bounds;
+        for (uint32_t p = node.first; p < node.first + node.count; ++p)
+        {
+            if (m_Primitives[p] != INVALID)
+                bounds = Union(bounds, m_Proxies[m_Primitives[p]].bounds);
+        }
+        node.bounds = bounds;
+    }
+}
+
+float BVH::ComputeCost() const
+{
+    if (m_Nodes.empty())
+        return 0.0f;
+
+    // expected box tests for a random ray hitting the root: interior nodes cost one, leaves their size
+    float cost = 0.0f;
+    for (const Node& node : m_Nodes)
+        cost += HalfArea(node.bounds) * (node.right != 0 ? 1.0f : static_cast<float>(node.count));
+
+    float root = HalfArea(m_Nodes[0].bounds);
+    return root > 0.0f ? cost / root : 0.0f;
+}
+
+int BVH::ComputeDepth() const
+{
+    int depth = 0;
+    for (size_t i = 0; i < m_Nodes.size(); ++i)
+    {
+        if (m_Nodes[i].right != 0)
+            continue;
+        int level = 0;
+        for (uint32_t parent = m_Nodes[i].parent; parent != INVALID; parent = m_Nodes[parent].parent)
+            ++level;
+        depth = std::max(depth, level + 1);
+    }
+    return depth;
+}
+
+BVH::Stats BVH::GetStats() const
+{
+    Stats stats;
+    stats.Proxies   = m_LiveCount;
+    stats.Nodes     = m_Nodes.size();
+    stats.Pending   = m_Pending.size();
+    stats.Removed   = m_Tombstones;
+    stats.Depth     = ComputeDepth();
+    stats.Cost      = ComputeCost();
+    stats.BuiltCost = m_BuiltCost;
+    stats.Rebuilds  = m_Rebuilds;
+    stats.Refits    = m_Refits;
+    return stats;
+}
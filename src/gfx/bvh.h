@@ -0,0 +1,331 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "frustum.h"
+
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_SAH_BINS      12
+#define BVH_STACK_SIZE    64
+
+struct BVHSettings {
+    float  RebuildThreshold = 1.5f; // SAH cost growth that triggers a rebuild
+    size_t MaxPending       = 256;  // also rebuilt when pending > proxies / 16
+    int    CostCheckPeriod  = 16;   // updates between SAH cost checks
+};
+
+// Bounding volume hierarchy over a dynamic set of boxes, one proxy per scene object.
+// Built top-down with binned SAH into a flat depth-first array: a node's left child
+// follows it directly and every subtree owns a contiguous range of primitives, so a
+// subtree that is fully inside a query is emitted without walking it.
+// Moved proxies refit the path above their leaf. New proxies wait in a pending list
+// that queries test flat until the next rebuild; a rebuild is due once enough are
+// pending or removed, or once refits have pushed the SAH cost RebuildThreshold
+// above what the last build achieved.
+class BVH
+{
+public:
+    static constexpr uint32_t INVALID = ~0u;
+
+    struct Stats {
+        size_t   Proxies   = 0;
+        size_t   Nodes     = 0;
+        size_t   Pending   = 0;
+        size_t   Removed   = 0; // tombstones left in the tree until the next rebuild
+        int      Depth     = 0;
+        float    Cost      = 0.0f;
+        float    BuiltCost = 0.0f;
+        uint64_t Rebuilds  = 0;
+        uint64_t Refits    = 0;
+    };
+
+    struct RayHit {
+        uint32_t userData = INVALID;
+        float    distance = FLT_MAX;
+        bool     Hit() const { return userData != INVALID; }
+    };
+
+    explicit BVH(const BVHSettings& settings = BVHSettings()) : m_Settings(settings) {}
+
+    uint32_t Insert(const AABB& bounds, uint32_t userData);
+    void     Remove(uint32_t proxy);
+    void     Move(uint32_t proxy, const AABB& bounds);
+
+    // refit moved proxies and rebuild when due, call once per frame before querying
+    void Update();
+    void Rebuild();
+
+    uint32_t    GetUserData(uint32_t proxy) const { return m_Proxies[proxy].userData; }
+    const AABB& GetBounds(uint32_t proxy)   const { return m_Proxies[proxy].bounds; }
+    Stats       GetStats() const;
+
+    // visit(userData) for every proxy intersecting any of the frusta, each reported once
+    template<typename F> void QueryFrusta(const Frustum* frusta, int count, F&& visit) const;
+    template<typename F> void QueryFrustum(const Frustum& frustum, F&& visit) const { QueryFrusta(&frustum, 1, visit); }
+
+    // visit(userData) for every proxy whose box overlaps box
+    template<typename F> void QueryBox(const AABB& box, F&& visit) const;
+
+    // closest hit along the ray. test(userData, boxDistance) returns the exact hit
+    // distance or a negative value for a miss; return boxDistance to hit boxes only.
+    // direction need not be normalized, distances are in units of its length.
+    template<typename F> RayHit Raycast(const glm::vec3& origin, const glm::vec3& direction,
+                                        float maxDistance, F&& test) const;
+
+private:
+    enum Containment { Outside, Partial, Inside };
+
+    struct Proxy {
+        AABB     bounds;
+        uint32_t userData = 0;
+        uint32_t leaf     = INVALID; // node holding it, INVALID while pending or free
+        uint32_t slot     = INVALID; // index into m_Primitives, or m_Pending while pending
+        bool     alive    = false;
+    };
+
+    struct Node {
+        AABB     bounds;
+        uint32_t first;  // primitives of the whole subtree: [first, first + count)
+        uint32_t count;
+        uint32_t right;  // 0 for leaves (the root is never a right child), left child is this + 1
+        uint32_t parent;
+    };
+
+    BVHSettings           m_Settings;
+    std::vector<Proxy>    m_Proxies;
+    std::vector<uint32_t> m_FreeProxies;
+    std::vector<Node>     m_Nodes;
+    std::vector<uint32_t> m_Primitives; // proxy ids in tree order, INVALID where removed
+    std::vector<uint32_t> m_Pending;
+    std::vector<uint32_t> m_Moved;      // leaves whose primitives moved
+    size_t                m_LiveCount    = 0;
+    size_t                m_Tombstones   = 0;
+    float                 m_BuiltCost    = 0.0f;
+    int                   m_UpdateCount  = 0;
+    uint64_t              m_Rebuilds     = 0;
+    uint64_t              m_Refits       = 0;
+
+    // build scratch, partitioned in place so the build streams through memory
+    // instead of chasing proxies; kept to avoid reallocating every rebuild
+    struct BuildRef {
+        AABB      bounds;
+        glm::vec3 centroid;
+        uint32_t  proxy;
+    };
+    std::vector<BuildRef> m_BuildRefs;
+
+    uint32_t BuildNode(uint32_t first, uint32_t count, uint32_t parent, int depth);
+    void     RefitLeaf(uint32_t node);
+    void     RefitAll();
+    float    ComputeCost() const;
+    int      ComputeDepth() const;
+
+    static Containment Classify(const Frustum& frustum, const AABB& box);
+    static bool        Overlaps(const AABB& a, const AABB& b);
+    static float       IntersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection,
+                                    float maxDistance);
+};
+
+inline BVH::Containment BVH::Classify(const Frustum& frustum, const AABB& box)
+{
+    Containment result = Inside;
+    for (const glm::vec4& p : frustum.Planes)
+    {
+        glm::vec3 positive(p.x > 0.0f ? box.Max.x : box.Min.x,
+                           p.y > 0.0f ? box.Max.y : box.Min.y,
+                           p.z > 0.0f ? box.Max.z : box.Min.z);
+        if (p.x * positive.x + p.y * positive.y + p.z * positive.z + p.w < 0.0f)
+            return Outside;
+
+        glm::vec3 negative(p.x > 0.0f ? box.Min.x : box.Max.x,
+                           p.y > 0.0f ? box.Min.y : box.Max.y,
+                           p.z > 0.0f ? box.Min.z : box.Max.z);
+        if (p.x * negative.x + p.y * negative.y + p.z * negative.z + p.w < 0.0f)
+            result = Partial;
+    }
+    return result;
+}
+
+inline bool BVH::Overlaps(const AABB& a, const AABB& b)
+{
+    return a.Min.x <= b.Max.x && a.Max.x >= b.Min.x &&
+           a.Min.y <= b.Max.y && a.Max.y >= b.Min.y &&
+           a.Min.z <= b.Max.z && a.Max.z >= b.Min.z;
+}
+
+// slab test, entry distance or FLT_MAX for a miss
+inline float BVH::IntersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection,
+                               float maxDistance)
+{
+    glm::vec3 t0 = (box.Min - origin) * inverseDirection;
+    glm::vec3 t1 = (box.Max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar  = glm::max(t0, t1);
+
+    float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+    float exit  = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+template<typename F>
+void BVH::QueryFrusta(const Frustum* frusta, int count, F&& visit) const
+{
+    auto classify = [&](const AABB& box) {
+        Containment best = Outside;
+        for (int i = 0; i < count && best != Inside; ++i)
+            best = std::max(best, Classify(frusta[i], box));
+        return best;
+    };
+
+    if (!m_Nodes.empty())
+    {
+        uint32_t stack[BVH_STACK_SIZE];
+        int      top = 0;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const Node& node = m_Nodes[stack[--top]];
+
+            Containment containment = classify(node.bounds);
+            if (containment == Outside)
+                continue;
+
+            if (containment == Inside || node.right == 0)
+            {
+                // a leaf only partially inside still tests its primitives one by one
+                bool test = containment != Inside;
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    uint32_t proxy = m_Primitives[i];
+                    if (proxy != INVALID && (!test || classify(m_Proxies[proxy].bounds) != Outside))
+                        visit(m_Proxies[proxy].userData);
+                }
+                continue;
+            }
+
+            stack[top++] = node.right;
+            stack[top++] = static_cast<uint32_t>(&node - m_Nodes.data()) + 1;
+        }
+    }
+
+    for (uint32_t proxy : m_Pending)
+    {
+        if (classify(m_Proxies[proxy].bounds) != Outside)
+            visit(m_Proxies[proxy].userData);
+    }
+}
+
+template<typename F>
+void BVH::QueryBox(const AABB& box, F&& visit) const
+{
+    if (!m_Nodes.empty())
+    {
+        uint32_t stack[BVH_STACK_SIZE];
+        int      top = 0;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            uint32_t    index = stack[--top];
+            const Node& node  = m_Nodes[index];
+            if (!Overlaps(node.bounds, box))
+                continue;
+
+            if (node.right == 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    uint32_t proxy = m_Primitives[i];
+                    if (proxy != INVALID && Overlaps(m_Proxies[proxy].bounds, box))
+                        visit(m_Proxies[proxy].userData);
+                }
+                continue;
+            }
+
+            stack[top++] = node.right;
+            stack[top++] = index + 1;
+        }
+    }
+
+    for (uint32_t proxy : m_Pending)
+    {
+        if (Overlaps(m_Proxies[proxy].bounds, box))
+            visit(m_Proxies[proxy].userData);
+    }
+}
+
+template<typename F>
+BVH::RayHit BVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, F&& test) const
+{
+    RayHit    hit;
+    glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    hit.distance = maxDistance;
+
+    auto testProxy = [&](uint32_t proxy) {
+        float box = IntersectRay(m_Proxies[proxy].bounds, origin, inverse, hit.distance);
+        if (box == FLT_MAX)
+            return;
+        float distance = test(m_Proxies[proxy].userData, box);
+        if (distance >= 0.0f && distance <= hit.distance)
+        {
+            hit.distance = distance;
+            hit.userData = m_Proxies[proxy].userData;
+        }
+    };
+
+    if (!m_Nodes.empty() && IntersectRay(m_Nodes[0].bounds, origin, inverse, hit.distance) != FLT_MAX)
+    {
+        // nearest child first so the closest hit so far prunes as much as possible
+        struct Entry { uint32_t node; float distance; };
+        Entry stack[BVH_STACK_SIZE];
+        int   top = 0;
+        stack[top++] = { 0, 0.0f };
+
+        while (top > 0)
+        {
+            Entry entry = stack[--top];
+            if (entry.distance > hit.distance)
+                continue;
+
+            const Node& node = m_Nodes[entry.node];
+            if (node.right == 0)
+            {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                {
+                    if (m_Primitives[i] != INVALID)
+                        testProxy(m_Primitives[i]);
+                }
+                continue;
+            }
+
+            uint32_t near = entry.node + 1, far = node.right;
+            float nearDistance = IntersectRay(m_Nodes[near].bounds, origin, inverse, hit.distance);
+            float farDistance  = IntersectRay(m_Nodes[far].bounds,  origin, inverse, hit.distance);
+            if (farDistance < nearDistance)
+            {
+                std::swap(near, far);
+                std::swap(nearDistance, farDistance);
+            }
+            if (farDistance != FLT_MAX)
+                stack[top++] = { far, farDistance };
+            if (nearDistance != FLT_MAX)
+                stack[top++] = { near, nearDistance };
+        }
+    }
+
+    for (uint32_t proxy : m_Pending)
+        testProxy(proxy);
+
+    return hit;
+}
+
+#endif
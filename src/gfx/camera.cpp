@@ -1,5 +1,7 @@
 #include "camera.h"
 
+#include "../core/log.hpp"
+
 // Constructor with vectors
 Camera::Camera(glm::vec3 position, glm::vec3 up, GLfloat yaw, GLfloat pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVTY), Zoom(ZOOM)
 {
@@ -19,16 +21,16 @@ Camera::Camera(GLfloat posX, GLfloat posY, GLfloat posZ, GLfloat upX, GLfloat up
     this->updateCameraVectors();
 }
 
-void Camera::Update(Window& window)
+void Camera::Update(Window& window, GLfloat deltaTime)
 {
     if (window.isKeyHeld(GLFW_KEY_W) || window.isKeyHeld(GLFW_KEY_UP))
-        ProcessKeyboard(FORWARD, window.deltaTime);
+        ProcessKeyboard(FORWARD, deltaTime);
     else if (window.isKeyHeld(GLFW_KEY_S) || window.isKeyHeld(GLFW_KEY_DOWN))
-        ProcessKeyboard(BACKWARD, window.deltaTime);
+        ProcessKeyboard(BACKWARD, deltaTime);
     if (window.isKeyHeld(GLFW_KEY_D) || window.isKeyHeld(GLFW_KEY_RIGHT))
-        ProcessKeyboard(RIGHT, window.deltaTime);
+        ProcessKeyboard(RIGHT, deltaTime);
     else if (window.isKeyHeld(GLFW_KEY_A) || window.isKeyHeld(GLFW_KEY_LEFT))
-        ProcessKeyboard(LEFT, window.deltaTime);
+        ProcessKeyboard(LEFT, deltaTime);
 
     if (window.isMouseButtonHeld(GLFW_MOUSE_BUTTON_RIGHT))
     {
@@ -47,7 +49,7 @@ glm::mat4 Camera::GetViewMatrix()
 // Processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
 void Camera::ProcessKeyboard(Camera_Movement direction, GLfloat deltaTime)
 {
-    std::cout << direction << "\n";
+    LOG_TRACE("CAMERA::MOVE %d", direction);
     GLfloat velocity = this->MovementSpeed * deltaTime;
     if (direction == FORWARD)
         this->Position += this->Front * velocity;
@@ -0,0 +1,61 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#include "frustum.h"
+
+class Model;
+class ShaderVariants;
+class Impostor;
+struct Skeleton;
+struct AnimationClip;
+
+// entt components shared by the renderer-side systems
+
+// world transform. Change it through registry.patch/replace so on_update fires
+// and the scene index refits the entity's bounds.
+struct TransformComponent {
+    glm::mat4 Matrix = glm::mat4(1.0f);
+};
+
+// each mesh draws with the variant of shaders its material asks for. With an
+// impostor set, far instances switch over to it (see Impostor::Fade).
+struct RenderableComponent {
+    Model*          model    = nullptr;
+    ShaderVariants* shaders  = nullptr;
+    bool            isStatic = false;
+    Impostor*       impostor = nullptr;
+};
+
+// set by StaticBatcher on static entities whose geometry is baked into its chunks,
+// they must not be submitted on their own
+struct StaticBatchedComponent {};
+
+// playback state of a skinned entity, advanced by AnimationSystem. With blendClip
+// set the pose is clip blended towards blendClip by blendWeight.
+struct AnimatorComponent {
+    const Skeleton*      skeleton    = nullptr;
+    const AnimationClip* clip        = nullptr;
+    const AnimationClip* blendClip   = nullptr;
+    float                time        = 0.0f;
+    float                blendTime   = 0.0f;
+    float                blendWeight = 0.0f;
+    float                speed       = 1.0f;
+    bool                 loop        = true;
+
+    // written by AnimationSystem::Update for the renderer
+    uint32_t paletteOffset = 0;  // first joint of this entity in the frame's palette
+    AABB     poseBounds;         // object-space box around the skinned vertices
+};
+
+// object-space bounds; the world box and the BVH proxy are maintained by SceneIndex
+struct BoundsComponent {
+    AABB     Local;
+    AABB     World;
+    uint32_t Proxy = ~0u;
+};
+
+#endif
@@ -0,0 +1,464 @@
+// frame_capture.cpp
+#include "frame_capture.h"
+
+#include "shader.h"
+#include "../core/log.hpp"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+namespace
+{
+    const char TRACE_MAGIC[4] = { 'K', 'T', 'R', 'C' };
+
+    // stdio buffer for the trace file, frames are written in one piece anyway
+    constexpr size_t FILE_BUFFER = 1024 * 1024;
+
+    void PutBytes(std::vector<char>& out, const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void Put(std::vector<char>& out, const T& value)
+    {
+        PutBytes(out, &value, sizeof(T));
+    }
+
+    // reads a chunk payload front to back, running past the end yields zeros
+    struct Cursor
+    {
+        const char* data;
+        size_t      size;
+        size_t      offset = 0;
+
+        void GetBytes(void* dst, size_t bytes)
+        {
+            if (offset + bytes > size)
+            {
+                std::memset(dst, 0, bytes);
+                offset = size;
+                return;
+            }
+            std::memcpy(dst, data + offset, bytes);
+            offset += bytes;
+        }
+
+        template <typename T>
+        T Get()
+        {
+            T value;
+            GetBytes(&value, sizeof(T));
+            return value;
+        }
+    };
+
+    // instances are affine, the last row is always (0, 0, 0, 1)
+    void PutAffine(std::vector<char>& out, const glm::mat4& m)
+    {
+        for (int column = 0; column < 4; ++column)
+            PutBytes(out, &m[column][0], 3 * sizeof(float));
+    }
+
+    glm::mat4 GetAffine(Cursor& in)
+    {
+        glm::mat4 m(1.0f);
+        for (int column = 0; column < 4; ++column)
+            in.GetBytes(&m[column][0], 3 * sizeof(float));
+        return m;
+    }
+}
+
+const char* TraceTextureTypeName(TraceTextureRole role)
+{
+    switch (role)
+    {
+        case TraceTextureRole::Specular: return "texture_specular";
+        case TraceTextureRole::Normal:   return "texture_normal";
+        case TraceTextureRole::Height:   return "texture_height";
+        default:                         return "texture_diffuse";
+    }
+}
+
+TraceTextureRole TraceTextureRoleFromType(const std::string& type)
+{
+    if (type == "texture_specular") return TraceTextureRole::Specular;
+    if (type == "texture_normal")   return TraceTextureRole::Normal;
+    if (type == "texture_height")   return TraceTextureRole::Height;
+    return TraceTextureRole::Diffuse;
+}
+
+FrameCapture& FrameCapture::Get()
+{
+    static FrameCapture instance;
+    return instance;
+}
+
+bool FrameCapture::Start(const std::string& path, bool includeGeometry)
+{
+    Stop();
+
+    m_File = std::fopen(path.c_str(), "wb");
+    if (!m_File)
+    {
+        LOG_ERROR("ERROR::CAPTURE::Could not open %s", path.c_str());
+        return false;
+    }
+    std::setvbuf(m_File, nullptr, _IOFBF, FILE_BUFFER);
+
+    uint32_t version = TRACE_VERSION;
+    std::fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), m_File);
+    std::fwrite(&version, sizeof(version), 1, m_File);
+
+    m_IncludeGeometry = includeGeometry;
+    m_FrameIndex      = 0;
+    m_FramesWritten   = 0;
+    m_BytesWritten    = sizeof(TRACE_MAGIC) + sizeof(version);
+    m_OmittedChunks    = 0;
+    m_OmittedImpostors = 0;
+    m_OmittedSkinned   = 0;
+    m_MeshIds.clear();
+    m_ShaderIds.clear();
+    m_TextureIds.clear();
+
+    LOG_INFO("CAPTURE::Recording frames to %s", path.c_str());
+    return true;
+}
+
+void FrameCapture::Stop()
+{
+    if (!m_File)
+        return;
+
+    std::fclose(m_File);
+    m_File    = nullptr;
+    m_InFrame = false;
+    LOG_INFO("CAPTURE::Stopped after %llu frames, %llu bytes",
+             (unsigned long long)m_FramesWritten, (unsigned long long)m_BytesWritten);
+    if (m_OmittedChunks || m_OmittedImpostors || m_OmittedSkinned)
+        LOG_WARN("WARNING::CAPTURE::Not in the trace: %llu static chunk, %llu impostor and %llu skinned draws",
+                 (unsigned long long)m_OmittedChunks, (unsigned long long)m_OmittedImpostors,
+                 (unsigned long long)m_OmittedSkinned);
+}
+
+void FrameCapture::BeginFrame(const glm::mat4& view, const glm::mat4& projection)
+{
+    m_InFrame = true;
+    m_Header.clear();
+    m_Passes.clear();
+    m_Batches.clear();
+    m_PassCount  = 0;
+    m_BatchCount = 0;
+
+    Put(m_Header, m_FrameIndex++);
+    PutBytes(m_Header, &view[0][0], sizeof(glm::mat4));
+    PutBytes(m_Header, &projection[0][0], sizeof(glm::mat4));
+    // the viewport completes the header in EndFrame, no pass has set it yet
+}
+
+void FrameCapture::RecordDepthPass(const glm::mat4& viewProjection, uint32_t filter)
+{
+    if (!m_InFrame)
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    PutBytes(m_Passes, &viewProjection[0][0], sizeof(glm::mat4));
+    Put(m_Passes, filter);
+    PutBytes(m_Passes, viewport, sizeof(viewport));
+    ++m_PassCount;
+}
+
+void FrameCapture::RecordBatch(const Mesh* mesh, const Shader* shader, const glm::mat4* instances,
+                               const uint8_t* isStatic, size_t count)
+{
+    if (!m_InFrame)
+        return;
+
+    // ids first, they may emit resource chunks ahead of this frame
+    uint32_t meshId   = MeshId(mesh);
+    uint32_t shaderId = ShaderId(shader);
+
+    Put(m_Batches, (uint64_t(shaderId) << 32) | meshId);
+    Put(m_Batches, meshId);
+    Put(m_Batches, shaderId);
+    Put(m_Batches, static_cast<uint32_t>(count));
+    for (size_t i = 0; i < count; ++i)
+        PutAffine(m_Batches, instances[i]);
+
+    // static flags as a bitset
+    for (size_t i = 0; i < count; i += 8)
+    {
+        uint8_t bits = 0;
+        for (size_t b = 0; b < 8 && i + b < count; ++b)
+            bits |= (isStatic[i + b] ? 1 : 0) << b;
+        Put(m_Batches, bits);
+    }
+    ++m_BatchCount;
+}
+
+void FrameCapture::RecordOmitted(size_t chunks, size_t impostors, size_t skinned)
+{
+    if (!m_InFrame || (chunks == 0 && impostors == 0 && skinned == 0))
+        return;
+
+    if (m_OmittedChunks == 0 && m_OmittedImpostors == 0 && m_OmittedSkinned == 0)
+        LOG_WARN("WARNING::CAPTURE::Static chunks, impostors and skinned meshes are not captured, "
+                 "frame %llu leaves out %zu, %zu and %zu of them",
+                 (unsigned long long)(m_FrameIndex - 1), chunks, impostors, skinned);
+    m_OmittedChunks    += chunks;
+    m_OmittedImpostors += impostors;
+    m_OmittedSkinned   += skinned;
+}
+
+void FrameCapture::EndFrame()
+{
+    if (!m_InFrame)
+        return;
+    m_InFrame = false;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    PutBytes(m_Header, viewport, sizeof(viewport));
+
+    m_Scratch.clear();
+    PutBytes(m_Scratch, m_Header.data(), m_Header.size());
+    Put(m_Scratch, m_PassCount);
+    PutBytes(m_Scratch, m_Passes.data(), m_Passes.size());
+    Put(m_Scratch, m_BatchCount);
+    PutBytes(m_Scratch, m_Batches.data(), m_Batches.size());
+    WriteChunk(TraceChunk::Frame, m_Scratch);
+    ++m_FramesWritten;
+}
+
+uint32_t FrameCapture::MeshId(const Mesh* mesh)
+{
+    auto it = m_MeshIds.find(mesh);
+    if (it != m_MeshIds.end())
+        return it->second;
+
+    uint32_t id = static_cast<uint32_t>(m_MeshIds.size());
+    m_MeshIds[mesh] = id;
+
+    // texture chunks go first so the mesh can refer to them
+    std::vector<uint32_t> textureIds;
+    for (const Texture& texture : mesh->textures)
+        textureIds.push_back(TextureId(texture.id));
+
+    std::vector<char> payload;
+    Put(payload, id);
+    Put(payload, mesh->VertexCount());
+    Put(payload, mesh->IndexCount());
+    Put(payload, static_cast<uint32_t>(mesh->textures.size()));
+    for (size_t i = 0; i < mesh->textures.size(); ++i)
+    {
+        Put(payload, textureIds[i]);
+        Put(payload, static_cast<uint8_t>(TraceTextureRoleFromType(mesh->textures[i].type)));
+    }
+    PutBytes(payload, &mesh->bounds.Min[0], sizeof(glm::vec3));
+    PutBytes(payload, &mesh->bounds.Max[0], sizeof(glm::vec3));
+    Put(payload, mesh->uvDensity);
+    Put(payload, static_cast<uint32_t>(m_IncludeGeometry ? 1 : 0));
+
+    if (m_IncludeGeometry)
+    {
+        std::vector<Vertex>       vertices;
+        std::vector<unsigned int> indices;
+        mesh->ReadBackGeometry(vertices, indices);
+        PutBytes(payload, vertices.data(), vertices.size() * sizeof(Vertex));
+        PutBytes(payload, indices.data(), indices.size() * sizeof(unsigned int));
+    }
+
+    WriteChunk(TraceChunk::Mesh, payload);
+    return id;
+}
+
+uint32_t FrameCapture::ShaderId(const Shader* shader)
+{
+    auto it = m_ShaderIds.find(shader);
+    if (it != m_ShaderIds.end())
+        return it->second;
+
+    uint32_t id = static_cast<uint32_t>(m_ShaderIds.size());
+    m_ShaderIds[shader] = id;
+
+    std::vector<char> payload;
+    Put(payload, id);
+    WriteChunk(TraceChunk::Shader, payload);
+    return id;
+}
+
+uint32_t FrameCapture::TextureId(unsigned int glId)
+{
+    auto it = m_TextureIds.find(glId);
+    if (it != m_TextureIds.end())
+        return it->second;
+
+    uint32_t id = static_cast<uint32_t>(m_TextureIds.size());
+    m_TextureIds[glId] = id;
+
+    // whatever is resident right now, streaming may change it later. The capture runs
+    // between draws, the binding it borrows is given back
+    GLint width = 0, height = 0, internalFormat = 0, maxLevel = 0, bound = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    glBindTexture(GL_TEXTURE_2D, glId);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(bound));
+
+    std::vector<char> payload;
+    Put(payload, id);
+    Put(payload, static_cast<int32_t>(width));
+    Put(payload, static_cast<int32_t>(height));
+    Put(payload, static_cast<uint32_t>(internalFormat));
+    Put(payload, static_cast<int32_t>(maxLevel + 1));
+    WriteChunk(TraceChunk::Texture, payload);
+    return id;
+}
+
+void FrameCapture::WriteChunk(TraceChunk type, const std::vector<char>& payload)
+{
+    uint32_t header[2] = { static_cast<uint32_t>(type), static_cast<uint32_t>(payload.size()) };
+    std::fwrite(header, sizeof(header), 1, m_File);
+    std::fwrite(payload.data(), 1, payload.size(), m_File);
+    m_BytesWritten += sizeof(header) + payload.size();
+}
+
+// ----------------------------------------------------------------------------
+
+TraceReader::TraceReader(const std::string& path)
+{
+    m_File = std::fopen(path.c_str(), "rb");
+    if (!m_File)
+    {
+        LOG_ERROR("ERROR::TRACE::Could not open %s", path.c_str());
+        return;
+    }
+
+    char     magic[4];
+    uint32_t version = 0;
+    if (std::fread(magic, 1, sizeof(magic), m_File) != sizeof(magic) ||
+        std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+        std::fread(&version, sizeof(version), 1, m_File) != 1 || version != TRACE_VERSION)
+    {
+        LOG_ERROR("ERROR::TRACE::%s is not a version %d trace", path.c_str(), TRACE_VERSION);
+        std::fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+TraceReader::~TraceReader()
+{
+    if (m_File)
+        std::fclose(m_File);
+}
+
+bool TraceReader::Next(TraceChunk& type)
+{
+    if (!m_File)
+        return false;
+
+    uint32_t header[2];
+    if (std::fread(header, sizeof(header), 1, m_File) != 1)
+        return false;
+
+    m_Payload.resize(header[1]);
+    if (header[1] && std::fread(m_Payload.data(), 1, header[1], m_File) != header[1])
+    {
+        LOG_WARN("WARNING::TRACE::Truncated chunk, stopping");
+        return false;
+    }
+
+    type = static_cast<TraceChunk>(header[0]);
+    return true;
+}
+
+TraceTexture TraceReader::ReadTexture() const
+{
+    Cursor in{ m_Payload.data(), m_Payload.size() };
+    TraceTexture texture;
+    texture.id             = in.Get<uint32_t>();
+    texture.width          = in.Get<int32_t>();
+    texture.height         = in.Get<int32_t>();
+    texture.internalFormat = in.Get<uint32_t>();
+    texture.levels         = in.Get<int32_t>();
+    return texture;
+}
+
+TraceMesh TraceReader::ReadMesh() const
+{
+    Cursor in{ m_Payload.data(), m_Payload.size() };
+    TraceMesh mesh;
+    mesh.id          = in.Get<uint32_t>();
+    mesh.vertexCount = in.Get<uint32_t>();
+    mesh.indexCount  = in.Get<uint32_t>();
+
+    uint32_t textureCount = in.Get<uint32_t>();
+    for (uint32_t i = 0; i < textureCount; ++i)
+    {
+        mesh.textures.push_back(in.Get<uint32_t>());
+        mesh.roles.push_back(static_cast<TraceTextureRole>(in.Get<uint8_t>()));
+    }
+
+    in.GetBytes(&mesh.bounds.Min[0], sizeof(glm::vec3));
+    in.GetBytes(&mesh.bounds.Max[0], sizeof(glm::vec3));
+    mesh.uvDensity = in.Get<float>();
+
+    if (in.Get<uint32_t>())
+    {
+        mesh.vertices.resize(mesh.vertexCount);
+        mesh.indices.resize(mesh.indexCount);
+        in.GetBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        in.GetBytes(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    }
+    return mesh;
+}
+
+uint32_t TraceReader::ReadShader() const
+{
+    Cursor in{ m_Payload.data(), m_Payload.size() };
+    return in.Get<uint32_t>();
+}
+
+void TraceReader::ReadFrame(TraceFrame& frame) const
+{
+    Cursor in{ m_Payload.data(), m_Payload.size() };
+    frame.index = in.Get<uint64_t>();
+    in.GetBytes(&frame.view[0][0], sizeof(glm::mat4));
+    in.GetBytes(&frame.projection[0][0], sizeof(glm::mat4));
+    in.GetBytes(frame.viewport, sizeof(frame.viewport));
+
+    frame.passes.resize(in.Get<uint32_t>());
+    for (TracePass& pass : frame.passes)
+    {
+        in.GetBytes(&pass.viewProjection[0][0], sizeof(glm::mat4));
+        pass.filter = in.Get<uint32_t>();
+        in.GetBytes(pass.viewport, sizeof(pass.viewport));
+    }
+
+    frame.batches.resize(in.Get<uint32_t>());
+    for (TraceBatch& batch : frame.batches)
+    {
+        batch.sortKey = in.Get<uint64_t>();
+        batch.mesh    = in.Get<uint32_t>();
+        batch.shader  = in.Get<uint32_t>();
+
+        uint32_t count = in.Get<uint32_t>();
+        batch.instances.resize(count);
+        for (glm::mat4& instance : batch.instances)
+            instance = GetAffine(in);
+
+        batch.isStatic.resize(count);
+        for (uint32_t i = 0; i < count; i += 8)
+        {
+            uint8_t bits = in.Get<uint8_t>();
+            for (uint32_t b = 0; b < 8 && i + b < count; ++b)
+                batch.isStatic[i + b] = (bits >> b) & 1;
+        }
+    }
+}
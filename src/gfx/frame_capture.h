@@ -0,0 +1,177 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.h"
+
+class Shader;
+
+// Binary trace layout, native endianness:
+//   "KTRC" u32 version, then chunks of { u32 type, u32 payloadSize, payload }.
+// Resources are emitted the first time a frame references them, so a capture
+// started mid-session is still self-contained.
+#define TRACE_VERSION 1
+
+enum class TraceChunk : uint32_t {
+    Texture = 1, // u32 id, i32 width, i32 height, u32 internalFormat, i32 levels
+    Mesh    = 2, // u32 id, u32 vertexCount, u32 indexCount, u32 textureCount, {u32 id, u8 role}[],
+                 // f32 bounds[6], f32 uvDensity, u32 hasGeometry, [Vertex[], u32 indices[]]
+    Shader  = 3, // u32 id
+    Frame   = 4  // u64 index, f32 view[16], f32 projection[16], i32 viewport[4],
+                 // u32 passCount, {f32 viewProjection[16], u32 filter, i32 viewport[4]}[],
+                 // u32 batchCount, {u64 sortKey, u32 mesh, u32 shader, u32 count, f32 affine[12][], u8 staticBits[]}[]
+};
+
+// texture roles as stored in the trace, same order as Model::processMesh loads them
+enum class TraceTextureRole : uint8_t { Diffuse, Specular, Normal, Height };
+
+const char*      TraceTextureTypeName(TraceTextureRole role);
+TraceTextureRole TraceTextureRoleFromType(const std::string& type);
+
+// Records the renderer's frame packets while active. The renderer calls the
+// Record*/EndFrame hooks; each frame is assembled in a reused buffer and written
+// with one fwrite at EndFrame. Only instanced mesh batches are captured: static
+// chunks, impostors and skinned meshes are left out of the trace, counted, and
+// reported when they first show up and when the capture stops.
+class FrameCapture
+{
+public:
+    static FrameCapture& Get();
+
+    // includeGeometry: store vertex/index data (read back from the GPU pools) so the
+    // trace replays without the original assets
+    bool Start(const std::string& path, bool includeGeometry = true);
+    void Stop();
+    bool IsActive() const { return m_File != nullptr; }
+
+    uint64_t GetFramesWritten() const { return m_FramesWritten; }
+    uint64_t GetBytesWritten()  const { return m_BytesWritten; }
+
+    // renderer hooks, only called while active. Viewports are read when the pass
+    // runs: the depth pass's in RecordDepthPass, the scene's in EndFrame (EndScene
+    // runs inside the scene pass)
+    void BeginFrame(const glm::mat4& view, const glm::mat4& projection);
+    void RecordDepthPass(const glm::mat4& viewProjection, uint32_t filter);
+    void RecordBatch(const Mesh* mesh, const Shader* shader, const glm::mat4* instances,
+                     const uint8_t* isStatic, size_t count);
+    // submissions of this frame the trace has no room for
+    void RecordOmitted(size_t chunks, size_t impostors, size_t skinned);
+    void EndFrame();
+
+private:
+    FILE*    m_File            = nullptr;
+    bool     m_IncludeGeometry = true;
+    bool     m_InFrame         = false; // a capture started mid-frame waits for the next BeginFrame
+    uint64_t m_FrameIndex      = 0;
+    uint64_t m_FramesWritten   = 0;
+    uint64_t m_BytesWritten    = 0;
+
+    // left out since Start
+    uint64_t m_OmittedChunks    = 0;
+    uint64_t m_OmittedImpostors = 0;
+    uint64_t m_OmittedSkinned   = 0;
+
+    std::unordered_map<const Mesh*, uint32_t>   m_MeshIds;
+    std::unordered_map<const Shader*, uint32_t> m_ShaderIds;
+    std::unordered_map<unsigned int, uint32_t>  m_TextureIds; // GL id -> trace id
+
+    // frame being assembled: fixed header, depth passes and batches are kept apart
+    // because passes arrive before the batches are known
+    std::vector<char> m_Header;
+    std::vector<char> m_Passes;
+    std::vector<char> m_Batches;
+    uint32_t          m_PassCount  = 0;
+    uint32_t          m_BatchCount = 0;
+    std::vector<char> m_Scratch;   // the assembled frame payload
+
+    FrameCapture() = default;
+    ~FrameCapture() { Stop(); }
+
+    uint32_t MeshId(const Mesh* mesh);
+    uint32_t ShaderId(const Shader* shader);
+    uint32_t TextureId(unsigned int glId);
+    void     WriteChunk(TraceChunk type, const std::vector<char>& payload);
+};
+
+// ----------------------------------------------------------------------------
+// Reading side, used by the replay tool
+
+struct TraceTexture {
+    uint32_t id;
+    int      width;
+    int      height;
+    uint32_t internalFormat;
+    int      levels;
+};
+
+struct TraceMesh {
+    uint32_t                      id;
+    uint32_t                      vertexCount;
+    uint32_t                      indexCount;
+    std::vector<uint32_t>         textures;
+    std::vector<TraceTextureRole> roles;
+    AABB                          bounds;
+    float                         uvDensity;
+    std::vector<Vertex>           vertices; // empty when captured without geometry
+    std::vector<unsigned int>     indices;
+};
+
+struct TracePass {
+    glm::mat4 viewProjection;
+    uint32_t  filter;
+    int       viewport[4];
+};
+
+struct TraceBatch {
+    uint64_t               sortKey;
+    uint32_t               mesh;
+    uint32_t               shader;
+    std::vector<glm::mat4> instances;
+    std::vector<uint8_t>   isStatic;
+};
+
+struct TraceFrame {
+    uint64_t                index;
+    glm::mat4               view;
+    glm::mat4               projection;
+    int                     viewport[4];
+    std::vector<TracePass>  passes;
+    std::vector<TraceBatch> batches;
+};
+
+// Sequential reader. Next() hands out one chunk at a time, resources before the
+// frames that use them.
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::string& path);
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool Valid() const { return m_File != nullptr; }
+
+    // false at the end of the trace (or on a damaged chunk)
+    bool Next(TraceChunk& type);
+
+    // decode the chunk Next() just returned
+    TraceTexture ReadTexture() const;
+    TraceMesh    ReadMesh() const;
+    uint32_t     ReadShader() const;
+    void         ReadFrame(TraceFrame& frame) const; // reuses frame's storage
+
+private:
+    FILE*             m_File = nullptr;
+    std::vector<char> m_Payload;
+};
+
+#endif
@@ -0,0 +1,615 @@
+// frame_graph.cpp
+#include "frame_graph.h"
+#include "gpu_memory.h"
+#include "../core/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    bool IsDepthFormat(GLenum format)
+    {
+        switch (format)
+        {
+        case GL_DEPTH_COMPONENT16:
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_DEPTH24_STENCIL8:
+        case GL_DEPTH32F_STENCIL8:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool HasStencil(GLenum format)
+    {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    // any format/type pair the internal format accepts will do, no pixels are uploaded
+    void TransferFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+    {
+        if (internalFormat == GL_DEPTH24_STENCIL8)
+        {
+            format = GL_DEPTH_STENCIL;
+            type   = GL_UNSIGNED_INT_24_8;
+        }
+        else if (internalFormat == GL_DEPTH32F_STENCIL8)
+        {
+            format = GL_DEPTH_STENCIL;
+            type   = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+        }
+        else if (IsDepthFormat(internalFormat))
+        {
+            format = GL_DEPTH_COMPONENT;
+            type   = GL_FLOAT;
+        }
+        else
+        {
+            format = GL_RGBA;
+            type   = GL_FLOAT;
+        }
+    }
+
+    GLuint CreateTarget(const FrameGraphTextureDesc& desc)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+
+        if (desc.Samples > 1)
+        {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.Samples, desc.Format,
+                                    desc.Width, desc.Height, GL_TRUE);
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+        }
+        else
+        {
+            GLenum format, type;
+            TransferFormat(desc.Format, format, type);
+
+            // depth is read back texel for texel, color gets upscaled by the post passes
+            GLint filter = IsDepthFormat(desc.Format) ? GL_NEAREST : GL_LINEAR;
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.Format, desc.Width, desc.Height, 0, format, type, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget, int64_t(
+            GpuMemory::TextureBytes(desc.Format, desc.Width, desc.Height, 1, 1, desc.Samples)));
+        return texture;
+    }
+
+    // what a later access needs flushed after a shader wrote the resource
+    GLbitfield BarrierBits(FrameGraphAccess access)
+    {
+        switch (access)
+        {
+        case FrameGraphAccess::Attachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+        case FrameGraphAccess::Sampled:    return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case FrameGraphAccess::Storage:    return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case FrameGraphAccess::Transfer:   return GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+        case FrameGraphAccess::External:   return GL_ALL_BARRIER_BITS;
+        }
+        return GL_ALL_BARRIER_BITS;
+    }
+
+    void Toggle(GLenum capability, bool enable)
+    {
+        if (enable)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+}
+
+FrameGraph::~FrameGraph()
+{
+    for (const CachedFramebuffer& framebuffer : m_Framebuffers)
+        glDeleteFramebuffers(1, &framebuffer.FBO);
+    for (const PooledTarget& target : m_Pool)
+    {
+        glDeleteTextures(1, &target.Texture);
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget, -int64_t(
+            GpuMemory::TextureBytes(target.Desc.Format, target.Desc.Width, target.Desc.Height, 1, 1, target.Desc.Samples)));
+    }
+}
+
+FrameGraphResource FrameGraph::Builder::Create(const char* name, const FrameGraphTextureDesc& desc)
+{
+    return m_Graph.AddResource(name, desc, 0, false, false);
+}
+
+FrameGraphResource FrameGraph::Builder::Read(FrameGraphResource resource, FrameGraphAccess access)
+{
+    m_Graph.AddAccess(m_Pass, resource, access, false);
+    return resource;
+}
+
+FrameGraphResource FrameGraph::Builder::Write(FrameGraphResource resource, FrameGraphAccess access)
+{
+    m_Graph.AddAccess(m_Pass, resource, access, true);
+    return resource;
+}
+
+void FrameGraph::Builder::SetState(const FrameGraphPassState& state)
+{
+    m_Graph.m_Passes[m_Pass].State = state;
+}
+
+void FrameGraph::Builder::SideEffect()
+{
+    m_Graph.m_Passes[m_Pass].SideEffect = true;
+}
+
+GLuint FrameGraph::Context::Texture(FrameGraphResource resource) const
+{
+    return m_Graph.m_Resources[resource].Texture;
+}
+
+const FrameGraphTextureDesc& FrameGraph::Context::Desc(FrameGraphResource resource) const
+{
+    return m_Graph.m_Resources[resource].Desc;
+}
+
+GLuint FrameGraph::Context::Framebuffer(std::initializer_list<FrameGraphResource> resources) const
+{
+    return m_Graph.GetFramebuffer(resources.begin(), resources.size());
+}
+
+FrameGraphResource FrameGraph::Import(const char* name, const FrameGraphTextureDesc& desc, GLuint texture)
+{
+    return AddResource(name, desc, texture, true, false);
+}
+
+FrameGraphResource FrameGraph::ImportBackbuffer(int width, int height)
+{
+    FrameGraphTextureDesc desc;
+    desc.Width  = width;
+    desc.Height = height;
+    desc.Format = GL_SRGB8_ALPHA8;
+    return AddResource("backbuffer", desc, 0, true, true);
+}
+
+uint32_t FrameGraph::BeginPass(const char* name)
+{
+    PassNode pass = {};
+    pass.Name        = name;
+    pass.FirstAccess = static_cast<uint32_t>(m_Accesses.size());
+    m_Passes.push_back(pass);
+    m_Compiled = false;
+    return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+FrameGraphResource FrameGraph::AddResource(const char* name, const FrameGraphTextureDesc& desc, GLuint texture,
+                                           bool imported, bool backbuffer)
+{
+    ResourceNode resource = {};
+    resource.Name       = name;
+    resource.Desc       = desc;
+    resource.Texture    = texture;
+    resource.Imported   = imported;
+    resource.Backbuffer = backbuffer;
+    resource.First      = -1;
+    resource.Last       = -1;
+    resource.Physical   = -1;
+    m_Resources.push_back(resource);
+    return static_cast<FrameGraphResource>(m_Resources.size() - 1);
+}
+
+void FrameGraph::AddAccess(uint32_t pass, FrameGraphResource resource, FrameGraphAccess access, bool write)
+{
+    if (resource >= m_Resources.size())
+    {
+        LOG_ERROR("ERROR::FRAME_GRAPH::pass %s uses an invalid resource", m_Passes[pass].Name);
+        return;
+    }
+
+    m_Accesses.push_back({ resource, access, write });
+    ++m_Passes[pass].AccessCount;
+}
+
+void FrameGraph::Compile()
+{
+    Cull();
+    AssignTargets();
+    m_Compiled = true;
+}
+
+void FrameGraph::Cull()
+{
+    // walk backwards: a pass survives if it writes something a surviving later pass
+    // reads (or something that outlives the frame), and then what it reads is needed
+    m_Needed.assign(m_Resources.size(), 0);
+
+    for (size_t i = m_Passes.size(); i-- > 0;)
+    {
+        PassNode& pass = m_Passes[i];
+        const AccessNode* accesses = m_Accesses.data() + pass.FirstAccess;
+
+        bool alive = pass.SideEffect;
+        for (uint32_t a = 0; a < pass.AccessCount && !alive; ++a)
+            if (accesses[a].Write && (m_Resources[accesses[a].Resource].Imported || m_Needed[accesses[a].Resource]))
+                alive = true;
+
+        pass.Alive = alive;
+        if (!alive)
+            continue;
+
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+            if (accesses[a].Write)
+                m_Needed[accesses[a].Resource] = 0;
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+            if (!accesses[a].Write)
+                m_Needed[accesses[a].Resource] = 1;
+    }
+}
+
+void FrameGraph::AssignTargets()
+{
+    m_Order.clear();
+    for (uint32_t i = 0; i < m_Passes.size(); ++i)
+        if (m_Passes[i].Alive)
+            m_Order.push_back(i);
+
+    m_Stats = Stats();
+    m_Stats.Passes       = m_Passes.size();
+    m_Stats.CulledPasses = m_Passes.size() - m_Order.size();
+
+    // lifetimes, in positions of m_Order
+    for (int k = 0; k < (int)m_Order.size(); ++k)
+    {
+        const PassNode& pass = m_Passes[m_Order[k]];
+        const AccessNode* accesses = m_Accesses.data() + pass.FirstAccess;
+
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+        {
+            ResourceNode& resource = m_Resources[accesses[a].Resource];
+            if (resource.Imported)
+                continue;
+
+            if (resource.First < 0)
+            {
+                resource.First = k;
+                if (!accesses[a].Write)
+                    LOG_WARN("WARNING::FRAME_GRAPH::%s reads %s before any pass writes it", pass.Name, resource.Name);
+            }
+            resource.Last = k;
+        }
+    }
+
+    // a target goes back to the pool after its last pass, so the next transient with the
+    // same description that starts later gets the same texture
+    for (int k = 0; k < (int)m_Order.size(); ++k)
+    {
+        const PassNode& pass = m_Passes[m_Order[k]];
+        const AccessNode* accesses = m_Accesses.data() + pass.FirstAccess;
+
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+        {
+            ResourceNode& resource = m_Resources[accesses[a].Resource];
+            if (resource.Imported || resource.First != k || resource.Physical >= 0)
+                continue;
+
+            resource.Physical = AcquireTarget(resource.Desc);
+            resource.Texture  = m_Pool[resource.Physical].Texture;
+
+            ++m_Stats.Transients;
+            m_Stats.TransientBytes += GpuMemory::TextureBytes(resource.Desc.Format, resource.Desc.Width,
+                                                              resource.Desc.Height, 1, 1, resource.Desc.Samples);
+        }
+
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+        {
+            const ResourceNode& resource = m_Resources[accesses[a].Resource];
+            if (resource.Physical >= 0 && resource.Last == k)
+                m_Pool[resource.Physical].InUse = false;
+        }
+    }
+
+    for (const PooledTarget& target : m_Pool)
+    {
+        if (target.LastUsed == m_Frame)
+            ++m_Stats.PhysicalTargets;
+        m_Stats.PooledBytes += GpuMemory::TextureBytes(target.Desc.Format, target.Desc.Width,
+                                                       target.Desc.Height, 1, 1, target.Desc.Samples);
+    }
+}
+
+int FrameGraph::AcquireTarget(const FrameGraphTextureDesc& desc)
+{
+    for (size_t i = 0; i < m_Pool.size(); ++i)
+    {
+        PooledTarget& target = m_Pool[i];
+        if (!target.InUse && target.Desc == desc)
+        {
+            target.InUse    = true;
+            target.LastUsed = m_Frame;
+            return static_cast<int>(i);
+        }
+    }
+
+    PooledTarget target;
+    target.Desc     = desc;
+    target.Texture  = CreateTarget(desc);
+    target.LastUsed = m_Frame;
+    target.InUse    = true;
+    m_Pool.push_back(target);
+    return static_cast<int>(m_Pool.size() - 1);
+}
+
+void FrameGraph::Execute()
+{
+    if (!m_Compiled)
+        Compile();
+
+    // whatever ran outside the graph may have changed state, the first pass sets all of it
+    m_AppliedValid = false;
+
+    Context context(*this);
+    for (uint32_t index : m_Order)
+    {
+        const PassNode& pass = m_Passes[index];
+
+        IssueBarriers(pass);
+        bool bound = BindAttachments(pass);
+        ApplyState(pass.State);
+
+        if (bound && pass.State.Clear)
+        {
+            // the depth mask also masks clears
+            bool maskDepth = (pass.State.Clear & GL_DEPTH_BUFFER_BIT) && !pass.State.DepthWrite;
+            if (maskDepth)
+                glDepthMask(GL_TRUE);
+            glClear(pass.State.Clear);
+            if (maskDepth)
+                glDepthMask(GL_FALSE);
+        }
+
+        pass.Invoke(pass.Data, context);
+
+        const AccessNode* accesses = m_Accesses.data() + pass.FirstAccess;
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+        {
+            if (accesses[a].Write && accesses[a].Access == FrameGraphAccess::Storage)
+            {
+                ResourceNode& resource = m_Resources[accesses[a].Resource];
+                resource.StorageDirty = true;
+                resource.Synchronized = 0;
+            }
+        }
+    }
+
+    Reset();
+    ReleaseUnused();
+    ++m_Frame;
+}
+
+void FrameGraph::IssueBarriers(const PassNode& pass)
+{
+    GLbitfield bits = 0;
+
+    const AccessNode* accesses = m_Accesses.data() + pass.FirstAccess;
+    for (uint32_t a = 0; a < pass.AccessCount; ++a)
+    {
+        ResourceNode& resource = m_Resources[accesses[a].Resource];
+        if (!resource.StorageDirty)
+            continue;
+
+        GLbitfield needed = BarrierBits(accesses[a].Access) & ~resource.Synchronized;
+        resource.Synchronized |= needed;
+        bits |= needed;
+    }
+
+    // nothing can write storage without 4.2 in the first place
+    if (bits && GLAD_GL_VERSION_4_2)
+        glMemoryBarrier(bits);
+}
+
+bool FrameGraph::BindAttachments(const PassNode& pass)
+{
+    FrameGraphResource attachments[FRAME_GRAPH_MAX_ATTACHMENTS + 1];
+    size_t count      = 0;
+    bool   backbuffer = false;
+
+    const AccessNode* accesses = m_Accesses.data() + pass.FirstAccess;
+    for (uint32_t a = 0; a < pass.AccessCount; ++a)
+    {
+        if (accesses[a].Access != FrameGraphAccess::Attachment)
+            continue;
+
+        FrameGraphResource resource = accesses[a].Resource;
+        if (m_Resources[resource].Backbuffer)
+        {
+            backbuffer = true;
+            continue;
+        }
+
+        // read and written (blending, depth test + write) is still one attachment
+        if (std::find(attachments, attachments + count, resource) != attachments + count)
+            continue;
+        if (count == FRAME_GRAPH_MAX_ATTACHMENTS + 1)
+        {
+            LOG_ERROR("ERROR::FRAME_GRAPH::%s has more attachments than a framebuffer takes", pass.Name);
+            break;
+        }
+        attachments[count++] = resource;
+    }
+
+    if (backbuffer)
+    {
+        if (count > 0)
+            LOG_ERROR("ERROR::FRAME_GRAPH::%s mixes the backbuffer with offscreen attachments", pass.Name);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        for (uint32_t a = 0; a < pass.AccessCount; ++a)
+        {
+            const ResourceNode& resource = m_Resources[accesses[a].Resource];
+            if (resource.Backbuffer)
+            {
+                glViewport(0, 0, resource.Desc.Width, resource.Desc.Height);
+                break;
+            }
+        }
+        return true;
+    }
+
+    if (count == 0)
+        return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, GetFramebuffer(attachments, count));
+    const FrameGraphTextureDesc& desc = m_Resources[attachments[0]].Desc;
+    glViewport(0, 0, desc.Width, desc.Height);
+    return true;
+}
+
+void FrameGraph::ApplyState(const FrameGraphPassState& state)
+{
+    bool all = !m_AppliedValid;
+
+    if (all || state.DepthTest != m_Applied.DepthTest)
+        Toggle(GL_DEPTH_TEST, state.DepthTest);
+    if (all || state.DepthWrite != m_Applied.DepthWrite)
+        glDepthMask(state.DepthWrite ? GL_TRUE : GL_FALSE);
+    if (all || state.DepthFunc != m_Applied.DepthFunc)
+        glDepthFunc(state.DepthFunc);
+    if (all || state.Blend != m_Applied.Blend)
+        Toggle(GL_BLEND, state.Blend);
+    if (all || state.BlendSrc != m_Applied.BlendSrc || state.BlendDst != m_Applied.BlendDst)
+        glBlendFunc(state.BlendSrc, state.BlendDst);
+    if (all || state.CullFace != m_Applied.CullFace)
+        Toggle(GL_CULL_FACE, state.CullFace);
+
+    m_Applied      = state;
+    m_AppliedValid = true;
+}
+
+GLuint FrameGraph::GetFramebuffer(const FrameGraphResource* resources, size_t count)
+{
+    CachedFramebuffer key = {};
+    int  colors    = 0;
+    bool transient = false;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const ResourceNode& resource = m_Resources[resources[i]];
+        transient |= resource.Imported;
+
+        if (IsDepthFormat(resource.Desc.Format))
+            key.Attachments[FRAME_GRAPH_MAX_ATTACHMENTS] = resource.Texture;
+        else if (colors < FRAME_GRAPH_MAX_ATTACHMENTS)
+            key.Attachments[colors++] = resource.Texture;
+    }
+
+    for (const CachedFramebuffer& framebuffer : m_Framebuffers)
+        if (std::memcmp(framebuffer.Attachments, key.Attachments, sizeof(key.Attachments)) == 0)
+            return framebuffer.FBO;
+
+    glGenFramebuffers(1, &key.FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, key.FBO);
+
+    GLenum drawBuffers[FRAME_GRAPH_MAX_ATTACHMENTS];
+    colors = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const ResourceNode& resource = m_Resources[resources[i]];
+        GLenum target = resource.Desc.Samples > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+
+        if (IsDepthFormat(resource.Desc.Format))
+        {
+            GLenum attachment = HasStencil(resource.Desc.Format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, target, resource.Texture, 0);
+        }
+        else if (colors < FRAME_GRAPH_MAX_ATTACHMENTS)
+        {
+            drawBuffers[colors] = GL_COLOR_ATTACHMENT0 + colors;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[colors], target, resource.Texture, 0);
+            ++colors;
+        }
+    }
+
+    if (colors > 0)
+    {
+        glDrawBuffers(colors, drawBuffers);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+    }
+    else
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        LOG_ERROR("ERROR::FRAME_GRAPH::framebuffer with %s is not complete", m_Resources[resources[0]].Name);
+
+    // imported textures can be deleted and their names reused behind the graph's back
+    key.Transient = transient;
+    m_Framebuffers.push_back(key);
+    return key.FBO;
+}
+
+void FrameGraph::ReleaseUnused()
+{
+    for (size_t i = 0; i < m_Pool.size();)
+    {
+        PooledTarget& target = m_Pool[i];
+        if (m_Frame - target.LastUsed < FRAME_GRAPH_POOL_FRAMES)
+        {
+            ++i;
+            continue;
+        }
+
+        for (size_t f = 0; f < m_Framebuffers.size();)
+        {
+            const GLuint* attachments = m_Framebuffers[f].Attachments;
+            if (std::find(attachments, attachments + FRAME_GRAPH_MAX_ATTACHMENTS + 1, target.Texture)
+                != attachments + FRAME_GRAPH_MAX_ATTACHMENTS + 1)
+            {
+                glDeleteFramebuffers(1, &m_Framebuffers[f].FBO);
+                m_Framebuffers[f] = m_Framebuffers.back();
+                m_Framebuffers.pop_back();
+            }
+            else
+                ++f;
+        }
+
+        glDeleteTextures(1, &target.Texture);
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget, -int64_t(
+            GpuMemory::TextureBytes(target.Desc.Format, target.Desc.Width, target.Desc.Height, 1, 1, target.Desc.Samples)));
+
+        m_Pool[i] = m_Pool.back();
+        m_Pool.pop_back();
+    }
+}
+
+void FrameGraph::Reset()
+{
+    for (size_t f = 0; f < m_Framebuffers.size();)
+    {
+        if (m_Framebuffers[f].Transient)
+        {
+            glDeleteFramebuffers(1, &m_Framebuffers[f].FBO);
+            m_Framebuffers[f] = m_Framebuffers.back();
+            m_Framebuffers.pop_back();
+        }
+        else
+            ++f;
+    }
+
+    for (PooledTarget& target : m_Pool)
+        target.InUse = false;
+
+    m_Resources.clear();
+    m_Accesses.clear();
+    m_Passes.clear();
+    m_Order.clear();
+    m_Arena.Reset();
+    m_Compiled = false;
+}
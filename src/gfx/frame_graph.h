@@ -0,0 +1,233 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../core/frame_arena.hpp"
+
+#define FRAME_GRAPH_MAX_ATTACHMENTS 4 // color attachments per framebuffer
+#define FRAME_GRAPH_POOL_FRAMES     8 // pooled targets unused for this many frames are released
+
+using FrameGraphResource = uint32_t;
+#define FRAME_GRAPH_INVALID 0xFFFFFFFFu
+
+struct FrameGraphTextureDesc {
+    int    Width   = 0;
+    int    Height  = 0;
+    GLenum Format  = GL_RGBA8;
+    int    Samples = 1; // > 1 allocates a multisample texture
+
+    bool operator==(const FrameGraphTextureDesc& other) const
+    {
+        return Width == other.Width && Height == other.Height
+            && Format == other.Format && Samples == other.Samples;
+    }
+};
+
+// how a pass touches a resource, decides the framebuffer it gets and the barriers before it
+enum class FrameGraphAccess {
+    Attachment, // drawn to (or depth tested against) through the framebuffer the graph binds
+    Sampled,    // texture fetches
+    Storage,    // image load/store from shaders, later accesses get a memory barrier
+    Transfer,   // blit source or destination, the pass binds Context::Framebuffer itself
+    External    // the pass renders through a framebuffer of its own, only the dependency is tracked
+};
+
+// fixed-function state a pass runs with, applied once before it executes
+struct FrameGraphPassState {
+    bool       DepthTest  = true;
+    bool       DepthWrite = true;
+    GLenum     DepthFunc  = GL_LESS;
+    bool       Blend      = false;
+    GLenum     BlendSrc   = GL_SRC_ALPHA;
+    GLenum     BlendDst   = GL_ONE_MINUS_SRC_ALPHA;
+    bool       CullFace   = false;
+    // buffers cleared (with the current clear color) once the pass framebuffer is bound
+    GLbitfield Clear      = 0;
+};
+
+// Passes for one frame, declared up front with the resources they read and write.
+// Compile culls passes nothing depends on, computes the lifetime of every transient
+// render target and backs targets whose lifetimes do not overlap with the same
+// pooled texture; Execute runs the surviving passes in declaration order (a pass can
+// only see resources declared before it, so that order is already topological),
+// binding each pass's attachments, applying its state and issuing the memory
+// barriers shader writes need. Everything declared is dropped after Execute; the
+// pooled textures and framebuffers carry over to the next frame.
+class FrameGraph
+{
+public:
+    class Context;
+
+    class Builder
+    {
+    public:
+        // a render target that only lives inside this frame
+        FrameGraphResource Create(const char* name, const FrameGraphTextureDesc& desc);
+        FrameGraphResource Read(FrameGraphResource resource, FrameGraphAccess access = FrameGraphAccess::Sampled);
+        // a pass that draws on top of existing contents should Read the resource too
+        FrameGraphResource Write(FrameGraphResource resource, FrameGraphAccess access = FrameGraphAccess::Attachment);
+        void SetState(const FrameGraphPassState& state);
+        // never cull this pass, e.g. it reads back or writes something the graph cannot see
+        void SideEffect();
+
+    private:
+        friend class FrameGraph;
+        Builder(FrameGraph& graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+
+        FrameGraph& m_Graph;
+        uint32_t    m_Pass;
+    };
+
+    // handed to pass callbacks, resolves resources to the GL objects backing them this frame
+    class Context
+    {
+    public:
+        GLuint Texture(FrameGraphResource resource) const;
+        const FrameGraphTextureDesc& Desc(FrameGraphResource resource) const;
+        // framebuffer with the given targets attached in order, depth formats on the
+        // depth attachment. Cached across frames for pooled targets.
+        GLuint Framebuffer(std::initializer_list<FrameGraphResource> resources) const;
+
+    private:
+        friend class FrameGraph;
+        explicit Context(FrameGraph& graph) : m_Graph(graph) {}
+
+        FrameGraph& m_Graph;
+    };
+
+    struct Stats {
+        size_t Passes          = 0; // declared
+        size_t CulledPasses    = 0;
+        size_t Transients      = 0; // transient targets the surviving passes use
+        size_t PhysicalTargets = 0; // pooled textures backing them
+        size_t TransientBytes  = 0; // what the transients would take without aliasing
+        size_t PooledBytes     = 0; // what the pool holds
+    };
+
+    FrameGraph() = default;
+    ~FrameGraph();
+
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // a texture owned outside the graph; its contents outlive the frame, so passes writing it are kept
+    FrameGraphResource Import(const char* name, const FrameGraphTextureDesc& desc, GLuint texture);
+    // the default framebuffer
+    FrameGraphResource ImportBackbuffer(int width, int height);
+
+    // setup runs immediately with a Builder, execute runs from Execute with a Context.
+    // execute is stored in the graph's arena and never destroyed, so it has to be
+    // trivially destructible (capture by reference or plain values).
+    template <typename Setup, typename Execute>
+    void AddPass(const char* name, Setup&& setup, Execute&& execute)
+    {
+        using Callback = typename std::decay<Execute>::type;
+        static_assert(std::is_trivially_destructible<Callback>::value,
+                      "frame graph passes are never destroyed, capture by reference");
+
+        Builder builder(*this, BeginPass(name));
+        setup(builder);
+
+        void* data = m_Arena.Allocate(sizeof(Callback), alignof(Callback));
+        new (data) Callback(std::forward<Execute>(execute));
+        m_Passes.back().Data   = data;
+        m_Passes.back().Invoke = [](void* callback, const Context& context) {
+            (*static_cast<Callback*>(callback))(context);
+        };
+    }
+
+    void Compile();
+    // compiles first if needed, then runs and resets the graph for the next frame
+    void Execute();
+
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    struct ResourceNode {
+        const char*           Name;
+        FrameGraphTextureDesc Desc;
+        GLuint                Texture;
+        bool                  Imported;
+        bool                  Backbuffer;
+        int                   First;          // lifetime in m_Order, transients only
+        int                   Last;
+        int                   Physical;       // index into m_Pool
+        bool                  StorageDirty;   // written from shaders, not yet fully synchronized
+        GLbitfield            Synchronized;   // barrier bits issued since that write
+    };
+
+    struct AccessNode {
+        FrameGraphResource Resource;
+        FrameGraphAccess   Access;
+        bool               Write;
+    };
+
+    struct PassNode {
+        const char*         Name;
+        FrameGraphPassState State;
+        bool                SideEffect;
+        bool                Alive;
+        uint32_t            FirstAccess;
+        uint32_t            AccessCount;
+        void*               Data;
+        void              (*Invoke)(void*, const Context&);
+    };
+
+    struct PooledTarget {
+        FrameGraphTextureDesc Desc;
+        GLuint                Texture;
+        uint64_t              LastUsed;
+        bool                  InUse;
+    };
+
+    struct CachedFramebuffer {
+        GLuint   Attachments[FRAME_GRAPH_MAX_ATTACHMENTS + 1]; // colors, then depth
+        GLuint   FBO;
+        bool     Transient; // has an imported attachment, deleted at the end of the frame
+    };
+
+    std::vector<ResourceNode>      m_Resources;
+    std::vector<AccessNode>        m_Accesses;
+    std::vector<PassNode>          m_Passes;
+    std::vector<uint32_t>          m_Order;
+    std::vector<uint8_t>           m_Needed; // scratch for culling
+    std::vector<PooledTarget>      m_Pool;
+    std::vector<CachedFramebuffer> m_Framebuffers;
+    LinearArena                    m_Arena { 4 * 1024 };
+    uint64_t                       m_Frame    = 0;
+    bool                           m_Compiled = false;
+    Stats                          m_Stats;
+
+    // state as last applied, so only what changes between passes is touched
+    FrameGraphPassState m_Applied;
+    bool                m_AppliedValid = false;
+
+    uint32_t BeginPass(const char* name);
+    FrameGraphResource AddResource(const char* name, const FrameGraphTextureDesc& desc, GLuint texture,
+                                   bool imported, bool backbuffer);
+    void AddAccess(uint32_t pass, FrameGraphResource resource, FrameGraphAccess access, bool write);
+
+    void Cull();
+    void AssignTargets();
+    int  AcquireTarget(const FrameGraphTextureDesc& desc);
+
+    void IssueBarriers(const PassNode& pass);
+    // binds the pass framebuffer and sizes the viewport to it, false if the pass has no attachments
+    bool BindAttachments(const PassNode& pass);
+    void ApplyState(const FrameGraphPassState& state);
+    GLuint GetFramebuffer(const FrameGraphResource* resources, size_t count);
+
+    void ReleaseUnused();
+    void Reset();
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// axis aligned bounding box
+struct AABB {
+    glm::vec3 Min = glm::vec3( FLT_MAX);
+    glm::vec3 Max = glm::vec3(-FLT_MAX);
+
+    void Expand(const glm::vec3& p)
+    {
+        Min = glm::min(Min, p);
+        Max = glm::max(Max, p);
+    }
+
+    bool Valid() const { return Min.x <= Max.x; }
+
+    glm::vec3 Center()  const { return (Min + Max) * 0.5f; }
+    glm::vec3 Extents() const { return (Max - Min) * 0.5f; }
+
+    // bounds of this box after an affine transform (Arvo's method)
+    AABB Transformed(const glm::mat4& m) const
+    {
+        AABB result;
+        glm::vec3 center  = glm::vec3(m * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 e;
+        for (int i = 0; i < 3; ++i)
+            e[i] = glm::abs(m[0][i]) * extents.x + glm::abs(m[1][i]) * extents.y + glm::abs(m[2][i]) * extents.z;
+        result.Min = center - e;
+        result.Max = center + e;
+        return result;
+    }
+};
+
+// six clip planes extracted from a view-projection matrix (Gribb/Hartmann)
+struct Frustum {
+    glm::vec4 Planes[6];
+
+    static Frustum FromMatrix(const glm::mat4& m)
+    {
+        Frustum f;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        f.Planes[0] = row3 + row0; // left
+        f.Planes[1] = row3 - row0; // right
+        f.Planes[2] = row3 + row1; // bottom
+        f.Planes[3] = row3 - row1; // top
+        f.Planes[4] = row3 + row2; // near
+        f.Planes[5] = row3 - row2; // far
+
+        for (auto& p : f.Planes)
+            p /= glm::length(glm::vec3(p.x, p.y, p.z));
+        return f;
+    }
+
+    // conservative test: false only if the box is fully outside one plane
+    bool Intersects(const AABB& box) const
+    {
+        for (const auto& p : Planes)
+        {
+            glm::vec3 positive(p.x > 0.0f ? box.Max.x : box.Min.x,
+                               p.y > 0.0f ? box.Max.y : box.Min.y,
+                               p.z > 0.0f ? box.Max.z : box.Min.z);
+            if (p.x * positive.x + p.y * positive.y + p.z * positive.z + p.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
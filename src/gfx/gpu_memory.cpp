@@ -0,0 +1,242 @@
+// gpu_memory.cpp
+#include "gpu_memory.h"
+
+#include <algorithm>
+
+size_t GpuMemory::s_Bytes[static_cast<size_t>(GpuMemoryCategory::Count)] = {};
+size_t GpuMemory::s_Peak[static_cast<size_t>(GpuMemoryCategory::Count)]  = {};
+
+const char* GpuMemoryCategoryName(GpuMemoryCategory category)
+{
+    switch (category)
+    {
+        case GpuMemoryCategory::VertexBuffer:   return "vertex buffers";
+        case GpuMemoryCategory::IndexBuffer:    return "index buffers";
+        case GpuMemoryCategory::InstanceBuffer: return "instance buffers";
+        case GpuMemoryCategory::Texture:        return "textures";
+        case GpuMemoryCategory::RenderTarget:   return "render targets";
+        case GpuMemoryCategory::Readback:       return "readback buffers";
+        default:                                return "unknown";
+    }
+}
+
+namespace
+{
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void GpuAllocation::Release()
+{
+    if (!m_Pool)
+        return;
+
+    m_Pool->Free(m_Page, GpuBufferPool::Range{ m_Offset, m_Size });
+    m_Pool = nullptr;
+}
+
+GpuBufferPool::GpuBufferPool(GpuMemoryCategory category, size_t pageSize, size_t alignment)
+    : m_Category(category), m_PageSize(pageSize), m_Alignment(alignment)
+{}
+
+GpuAllocation GpuBufferPool::Allocate(size_t size, const void* data)
+{
+    GpuAllocation allocation;
+    if (size == 0)
+        return allocation;
+
+    size_t       alignedSize = AlignUp(size, m_Alignment);
+    size_t       offset      = 0;
+    unsigned int page        = 0;
+
+    while (page < m_Pages.size() && !TryAllocate(page, alignedSize, offset))
+        ++page;
+
+    if (page == m_Pages.size())
+    {
+        // oversized requests get a page of their own
+        page = AddPage(std::max(m_PageSize, alignedSize));
+        TryAllocate(page, alignedSize, offset);
+    }
+
+    m_Used += alignedSize;
+
+    if (data)
+    {
+        // the copy target never touches VAO state (unlike GL_ELEMENT_ARRAY_BUFFER)
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Pages[page].buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    allocation.m_Pool   = this;
+    allocation.m_Page   = page;
+    allocation.m_Offset = offset;
+    allocation.m_Size   = alignedSize;
+    allocation.m_Buffer = m_Pages[page].buffer;
+    return allocation;
+}
+
+void GpuBufferPool::EndFrame()
+{
+    if (!m_FreedThisFrame.empty())
+    {
+        FencedFrees batch;
+        batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        batch.frees.swap(m_FreedThisFrame);
+        m_InFlight.push_back(std::move(batch));
+    }
+
+    // fences signal in order, stop at the first one still pending
+    while (!m_InFlight.empty())
+    {
+        FencedFrees& oldest = m_InFlight.front();
+        GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(oldest.fence);
+        for (const PendingFree& pending : oldest.frees)
+        {
+            m_PendingBytes -= pending.range.size;
+            ReturnRange(pending.page, pending.range);
+        }
+        m_InFlight.pop_front();
+    }
+}
+
+void GpuBufferPool::Free(unsigned int page, Range range)
+{
+    m_Used         -= range.size;
+    m_PendingBytes += range.size;
+    m_FreedThisFrame.push_back(PendingFree{ page, range });
+}
+
+void GpuBufferPool::ReturnRange(unsigned int page, Range range)
+{
+    std::vector<Range>& freeList = m_Pages[page].freeList;
+
+    auto it = std::lower_bound(freeList.begin(), freeList.end(), range.offset,
+                               [](const Range& r, size_t offset) { return r.offset < offset; });
+    it = freeList.insert(it, range);
+
+    // merge with the following range, then with the preceding one
+    auto next = it + 1;
+    if (next != freeList.end() && it->offset + it->size == next->offset)
+    {
+        it->size += next->size;
+        freeList.erase(next);
+    }
+    if (it != freeList.begin())
+    {
+        auto prev = it - 1;
+        if (prev->offset + prev->size == it->offset)
+        {
+            prev->size += it->size;
+            freeList.erase(it);
+        }
+    }
+}
+
+bool GpuBufferPool::TryAllocate(unsigned int page, size_t size, size_t& offset)
+{
+    std::vector<Range>& freeList = m_Pages[page].freeList;
+    for (auto it = freeList.begin(); it != freeList.end(); ++it)
+    {
+        if (it->size < size)
+            continue;
+
+        offset      = it->offset;
+        it->offset += size;
+        it->size   -= size;
+        if (it->size == 0)
+            freeList.erase(it);
+        return true;
+    }
+    return false;
+}
+
+unsigned int GpuBufferPool::AddPage(size_t size)
+{
+    Page page;
+    page.size = size;
+    page.freeList.push_back(Range{ 0, size });
+
+    glGenBuffers(1, &page.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_Reserved += size;
+    GpuMemory::Track(m_Category, static_cast<int64_t>(size));
+
+    m_Pages.push_back(std::move(page));
+    return static_cast<unsigned int>(m_Pages.size() - 1);
+}
+
+GpuBufferPool& GpuMemory::Vertices()
+{
+    // pages are owned by the GL context and go away with it
+    static GpuBufferPool pool(GpuMemoryCategory::VertexBuffer, size_t(32) * 1024 * 1024, 16);
+    return pool;
+}
+
+GpuBufferPool& GpuMemory::Indices()
+{
+    static GpuBufferPool pool(GpuMemoryCategory::IndexBuffer, size_t(16) * 1024 * 1024, 16);
+    return pool;
+}
+
+void GpuMemory::EndFrame()
+{
+    Vertices().EndFrame();
+    Indices().EndFrame();
+}
+
+void GpuMemory::Track(GpuMemoryCategory category, int64_t deltaBytes)
+{
+    size_t index = static_cast<size_t>(category);
+    s_Bytes[index] += deltaBytes;
+    s_Peak[index]   = std::max(s_Peak[index], s_Bytes[index]);
+}
+
+size_t GpuMemory::GetBytes(GpuMemoryCategory category)
+{
+    return s_Bytes[static_cast<size_t>(category)];
+}
+
+size_t GpuMemory::GetPeakBytes(GpuMemoryCategory category)
+{
+    return s_Peak[static_cast<size_t>(category)];
+}
+
+void GpuMemory::ResetPeaks()
+{
+    for (size_t i = 0; i < static_cast<size_t>(GpuMemoryCategory::Count); ++i)
+        s_Peak[i] = s_Bytes[i];
+}
+
+size_t GpuMemory::TextureBytes(GLenum internalFormat, int width, int height, int layers, int levels, int samples)
+{
+    size_t bytesPerTexel;
+    switch (internalFormat)
+    {
+        case GL_R8:                 bytesPerTexel = 1;  break;
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16:  bytesPerTexel = 2;  break;
+        case GL_RGBA16F:
+        case GL_RG32F:              bytesPerTexel = 8;  break;
+        case GL_RGB32F:
+        case GL_RGBA32F:            bytesPerTexel = 16; break;
+        case GL_RGB16F:             bytesPerTexel = 8;  break;
+        default:                    bytesPerTexel = 4;  break; // RGB(A)8, sRGB, R32F, 24/32 bit depth
+    }
+
+    size_t bytes = 0;
+    for (int level = 0; level < levels; ++level)
+        bytes += size_t(std::max(1, width >> level)) * std::max(1, height >> level);
+    return bytes * bytesPerTexel * std::max(1, layers) * std::max(1, samples);
+}
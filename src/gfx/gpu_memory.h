@@ -0,0 +1,158 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+enum class GpuMemoryCategory {
+    VertexBuffer,
+    IndexBuffer,
+    InstanceBuffer,
+    Texture,        // material textures, estimated from format and resident mips
+    RenderTarget,   // framebuffer attachments (scene target, shadow maps)
+    Readback,       // pixel pack buffers of the screen capture
+    Count
+};
+
+const char* GpuMemoryCategoryName(GpuMemoryCategory category);
+
+class GpuBufferPool;
+
+// A range inside one of the pooled GL buffers. Move-only, the range goes back to
+// its pool when the handle dies, but only once the GPU is done with the frame.
+class GpuAllocation
+{
+public:
+    GpuAllocation() = default;
+    ~GpuAllocation() { Release(); }
+
+    GpuAllocation(const GpuAllocation&) = delete;
+    GpuAllocation& operator=(const GpuAllocation&) = delete;
+
+    GpuAllocation(GpuAllocation&& other) noexcept { *this = std::move(other); }
+    GpuAllocation& operator=(GpuAllocation&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            m_Pool   = other.m_Pool;
+            m_Page   = other.m_Page;
+            m_Offset = other.m_Offset;
+            m_Size   = other.m_Size;
+            m_Buffer = other.m_Buffer;
+            other.m_Pool = nullptr;
+        }
+        return *this;
+    }
+
+    bool         Valid()  const { return m_Pool != nullptr; }
+    unsigned int Buffer() const { return m_Buffer; }
+    size_t       Offset() const { return m_Offset; }
+    size_t       Size()   const { return m_Size; }
+
+    // hand the range back (deferred until the GPU has finished the current frame)
+    void Release();
+
+private:
+    friend class GpuBufferPool;
+
+    GpuBufferPool* m_Pool   = nullptr;
+    unsigned int   m_Page   = 0;
+    size_t         m_Offset = 0;
+    size_t         m_Size   = 0;
+    unsigned int   m_Buffer = 0;
+};
+
+// Suballocates ranges out of a few large GL buffers with a first-fit free list.
+// Freed ranges are parked behind a fence and only reused once it signals.
+class GpuBufferPool
+{
+public:
+    GpuBufferPool(GpuMemoryCategory category, size_t pageSize, size_t alignment);
+
+    GpuBufferPool(const GpuBufferPool&) = delete;
+    GpuBufferPool& operator=(const GpuBufferPool&) = delete;
+
+    // reserve size bytes and fill them with data (may be null)
+    GpuAllocation Allocate(size_t size, const void* data);
+
+    // fence this frame's frees and recycle the ones the GPU is done with
+    void EndFrame();
+
+    size_t GetReservedBytes() const { return m_Reserved; }
+    size_t GetUsedBytes()     const { return m_Used; }
+    size_t GetPendingBytes()  const { return m_PendingBytes; }
+    size_t GetPageCount()     const { return m_Pages.size(); }
+
+private:
+    friend class GpuAllocation;
+
+    struct Range {
+        size_t offset;
+        size_t size;
+    };
+
+    struct Page {
+        unsigned int       buffer;
+        size_t             size;
+        std::vector<Range> freeList; // sorted by offset, neighbours always merged
+    };
+
+    struct PendingFree {
+        unsigned int page;
+        Range        range;
+    };
+
+    struct FencedFrees {
+        GLsync                   fence;
+        std::vector<PendingFree> frees;
+    };
+
+    GpuMemoryCategory        m_Category;
+    size_t                   m_PageSize;
+    size_t                   m_Alignment;
+    std::vector<Page>        m_Pages;
+    std::vector<PendingFree> m_FreedThisFrame;
+    std::deque<FencedFrees>  m_InFlight;
+    size_t                   m_Reserved     = 0;
+    size_t                   m_Used         = 0;
+    size_t                   m_PendingBytes = 0;
+
+    void Free(unsigned int page, Range range);
+    void ReturnRange(unsigned int page, Range range);
+    bool TryAllocate(unsigned int page, size_t size, size_t& offset);
+    unsigned int AddPage(size_t size);
+};
+
+// Engine-wide GPU memory: the shared geometry pools plus byte accounting per category.
+class GpuMemory
+{
+public:
+    static GpuBufferPool& Vertices();
+    static GpuBufferPool& Indices();
+
+    // call once per frame after SwapBuffers
+    static void EndFrame();
+
+    // adjust the byte count of a category for memory that does not come from a pool
+    static void Track(GpuMemoryCategory category, int64_t deltaBytes);
+    static size_t GetBytes(GpuMemoryCategory category);
+    // high-water mark since startup or the last ResetPeaks()
+    static size_t GetPeakBytes(GpuMemoryCategory category);
+    static void ResetPeaks();
+
+    // estimated size of a texture's storage; drivers pad 3 channel formats to 4 bytes
+    static size_t TextureBytes(GLenum internalFormat, int width, int height,
+                               int layers = 1, int levels = 1, int samples = 1);
+
+private:
+    static size_t s_Bytes[static_cast<size_t>(GpuMemoryCategory::Count)];
+    static size_t s_Peak[static_cast<size_t>(GpuMemoryCategory::Count)];
+};
+
+#endif
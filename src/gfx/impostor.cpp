@@ -0,0 +1,282 @@
+// impostor.cpp
+#include "impostor.h"
+#include "model.h"
+#include "shader_variants.h"
+#include "gpu_memory.h"
+#include "../core/log.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    // inverse of OctEncode in impostor.vert: a point of the [-1, 1] square onto the unit
+    // sphere, the upper hemisphere in the inner diamond and the lower one folded outside it
+    glm::vec3 OctahedronDecode(glm::vec2 f)
+    {
+        glm::vec3 n(f.x, 1.0f - std::abs(f.x) - std::abs(f.y), f.y);
+        if (n.y < 0.0f)
+        {
+            float x = n.x;
+            n.x = (1.0f - std::abs(n.z)) * (x   >= 0.0f ? 1.0f : -1.0f);
+            n.z = (1.0f - std::abs(x))   * (n.z >= 0.0f ? 1.0f : -1.0f);
+        }
+        return glm::normalize(n);
+    }
+
+    // up vector of the view looking back along direction, matches FrameBasis in impostor.vert
+    glm::vec3 FrameUp(const glm::vec3& direction)
+    {
+        return std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    // mip chain of one atlas, for the memory accounting
+    size_t AtlasBytes(GLenum format, int size)
+    {
+        size_t bytes = 0;
+        for (; size >= 1; size /= 2)
+            bytes += GpuMemory::TextureBytes(format, size, size, 1);
+        return bytes;
+    }
+
+    GLuint CreateAtlas(GLenum format, int size)
+    {
+        int levels = 1;
+        while ((size >> levels) > 0)
+            ++levels;
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (int level = 0; level < levels; ++level)
+        {
+            int levelSize = std::max(size >> level, 1);
+            glTexImage2D(GL_TEXTURE_2D, level, format, levelSize, levelSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+}
+
+Impostor::Impostor(const Model& model, ShaderVariants& bakeShaders, const ImpostorSettings& settings)
+    : m_Model(model), m_BakeShaders(bakeShaders), m_Settings(settings)
+{
+    m_Settings.Frames    = std::max(m_Settings.Frames, 2);
+    m_Settings.FrameSize = std::max(m_Settings.FrameSize, 8);
+
+    m_Bounds = model.GetBounds();
+    if (m_Bounds.Valid())
+    {
+        m_Center = m_Bounds.Center();
+        m_Radius = std::max(glm::length(m_Bounds.Extents()), 1e-4f);
+    }
+
+    const int atlasSize = m_Settings.Frames * m_Settings.FrameSize;
+    m_Albedo      = CreateAtlas(GL_SRGB8_ALPHA8, atlasSize);
+    m_NormalDepth = CreateAtlas(GL_RGBA8, atlasSize);
+    m_AtlasBytes  = AtlasBytes(GL_SRGB8_ALPHA8, atlasSize) + AtlasBytes(GL_RGBA8, atlasSize);
+    GpuMemory::Track(GpuMemoryCategory::RenderTarget, int64_t(m_AtlasBytes));
+
+    // one quad, corners in [-1, 1], drawn as a strip
+    const float corners[] = { -1.0f, -1.0f,   1.0f, -1.0f,   -1.0f, 1.0f,   1.0f, 1.0f };
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_QuadVBO);
+    glGenBuffers(1, &m_InstanceVBO);
+
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_QuadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    GpuMemory::Track(GpuMemoryCategory::VertexBuffer, int64_t(sizeof(corners)));
+
+    // per-instance model matrix at the same locations as Mesh
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+    for (int i = 0; i < 4; ++i)
+    {
+        glEnableVertexAttribArray(7 + i);
+        glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * i));
+        glVertexAttribDivisor(7 + i, 1);
+    }
+    glBindVertexArray(0);
+
+    Bake();
+}
+
+Impostor::~Impostor()
+{
+    glDeleteTextures(1, &m_Albedo);
+    glDeleteTextures(1, &m_NormalDepth);
+    GpuMemory::Track(GpuMemoryCategory::RenderTarget, -int64_t(m_AtlasBytes));
+
+    glDeleteVertexArrays(1, &m_VAO);
+    glDeleteBuffers(1, &m_QuadVBO);
+    glDeleteBuffers(1, &m_InstanceVBO);
+    GpuMemory::Track(GpuMemoryCategory::VertexBuffer, -int64_t(8 * sizeof(float)));
+    GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, -int64_t(m_InstanceBytes));
+}
+
+void Impostor::Bake()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const int frames    = m_Settings.Frames;
+    const int frameSize = m_Settings.FrameSize;
+    const int atlasSize = frames * frameSize;
+
+    // everything below is restored afterwards, baking can happen mid-frame
+    GLint   previousFBO;
+    GLint   viewport[4];
+    GLfloat clearColor[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFBO);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend     = glIsEnabled(GL_BLEND);
+    GLboolean cullFace  = glIsEnabled(GL_CULL_FACE);
+
+    // the depth buffer is only needed while baking
+    GLuint depth;
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_NormalDepth, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        LOG_ERROR("ERROR::IMPOSTOR::bake framebuffer is incomplete");
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+
+    glViewport(0, 0, atlasSize, atlasSize);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    const auto& meshes    = m_Model.GetMeshes();
+    const auto& instances = m_Model.GetInstances();
+
+    for (int y = 0; y < frames; ++y)
+    {
+        for (int x = 0; x < frames; ++x)
+        {
+            // grid points sit on the edges of the square, so the outer views meet the folded seams exactly
+            glm::vec2 grid      = glm::vec2(float(x), float(y)) / float(frames - 1);
+            glm::vec3 direction = OctahedronDecode(grid * 2.0f - 1.0f);
+
+            // orthographic view from outside the bounding sphere, back along direction
+            glm::mat4 view       = glm::lookAt(m_Center + direction * (2.0f * m_Radius), m_Center, FrameUp(direction));
+            glm::mat4 projection = glm::ortho(-m_Radius, m_Radius, -m_Radius, m_Radius, m_Radius, 3.0f * m_Radius);
+            glm::mat4 viewProjection = projection * view;
+
+            glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+
+            for (const MeshInstance& instance : instances)
+            {
+                const Mesh& mesh   = meshes[instance.mesh];
+                Shader*     shader = m_BakeShaders.Get(mesh.features);
+
+                shader->use();
+                shader->setMat4("viewProjection", viewProjection);
+                shader->setVec3("center", m_Center);
+                shader->setVec3("viewDirection", direction);
+                shader->setFloat("radius", m_Radius);
+
+                mesh.Bind();
+                mesh.BindTextures(*shader);
+                // skinned meshes bake in their bind pose, placed by their bones rather than the node
+                glm::mat4 transform = mesh.skinned ? glm::mat4(1.0f) : instance.transform;
+                mesh.UploadInstances(&transform, sizeof(transform));
+                glDrawElementsInstanced(GL_TRIANGLES, mesh.IndexCount(), GL_UNSIGNED_INT, mesh.IndexOffset(), 1);
+            }
+        }
+    }
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_2D, m_Albedo);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, m_NormalDepth);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFBO);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &depth);
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    if (!depthTest) glDisable(GL_DEPTH_TEST);
+    if (blend)      glEnable(GL_BLEND);
+    if (cullFace)   glEnable(GL_CULL_FACE);
+
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("SUCCESS::IMPOSTOR::baked %d views into a %dx%d atlas in %.2f ms",
+             frames * frames, atlasSize, atlasSize, ms);
+}
+
+float Impostor::Fade(const glm::mat4& modelMatrix, const glm::vec3& eye, float projectionScale) const
+{
+    float scale = std::max({ glm::length(glm::vec3(modelMatrix[0])),
+                             glm::length(glm::vec3(modelMatrix[1])),
+                             glm::length(glm::vec3(modelMatrix[2])) });
+    float radius   = m_Radius * scale;
+    float distance = glm::length(glm::vec3(modelMatrix * glm::vec4(m_Center, 1.0f)) - eye);
+    if (distance <= radius)
+        return 0.0f;
+
+    float screenSize = radius * projectionScale / distance;
+    float fadeStart  = m_Settings.ScreenSize * (1.0f + m_Settings.FadeRange);
+    if (screenSize >= fadeStart)
+        return 0.0f;
+    if (screenSize <= m_Settings.ScreenSize)
+        return 1.0f;
+    return (fadeStart - screenSize) / (fadeStart - m_Settings.ScreenSize);
+}
+
+void Impostor::Bind(const Shader& shader) const
+{
+    glBindVertexArray(m_VAO);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_Albedo);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_NormalDepth);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setInt("albedoAtlas", 0);
+    shader.setInt("normalDepthAtlas", 1);
+    shader.setVec3("center", m_Center);
+    shader.setFloat("radius", m_Radius);
+    shader.setFloat("frames", float(m_Settings.Frames));
+}
+
+void Impostor::UploadInstances(const void* data, size_t bytes) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+
+    GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, int64_t(bytes) - int64_t(m_InstanceBytes));
+    m_InstanceBytes = bytes;
+}
+
+void Impostor::Draw(size_t instanceCount) const
+{
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instanceCount));
+}
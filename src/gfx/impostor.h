@@ -0,0 +1,81 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "frustum.h"
+#include "shader.h"
+
+class Model;
+class ShaderVariants;
+
+struct ImpostorSettings {
+    // views per side of the octahedral grid, Frames * Frames views cover the whole sphere
+    int   Frames     = 8;
+    // atlas pixels per view
+    int   FrameSize  = 128;
+    // projected radius (as a fraction of half the viewport height) below which only the impostor draws
+    float ScreenSize = 0.06f;
+    // the mesh starts fading out at ScreenSize * (1 + FadeRange)
+    float FadeRange  = 0.25f;
+};
+
+// Octahedral impostor of a Model: the model is rendered from Frames * Frames
+// directions spread over an octahedron into one atlas of albedo and one of
+// object-space normal plus depth. Far instances draw as a single camera-facing
+// quad that blends the four views closest to the view direction, lights them with
+// the baked normals and writes the baked depth, so it intersects, occludes and
+// casts shadows like the mesh would. Between the two, mesh and quad crossfade
+// with complementary dither patterns (see Fade and SHADER_FEATURE_CROSSFADE).
+class Impostor
+{
+public:
+    // bakes right away, call with the GL context current
+    Impostor(const Model& model, ShaderVariants& bakeShaders, const ImpostorSettings& settings = ImpostorSettings());
+    ~Impostor();
+
+    Impostor(const Impostor&) = delete;
+    Impostor& operator=(const Impostor&) = delete;
+
+    // render the views into the atlases again. They bake from whatever texture mips
+    // are resident, so bake again once the model's textures have streamed in.
+    void Bake();
+
+    // how far an instance has handed over to the impostor: 0 draws the mesh only,
+    // 1 the impostor only, anything between draws both crossfading.
+    // projectionScale is projection[1][1].
+    float Fade(const glm::mat4& modelMatrix, const glm::vec3& eye, float projectionScale) const;
+
+    // binds the quad and the atlases (texture units 0 and 1) and sets the per-impostor uniforms
+    void Bind(const Shader& shader) const;
+    // replace the per-instance matrices (crossfade in the bottom row, see Renderer::SubmitImpostor)
+    void UploadInstances(const void* data, size_t bytes) const;
+    void Draw(size_t instanceCount) const;
+
+    // object-space bounds of the model, what each instance is culled with
+    const AABB& GetBounds() const { return m_Bounds; }
+    GLuint GetAlbedoAtlas() const { return m_Albedo; }
+    GLuint GetNormalDepthAtlas() const { return m_NormalDepth; }
+
+private:
+    const Model&     m_Model;
+    ShaderVariants&  m_BakeShaders;
+    ImpostorSettings m_Settings;
+
+    AABB      m_Bounds;
+    glm::vec3 m_Center{ 0.0f };
+    float     m_Radius = 1.0f;
+
+    GLuint m_Albedo      = 0; // sRGB, alpha is coverage
+    GLuint m_NormalDepth = 0; // object-space normal in rgb, depth towards the view in a
+    GLuint m_VAO         = 0;
+    GLuint m_QuadVBO     = 0;
+    GLuint m_InstanceVBO = 0;
+    size_t m_AtlasBytes  = 0;
+    mutable size_t m_InstanceBytes = 0;
+};
+
+#endif
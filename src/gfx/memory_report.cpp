@@ -0,0 +1,189 @@
+// memory_report.cpp
+#include "memory_report.h"
+
+#include "../core/log.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    constexpr double MIB = 1024.0 * 1024.0;
+
+    // "vertex buffers" -> "vertex_buffers"
+    std::string KeyName(const char* name)
+    {
+        std::string key = name;
+        for (char& c : key)
+        {
+            if (c == ' ')
+                c = '_';
+        }
+        return key;
+    }
+
+    bool ParseSize(const char* text, size_t& bytes)
+    {
+        char* end = nullptr;
+        double value = std::strtod(text, &end);
+        if (end == text || value < 0.0)
+            return false;
+
+        switch (std::toupper(static_cast<unsigned char>(*end)))
+        {
+            case 'K': value *= 1024.0;              ++end; break;
+            case 'M': value *= 1024.0 * 1024.0;     ++end; break;
+            case 'G': value *= 1024.0 * 1024.0 * 1024.0; ++end; break;
+            default: break;
+        }
+        if (std::toupper(static_cast<unsigned char>(*end)) == 'B')
+            ++end;
+        if (*end != '\0')
+            return false;
+
+        bytes = static_cast<size_t>(value);
+        return true;
+    }
+
+    size_t* FindBudget(MemoryBudgets& budgets, const std::string& key)
+    {
+        if (key == "cpu.total")
+            return &budgets.CpuTotal;
+        if (key == "gpu.total")
+            return &budgets.GpuTotal;
+
+        for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i)
+        {
+            if (key == "cpu." + KeyName(AllocationCounter::getTagName(static_cast<MemoryTag>(i))))
+                return &budgets.Cpu[i];
+        }
+        for (size_t i = 0; i < GPU_MEMORY_CATEGORIES; ++i)
+        {
+            if (key == "gpu." + KeyName(GpuMemoryCategoryName(static_cast<GpuMemoryCategory>(i))))
+                return &budgets.Gpu[i];
+        }
+        return nullptr;
+    }
+
+    bool CheckOne(const char* side, const char* name, size_t peak, size_t budget)
+    {
+        if (budget == 0 || peak <= budget)
+            return true;
+
+        LOG_ERROR("ERROR::MEMORY::%s %s peaked at %.2f MiB, budget is %.2f MiB",
+                  side, name, peak / MIB, budget / MIB);
+        return false;
+    }
+}
+
+size_t MemorySnapshot::CpuTotal() const
+{
+    size_t total = 0;
+    for (size_t bytes : CpuBytes)
+        total += bytes;
+    return total;
+}
+
+size_t MemorySnapshot::GpuTotal() const
+{
+    size_t total = 0;
+    for (size_t bytes : GpuBytes)
+        total += bytes;
+    return total;
+}
+
+MemorySnapshot MemoryReport::Capture()
+{
+    MemorySnapshot snapshot;
+    for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i)
+    {
+        MemoryTag tag = static_cast<MemoryTag>(i);
+        snapshot.CpuBytes[i]       = AllocationCounter::getBytes(tag);
+        snapshot.CpuPeak[i]        = AllocationCounter::getPeakBytes(tag);
+        snapshot.CpuAllocations[i] = AllocationCounter::getLiveAllocations(tag);
+    }
+    for (size_t i = 0; i < GPU_MEMORY_CATEGORIES; ++i)
+    {
+        GpuMemoryCategory category = static_cast<GpuMemoryCategory>(i);
+        snapshot.GpuBytes[i] = GpuMemory::GetBytes(category);
+        snapshot.GpuPeak[i]  = GpuMemory::GetPeakBytes(category);
+    }
+    return snapshot;
+}
+
+void MemoryReport::Log(const MemorySnapshot& snapshot)
+{
+    LOG_INFO("MEMORY::cpu %.2f MiB, gpu %.2f MiB (estimated)", snapshot.CpuTotal() / MIB, snapshot.GpuTotal() / MIB);
+    for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i)
+    {
+        LOG_INFO("MEMORY::  cpu %-16s %9.2f MiB  peak %9.2f MiB  %8zu allocations",
+                 AllocationCounter::getTagName(static_cast<MemoryTag>(i)),
+                 snapshot.CpuBytes[i] / MIB, snapshot.CpuPeak[i] / MIB, snapshot.CpuAllocations[i]);
+    }
+    for (size_t i = 0; i < GPU_MEMORY_CATEGORIES; ++i)
+    {
+        LOG_INFO("MEMORY::  gpu %-16s %9.2f MiB  peak %9.2f MiB",
+                 GpuMemoryCategoryName(static_cast<GpuMemoryCategory>(i)),
+                 snapshot.GpuBytes[i] / MIB, snapshot.GpuPeak[i] / MIB);
+    }
+}
+
+bool MemoryReport::LoadBudgets(const std::string& path, MemoryBudgets& budgets)
+{
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (!file)
+    {
+        LOG_ERROR("ERROR::MEMORY::could not open budget file %s", path.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    char line[256];
+    int  lineNumber = 0;
+    while (std::fgets(line, sizeof(line), file))
+    {
+        ++lineNumber;
+        if (char* comment = std::strchr(line, '#'))
+            *comment = '\0';
+
+        char key[128], size[64];
+        int fields = std::sscanf(line, "%127s %63s", key, size);
+        if (fields <= 0)
+            continue; // blank
+
+        size_t* budget = fields == 2 ? FindBudget(budgets, key) : nullptr;
+        if (!budget || !ParseSize(size, *budget))
+        {
+            LOG_ERROR("ERROR::MEMORY::%s:%d: bad budget line", path.c_str(), lineNumber);
+            ok = false;
+        }
+    }
+
+    std::fclose(file);
+    return ok;
+}
+
+bool MemoryReport::CheckBudgets(const MemorySnapshot& snapshot, const MemoryBudgets& budgets)
+{
+    // peaks of different tags need not coincide, the totals are checked against the sum of peaks
+    size_t cpuPeak = 0, gpuPeak = 0;
+    bool   ok      = true;
+
+    for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i)
+    {
+        ok &= CheckOne("cpu", AllocationCounter::getTagName(static_cast<MemoryTag>(i)),
+                       snapshot.CpuPeak[i], budgets.Cpu[i]);
+        cpuPeak += snapshot.CpuPeak[i];
+    }
+    for (size_t i = 0; i < GPU_MEMORY_CATEGORIES; ++i)
+    {
+        ok &= CheckOne("gpu", GpuMemoryCategoryName(static_cast<GpuMemoryCategory>(i)),
+                       snapshot.GpuPeak[i], budgets.Gpu[i]);
+        gpuPeak += snapshot.GpuPeak[i];
+    }
+    ok &= CheckOne("cpu", "total", cpuPeak, budgets.CpuTotal);
+    ok &= CheckOne("gpu", "total", gpuPeak, budgets.GpuTotal);
+    return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include "gpu_memory.h"
+#include "../core/alloc_counter.hpp"
+
+#include <cstddef>
+#include <string>
+
+#define MEMORY_TAG_COUNT      static_cast<size_t>(MemoryTag::Count)
+#define GPU_MEMORY_CATEGORIES static_cast<size_t>(GpuMemoryCategory::Count)
+
+// one point-in-time view of every CPU tag and GPU category
+struct MemorySnapshot {
+    size_t CpuBytes[MEMORY_TAG_COUNT]       = {};
+    size_t CpuPeak[MEMORY_TAG_COUNT]        = {};
+    size_t CpuAllocations[MEMORY_TAG_COUNT] = {};
+    size_t GpuBytes[GPU_MEMORY_CATEGORIES]  = {};
+    size_t GpuPeak[GPU_MEMORY_CATEGORIES]   = {};
+
+    size_t CpuTotal() const;
+    size_t GpuTotal() const;
+};
+
+// high-water limits in bytes, 0 means unlimited
+struct MemoryBudgets {
+    size_t Cpu[MEMORY_TAG_COUNT]      = {};
+    size_t Gpu[GPU_MEMORY_CATEGORIES] = {};
+    size_t CpuTotal = 0;
+    size_t GpuTotal = 0;
+};
+
+// Reporting on top of AllocationCounter (CPU heap by tag) and GpuMemory (estimated VRAM by category).
+// Budget files hold one "<key> <size>" per line, '#' starts a comment, sizes take K/M/G suffixes.
+// Keys are cpu.<tag>, gpu.<category> (spaces become '_') or cpu.total / gpu.total, e.g.
+//   cpu.mesh          64M
+//   gpu.textures      512M
+namespace MemoryReport
+{
+    MemorySnapshot Capture();
+
+    // current and peak bytes per tag/category, through the logger
+    void Log(const MemorySnapshot& snapshot);
+
+    bool LoadBudgets(const std::string& path, MemoryBudgets& budgets);
+
+    // compares the high-water marks against the budgets, logs every overrun,
+    // returns false if anything went over
+    bool CheckBudgets(const MemorySnapshot& snapshot, const MemoryBudgets& budgets);
+}
+
+#endif
@@ -7,7 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "shader_variants.h"
+#include "frustum.h"
+#include "gpu_memory.h"
+#include "meshlet.h"
 
+#include <cmath>
 #include <string>
 #include <vector>
 using namespace std;
@@ -31,6 +36,15 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// output of the skinning pre-pass (see skinning.h): Vertex without the bone data
+struct SkinnedVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -45,18 +59,87 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO = 0;
-    unsigned int VBO = 0;
-    unsigned int EBO = 0;
     unsigned int instanceVBO = 0; // for per-instance model matrices
 
+    AABB  bounds;            // object-space bounds, used for culling
+    float uvDensity = 1.0f;  // uv units per object-space unit, used for texture streaming
+    bool  skinned   = false; // has bone weights, drawn from the skinning pre-pass output
+    // SHADER_FEATURE_* bits of the material, picks the ShaderVariants program
+    // (maps from the textures here, the importer adds the rest)
+    uint32_t features = 0;
+
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // geometry goes into the shared GPU pools, the CPU copies are dropped after
+    // upload unless keepCpuData is set (e.g. for tools that need to read it back)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool keepCpuData = false)
     {
         this->vertices = std::move(vertices);
         this->indices  = std::move(indices);
         this->textures = std::move(textures);
 
+        for (const auto& v : this->vertices)
+        {
+            bounds.Expand(v.Position);
+            skinned |= v.m_Weights[0] > 0.0f;
+        }
+        uvDensity = ComputeUVDensity();
+        BuildSamplerNames();
+        features = TextureFeatures();
+
         setupMesh();
+
+        if (!keepCpuData)
+        {
+            vector<Vertex>().swap(this->vertices);
+            vector<unsigned int>().swap(this->indices);
+        }
+    }
+
+    // GL objects are owned, so meshes move but never copy
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh&& other) noexcept { *this = std::move(other); }
+    Mesh& operator=(Mesh&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+
+            vertices           = std::move(other.vertices);
+            indices            = std::move(other.indices);
+            textures           = std::move(other.textures);
+            VAO                = other.VAO;
+            instanceVBO        = other.instanceVBO;
+            bounds             = other.bounds;
+            uvDensity          = other.uvDensity;
+            skinned            = other.skinned;
+            features           = other.features;
+            m_SkinnedVAO       = other.m_SkinnedVAO;
+            m_SamplerNames     = std::move(other.m_SamplerNames);
+            m_SamplerProgram   = other.m_SamplerProgram;
+            m_SamplerLocations = std::move(other.m_SamplerLocations);
+            m_VertexAllocation = std::move(other.m_VertexAllocation);
+            m_IndexAllocation  = std::move(other.m_IndexAllocation);
+            m_IndexCount       = other.m_IndexCount;
+            m_VertexCount      = other.m_VertexCount;
+            m_InstanceBytes    = other.m_InstanceBytes;
+            m_MeshletBuffer    = other.m_MeshletBuffer;
+            m_MeshletCount     = other.m_MeshletCount;
+
+            other.VAO             = 0;
+            other.instanceVBO     = 0;
+            other.m_SkinnedVAO    = 0;
+            other.m_InstanceBytes = 0;
+            other.m_MeshletBuffer = 0;
+            other.m_MeshletCount  = 0;
+        }
+        return *this;
+    }
+
+    ~Mesh()
+    {
+        Release();
     }
 
     // Bind VAO (geometry)
@@ -65,20 +148,177 @@ public:
         glBindVertexArray(VAO);
     }
 
+    // Bind a VAO that reads vertices from skinnedBuffer (SkinnedVertex layout, draws pick
+    // their range with a base vertex) and indices/instances from this mesh
+    void BindSkinned(unsigned int skinnedBuffer) const
+    {
+        if (!m_SkinnedVAO)
+        {
+            glGenVertexArrays(1, &m_SkinnedVAO);
+            glBindVertexArray(m_SkinnedVAO);
+
+            glBindBuffer(GL_ARRAY_BUFFER, skinnedBuffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexAllocation.Buffer());
+
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, TexCoords));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Tangent));
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, Bitangent));
+
+            // same per-instance matrices as the regular VAO
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            for (int i = 0; i < 4; ++i)
+            {
+                glEnableVertexAttribArray(7 + i);
+                glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * i));
+                glVertexAttribDivisor(7 + i, 1);
+            }
+        }
+        glBindVertexArray(m_SkinnedVAO);
+    }
+
     // Bind textures and set sampler uniforms on the shader
     void BindTextures(const Shader &shader) const
+    {
+        // sampler locations only change with the program
+        if (shader.ID != m_SamplerProgram)
+        {
+            m_SamplerLocations.resize(textures.size());
+            for (unsigned int i = 0; i < textures.size(); i++)
+                m_SamplerLocations[i] = glGetUniformLocation(shader.ID, m_SamplerNames[i].c_str());
+            m_SamplerProgram = shader.ID;
+        }
+
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
+
+            // set sampler to the correct texture unit
+            if (m_SamplerLocations[i] != -1)
+                glUniform1i(m_SamplerLocations[i], i);
+
+            // bind texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+
+        // Reset active texture to 0 (optional)
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    unsigned int IndexCount() const { return m_IndexCount; }
+    unsigned int VertexCount() const { return m_VertexCount; }
+    // where the source vertices live in the shared pool, for the skinning pre-pass
+    unsigned int VertexBuffer() const { return m_VertexAllocation.Buffer(); }
+    size_t       VertexOffset() const { return m_VertexAllocation.Offset(); }
+    // byte offset of this mesh's indices in the bound element buffer, for glDrawElements*
+    const void*  IndexOffset() const { return reinterpret_cast<const void*>(m_IndexAllocation.Offset()); }
+
+    // clusters of the index buffer for MeshletCuller, uploaded as a storage buffer
+    void SetMeshlets(const vector<Meshlet>& meshlets)
+    {
+        if (meshlets.empty())
+            return;
+        if (!m_MeshletBuffer)
+            glGenBuffers(1, &m_MeshletBuffer);
+        else
+            GpuMemory::Track(GpuMemoryCategory::IndexBuffer, -int64_t(m_MeshletCount * sizeof(Meshlet)));
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_MeshletBuffer);
+        glBufferData(GL_ARRAY_BUFFER, meshlets.size() * sizeof(Meshlet), meshlets.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_MeshletCount = static_cast<unsigned int>(meshlets.size());
+        GpuMemory::Track(GpuMemoryCategory::IndexBuffer, int64_t(m_MeshletCount * sizeof(Meshlet)));
+    }
+
+    unsigned int MeshletBuffer() const { return m_MeshletBuffer; }
+    unsigned int MeshletCount() const { return m_MeshletCount; }
+
+    // replace the per-instance data (must have the VAO's instance layout, see setupMesh)
+    void UploadInstances(const void* data, size_t bytes) const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+
+        GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, int64_t(bytes) - int64_t(m_InstanceBytes));
+        m_InstanceBytes = bytes;
+    }
+
+    // copy the geometry back out of the GPU pools (stalls, meant for tools and captures)
+    void ReadBackGeometry(vector<Vertex>& outVertices, vector<unsigned int>& outIndices) const
+    {
+        outVertices.resize(m_VertexCount);
+        outIndices.resize(m_IndexCount);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, m_VertexAllocation.Buffer());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, m_VertexAllocation.Offset(),
+                           m_VertexCount * sizeof(Vertex), outVertices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, m_IndexAllocation.Buffer());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, m_IndexAllocation.Offset(),
+                           m_IndexCount * sizeof(unsigned int), outIndices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+private:
+    GpuAllocation  m_VertexAllocation;
+    GpuAllocation  m_IndexAllocation;
+    unsigned int   m_IndexCount = 0;
+    unsigned int   m_VertexCount = 0;
+    mutable size_t m_InstanceBytes = 0;
+    mutable unsigned int m_SkinnedVAO = 0;
+    unsigned int   m_MeshletBuffer = 0;
+    unsigned int   m_MeshletCount  = 0;
+
+    void Release()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (m_SkinnedVAO)
+            glDeleteVertexArrays(1, &m_SkinnedVAO);
+        if (instanceVBO)
+        {
+            glDeleteBuffers(1, &instanceVBO);
+            GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, -int64_t(m_InstanceBytes));
+        }
+        if (m_MeshletBuffer)
+        {
+            glDeleteBuffers(1, &m_MeshletBuffer);
+            GpuMemory::Track(GpuMemoryCategory::IndexBuffer, -int64_t(m_MeshletCount * sizeof(Meshlet)));
+        }
+        VAO             = 0;
+        instanceVBO     = 0;
+        m_InstanceBytes = 0;
+        m_SkinnedVAO    = 0;
+        m_MeshletBuffer = 0;
+        m_MeshletCount  = 0;
+
+        m_VertexAllocation.Release();
+        m_IndexAllocation.Release();
+    }
+
+    // "texture_diffuse1", "texture_specular1", ... built once instead of every bind
+    vector<string>       m_SamplerNames;
+    mutable unsigned int m_SamplerProgram = 0;
+    mutable vector<int>  m_SamplerLocations;
+
+    void BuildSamplerNames()
     {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
 
-        for (unsigned int i = 0; i < textures.size(); i++)
+        m_SamplerNames.clear();
+        for (const Texture& texture : textures)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // activate proper texture unit before binding
-
             string number;
-            string name = textures[i].type;
+            string name = texture.type;
             if (name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if (name == "texture_specular")
@@ -87,70 +327,91 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
             else if (name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
+            m_SamplerNames.push_back(name + number);
+        }
+    }
 
-            // set sampler to the correct texture unit
-            int loc = glGetUniformLocation(shader.ID, (name + number).c_str());
-            if (loc != -1)
-                glUniform1i(loc, i);
+    uint32_t TextureFeatures() const
+    {
+        uint32_t result = 0;
+        for (const Texture& texture : textures)
+        {
+            if (texture.type == "texture_diffuse")
+                result |= SHADER_FEATURE_DIFFUSE_MAP;
+            else if (texture.type == "texture_specular")
+                result |= SHADER_FEATURE_SPECULAR_MAP;
+            else if (texture.type == "texture_normal")
+                result |= SHADER_FEATURE_NORMAL_MAP;
+        }
+        return result;
+    }
 
-            // bind texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    // average ratio of uv area to surface area, as a length ratio
+    float ComputeUVDensity() const
+    {
+        double worldArea = 0.0;
+        double uvArea    = 0.0;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            const Vertex& a = vertices[indices[i]];
+            const Vertex& b = vertices[indices[i + 1]];
+            const Vertex& c = vertices[indices[i + 2]];
+
+            worldArea += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+            glm::vec2 e1 = b.TexCoords - a.TexCoords;
+            glm::vec2 e2 = c.TexCoords - a.TexCoords;
+            uvArea    += std::abs(e1.x * e2.y - e1.y * e2.x);
         }
 
-        // Reset active texture to 0 (optional)
-        glActiveTexture(GL_TEXTURE0);
+        if (worldArea <= 0.0 || uvArea <= 0.0)
+            return 1.0f;
+        return static_cast<float>(std::sqrt(uvArea / worldArea));
     }
 
-    unsigned int IndexCount() const { return static_cast<unsigned int>(indices.size()); }
-
-private:
     // initializes all the buffer objects/arrays, including instance attributes
     void setupMesh()
     {
+        // geometry lives in ranges of the shared pools
+        m_VertexAllocation = GpuMemory::Vertices().Allocate(vertices.size() * sizeof(Vertex), vertices.data());
+        m_IndexAllocation  = GpuMemory::Indices().Allocate(indices.size() * sizeof(unsigned int), indices.data());
+        m_IndexCount       = static_cast<unsigned int>(indices.size());
+        m_VertexCount      = static_cast<unsigned int>(vertices.size());
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
         glGenBuffers(1, &instanceVBO); // instance buffer
 
         glBindVertexArray(VAO);
 
-        // vertex buffer
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER,
-                     vertices.size() * sizeof(Vertex),
-                     vertices.data(),
-                     GL_STATIC_DRAW);
+        // vertex buffer (attribute offsets below start at our range in the pool)
+        glBindBuffer(GL_ARRAY_BUFFER, m_VertexAllocation.Buffer());
+        const size_t base = m_VertexAllocation.Offset();
 
         // index buffer
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     indices.size() * sizeof(unsigned int),
-                     indices.data(),
-                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexAllocation.Buffer());
 
         // vertex attribute pointers
         // position
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, Position)));
         // normal
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, Normal)));
         // texcoords
         glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, TexCoords)));
         // tangent
         glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, Tangent)));
         // bitangent
         glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, Bitangent)));
         // bone IDs
         glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)(base + offsetof(Vertex, m_BoneIDs)));
         // weights
         glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, m_Weights)));
 
         // --- Instance data: mat4 per instance (locations 7,8,9,10) ---
         glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
@@ -0,0 +1,327 @@
+// mesh_import.cpp
+#include "mesh_import.h"
+
+#include "../core/job_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_IMPORT_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // below these sizes a mesh is converted by a single thread
+    constexpr size_t VERTEX_GRAIN = 64 * 1024;
+    constexpr size_t FACE_GRAIN   = 128 * 1024;
+
+    // the streams a mesh actually has, looked up once per mesh
+    struct Streams {
+        const aiVector3D* positions;
+        const aiVector3D* normals;
+        const aiVector3D* uvs;
+        const aiVector3D* tangents;
+        const aiVector3D* bitangents;
+    };
+
+    Streams GetStreams(const aiMesh* mesh)
+    {
+        Streams s;
+        s.positions  = mesh->mVertices;
+        s.normals    = mesh->HasNormals() ? mesh->mNormals : nullptr;
+        s.uvs        = mesh->mTextureCoords[0];
+        // tangents only make sense with uvs (aiProcess_CalcTangentSpace needs them)
+        s.tangents   = s.uvs ? mesh->mTangents : nullptr;
+        s.bitangents = s.uvs ? mesh->mBitangents : nullptr;
+        return s;
+    }
+
+    void ConvertScalar(const Streams& s, Vertex* out, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            Vertex& v = out[i];
+            v.Position  = glm::vec3(s.positions[i].x, s.positions[i].y, s.positions[i].z);
+            v.Normal    = s.normals    ? glm::vec3(s.normals[i].x, s.normals[i].y, s.normals[i].z) : glm::vec3(0.0f);
+            v.TexCoords = s.uvs        ? glm::vec2(s.uvs[i].x, s.uvs[i].y) : glm::vec2(0.0f);
+            v.Tangent   = s.tangents   ? glm::vec3(s.tangents[i].x, s.tangents[i].y, s.tangents[i].z) : glm::vec3(0.0f);
+            v.Bitangent = s.bitangents ? glm::vec3(s.bitangents[i].x, s.bitangents[i].y, s.bitangents[i].z) : glm::vec3(0.0f);
+
+            // init bone IDs / weights to 0
+            for (int b = 0; b < MAX_BONE_INFLUENCE; ++b)
+            {
+                v.m_BoneIDs[b] = 0;
+                v.m_Weights[b] = 0.0f;
+            }
+        }
+    }
+
+#ifdef MESH_IMPORT_SSE
+    // The SSE path moves every vec3 with one 16 byte load and store. The 4th lane spills
+    // into the next field and is overwritten by the following store, which is why the
+    // stores below must stay in field order. Loads read 4 bytes past element i, so the
+    // last vertex of a mesh always goes through the scalar path.
+    static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "aiVector3D must be 3 packed floats");
+    static_assert(offsetof(Vertex, Position)  == 0  * sizeof(float) &&
+                  offsetof(Vertex, Normal)    == 3  * sizeof(float) &&
+                  offsetof(Vertex, TexCoords) == 6  * sizeof(float) &&
+                  offsetof(Vertex, Tangent)   == 8  * sizeof(float) &&
+                  offsetof(Vertex, Bitangent) == 11 * sizeof(float) &&
+                  offsetof(Vertex, m_BoneIDs) == 14 * sizeof(float) &&
+                  offsetof(Vertex, m_Weights) == 18 * sizeof(float) &&
+                  sizeof(Vertex)              == 22 * sizeof(float),
+                  "SSE vertex conversion assumes the Vertex layout in mesh.h");
+
+    void ConvertSSE(const Streams& s, Vertex* out, size_t begin, size_t end)
+    {
+        const __m128  zero  = _mm_setzero_ps();
+        const __m128i zeroi = _mm_setzero_si128();
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            float* dst = reinterpret_cast<float*>(out + i);
+
+            _mm_storeu_ps(dst + 0,  _mm_loadu_ps(&s.positions[i].x));
+            _mm_storeu_ps(dst + 3,  s.normals    ? _mm_loadu_ps(&s.normals[i].x)    : zero);
+            _mm_storel_pi(reinterpret_cast<__m64*>(dst + 6), s.uvs ? _mm_loadu_ps(&s.uvs[i].x) : zero);
+            _mm_storeu_ps(dst + 8,  s.tangents   ? _mm_loadu_ps(&s.tangents[i].x)   : zero);
+            _mm_storeu_ps(dst + 11, s.bitangents ? _mm_loadu_ps(&s.bitangents[i].x) : zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 14), zeroi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 18), zeroi);
+        }
+    }
+#endif
+
+    bool TrianglesOnly(const aiMesh* mesh)
+    {
+        return mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+    }
+
+    void CopyTriangles(const aiMesh* mesh, unsigned int* out, size_t begin, size_t end)
+    {
+        for (size_t f = begin; f < end; ++f)
+            std::memcpy(out + f * 3, mesh->mFaces[f].mIndices, 3 * sizeof(unsigned int));
+    }
+
+    // sphere and normal cone of triangles [first, last)
+    Meshlet MeshletBounds(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                          size_t first, size_t last)
+    {
+        AABB box;
+        for (size_t i = first * 3; i < last * 3; ++i)
+            box.Expand(vertices[indices[i]].Position);
+
+        glm::vec3 center = box.Center();
+        float     radius = 0.0f;
+        for (size_t i = first * 3; i < last * 3; ++i)
+            radius = std::max(radius, glm::length(vertices[indices[i]].Position - center));
+
+        // geometric normals: the winding is what decides which side faces away
+        glm::vec3 sum(0.0f);
+        for (size_t t = first; t < last; ++t)
+        {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].Position - a, vertices[indices[t * 3 + 2]].Position - a);
+            float length = glm::length(n);
+            if (length > 0.0f)
+                sum += n / length;
+        }
+
+        // 2 disables the cone test: the normals spread over a hemisphere or more
+        glm::vec4 cone(0.0f, 0.0f, 0.0f, 2.0f);
+        float sumLength = glm::length(sum);
+        if (sumLength > 1e-6f)
+        {
+            glm::vec3 axis   = sum / sumLength;
+            float     minDot = 1.0f;
+            for (size_t t = first; t < last; ++t)
+            {
+                const glm::vec3& a = vertices[indices[t * 3]].Position;
+                glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].Position - a, vertices[indices[t * 3 + 2]].Position - a);
+                float length = glm::length(n);
+                if (length > 0.0f)
+                    minDot = std::min(minDot, glm::dot(n / length, axis));
+            }
+            // back facing as a whole once the view is within 90 degrees minus the spread of the axis
+            if (minDot > 0.0f)
+                cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+        }
+
+        Meshlet meshlet;
+        meshlet.Sphere     = glm::vec4(center, radius);
+        meshlet.Cone       = cone;
+        meshlet.FirstIndex = static_cast<uint32_t>(first * 3);
+        meshlet.IndexCount = static_cast<uint32_t>((last - first) * 3);
+        meshlet.Padding[0] = meshlet.Padding[1] = 0;
+        return meshlet;
+    }
+}
+
+void MeshImport::ConvertVertices(const aiMesh* mesh, Vertex* out, size_t begin, size_t end)
+{
+    const Streams s = GetStreams(mesh);
+
+#ifdef MESH_IMPORT_SSE
+    size_t simdEnd = std::min<size_t>(end, mesh->mNumVertices - 1);
+    if (begin < simdEnd)
+    {
+        ConvertSSE(s, out, begin, simdEnd);
+        begin = simdEnd;
+    }
+#endif
+
+    ConvertScalar(s, out, begin, end);
+}
+
+size_t MeshImport::CountIndices(const aiMesh* mesh)
+{
+    if (TrianglesOnly(mesh))
+        return size_t(mesh->mNumFaces) * 3;
+
+    size_t count = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        count += mesh->mFaces[i].mNumIndices;
+    return count;
+}
+
+void MeshImport::ConvertIndices(const aiMesh* mesh, unsigned int* out)
+{
+    if (TrianglesOnly(mesh))
+    {
+        CopyTriangles(mesh, out, 0, mesh->mNumFaces);
+        return;
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        const aiFace& face = mesh->mFaces[i];
+        std::memcpy(out, face.mIndices, face.mNumIndices * sizeof(unsigned int));
+        out += face.mNumIndices;
+    }
+}
+
+glm::mat4 MeshImport::ToMatrix(const aiMatrix4x4& m)
+{
+    return glm::mat4(m.a1, m.b1, m.c1, m.d1,
+                     m.a2, m.b2, m.c2, m.d2,
+                     m.a3, m.b3, m.c3, m.d3,
+                     m.a4, m.b4, m.c4, m.d4);
+}
+
+void MeshImport::ConvertBoneWeights(const aiMesh* mesh, const Skeleton& skeleton, Vertex* out)
+{
+    for (unsigned int b = 0; b < mesh->mNumBones; ++b)
+    {
+        const aiBone* bone  = mesh->mBones[b];
+        int           joint = skeleton.Find(bone->mName.C_Str());
+        if (joint < 0)
+            continue;
+
+        for (unsigned int w = 0; w < bone->mNumWeights; ++w)
+        {
+            const aiVertexWeight& weight = bone->mWeights[w];
+            Vertex& v = out[weight.mVertexId];
+
+            // replace the weakest slot (empty slots have weight 0)
+            int weakest = 0;
+            for (int i = 1; i < MAX_BONE_INFLUENCE; ++i)
+            {
+                if (v.m_Weights[i] < v.m_Weights[weakest])
+                    weakest = i;
+            }
+            if (weight.mWeight > v.m_Weights[weakest])
+            {
+                v.m_BoneIDs[weakest] = joint;
+                v.m_Weights[weakest] = weight.mWeight;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+    {
+        Vertex& v   = out[i];
+        float   sum = 0.0f;
+        for (int b = 0; b < MAX_BONE_INFLUENCE; ++b)
+            sum += v.m_Weights[b];
+        if (sum > 0.0f)
+        {
+            for (int b = 0; b < MAX_BONE_INFLUENCE; ++b)
+                v.m_Weights[b] /= sum;
+        }
+    }
+}
+
+std::vector<Meshlet> MeshImport::BuildMeshlets(const std::vector<Vertex>& vertices,
+                                               const std::vector<unsigned int>& indices)
+{
+    std::vector<Meshlet> meshlets;
+    // the meshlet a vertex was last counted for, so each is counted once per meshlet
+    std::vector<uint32_t> counted(vertices.size(), UINT32_MAX);
+
+    // consecutive triangles only, so a meshlet is a plain range of the index buffer
+    const size_t triangles = indices.size() / 3;
+    size_t first = 0;
+    while (first < triangles)
+    {
+        const uint32_t id     = static_cast<uint32_t>(meshlets.size());
+        size_t         unique = 0;
+        size_t         last   = first;
+        for (; last < triangles && last - first < MESHLET_MAX_TRIANGLES; ++last)
+        {
+            size_t added = 0;
+            for (int k = 0; k < 3; ++k)
+                added += counted[indices[last * 3 + k]] != id;
+            if (unique + added > MESHLET_MAX_VERTICES)
+                break;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int vertex = indices[last * 3 + k];
+                if (counted[vertex] != id)
+                {
+                    counted[vertex] = id;
+                    ++unique;
+                }
+            }
+        }
+
+        meshlets.push_back(MeshletBounds(vertices, indices, first, last));
+        first = last;
+    }
+    return meshlets;
+}
+
+ImportedMesh MeshImport::Import(const aiMesh* mesh)
+{
+    ImportedMesh result;
+
+    result.vertices.resize(mesh->mNumVertices);
+    Vertex* vertices = result.vertices.data();
+    JobSystem::ParallelFor(mesh->mNumVertices, VERTEX_GRAIN, [mesh, vertices](size_t begin, size_t end) {
+        ConvertVertices(mesh, vertices, begin, end);
+    });
+
+    result.indices.resize(CountIndices(mesh));
+    unsigned int* indices = result.indices.data();
+    if (TrianglesOnly(mesh))
+    {
+        // fixed stride, so faces can be split across threads without a prefix sum
+        JobSystem::ParallelFor(mesh->mNumFaces, FACE_GRAIN, [mesh, indices](size_t begin, size_t end) {
+            CopyTriangles(mesh, indices, begin, end);
+        });
+    }
+    else
+    {
+        ConvertIndices(mesh, indices);
+    }
+
+    if (TrianglesOnly(mesh) && mesh->mNumFaces >= MESHLET_MIN_TRIANGLES)
+        result.meshlets = BuildMeshlets(result.vertices, result.indices);
+
+    return result;
+}
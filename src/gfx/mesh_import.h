@@ -0,0 +1,50 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <assimp/scene.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+#include "animation.h"
+
+// CPU side of a converted aiMesh, ready to be turned into a Mesh on the GL thread
+struct ImportedMesh {
+    std::vector<Vertex>       vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Meshlet>      meshlets; // empty below MESHLET_MIN_TRIANGLES
+};
+
+// Bulk conversion of Assimp's per-attribute arrays into our interleaved Vertex layout.
+// Attribute presence is decided once per mesh, not per vertex, and the copy loop uses
+// SSE where available. Large meshes are split across the job system.
+// None of these touch GL, so they are safe to call from worker threads.
+namespace MeshImport
+{
+    // convert vertices [begin, end) of mesh into out[begin, end)
+    void ConvertVertices(const aiMesh* mesh, Vertex* out, size_t begin, size_t end);
+
+    // total number of indices over all faces
+    size_t CountIndices(const aiMesh* mesh);
+
+    // write all face indices to out (CountIndices(mesh) entries)
+    void ConvertIndices(const aiMesh* mesh, unsigned int* out);
+
+    // assimp matrices are row-major, glm's column-major
+    glm::mat4 ToMatrix(const aiMatrix4x4& m);
+
+    // fill m_BoneIDs/m_Weights from the mesh's bones: skeleton joint indices, the
+    // MAX_BONE_INFLUENCE strongest influences per vertex, weights normalized
+    void ConvertBoneWeights(const aiMesh* mesh, const Skeleton& skeleton, Vertex* out);
+
+    // split the index buffer into meshlets: runs of consecutive triangles with at most
+    // MESHLET_MAX_VERTICES unique vertices and MESHLET_MAX_TRIANGLES triangles, each
+    // with a bounding sphere and the cone around its triangle normals
+    std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+    // full conversion of one mesh, parallel inside the mesh when it is big enough
+    ImportedMesh Import(const aiMesh* mesh);
+}
+
+#endif
@@ -0,0 +1,169 @@
+// meshlet.cpp
+#include "meshlet.h"
+#include "mesh.h"
+#include "gpu_memory.h"
+
+#include <algorithm>
+
+static_assert(sizeof(Meshlet) == 12 * sizeof(float), "meshlet_cull.comp reads Meshlet as vec4, vec4, uvec4");
+
+namespace
+{
+    // first four entries of the counter buffer, the draw counts per Draw follow
+    constexpr size_t STAT_COUNTERS = 4;
+
+    enum Location { MESHLET_COUNT, FIRST_INDEX, BATCH, INSTANCE_OFFSET, PLANES, EYE, LOCATION_COUNT };
+    const char* const LOCATION_NAMES[LOCATION_COUNT] = {
+        "meshletCount", "firstIndex", "batch", "instanceOffset", "planes", "eye"
+    };
+}
+
+MeshletCuller& MeshletCuller::Get()
+{
+    static MeshletCuller instance;
+    return instance;
+}
+
+bool MeshletCuller::Supported()
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+MeshletCuller::~MeshletCuller()
+{
+    // the context may already be gone at static destruction, only forget the accounting
+    GpuMemory::Track(GpuMemoryCategory::InstanceBuffer,
+                     -int64_t(m_CommandCapacity + 2 * (STAT_COUNTERS + m_CounterCapacity) * sizeof(uint32_t)));
+}
+
+void MeshletCuller::Init()
+{
+    m_Shader = std::make_unique<Shader>(m_ShaderDirectory + "/meshlet_cull.comp");
+    for (int i = 0; i < LOCATION_COUNT; ++i)
+        m_Locations[i] = glGetUniformLocation(m_Shader->ID, LOCATION_NAMES[i]);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_OffsetAlignment);
+    m_OffsetAlignment = std::max(m_OffsetAlignment, GLint(sizeof(uint32_t)));
+
+    glGenBuffers(1, &m_Commands);
+    glGenBuffers(2, m_Counters);
+
+    m_CounterCapacity = 256;
+    for (unsigned int counters : m_Counters)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (STAT_COUNTERS + m_CounterCapacity) * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, int64_t(2 * (STAT_COUNTERS + m_CounterCapacity) * sizeof(uint32_t)));
+}
+
+void MeshletCuller::BeginFrame()
+{
+    m_Batch   = 0;
+    m_CommandCursor    = 0;
+    m_Stats.Dispatches = 0;
+    // nothing to read back before the first Draw
+    if (!m_Shader)
+        return;
+
+    m_Current = 1 - m_Current;
+
+    // written two frames ago, the frame pacer has waited for that frame's GPU work by now,
+    // and the barrier after each dispatch made the shader's writes visible to this read
+    uint32_t counters[STAT_COUNTERS];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Counters[m_Current]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+    m_Stats.Meshlets         = counters[0];
+    m_Stats.VisibleMeshlets  = counters[1];
+    m_Stats.Triangles        = counters[2];
+    m_Stats.VisibleTriangles = counters[3];
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    // fresh storage while the GPU may still be drawing from last frame's commands
+    if (m_CommandCapacity)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Commands);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_CommandCapacity, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MeshletCuller::Draw(const Mesh& mesh, size_t instanceCount, const Frustum& frustum, const glm::vec4& eye,
+                         const Shader& shader)
+{
+    const uint32_t meshletCount = mesh.MeshletCount();
+    if (instanceCount == 0 || meshletCount == 0)
+        return;
+    if (!m_Shader)
+        Init();
+
+    const size_t commandBytes = size_t(meshletCount) * instanceCount * sizeof(DrawCommand);
+    const size_t offset       = (m_CommandCursor + m_OffsetAlignment - 1) / m_OffsetAlignment * m_OffsetAlignment;
+
+    // out of room: new, bigger storage. Draws already issued keep reading the old one.
+    if (offset + commandBytes > m_CommandCapacity)
+    {
+        size_t required = std::max(commandBytes, m_CommandCapacity * 2);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Commands);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, required, nullptr, GL_STREAM_DRAW);
+        GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, int64_t(required) - int64_t(m_CommandCapacity));
+        m_CommandCapacity = required;
+        m_CommandCursor   = 0;
+        Draw(mesh, instanceCount, frustum, eye, shader);
+        return;
+    }
+    m_CommandCursor = offset + commandBytes;
+
+    if (m_Batch >= m_CounterCapacity)
+    {
+        // more draws than slots: grow both buffers, this frame's stats are lost
+        m_CounterCapacity *= 2;
+        size_t bytes = (STAT_COUNTERS + m_CounterCapacity) * sizeof(uint32_t);
+        for (unsigned int counters : m_Counters)
+        {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, counters);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_READ);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        }
+        GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, int64_t(m_CounterCapacity * sizeof(uint32_t)));
+    }
+
+    // culled pairs leave zeroed commands at the tail of the range, the multi-draw skips them
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Commands);
+    glClearBufferSubData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, offset, commandBytes, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    m_Shader->use();
+    glUniform1ui(m_Locations[MESHLET_COUNT], meshletCount);
+    glUniform1ui(m_Locations[FIRST_INDEX], static_cast<GLuint>(reinterpret_cast<size_t>(mesh.IndexOffset()) / sizeof(unsigned int)));
+    glUniform1ui(m_Locations[BATCH], m_Batch);
+    glUniform4fv(m_Locations[PLANES], 6, &frustum.Planes[0].x);
+    glUniform4f(m_Locations[EYE], eye.x, eye.y, eye.z, eye.w);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mesh.MeshletBuffer());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mesh.instanceVBO);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, m_Commands, offset, commandBytes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_Counters[m_Current]);
+
+    const GLuint groups = (meshletCount + MESHLET_GROUP_SIZE - 1) / MESHLET_GROUP_SIZE;
+    for (size_t first = 0; first < instanceCount; first += MESHLET_MAX_DISPATCH_Y)
+    {
+        size_t count = std::min<size_t>(instanceCount - first, MESHLET_MAX_DISPATCH_Y);
+        glUniform1ui(m_Locations[INSTANCE_OFFSET], static_cast<GLuint>(first));
+        glDispatchCompute(groups, static_cast<GLuint>(count), 1);
+        ++m_Stats.Dispatches;
+    }
+    ++m_Batch;
+
+    for (GLuint binding = 0; binding < 4; ++binding)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+
+    shader.use();
+
+    // the commands feed the indirect draw below, the counters BeginFrame's read back and clear
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset),
+                                static_cast<GLsizei>(size_t(meshletCount) * instanceCount), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,100 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "frustum.h"
+#include "shader.h"
+
+#define MESHLET_MAX_VERTICES  64    // unique vertices per cluster
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MIN_TRIANGLES 2048  // smaller meshes are culled whole, clusters would not pay off
+#define MESHLET_GROUP_SIZE    64    // must match local_size_x in meshlet_cull.comp
+#define MESHLET_MAX_DISPATCH_Y 65535 // instances per dispatch, the minimum every GL 4.3 driver allows
+
+// a run of consecutive triangles of a mesh's index buffer, std430 layout of meshlet_cull.comp
+struct Meshlet {
+    glm::vec4 Sphere;      // object-space bounding sphere, center and radius
+    glm::vec4 Cone;        // axis of the triangle normals, w = sin of their spread (>= 1 never culls)
+    uint32_t  FirstIndex;  // relative to the mesh's first index
+    uint32_t  IndexCount;
+    uint32_t  Padding[2];
+};
+
+class Mesh;
+
+// Per-cluster culling for meshes with meshlets (see MeshImport::BuildMeshlets).
+// A compute pass tests every (instance, meshlet) pair against the frustum and,
+// for one-sided materials, the meshlet's normal cone against the viewer, and
+// appends an indirect draw command for each survivor; the mesh is then drawn
+// with one multi-draw over that compacted list. Triangle counts are summed on
+// the GPU and read back two frames later. Needs GL 4.3, see Supported().
+class MeshletCuller
+{
+public:
+    struct Stats {
+        size_t   Dispatches       = 0; // this frame so far
+        // counted on the GPU, from two frames ago
+        uint64_t Meshlets         = 0;
+        uint64_t VisibleMeshlets  = 0;
+        uint64_t Triangles        = 0;
+        uint64_t VisibleTriangles = 0;
+    };
+
+    static MeshletCuller& Get();
+    static bool Supported();
+
+    // once per frame before the first Draw, picks up the stats of two frames ago
+    void BeginFrame();
+
+    // draw the meshlets of the instances in the mesh's instance buffer (uploaded
+    // already, instanceCount of them) that survive culling. The mesh must be bound.
+    // eye is the camera position (w = 1); w = 0 skips the cone test, e.g. for
+    // depth passes where back faces still cast shadows. shader is the program the
+    // caller draws with, bound again after the culling dispatch.
+    void Draw(const Mesh& mesh, size_t instanceCount, const Frustum& frustum, const glm::vec4& eye,
+              const Shader& shader);
+
+    const Stats& GetStats() const { return m_Stats; }
+
+    void SetShaderDirectory(const std::string& directory) { m_ShaderDirectory = directory; }
+
+private:
+    MeshletCuller() = default;
+    ~MeshletCuller();
+
+    MeshletCuller(const MeshletCuller&) = delete;
+    MeshletCuller& operator=(const MeshletCuller&) = delete;
+
+    // indirect command of glMultiDrawElementsIndirect, written by the compute pass
+    struct DrawCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t  baseVertex;
+        uint32_t baseInstance;
+    };
+
+    std::unique_ptr<Shader> m_Shader;
+    std::string             m_ShaderDirectory = "../res/shaders";
+    unsigned int            m_Commands    = 0;
+    unsigned int            m_Counters[2] = { 0, 0 }; // alternate frames, so the read back never waits
+    size_t                  m_CommandCapacity = 0;    // bytes
+    size_t                  m_CounterCapacity = 0;    // draw counts per buffer
+    size_t                  m_CommandCursor   = 0;    // bytes used this frame
+    uint32_t                m_Batch           = 0;    // draw count slot of the next Draw
+    int                     m_Current         = 0;
+    GLint                   m_OffsetAlignment = 0;
+    GLint                   m_Locations[6]    = {}; // uniform locations in meshlet_cull.comp
+    Stats                   m_Stats;
+
+    void Init();
+};
+
+#endif
@@ -5,36 +5,146 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
 #include "shader.h"
+#include "texture_streamer.h"
+#include "mesh_import.h"
+#include "animation.h"
+#include "../core/alloc_counter.hpp"
+#include "../core/job_system.hpp"
+#include "../core/log.hpp"
 
 #include <string>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// one node's reference to a mesh, placed by the node's accumulated transform
+struct MeshInstance {
+    unsigned int mesh;      // index into Model::meshes
+    glm::mat4    transform;
+};
+
+// the CPU half of loading a model (see Model::Import): the file parsed, meshes
+// converted and textures decoded, but no GL objects yet
+struct ModelImport {
+    unique_ptr<Assimp::Importer> importer;  // owns scene
+    const aiScene*               scene = nullptr;
+    string                       directory;
+    Skeleton                     skeleton;
+    vector<AnimationClip>        animations;
+    vector<MeshInstance>         instances;
+    vector<unsigned int>         sceneMeshes; // aiMesh index per imported mesh
+    vector<ImportedMesh>         meshes;
+    unordered_map<string, PreparedTexture> textures; // keyed by the material's texture path
+
+    bool Valid() const { return scene != nullptr; }
+
+    // roughly what the model will take in VRAM once created
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const ImportedMesh& mesh : meshes)
+            bytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int)
+                   + mesh.meshlets.size() * sizeof(Meshlet);
+        for (const auto& texture : textures)
+            bytes += texture.second.Bytes();
+        return bytes;
+    }
+};
+
 class Model
 {
 public:
     // model data
     vector<Texture> textures_loaded;	// optimization: avoid duplicate loads
-    vector<Mesh>    meshes;
+    vector<Mesh>    meshes;     // one per aiMesh, however many nodes reference it
+    vector<MeshInstance> instances;
+    Skeleton        skeleton;   // empty unless a mesh has bones
+    vector<AnimationClip> animations;
     string          directory;
     bool            gammaCorrection;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false)
+        : Model(*Import(path), gamma)
+    {
+    }
+
+    // the GL half: create meshes and textures from an import, which is left spent
+    explicit Model(ModelImport &imported, bool gamma = false)
         : gammaCorrection(gamma)
     {
-        loadModel(path);
+        if (!imported.Valid())
+            return;
+
+        directory  = std::move(imported.directory);
+        skeleton   = std::move(imported.skeleton);
+        animations = std::move(imported.animations);
+        instances  = std::move(imported.instances);
+
+        const aiScene* scene = imported.scene;
+        meshes.reserve(imported.sceneMeshes.size());
+        for (size_t i = 0; i < imported.sceneMeshes.size(); i++)
+            meshes.push_back(processMesh(std::move(imported.meshes[i]), scene->mMeshes[imported.sceneMeshes[i]],
+                                         scene, imported.textures));
+    }
+
+    Model(Model&&) = default;
+
+    // textures belong to the model, meshes free their own buffers
+    ~Model()
+    {
+        for (const Texture& texture : textures_loaded)
+            if (texture.id)
+                TextureStreamer::Get().Unload(texture.id);
+    }
+
+    // read and convert the file without touching GL, safe on any thread.
+    // Invalid (and logged) if the file could not be read.
+    static unique_ptr<ModelImport> Import(string const &path)
+    {
+        MemoryTagScope tag(MemoryTag::Mesh);
+
+        auto result = make_unique<ModelImport>();
+        result->importer = make_unique<Assimp::Importer>();
+        const aiScene* scene = result->importer->ReadFile(
+            path,
+            aiProcess_Triangulate |
+            aiProcess_GenSmoothNormals |
+            aiProcess_FlipUVs |
+            aiProcess_CalcTangentSpace |
+            aiProcess_LimitBoneWeights
+        );
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            LOG_ERROR("ERROR::ASSIMP:: %s", result->importer->GetErrorString());
+            return result;
+        }
+
+        result->scene     = scene;
+        result->directory = path.substr(0, path.find_last_of('/'));
+
+        // joints first, meshes map their bone names onto them
+        result->skeleton = Animation::ImportSkeleton(scene);
+        processNode(scene->mRootNode, *result);
+        prepareTextures(*result);
+
+        if (!result->skeleton.Empty())
+        {
+            for (unsigned int i = 0; i < scene->mNumAnimations; i++)
+                result->animations.push_back(Animation::ImportClip(scene->mAnimations[i], result->skeleton));
+        }
+        return result;
     }
 
     // legacy draw: still works if you want direct use
@@ -45,147 +155,172 @@ public:
             glDrawElements(GL_TRIANGLES,
                            meshes[i].IndexCount(),
                            GL_UNSIGNED_INT,
-                           0);
+                           meshes[i].IndexOffset());
         glBindVertexArray(0);
     }
 
     // give renderer read access to meshes
     const std::vector<Mesh>& GetMeshes() const { return meshes; }
+    // every placement of a mesh in the model, what Renderer::Submit draws
+    const std::vector<MeshInstance>& GetInstances() const { return instances; }
 
-private:
-    void loadModel(string const &path)
+    const Skeleton&              GetSkeleton()   const { return skeleton; }
+    const vector<AnimationClip>& GetAnimations() const { return animations; }
+
+    // object-space bounds of every placed mesh together
+    AABB GetBounds() const
     {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(
-            path,
-            aiProcess_Triangulate |
-            aiProcess_GenSmoothNormals |
-            aiProcess_FlipUVs |
-            aiProcess_CalcTangentSpace
-        );
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        AABB bounds;
+        for (const MeshInstance& instance : instances)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            const Mesh& mesh = meshes[instance.mesh];
+            if (!mesh.bounds.Valid())
+                continue;
+            // skinned meshes are placed by their bones, not their node
+            AABB placed = mesh.skinned ? mesh.bounds : mesh.bounds.Transformed(instance.transform);
+            bounds.Expand(placed.Min);
+            bounds.Expand(placed.Max);
         }
+        return bounds;
+    }
+
+private:
+    // material texture slots in the order meshes list them, color maps are sRGB
+    struct TextureSlot {
+        aiTextureType type;
+        const char*   name;
+        bool          srgb;
+    };
+    static constexpr TextureSlot TEXTURE_SLOTS[] = {
+        { aiTextureType_DIFFUSE,  "texture_diffuse",  true  },
+        { aiTextureType_SPECULAR, "texture_specular", false },
+        { aiTextureType_HEIGHT,   "texture_normal",   false },
+        { aiTextureType_AMBIENT,  "texture_height",   false },
+    };
+
+    static void processNode(aiNode *node, ModelImport &result)
+    {
+        // gather every node -> mesh reference first. Each aiMesh is converted once
+        // (in parallel) however many nodes use it, the references become instances;
+        // GL objects are created later, in first-use order
+        const aiScene* scene = result.scene;
+        vector<int>    meshOfScene(scene->mNumMeshes, -1);
+        collectMeshes(node, scene, glm::mat4(1.0f), result, meshOfScene);
+
+        result.meshes.resize(result.sceneMeshes.size());
+        JobSystem::ParallelFor(result.sceneMeshes.size(), 1, [&](size_t begin, size_t end) {
+            MemoryTagScope tag(MemoryTag::Mesh); // tags are per thread
+            for (size_t i = begin; i < end; ++i)
+            {
+                const aiMesh* mesh = scene->mMeshes[result.sceneMeshes[i]];
+                result.meshes[i] = MeshImport::Import(mesh);
+                if (mesh->HasBones() && !result.skeleton.Empty())
+                    MeshImport::ConvertBoneWeights(mesh, result.skeleton, result.meshes[i].vertices.data());
+            }
+        });
 
-        directory = path.substr(0, path.find_last_of('/'));
-        processNode(scene->mRootNode, scene);
+        for (const ImportedMesh& mesh : result.meshes)
+            Animation::MeasureRadii(result.skeleton, mesh.vertices.data(), mesh.vertices.size());
     }
 
-    void processNode(aiNode *node, const aiScene *scene)
+    // decode every texture the meshes' materials use, in parallel. A path used by
+    // several slots keeps the color space of its first use, like loadMaterialTextures.
+    static void prepareTextures(ModelImport &result)
     {
-        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        vector<pair<string, bool>> files;
+        for (unsigned int sceneMesh : result.sceneMeshes)
         {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            aiMaterial* material = result.scene->mMaterials[result.scene->mMeshes[sceneMesh]->mMaterialIndex];
+            for (const TextureSlot& slot : TEXTURE_SLOTS)
+            {
+                for (unsigned int i = 0; i < material->GetTextureCount(slot.type); i++)
+                {
+                    aiString str;
+                    material->GetTexture(slot.type, i, &str);
+                    if (result.textures.emplace(str.C_Str(), PreparedTexture()).second)
+                        files.emplace_back(str.C_Str(), slot.srgb);
+                }
+            }
         }
 
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
-        {
-            processNode(node->mChildren[i], scene);
-        }
+        vector<PreparedTexture> prepared(files.size());
+        JobSystem::ParallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                prepared[i] = TextureStreamer::Get().Prepare(result.directory + '/' + files[i].first, files[i].second);
+        });
+        for (size_t i = 0; i < files.size(); i++)
+            result.textures[files[i].first] = std::move(prepared[i]);
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static void collectMeshes(aiNode *node, const aiScene *scene, const glm::mat4 &parentTransform,
+                              ModelImport &result, vector<int> &meshOfScene)
     {
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        glm::mat4 transform = parentTransform * MeshImport::ToMatrix(node->mTransformation);
 
-        // vertices
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
-            Vertex vertex{};
-            glm::vec3 vector;
-
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-
-            // normals
-            if (mesh->HasNormals())
+            unsigned int sceneMesh = node->mMeshes[i];
+            if (meshOfScene[sceneMesh] < 0)
             {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
+                meshOfScene[sceneMesh] = static_cast<int>(result.sceneMeshes.size());
+                result.sceneMeshes.push_back(sceneMesh);
             }
+            result.instances.push_back(MeshInstance{ static_cast<unsigned int>(meshOfScene[sceneMesh]), transform });
+        }
 
-            // texture coordinates
-            if (mesh->mTextureCoords[0])
-            {
-                glm::vec2 vec;
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
-            }
-            else
-            {
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-            }
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            collectMeshes(node->mChildren[i], scene, transform, result, meshOfScene);
+    }
 
-            // init bone IDs / weights to 0
-            for (int b = 0; b < MAX_BONE_INFLUENCE; ++b) {
-                vertex.m_BoneIDs[b] = 0;
-                vertex.m_Weights[b] = 0.0f;
-            }
+    Mesh processMesh(ImportedMesh imported, const aiMesh *mesh, const aiScene *scene,
+                     unordered_map<string, PreparedTexture> &prepared)
+    {
+        vector<Texture> textures;
 
-            vertices.push_back(vertex);
-        }
+        // materials
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-        // indices
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        for (const TextureSlot& slot : TEXTURE_SLOTS)
         {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            vector<Texture> maps = loadMaterialTextures(material, slot, prepared);
+            textures.insert(textures.end(), maps.begin(), maps.end());
         }
 
-        // materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-        vector<Texture> diffuseMaps  = loadMaterialTextures(material, aiTextureType_DIFFUSE,  "texture_diffuse");
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        vector<Texture> normalMaps   = loadMaterialTextures(material, aiTextureType_HEIGHT,   "texture_normal");
-        vector<Texture> heightMaps   = loadMaterialTextures(material, aiTextureType_AMBIENT,  "texture_height");
+        Mesh result(std::move(imported.vertices), std::move(imported.indices), std::move(textures));
+        result.SetMeshlets(imported.meshlets);
+        if (isAlphaTested(material))
+            result.features |= SHADER_FEATURE_ALPHA_TEST;
+        return result;
+    }
 
-        textures.insert(textures.end(), diffuseMaps.begin(),  diffuseMaps.end());
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        textures.insert(textures.end(), normalMaps.begin(),   normalMaps.end());
-        textures.insert(textures.end(), heightMaps.begin(),   heightMaps.end());
+    // cutout materials: an opacity mask (OBJ map_d) or glTF alphaMode MASK.
+    // The cutout reads the diffuse alpha, which is where both formats keep it.
+    static bool isAlphaTested(const aiMaterial *material)
+    {
+        if (material->GetTextureCount(aiTextureType_OPACITY) > 0)
+            return true;
 
-        return Mesh(std::move(vertices), std::move(indices), std::move(textures));
+        aiString alphaMode;
+        return material->Get("$mat.gltf.alphaMode", 0, 0, alphaMode) == AI_SUCCESS
+            && std::strcmp(alphaMode.C_Str(), "MASK") == 0;
     }
 
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    vector<Texture> loadMaterialTextures(aiMaterial *mat, const TextureSlot &slot,
+                                         unordered_map<string, PreparedTexture> &prepared)
     {
         vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        for (unsigned int i = 0; i < mat->GetTextureCount(slot.type); i++)
         {
             aiString str;
-            mat->GetTexture(type, i, &str);
+            mat->GetTexture(slot.type, i, &str);
 
             bool skip = false;
             for (unsigned int j = 0; j < textures_loaded.size(); j++)
             {
                 if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
                 {
-                    textures.push_back(textures_loaded[j]);
+                    if (textures_loaded[j].id)
+                        textures.push_back(textures_loaded[j]);
                     skip = true;
                     break;
                 }
@@ -193,10 +328,17 @@ private:
             if (!skip)
             {
                 Texture texture;
-                texture.id   = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
+                // only color maps are sRGB encoded, normal/specular/height maps are linear data
+                auto decoded = prepared.find(str.C_Str());
+                texture.id   = decoded != prepared.end()
+                             ? TextureStreamer::Get().Load(std::move(decoded->second))
+                             : TextureFromFile(str.C_Str(), this->directory, slot.srgb);
+                texture.type = slot.name;
                 texture.path = str.C_Str();
-                textures.push_back(texture);
+                // a file that failed to load is remembered but not bound, so the
+                // material's variant does not sample a map it does not have
+                if (texture.id)
+                    textures.push_back(texture);
                 textures_loaded.push_back(texture);
             }
         }
@@ -204,44 +346,14 @@ private:
     }
 };
 
+// textures start with their low mips only, finer levels are streamed in on demand
+// gamma: the file is sRGB color data and gets an sRGB internal format
 inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureStreamer::Get().Load(filename, gamma);
 }
 
 #endif
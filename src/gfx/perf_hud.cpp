@@ -0,0 +1,463 @@
+// perf_hud.cpp
+#include "perf_hud.h"
+#include "renderer.h"
+#include "gpu_memory.h"
+#include "../core/alloc_counter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // 5x7 glyphs for ASCII 32 (space) to 95 (underscore), one byte per row, bit 4 is
+    // the leftmost column. Lower case is drawn with the upper case glyphs.
+    const unsigned char FONT[64][7] = {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+        { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // !
+        { 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 }, // "
+        { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A }, // #
+        { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 }, // $
+        { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+        { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D }, // &
+        { 0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, // '
+        { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+        { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+        { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 }, // *
+        { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // +
+        { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ,
+        { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // -
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // .
+        { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+        { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // 0
+        { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 1
+        { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // 2
+        { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // 3
+        { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // 4
+        { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // 5
+        { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // 6
+        { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+        { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // 8
+        { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // 9
+        { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // :
+        { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 }, // ;
+        { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // <
+        { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // =
+        { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // >
+        { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // ?
+        { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E }, // @
+        { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 }, // A
+        { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // B
+        { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // C
+        { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // D
+        { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // E
+        { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // F
+        { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // G
+        { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // H
+        { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // I
+        { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // J
+        { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // L
+        { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+        { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+        { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // O
+        { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // P
+        { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // Q
+        { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // R
+        { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // S
+        { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+        { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // U
+        { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // V
+        { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // W
+        { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // X
+        { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, // Y
+        { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // Z
+        { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E }, // [
+        { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // backslash
+        { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E }, // ]
+        { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 }, // ^
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }, // _
+    };
+
+    // atlas layout: 16 x 5 cells of 8x8 texels, glyph i in cell i, cell 64 solid
+    constexpr int GLYPH_WIDTH   = 5;
+    constexpr int GLYPH_HEIGHT  = 7;
+    constexpr int CELL          = 8;
+    constexpr int ATLAS_COLUMNS = 16;
+    constexpr int ATLAS_WIDTH   = ATLAS_COLUMNS * CELL;
+    constexpr int ATLAS_HEIGHT  = 5 * CELL;
+    constexpr int SOLID_CELL    = 64;
+
+    // layout in font texels
+    constexpr float ADVANCE      = 6.0f;
+    constexpr float LINE_HEIGHT  = 10.0f;
+    constexpr float PADDING      = 4.0f;
+    constexpr float GRAPH_HEIGHT = 40.0f;
+
+    constexpr uint32_t Rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    constexpr uint32_t PANEL_COLOR  = Rgba(0, 0, 0, 160);
+    constexpr uint32_t GRAPH_COLOR  = Rgba(255, 255, 255, 24);
+    constexpr uint32_t MARK_COLOR   = Rgba(255, 255, 255, 96);
+    constexpr uint32_t TEXT_COLOR   = Rgba(230, 230, 230, 255);
+    constexpr uint32_t LABEL_COLOR  = Rgba(140, 200, 255, 255);
+    constexpr uint32_t GOOD_COLOR   = Rgba(80, 220, 80, 255);
+    constexpr uint32_t SLOW_COLOR   = Rgba(240, 200, 60, 255);
+    constexpr uint32_t BAD_COLOR    = Rgba(240, 70, 60, 255);
+    constexpr uint32_t GPU_COLOR    = Rgba(80, 200, 255, 255);
+
+    constexpr float TARGET_MS = 1000.0f / 60.0f;
+
+    uint32_t FrameColor(float ms)
+    {
+        if (ms <= TARGET_MS * 1.05f)
+            return GOOD_COLOR;
+        return ms <= 2.0f * TARGET_MS ? SLOW_COLOR : BAD_COLOR;
+    }
+
+    // 1234, 12.3K, 4.56M: counters in a few characters
+    const char* Compact(char* buffer, size_t size, double value)
+    {
+        if (value >= 1e9)
+            std::snprintf(buffer, size, "%.2fG", value / 1e9);
+        else if (value >= 1e6)
+            std::snprintf(buffer, size, "%.2fM", value / 1e6);
+        else if (value >= 1e4)
+            std::snprintf(buffer, size, "%.1fK", value / 1e3);
+        else
+            std::snprintf(buffer, size, "%.0f", value);
+        return buffer;
+    }
+
+    const char* Bytes(char* buffer, size_t size, double bytes)
+    {
+        if (bytes >= 1024.0 * 1024.0)
+            std::snprintf(buffer, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+        else
+            std::snprintf(buffer, size, "%.1f KB", bytes / 1024.0);
+        return buffer;
+    }
+}
+
+PerfHud::PerfHud(const PerfHudSettings& settings, const std::string& shaderDirectory)
+    : m_Settings(settings),
+      m_Shader(shaderDirectory + "/hud.vert", shaderDirectory + "/hud.frag")
+{
+    m_Settings.Scale = std::max(m_Settings.Scale, 1);
+    m_Settings.GraphMaxMs = std::max(m_Settings.GraphMaxMs, 1.0f);
+
+    CreateAtlas();
+
+    m_Vertices.resize(size_t(PERF_HUD_MAX_QUADS) * 6);
+    const size_t capacity = m_Vertices.size() * sizeof(HudVertex);
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, u));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, color));
+    glBindVertexArray(0);
+    GpuMemory::Track(GpuMemoryCategory::VertexBuffer, int64_t(capacity));
+
+    glGenQueries(PERF_HUD_TIMER_QUERIES, m_Queries);
+
+    m_Shader.use();
+    m_Shader.setInt("atlas", 0);
+}
+
+PerfHud::~PerfHud()
+{
+    GpuMemory::Track(GpuMemoryCategory::VertexBuffer, -int64_t(m_Vertices.size() * sizeof(HudVertex)));
+    GpuMemory::Track(GpuMemoryCategory::Texture, -int64_t(GpuMemory::TextureBytes(GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT)));
+
+    glDeleteQueries(PERF_HUD_TIMER_QUERIES, m_Queries);
+    glDeleteBuffers(1, &m_VBO);
+    glDeleteVertexArrays(1, &m_VAO);
+    glDeleteTextures(1, &m_Atlas);
+    glDeleteProgram(m_Shader.ID);
+}
+
+void PerfHud::CreateAtlas()
+{
+    unsigned char texels[ATLAS_WIDTH * ATLAS_HEIGHT] = {};
+    for (int glyph = 0; glyph < 64; ++glyph)
+    {
+        int x0 = (glyph % ATLAS_COLUMNS) * CELL;
+        int y0 = (glyph / ATLAS_COLUMNS) * CELL;
+        for (int row = 0; row < GLYPH_HEIGHT; ++row)
+        {
+            for (int column = 0; column < GLYPH_WIDTH; ++column)
+            {
+                if (FONT[glyph][row] & (0x10 >> column))
+                    texels[(y0 + row) * ATLAS_WIDTH + x0 + column] = 255;
+            }
+        }
+    }
+
+    int solidX = (SOLID_CELL % ATLAS_COLUMNS) * CELL;
+    int solidY = (SOLID_CELL / ATLAS_COLUMNS) * CELL;
+    for (int row = 0; row < CELL; ++row)
+        std::memset(&texels[(solidY + row) * ATLAS_WIDTH + solidX], 255, CELL);
+
+    glGenTextures(1, &m_Atlas);
+    glBindTexture(GL_TEXTURE_2D, m_Atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, texels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GpuMemory::Track(GpuMemoryCategory::Texture, int64_t(GpuMemory::TextureBytes(GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT)));
+}
+
+void PerfHud::Update(Window& window, float frameMs, float sceneGpuMs)
+{
+    if (window.isKeyPressed(static_cast<unsigned int>(m_Settings.ToggleKey)))
+        m_Settings.Visible = !m_Settings.Visible;
+
+    m_FrameMs[m_Next]    = frameMs;
+    m_SceneGpuMs[m_Next] = sceneGpuMs;
+    m_Next = (m_Next + 1) % PERF_HUD_SAMPLES;
+}
+
+void PerfHud::ReadTimers()
+{
+    // oldest first, like SceneTarget: nothing waits on a query still in flight
+    for (int i = 1; i <= PERF_HUD_TIMER_QUERIES; ++i)
+    {
+        int slot = (m_QueryIndex + i) % PERF_HUD_TIMER_QUERIES;
+        if (!m_QueryPending[slot])
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &elapsed);
+        m_Stats.GpuMs = (float)(elapsed / 1.0e6);
+        m_QueryPending[slot] = false;
+    }
+}
+
+void PerfHud::Quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t color)
+{
+    if (m_QuadCount == PERF_HUD_MAX_QUADS)
+        return;
+
+    HudVertex* v = &m_Vertices[m_QuadCount++ * 6];
+    v[0] = { x0, y0, u0, v0, color };
+    v[1] = { x0, y1, u0, v1, color };
+    v[2] = { x1, y1, u1, v1, color };
+    v[3] = { x0, y0, u0, v0, color };
+    v[4] = { x1, y1, u1, v1, color };
+    v[5] = { x1, y0, u1, v0, color };
+}
+
+void PerfHud::Rect(float x0, float y0, float x1, float y1, uint32_t color)
+{
+    // every corner samples the middle of the solid cell
+    const float u = ((SOLID_CELL % ATLAS_COLUMNS) * CELL + 0.5f * CELL) / ATLAS_WIDTH;
+    const float v = ((SOLID_CELL / ATLAS_COLUMNS) * CELL + 0.5f * CELL) / ATLAS_HEIGHT;
+    Quad(x0, y0, x1, y1, u, v, u, v, color);
+}
+
+float PerfHud::Text(float x, float y, const char* text, uint32_t color)
+{
+    const float scale = float(m_Settings.Scale);
+    for (const char* c = text; *c; ++c)
+    {
+        int code = static_cast<unsigned char>(*c);
+        if (code >= 'a' && code <= 'z')
+            code -= 'a' - 'A';
+        if (code < 32 || code > 95)
+            code = '?';
+
+        if (code != ' ')
+        {
+            int   glyph = code - 32;
+            float u0    = float((glyph % ATLAS_COLUMNS) * CELL) / ATLAS_WIDTH;
+            float v0    = float((glyph / ATLAS_COLUMNS) * CELL) / ATLAS_HEIGHT;
+            Quad(x, y, x + GLYPH_WIDTH * scale, y + GLYPH_HEIGHT * scale,
+                 u0, v0, u0 + float(GLYPH_WIDTH) / ATLAS_WIDTH, v0 + float(GLYPH_HEIGHT) / ATLAS_HEIGHT, color);
+        }
+        x += ADVANCE * scale;
+    }
+    return x;
+}
+
+void PerfHud::Graph(float x, float y, float height)
+{
+    const float scale  = float(m_Settings.Scale);
+    const float width  = PERF_HUD_SAMPLES * scale;
+    const float bottom = y + height;
+    const float toPixels = height / m_Settings.GraphMaxMs;
+
+    Rect(x, y, x + width, bottom, GRAPH_COLOR);
+    // 60 and 30 fps marks
+    for (float ms : { TARGET_MS, 2.0f * TARGET_MS })
+    {
+        if (ms < m_Settings.GraphMaxMs)
+            Rect(x, bottom - ms * toPixels, x + width, bottom - ms * toPixels + 1.0f, MARK_COLOR);
+    }
+
+    // frame times as bars, the scene's GPU time as a dot on each, oldest on the left
+    for (int i = 0; i < PERF_HUD_SAMPLES; ++i)
+    {
+        int   sample = (m_Next + i) % PERF_HUD_SAMPLES;
+        float frame  = m_FrameMs[sample];
+        float gpu    = m_SceneGpuMs[sample];
+        float left   = x + i * scale;
+
+        if (frame > 0.0f)
+            Rect(left, bottom - std::min(frame * toPixels, height), left + scale, bottom, FrameColor(frame));
+        if (gpu > 0.0f)
+        {
+            float top = bottom - std::min(gpu * toPixels, height);
+            Rect(left, top, left + scale, top + scale, GPU_COLOR);
+        }
+    }
+}
+
+void PerfHud::Draw(int width, int height)
+{
+    ReadTimers();
+    if (!m_Settings.Visible || width <= 0 || height <= 0)
+        return;
+
+    Clock::time_point start = Clock::now();
+
+    const float scale = float(m_Settings.Scale);
+    const float left  = PADDING * scale;
+    const float line  = LINE_HEIGHT * scale;
+    float       y     = PADDING * scale;
+    float       right = left;
+
+    // quad 0 is the panel, filled in once the content size is known
+    m_QuadCount = 1;
+
+    float last    = m_FrameMs[(m_Next + PERF_HUD_SAMPLES - 1) % PERF_HUD_SAMPLES];
+    float lastGpu = m_SceneGpuMs[(m_Next + PERF_HUD_SAMPLES - 1) % PERF_HUD_SAMPLES];
+    float sum = 0.0f, worst = 0.0f;
+    int   count = 0;
+    for (int i = 0; i < PERF_HUD_SAMPLES; ++i)
+    {
+        if (m_FrameMs[i] <= 0.0f)
+            continue;
+        sum  += m_FrameMs[i];
+        worst = std::max(worst, m_FrameMs[i]);
+        ++count;
+    }
+    float average = count ? sum / count : 0.0f;
+
+    const Renderer::Stats& renderer = Renderer::GetStats();
+
+    size_t cpuBytes = 0, gpuBytes = 0;
+    for (size_t tag = 0; tag < static_cast<size_t>(MemoryTag::Count); ++tag)
+        cpuBytes += AllocationCounter::getBytes(static_cast<MemoryTag>(tag));
+    for (size_t category = 0; category < static_cast<size_t>(GpuMemoryCategory::Count); ++category)
+        gpuBytes += GpuMemory::GetBytes(static_cast<GpuMemoryCategory>(category));
+
+    char text[128], a[16], b[16];
+
+    float x = Text(left, y, "FRAME ", LABEL_COLOR);
+    std::snprintf(text, sizeof(text), "%5.2f MS  AVG %5.2f  MAX %5.2f  %3.0f FPS", last, average, worst,
+                  average > 0.0f ? 1000.0f / average : 0.0f);
+    right = std::max(right, Text(x, y, text, FrameColor(last)));
+    y += line;
+
+    x = Text(left, y, "SCENE GPU ", LABEL_COLOR);
+    std::snprintf(text, sizeof(text), "%5.2f MS", lastGpu);
+    right = std::max(right, Text(x, y, text, GPU_COLOR));
+    y += line;
+
+    x = Text(left, y, "DRAWS ", LABEL_COLOR);
+    std::snprintf(text, sizeof(text), "%u  INSTANCES %s  TRIANGLES %s", renderer.DrawCalls,
+                  Compact(a, sizeof(a), double(renderer.Instances)), Compact(b, sizeof(b), double(renderer.Triangles)));
+    right = std::max(right, Text(x, y, text, TEXT_COLOR));
+    y += line;
+
+    x = Text(left, y, "STATE CHANGES ", LABEL_COLOR);
+    std::snprintf(text, sizeof(text), "%u  UPLOAD %s", renderer.StateChanges,
+                  Bytes(a, sizeof(a), double(renderer.UploadBytes)));
+    right = std::max(right, Text(x, y, text, TEXT_COLOR));
+    y += line;
+
+    x = Text(left, y, "MEMORY ", LABEL_COLOR);
+    std::snprintf(text, sizeof(text), "CPU %s  GPU %s", Bytes(a, sizeof(a), double(cpuBytes)),
+                  Bytes(b, sizeof(b), double(gpuBytes)));
+    right = std::max(right, Text(x, y, text, TEXT_COLOR));
+    y += line;
+
+    // last frame's numbers, this one is still being measured
+    x = Text(left, y, "HUD ", LABEL_COLOR);
+    std::snprintf(text, sizeof(text), "%.3f MS CPU  %.3f MS GPU  %u QUADS", m_Stats.CpuMs, m_Stats.GpuMs,
+                  m_Stats.Quads);
+    right = std::max(right, Text(x, y, text, TEXT_COLOR));
+    y += line;
+
+    Graph(left, y, GRAPH_HEIGHT * scale);
+    y    += GRAPH_HEIGHT * scale;
+    right = std::max(right, left + PERF_HUD_SAMPLES * scale);
+
+    size_t quads = m_QuadCount;
+    m_QuadCount  = 0;
+    Rect(0.0f, 0.0f, right + PADDING * scale, y + PADDING * scale, PANEL_COLOR);
+    m_QuadCount  = quads;
+
+    m_QueryIndex = (m_QueryIndex + 1) % PERF_HUD_TIMER_QUERIES;
+    glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_QueryIndex]);
+    m_QueryPending[m_QueryIndex] = true;
+
+    // orphan the whole buffer so the driver never waits on last frame's draw
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(HudVertex), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_QuadCount * 6 * sizeof(HudVertex), m_Vertices.data());
+
+    GLint     viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean blend     = glIsEnabled(GL_BLEND);
+    GLboolean cullFace  = glIsEnabled(GL_CULL_FACE);
+    GLboolean srgb      = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    // the colours are sRGB bytes already, encoding them again would wash them out
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    m_Shader.use();
+    m_Shader.setVec2("screenSize", glm::vec2(float(width), float(height)));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_Atlas);
+    glBindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(m_QuadCount * 6));
+    glBindVertexArray(0);
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+    if (!blend)    glDisable(GL_BLEND);
+    if (cullFace)  glEnable(GL_CULL_FACE);
+    if (srgb)      glEnable(GL_FRAMEBUFFER_SRGB);
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    m_Stats.Quads = static_cast<uint32_t>(m_QuadCount);
+    m_Stats.CpuMs = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
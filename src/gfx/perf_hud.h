@@ -0,0 +1,103 @@
+#ifndef PERF_HUD_H
+#define PERF_HUD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "../core/window.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define PERF_HUD_SAMPLES       240  // frames shown in the graphs
+#define PERF_HUD_MAX_QUADS     2048
+#define PERF_HUD_TIMER_QUERIES 4
+
+struct PerfHudSettings {
+    int   ToggleKey  = GLFW_KEY_F3;
+    bool  Visible    = false;
+    // screen pixels per font texel, kept integral so the glyphs stay crisp
+    int   Scale      = 2;
+    // frame time at the top of the graphs
+    float GraphMaxMs = 33.3f;
+};
+
+// On-screen overlay with frame time graphs and this frame's renderer counters
+// (draw calls, instances, triangles, state changes, instance uploads) plus CPU
+// and GPU memory. Text comes from a 5x7 bitmap font baked into an R8 atlas at
+// startup; glyphs, graph bars and the panel behind them are quads in one
+// preallocated vertex array, streamed into one buffer and drawn with one call,
+// so a visible HUD costs one upload and one draw and never touches the heap.
+// It reports its own cost: CPU time of Draw and GPU time from a ring of timer
+// queries read back a few frames late.
+class PerfHud
+{
+public:
+    struct Stats {
+        float    CpuMs = 0.0f; // building, uploading and submitting the last HUD frame
+        float    GpuMs = 0.0f;
+        uint32_t Quads = 0;
+    };
+
+    PerfHud(const PerfHudSettings& settings = PerfHudSettings(),
+            const std::string& shaderDirectory = "../res/shaders");
+    ~PerfHud();
+
+    PerfHud(const PerfHud&) = delete;
+    PerfHud& operator=(const PerfHud&) = delete;
+
+    // toggle on the key and record this frame's times, also while hidden so the
+    // graphs are full when it is shown
+    void Update(Window& window, float frameMs, float sceneGpuMs);
+
+    // draw over whatever is bound (normally the backbuffer), after EndScene so the
+    // renderer counters cover the whole frame
+    void Draw(int width, int height);
+
+    bool IsVisible() const { return m_Settings.Visible; }
+    void SetVisible(bool visible) { m_Settings.Visible = visible; }
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    struct HudVertex {
+        float    x, y;
+        float    u, v;
+        uint32_t color; // RGBA8
+    };
+
+    PerfHudSettings m_Settings;
+    Shader          m_Shader;
+
+    unsigned int m_Atlas = 0;
+    unsigned int m_VAO   = 0;
+    unsigned int m_VBO   = 0;
+
+    // CPU side of the vertex buffer, sized once for PERF_HUD_MAX_QUADS
+    std::vector<HudVertex> m_Vertices;
+    size_t                 m_QuadCount = 0;
+
+    // frame history, m_Next is the oldest sample
+    float m_FrameMs[PERF_HUD_SAMPLES]    = {};
+    float m_SceneGpuMs[PERF_HUD_SAMPLES] = {};
+    int   m_Next = 0;
+
+    unsigned int m_Queries[PERF_HUD_TIMER_QUERIES] = {};
+    bool         m_QueryPending[PERF_HUD_TIMER_QUERIES] = {};
+    int          m_QueryIndex = 0;
+
+    Stats m_Stats;
+
+    void CreateAtlas();
+    void ReadTimers();
+
+    void Quad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, uint32_t color);
+    void Rect(float x0, float y0, float x1, float y1, uint32_t color);
+    // returns the x after the last glyph
+    float Text(float x, float y, const char* text, uint32_t color);
+    void Graph(float x, float y, float height);
+};
+
+#endif
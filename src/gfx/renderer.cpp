@@ -3,52 +3,550 @@
 
 #include <glad/glad.h>
 
+#include "shader_variants.h"
+#include "../core/alloc_counter.hpp"
+#include "../core/job_system.hpp"
+#include "../core/log.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
 // static definitions
 Renderer::SceneData Renderer::s_SceneData{};
-std::map<Renderer::BatchKey, std::vector<Renderer::InstanceData>> Renderer::s_Batches;
+FrameMap<Renderer::BatchKey, Renderer::Batch> Renderer::s_Batches;
+FrameMap<Renderer::ImpostorKey, Renderer::Batch> Renderer::s_Impostors;
+std::vector<Renderer::InstanceData> Renderer::s_Visible;
+uint64_t Renderer::s_StaticHash = 0;
+Renderer::Stats Renderer::s_Stats{};
+FrameVector<Renderer::StaticChunk> Renderer::s_Chunks;
+FrameVector<Renderer::SkinnedInstance> Renderer::s_Skinned;
+std::vector<GLint> Renderer::s_VisibleBaseVertex;
+const glm::mat4* Renderer::s_Palette = nullptr;
+size_t Renderer::s_PaletteSize = 0;
+bool Renderer::s_SkinningDone = false;
+std::vector<std::unique_ptr<Renderer::SubmissionContext>> Renderer::s_Contexts;
+size_t Renderer::s_ContextCount = 0;
+bool Renderer::s_ContextsMerged = true;
+
+namespace
+{
+    // FNV-1a, only used to detect changes in the static submission set
+    constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    // first block of a submission context's arena, it grows to what a frame needs
+    constexpr size_t CONTEXT_ARENA_SIZE = 64 * 1024;
+}
 
 void Renderer::BeginScene(const glm::mat4& view, const glm::mat4& projection)
 {
     s_SceneData.View       = view;
     s_SceneData.Projection = projection;
+    s_SceneData.CameraPosition = glm::vec3(glm::inverse(view)[3]);
     s_Batches.clear();
+    s_Impostors.clear();
+    s_StaticHash = FNV_OFFSET;
+    s_Chunks.clear();
+    s_Skinned.clear();
+    s_SkinningDone = false;
+    s_Stats        = Stats{};
+
+    if (MeshletCuller::Supported())
+        MeshletCuller::Get().BeginFrame();
+
+    FrameCapture& capture = FrameCapture::Get();
+    if (capture.IsActive())
+        capture.BeginFrame(view, projection);
 }
 
-void Renderer::Submit(Model* model, Shader* shader, const glm::mat4& modelMatrix)
+void Renderer::Submit(Model* model, Shader* shader, const glm::mat4& modelMatrix, bool isStatic)
 {
-    // Every mesh in the model uses the same model matrix for now (like LearnOpenGL)
+    // every node placement of a mesh lands in that mesh's batch, so a mesh the asset
+    // reuses many times is still drawn with one instanced call
     const auto& meshes = model->GetMeshes();
-    for (const auto& m : meshes)
+    for (const MeshInstance& instance : model->GetInstances())
     {
-        SubmitMesh(const_cast<Mesh*>(&m), shader, modelMatrix);
+        SubmitMesh(const_cast<Mesh*>(&meshes[instance.mesh]), shader, modelMatrix * instance.transform, isStatic);
     }
 }
 
-void Renderer::SubmitMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix)
+void Renderer::SubmitMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix, bool isStatic)
 {
+    MemoryTagScope tag(MemoryTag::Renderer);
     BatchKey key{ mesh, shader };
-    InstanceData instance{ modelMatrix };
-    s_Batches[key].push_back(instance);
+    Batch& batch = s_Batches[key];
+    batch.instances.push_back(InstanceData{ modelMatrix });
+    batch.bounds.push_back(mesh->bounds.Transformed(modelMatrix));
+    batch.isStatic.push_back(isStatic ? 1 : 0);
+
+    if (isStatic)
+    {
+        s_StaticHash = HashBytes(s_StaticHash, &mesh, sizeof(mesh));
+        s_StaticHash = HashBytes(s_StaticHash, &modelMatrix, sizeof(modelMatrix));
+    }
+}
+
+void Renderer::Submit(Model* model, ShaderVariants* shaders, const glm::mat4& modelMatrix, bool isStatic,
+                      float fade)
+{
+    // a crossfade changes every frame, so it would keep invalidating the cached shadow cascades
+    const uint32_t crossfade = fade > 0.0f ? SHADER_FEATURE_CROSSFADE : 0;
+    isStatic = isStatic && !crossfade;
+
+    const auto& meshes = model->GetMeshes();
+    for (const MeshInstance& instance : model->GetInstances())
+    {
+        Mesh* mesh = const_cast<Mesh*>(&meshes[instance.mesh]);
+        glm::mat4 world = modelMatrix * instance.transform;
+        // the bottom row of an affine matrix is unused, the CROSSFADE variants read the fade from there
+        if (crossfade)
+            world[0][3] = fade;
+        SubmitMesh(mesh, shaders->Get(mesh->features | crossfade), world, isStatic);
+    }
+}
+
+void Renderer::SubmitSkinned(Model* model, Shader* shader, const glm::mat4& modelMatrix,
+                             uint32_t paletteOffset, const AABB& poseBounds)
+{
+    const auto& meshes = model->GetMeshes();
+    for (const MeshInstance& instance : model->GetInstances())
+    {
+        SubmitSkinnedMesh(const_cast<Mesh*>(&meshes[instance.mesh]), shader, modelMatrix, instance.transform,
+                          paletteOffset, poseBounds);
+    }
+}
+
+void Renderer::SubmitSkinned(Model* model, ShaderVariants* shaders, const glm::mat4& modelMatrix,
+                             uint32_t paletteOffset, const AABB& poseBounds)
+{
+    const auto& meshes = model->GetMeshes();
+    for (const MeshInstance& instance : model->GetInstances())
+    {
+        Mesh* mesh = const_cast<Mesh*>(&meshes[instance.mesh]);
+        SubmitSkinnedMesh(mesh, shaders->Get(mesh->features), modelMatrix, instance.transform,
+                          paletteOffset, poseBounds);
+    }
+}
+
+void Renderer::SubmitSkinnedMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix,
+                                 const glm::mat4& nodeTransform, uint32_t paletteOffset, const AABB& poseBounds)
+{
+    MemoryTagScope tag(MemoryTag::Renderer);
+
+    static bool warned = false;
+    if (!mesh->skinned || !GpuSkinning::Supported())
+    {
+        if (mesh->skinned && !warned)
+        {
+            LOG_WARN("WARNING::RENDERER::GPU skinning needs GL 4.3, skinned meshes draw in bind pose");
+            warned = true;
+        }
+        // skinned meshes are placed by their bones, the node transform does not apply
+        SubmitMesh(mesh, shader, mesh->skinned ? modelMatrix : modelMatrix * nodeTransform, false);
+        return;
+    }
+
+    const AABB& local = poseBounds.Valid() ? poseBounds : mesh->bounds;
+    s_Skinned.push_back(SkinnedInstance{ mesh, shader, modelMatrix, local.Transformed(modelMatrix), paletteOffset, 0 });
+}
+
+void Renderer::SubmitStaticChunk(Mesh* chunk, Shader* shader, uint64_t revision)
+{
+    MemoryTagScope tag(MemoryTag::Renderer);
+    s_Chunks.push_back(StaticChunk{ chunk, shader, revision });
+
+    s_StaticHash = HashBytes(s_StaticHash, &chunk, sizeof(chunk));
+    s_StaticHash = HashBytes(s_StaticHash, &revision, sizeof(revision));
+}
+
+void Renderer::SubmitImpostor(const Impostor* impostor, Shader* shader, const glm::mat4& modelMatrix, float fade,
+                              bool isStatic)
+{
+    MemoryTagScope tag(MemoryTag::Renderer);
+    isStatic = isStatic && fade >= 1.0f;
+
+    // handed to impostor.vert in the bottom row, like the CROSSFADE mesh variants
+    glm::mat4 instance = modelMatrix;
+    instance[0][3] = std::min(fade, 1.0f);
+
+    Batch& batch = s_Impostors[ImpostorKey{ impostor, shader }];
+    batch.instances.push_back(InstanceData{ instance });
+    batch.bounds.push_back(impostor->GetBounds().Transformed(modelMatrix));
+    batch.isStatic.push_back(isStatic ? 1 : 0);
+
+    if (isStatic)
+    {
+        s_StaticHash = HashBytes(s_StaticHash, &impostor, sizeof(impostor));
+        s_StaticHash = HashBytes(s_StaticHash, &instance, sizeof(instance));
+    }
+}
+
+void Renderer::SetBonePalette(const glm::mat4* palette, size_t jointCount)
+{
+    s_Palette     = palette;
+    s_PaletteSize = jointCount;
+}
+
+void Renderer::RenderDepth(const Shader& depthShader, const glm::mat4& viewProjection, CasterFilter filter)
+{
+    MemoryTagScope tag(MemoryTag::Renderer);
+    MergeContexts();
+    Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+    FrameCapture& capture = FrameCapture::Get();
+    if (capture.IsActive())
+        capture.RecordDepthPass(viewProjection, static_cast<uint32_t>(filter));
+
+    SkinMeshes();
+
+    depthShader.use();
+    depthShader.setMat4("viewProjection", viewProjection);
+    ++s_Stats.StateChanges;
+
+    for (auto& pair : s_Batches)
+    {
+        if (CullBatch(pair.second, frustum, filter) == 0)
+            continue;
+
+        // back faces still cast shadows, no cone test here
+        pair.first.mesh->Bind();
+        ++s_Stats.StateChanges;
+        DrawVisible(*pair.first.mesh, depthShader, frustum, glm::vec4(0.0f));
+    }
+
+    if (filter != CasterFilter::DynamicOnly)
+        DrawChunks(frustum, nullptr, 0.0f);
+
+    // animated instances never belong to the static set
+    if (filter != CasterFilter::StaticOnly)
+        DrawSkinned(frustum, nullptr, 0.0f);
+
+    // the impostors face the light: row 2 of an orthographic light matrix is the depth axis
+    glm::vec3 towardsLight = -glm::vec3(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2]);
+    DrawImpostors(frustum, viewProjection, glm::vec4(glm::normalize(towardsLight), 0.0f), nullptr, filter);
+
+    glBindVertexArray(0);
+}
+
+uint64_t Renderer::GetStaticSetHash()
+{
+    MergeContexts();
+    return s_StaticHash;
+}
+
+uint64_t Renderer::GetStaticCasterHash(const glm::mat4& viewProjection)
+{
+    MergeContexts();
+    Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+    // summed per caster, the order the scene query submitted them in does not matter
+    uint64_t sum   = 0;
+    uint64_t count = 0;
+    auto add = [&sum, &count](const void* key, const void* data, size_t size) {
+        uint64_t hash = HashBytes(FNV_OFFSET, &key, sizeof(key));
+        sum += HashBytes(hash, data, size);
+        ++count;
+    };
+
+    for (const auto& pair : s_Batches)
+    {
+        const Batch& batch = pair.second;
+        for (size_t i = 0; i < batch.instances.size(); ++i)
+            if (batch.isStatic[i] && frustum.Intersects(batch.bounds[i]))
+                add(pair.first.mesh, &batch.instances[i], sizeof(InstanceData));
+    }
+    for (const auto& pair : s_Impostors)
+    {
+        const Batch& batch = pair.second;
+        for (size_t i = 0; i < batch.instances.size(); ++i)
+            if (batch.isStatic[i] && frustum.Intersects(batch.bounds[i]))
+                add(pair.first.impostor, &batch.instances[i], sizeof(InstanceData));
+    }
+    for (const StaticChunk& chunk : s_Chunks)
+        if (frustum.Intersects(chunk.mesh->bounds))
+            add(chunk.mesh, &chunk.revision, sizeof(chunk.revision));
+
+    return HashBytes(sum, &count, sizeof(count));
 }
 
 void Renderer::EndScene()
 {
+    MergeContexts();
+
+    FrameCapture& capture = FrameCapture::Get();
+    if (capture.IsActive())
+    {
+        static_assert(sizeof(InstanceData) == sizeof(glm::mat4), "captures store instances as plain matrices");
+        for (const auto& pair : s_Batches)
+        {
+            const Batch& batch = pair.second;
+            capture.RecordBatch(pair.first.mesh, pair.first.shader, &batch.instances.data()->model,
+                                batch.isStatic.data(), batch.instances.size());
+        }
+        size_t impostors = 0;
+        for (const auto& pair : s_Impostors)
+            impostors += pair.second.instances.size();
+        capture.RecordOmitted(s_Chunks.size(), impostors, s_Skinned.size());
+        capture.EndFrame();
+    }
+
     Flush();
     s_Batches.clear();
+    s_Impostors.clear();
+    // arena storage is about to be recycled, the vector must not keep pointing at it
+    FrameVector<StaticChunk>().swap(s_Chunks);
+    FrameVector<SkinnedInstance>().swap(s_Skinned);
+    s_Palette     = nullptr;
+    s_PaletteSize = 0;
+    for (size_t i = 0; i < s_ContextCount; ++i)
+        s_Contexts[i]->Reset();
+    s_ContextCount = 0;
+
+    // nothing references frame data past this point
+    FrameArena::ResetAll();
+}
+
+void Renderer::BeginContexts(size_t count)
+{
+    while (s_Contexts.size() < count)
+        s_Contexts.push_back(std::make_unique<SubmissionContext>());
+    s_ContextCount  = std::max(s_ContextCount, count);
+    s_ContextsMerged = false;
+}
+
+void Renderer::MergeContexts()
+{
+    if (s_ContextsMerged)
+        return;
+    s_ContextsMerged = true;
+
+    // variants first asked for on a worker compile here, the GL context lives on this thread
+    for (size_t i = 0; i < s_ContextCount; ++i)
+    {
+        SubmissionContext& context = *s_Contexts[i];
+        for (const SubmissionContext::PendingVariant& pending : context.m_Pending)
+            context.m_Meshes.keys[pending.entry].shader = pending.shaders->Get(pending.features);
+        context.m_Pending.clear();
+    }
+
+    MergeEntries(s_Batches, &SubmissionContext::m_Meshes);
+    MergeEntries(s_Impostors, &SubmissionContext::m_Impostors);
+
+    // each context hashed its own static submissions, folded in context order
+    for (size_t i = 0; i < s_ContextCount; ++i)
+    {
+        const SubmissionContext& context = *s_Contexts[i];
+        if (context.m_StaticHash != FNV_OFFSET)
+            s_StaticHash = HashBytes(s_StaticHash, &context.m_StaticHash, sizeof(context.m_StaticHash));
+    }
+
+    // everything was copied out, a later BeginContexts this frame starts from empty contexts
+    for (size_t i = 0; i < s_ContextCount; ++i)
+        s_Contexts[i]->Reset();
+    s_ContextCount = 0;
+}
+
+template <typename Key>
+void Renderer::MergeEntries(FrameMap<Key, Batch>& batches, SubmissionContext::Entries<Key> SubmissionContext::*member)
+{
+    const size_t count = s_ContextCount;
+
+    // 1. every context sorts its own entries by key, ties keep submission order
+    JobSystem::ParallelFor(count, 1, [member](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            auto& entries = (*s_Contexts[i]).*member;
+            entries.order.resize(entries.keys.size());
+            for (uint32_t j = 0; j < entries.order.size(); ++j)
+                entries.order[j] = j;
+            std::sort(entries.order.begin(), entries.order.end(), [&entries](uint32_t a, uint32_t b) {
+                if (entries.keys[a] < entries.keys[b]) return true;
+                if (entries.keys[b] < entries.keys[a]) return false;
+                return a < b;
+            });
+        }
+    });
+
+    // 2. reserve each run of equal keys its slots in the batch, context by context
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto& entries = (*s_Contexts[i]).*member;
+        entries.runs.clear();
+        for (uint32_t first = 0; first < entries.order.size();)
+        {
+            const Key& key  = entries.keys[entries.order[first]];
+            uint32_t   last = first + 1;
+            while (last < entries.order.size() && !(key < entries.keys[entries.order[last]]))
+                ++last;
+
+            Batch& batch  = batches[key];
+            size_t offset = batch.instances.size();
+            batch.instances.resize(offset + (last - first));
+            batch.bounds.resize(offset + (last - first));
+            batch.isStatic.resize(offset + (last - first));
+            entries.runs.push_back(typename SubmissionContext::Run{ &batch, first, last - first, offset });
+            first = last;
+        }
+    }
+
+    // 3. the slots are disjoint, contexts copy into them in parallel
+    JobSystem::ParallelFor(count, 1, [member](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto& entries = (*s_Contexts[i]).*member;
+            for (const auto& run : entries.runs)
+            {
+                for (uint32_t j = 0; j < run.count; ++j)
+                {
+                    uint32_t entry = entries.order[run.first + j];
+                    run.batch->instances[run.offset + j] = entries.instances[entry];
+                    run.batch->bounds[run.offset + j]    = entries.bounds[entry];
+                    run.batch->isStatic[run.offset + j]  = entries.isStatic[entry];
+                }
+            }
+        }
+    });
+}
+
+Renderer::SubmissionContext::SubmissionContext()
+    : m_Arena(CONTEXT_ARENA_SIZE),
+      m_Meshes(m_Arena),
+      m_Impostors(m_Arena),
+      m_Pending(ArenaAllocator<PendingVariant>(m_Arena)),
+      m_StaticHash(FNV_OFFSET)
+{
+}
+
+template <typename Key>
+Renderer::SubmissionContext::Entries<Key>::Entries(LinearArena& arena)
+    : keys(ArenaAllocator<Key>(arena)),
+      instances(ArenaAllocator<InstanceData>(arena)),
+      bounds(ArenaAllocator<AABB>(arena)),
+      isStatic(ArenaAllocator<uint8_t>(arena)),
+      order(ArenaAllocator<uint32_t>(arena)),
+      runs(ArenaAllocator<Run>(arena))
+{
+}
+
+template <typename Key>
+void Renderer::SubmissionContext::Entries<Key>::Push(const Key& key, const glm::mat4& matrix, const AABB& worldBounds,
+                                                     bool isStaticEntry)
+{
+    keys.push_back(key);
+    instances.push_back(InstanceData{ matrix });
+    bounds.push_back(worldBounds);
+    isStatic.push_back(isStaticEntry ? 1 : 0);
+}
+
+template <typename Key>
+void Renderer::SubmissionContext::Entries<Key>::Clear()
+{
+    // the arena is about to be reset, drop the storage rather than keep pointing at it
+    keys      = FrameVector<Key>(keys.get_allocator());
+    instances = FrameVector<InstanceData>(instances.get_allocator());
+    bounds    = FrameVector<AABB>(bounds.get_allocator());
+    isStatic  = FrameVector<uint8_t>(isStatic.get_allocator());
+    order     = FrameVector<uint32_t>(order.get_allocator());
+    runs      = FrameVector<Run>(runs.get_allocator());
+}
+
+void Renderer::SubmissionContext::Reset()
+{
+    m_Meshes.Clear();
+    m_Impostors.Clear();
+    m_Pending    = FrameVector<PendingVariant>(m_Pending.get_allocator());
+    m_StaticHash = FNV_OFFSET;
+    m_Arena.Reset();
+}
+
+void Renderer::SubmissionContext::Submit(Model* model, Shader* shader, const glm::mat4& modelMatrix, bool isStatic)
+{
+    const auto& meshes = model->GetMeshes();
+    for (const MeshInstance& instance : model->GetInstances())
+        SubmitMesh(const_cast<Mesh*>(&meshes[instance.mesh]), shader, modelMatrix * instance.transform, isStatic);
+}
+
+void Renderer::SubmissionContext::Submit(Model* model, ShaderVariants* shaders, const glm::mat4& modelMatrix,
+                                         bool isStatic, float fade)
+{
+    // same as Renderer::Submit, except that a variant is only compiled on the main thread
+    const uint32_t crossfade = fade > 0.0f ? SHADER_FEATURE_CROSSFADE : 0;
+    isStatic = isStatic && !crossfade;
+
+    const auto& meshes = model->GetMeshes();
+    for (const MeshInstance& instance : model->GetInstances())
+    {
+        Mesh* mesh = const_cast<Mesh*>(&meshes[instance.mesh]);
+        glm::mat4 world = modelMatrix * instance.transform;
+        if (crossfade)
+            world[0][3] = fade;
+
+        const uint32_t features = mesh->features | crossfade;
+        Shader*        shader   = shaders->Find(features);
+        if (!shader)
+            m_Pending.push_back(PendingVariant{ static_cast<uint32_t>(m_Meshes.keys.size()), shaders, features });
+        SubmitMesh(mesh, shader, world, isStatic);
+    }
+}
+
+void Renderer::SubmissionContext::SubmitMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix, bool isStatic)
+{
+    m_Meshes.Push(BatchKey{ mesh, shader }, modelMatrix, mesh->bounds.Transformed(modelMatrix), isStatic);
+
+    if (isStatic)
+    {
+        m_StaticHash = HashBytes(m_StaticHash, &mesh, sizeof(mesh));
+        m_StaticHash = HashBytes(m_StaticHash, &modelMatrix, sizeof(modelMatrix));
+    }
+}
+
+void Renderer::SubmissionContext::SubmitImpostor(const Impostor* impostor, Shader* shader, const glm::mat4& modelMatrix,
+                                                 float fade, bool isStatic)
+{
+    isStatic = isStatic && fade >= 1.0f;
+
+    glm::mat4 instance = modelMatrix;
+    instance[0][3] = std::min(fade, 1.0f);
+    m_Impostors.Push(ImpostorKey{ impostor, shader }, instance, impostor->GetBounds().Transformed(modelMatrix), isStatic);
+
+    if (isStatic)
+    {
+        m_StaticHash = HashBytes(m_StaticHash, &impostor, sizeof(impostor));
+        m_StaticHash = HashBytes(m_StaticHash, &instance, sizeof(instance));
+    }
 }
 
 void Renderer::Flush()
 {
+    MemoryTagScope tag(MemoryTag::Renderer);
+    SkinMeshes();
+
     Shader* lastShader = nullptr;
+    Frustum frustum    = Frustum::FromMatrix(s_SceneData.Projection * s_SceneData.View);
+
+    // screen pixels covered by one world unit at distance one, for texture streaming
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float pixelsPerUnitAtOne = 0.5f * viewport[3] * s_SceneData.Projection[1][1];
 
     for (auto& pair : s_Batches)
     {
         BatchKey key         = pair.first;
-        auto&    instances   = pair.second;
         Mesh*    mesh        = key.mesh;
         Shader*  shader      = key.shader;
 
-        if (instances.empty())
+        if (CullBatch(pair.second, frustum, CasterFilter::All) == 0)
             continue;
 
         // bind shader only if changed
@@ -58,29 +556,256 @@ void Renderer::Flush()
             shader->setMat4("view",       s_SceneData.View);
             shader->setMat4("projection", s_SceneData.Projection);
             lastShader = shader;
+            ++s_Stats.StateChanges;
         }
 
+        RequestTextureDetail(*mesh, pixelsPerUnitAtOne);
+
         // bind mesh geometry + textures
         mesh->Bind();
         mesh->BindTextures(*shader);
+        ++s_Stats.StateChanges;
 
-        // upload instance data to instanceVBO
-        glBindBuffer(GL_ARRAY_BUFFER, mesh->instanceVBO);
-        glBufferData(GL_ARRAY_BUFFER,
-                     instances.size() * sizeof(InstanceData),
-                     instances.data(),
-                     GL_DYNAMIC_DRAW);
-
-        // draw all instances of this mesh in one call
-        glDrawElementsInstanced(
-            GL_TRIANGLES,
-            mesh->IndexCount(),
-            GL_UNSIGNED_INT,
-            0,
-            static_cast<GLsizei>(instances.size())
-        );
+        // draw all visible instances of this mesh in one call
+        DrawVisible(*mesh, *shader, frustum, glm::vec4(s_SceneData.CameraPosition, 1.0f));
     }
 
+    DrawChunks(frustum, &lastShader, pixelsPerUnitAtOne);
+    DrawSkinned(frustum, &lastShader, pixelsPerUnitAtOne);
+    DrawImpostors(frustum, s_SceneData.Projection * s_SceneData.View, glm::vec4(s_SceneData.CameraPosition, 1.0f),
+                  &lastShader, CasterFilter::All);
+
     // unbind VAO
     glBindVertexArray(0);
 }
+
+size_t Renderer::CullBatch(const Batch& batch, const Frustum& frustum, CasterFilter filter)
+{
+    s_Visible.clear();
+
+    for (size_t i = 0; i < batch.instances.size(); ++i)
+    {
+        if (filter == CasterFilter::StaticOnly  && !batch.isStatic[i])
+            continue;
+        if (filter == CasterFilter::DynamicOnly &&  batch.isStatic[i])
+            continue;
+        if (!frustum.Intersects(batch.bounds[i]))
+            continue;
+
+        s_Visible.push_back(batch.instances[i]);
+    }
+
+    return s_Visible.size();
+}
+
+void Renderer::DrawVisible(const Mesh& mesh, const Shader& shader, const Frustum& frustum, const glm::vec4& eye)
+{
+    // upload instance data to instanceVBO
+    mesh.UploadInstances(s_Visible.data(), s_Visible.size() * sizeof(InstanceData));
+    s_Stats.DrawCalls   += 1;
+    s_Stats.Instances   += s_Visible.size();
+    s_Stats.Triangles   += uint64_t(mesh.IndexCount() / 3) * s_Visible.size();
+    s_Stats.UploadBytes += s_Visible.size() * sizeof(InstanceData);
+
+    // large meshes are culled per meshlet on the GPU; cutouts are seen from both sides
+    if (mesh.MeshletCount() && MeshletCuller::Supported())
+    {
+        bool oneSided = !(mesh.features & SHADER_FEATURE_ALPHA_TEST);
+        MeshletCuller::Get().Draw(mesh, s_Visible.size(), frustum, oneSided ? eye : glm::vec4(0.0f), shader);
+        return;
+    }
+
+    glDrawElementsInstanced(
+        GL_TRIANGLES,
+        mesh.IndexCount(),
+        GL_UNSIGNED_INT,
+        mesh.IndexOffset(),
+        static_cast<GLsizei>(s_Visible.size())
+    );
+}
+
+void Renderer::DrawChunks(const Frustum& frustum, Shader** lastShader, float pixelsPerUnitAtOne)
+{
+    for (const StaticChunk& chunk : s_Chunks)
+    {
+        const Mesh& mesh = *chunk.mesh;
+        if (!frustum.Intersects(mesh.bounds))
+            continue;
+
+        if (lastShader)
+        {
+            if (chunk.shader != *lastShader)
+            {
+                chunk.shader->use();
+                chunk.shader->setMat4("view",       s_SceneData.View);
+                chunk.shader->setMat4("projection", s_SceneData.Projection);
+                *lastShader = chunk.shader;
+                ++s_Stats.StateChanges;
+            }
+
+            // the chunk is in world space, its center stands in for the instance position
+            s_Visible.clear();
+            s_Visible.push_back(InstanceData{ glm::translate(glm::mat4(1.0f), mesh.bounds.Center()) });
+            RequestTextureDetail(mesh, pixelsPerUnitAtOne);
+
+            mesh.Bind();
+            mesh.BindTextures(*chunk.shader);
+        }
+        else
+            mesh.Bind();
+
+        glDrawElements(GL_TRIANGLES, mesh.IndexCount(), GL_UNSIGNED_INT, mesh.IndexOffset());
+        s_Stats.DrawCalls    += 1;
+        s_Stats.Instances    += 1;
+        s_Stats.Triangles    += mesh.IndexCount() / 3;
+        s_Stats.StateChanges += 1;
+    }
+}
+
+void Renderer::DrawImpostors(const Frustum& frustum, const glm::mat4& viewProjection, const glm::vec4& eye,
+                             Shader** lastShader, CasterFilter filter)
+{
+    for (auto& pair : s_Impostors)
+    {
+        const Impostor& impostor = *pair.first.impostor;
+        Shader*         shader   = pair.first.shader;
+
+        if (CullBatch(pair.second, frustum, filter) == 0)
+            continue;
+
+        // depth passes share one depth shader for everything else, so always rebind there
+        if (!lastShader || shader != *lastShader)
+        {
+            shader->use();
+            shader->setMat4("view",           s_SceneData.View);
+            shader->setMat4("viewProjection", viewProjection);
+            shader->setVec4("eye",            eye);
+            shader->setBool("depthOnly",      lastShader == nullptr);
+            if (lastShader)
+                *lastShader = shader;
+            ++s_Stats.StateChanges;
+        }
+
+        impostor.Bind(*shader);
+        impostor.UploadInstances(s_Visible.data(), s_Visible.size() * sizeof(InstanceData));
+        impostor.Draw(s_Visible.size());
+        s_Stats.DrawCalls    += 1;
+        s_Stats.Instances    += s_Visible.size();
+        s_Stats.Triangles    += 2 * s_Visible.size(); // one quad each
+        s_Stats.StateChanges += 1;
+        s_Stats.UploadBytes  += s_Visible.size() * sizeof(InstanceData);
+    }
+}
+
+void Renderer::SkinMeshes()
+{
+    if (s_SkinningDone)
+        return;
+    s_SkinningDone = true;
+    if (s_Skinned.empty())
+        return;
+
+    // grouped like the batches so passes bind each shader and mesh once
+    std::sort(s_Skinned.begin(), s_Skinned.end(), [](const SkinnedInstance& a, const SkinnedInstance& b) {
+        if (a.shader != b.shader)
+            return a.shader < b.shader;
+        return a.mesh < b.mesh;
+    });
+
+    uint32_t vertices = 0;
+    for (SkinnedInstance& instance : s_Skinned)
+    {
+        instance.outputVertex = vertices;
+        vertices += instance.mesh->VertexCount();
+    }
+
+    GpuSkinning& skinning = GpuSkinning::Get();
+    skinning.Begin(s_Palette, s_PaletteSize, vertices);
+    for (const SkinnedInstance& instance : s_Skinned)
+        skinning.Add(*instance.mesh, instance.paletteOffset, instance.outputVertex);
+    skinning.Dispatch();
+}
+
+void Renderer::DrawSkinned(const Frustum& frustum, Shader** lastShader, float pixelsPerUnitAtOne)
+{
+    const unsigned int output = GpuSkinning::Get().GetOutputBuffer();
+
+    size_t first = 0;
+    while (first < s_Skinned.size())
+    {
+        Mesh*   mesh   = s_Skinned[first].mesh;
+        Shader* shader = s_Skinned[first].shader;
+
+        s_Visible.clear();
+        s_VisibleBaseVertex.clear();
+        size_t last = first;
+        for (; last < s_Skinned.size() && s_Skinned[last].mesh == mesh && s_Skinned[last].shader == shader; ++last)
+        {
+            if (!frustum.Intersects(s_Skinned[last].bounds))
+                continue;
+            s_Visible.push_back(InstanceData{ s_Skinned[last].model });
+            s_VisibleBaseVertex.push_back(static_cast<GLint>(s_Skinned[last].outputVertex));
+        }
+        first = last;
+
+        if (s_Visible.empty())
+            continue;
+
+        if (lastShader)
+        {
+            if (shader != *lastShader)
+            {
+                shader->use();
+                shader->setMat4("view",       s_SceneData.View);
+                shader->setMat4("projection", s_SceneData.Projection);
+                *lastShader = shader;
+                ++s_Stats.StateChanges;
+            }
+            RequestTextureDetail(*mesh, pixelsPerUnitAtOne);
+        }
+
+        mesh->BindSkinned(output);
+        if (lastShader)
+            mesh->BindTextures(*shader);
+        mesh->UploadInstances(s_Visible.data(), s_Visible.size() * sizeof(InstanceData));
+        s_Stats.DrawCalls    += static_cast<uint32_t>(s_Visible.size());
+        s_Stats.Instances    += s_Visible.size();
+        s_Stats.Triangles    += uint64_t(mesh->IndexCount() / 3) * s_Visible.size();
+        s_Stats.StateChanges += 1;
+        s_Stats.UploadBytes  += s_Visible.size() * sizeof(InstanceData);
+
+        // every instance has its own vertices, so one draw each: the base vertex picks
+        // the skinned copy, the base instance its matrix
+        for (size_t i = 0; i < s_Visible.size(); ++i)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh->IndexCount(), GL_UNSIGNED_INT,
+                                                          mesh->IndexOffset(), 1, s_VisibleBaseVertex[i],
+                                                          static_cast<GLuint>(i));
+        }
+    }
+}
+
+void Renderer::RequestTextureDetail(const Mesh& mesh, float pixelsPerUnitAtOne)
+{
+    if (mesh.textures.empty())
+        return;
+
+    // the closest visible instance decides the mip every texture of the mesh needs
+    float radius     = glm::length(mesh.bounds.Extents());
+    float uvPerPixel = FLT_MAX;
+    for (const InstanceData& instance : s_Visible)
+    {
+        float scale = std::max({ glm::length(glm::vec3(instance.model[0])),
+                                 glm::length(glm::vec3(instance.model[1])),
+                                 glm::length(glm::vec3(instance.model[2])) });
+        float distance = glm::length(glm::vec3(instance.model[3]) - s_SceneData.CameraPosition) - radius * scale;
+        distance = std::max(distance, 0.1f);
+
+        float pixelsPerUnit = pixelsPerUnitAtOne / distance;
+        uvPerPixel = std::min(uvPerPixel, mesh.uvDensity / (scale * pixelsPerUnit));
+    }
+
+    TextureStreamer& streamer = TextureStreamer::Get();
+    for (const Texture& texture : mesh.textures)
+        streamer.RequestResolution(texture.id, uvPerPixel);
+}
@@ -2,31 +2,30 @@
 #define RENDERER_H
 
 #include <map>
+#include <memory>
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
 
 #include "model.h"
 #include "mesh.h"
 #include "shader.h"
+#include "frustum.h"
+#include "frame_capture.h"
+#include "skinning.h"
+#include "impostor.h"
+#include "meshlet.h"
+#include "../core/frame_arena.hpp"
+
+class ShaderVariants;
 
 class Renderer
 {
-public:
-    static void BeginScene(const glm::mat4& view, const glm::mat4& projection);
-
-    // submit a whole model (all its meshes share the same model matrix)
-    static void Submit(Model* model, Shader* shader, const glm::mat4& modelMatrix);
-
-    // submit a single mesh (if you want more direct control)
-    static void SubmitMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix);
-
-    static void EndScene();
-
-private:
     struct InstanceData {
         glm::mat4 model;
     };
 
+    // shader is the resolved program, so every material variant batches (and sorts) apart
     struct BatchKey {
         Mesh*   mesh;
         Shader* shader;
@@ -39,15 +38,237 @@ private:
         }
     };
 
+    struct ImpostorKey {
+        const Impostor* impostor;
+        Shader*         shader;
+
+        bool operator<(const ImpostorKey& other) const
+        {
+            if (shader != other.shader)
+                return shader < other.shader;
+            return impostor < other.impostor;
+        }
+    };
+
+    // per-instance data to upload, plus what culling needs (kept parallel)
+    // lives in the frame arena, released in one go at EndScene
+    struct Batch {
+        FrameVector<InstanceData> instances;
+        FrameVector<AABB>         bounds;
+        FrameVector<uint8_t>      isStatic;
+    };
+
+public:
+    // which submissions a depth-only pass should draw
+    enum class CasterFilter {
+        All,
+        StaticOnly,
+        DynamicOnly
+    };
+
+    static void BeginScene(const glm::mat4& view, const glm::mat4& projection);
+
+    // submit a whole model (all its meshes share the same model matrix)
+    // static submissions are expected to keep the same transform frame to frame
+    static void Submit(Model* model, Shader* shader, const glm::mat4& modelMatrix, bool isStatic = false);
+
+    // submit a whole model, each mesh with the variant of shaders its material needs.
+    // fade > 0 draws it with the CROSSFADE variants, dithered out by that much
+    // towards an impostor submitted alongside (see SubmitImpostor)
+    static void Submit(Model* model, ShaderVariants* shaders, const glm::mat4& modelMatrix, bool isStatic = false,
+                       float fade = 0.0f);
+
+    // submit a single mesh (if you want more direct control)
+    static void SubmitMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix, bool isStatic = false);
+
+    // submit an animated model. Its skinned meshes go through the compute skinning
+    // pre-pass once per frame and every pass draws the result; they always count as
+    // dynamic and are not recorded by frame captures. paletteOffset is the model's
+    // first joint in the SetBonePalette array, poseBounds the object-space box around
+    // the posed vertices (invalid to use the bind-pose bounds).
+    static void SubmitSkinned(Model* model, Shader* shader, const glm::mat4& modelMatrix,
+                              uint32_t paletteOffset, const AABB& poseBounds);
+    static void SubmitSkinned(Model* model, ShaderVariants* shaders, const glm::mat4& modelMatrix,
+                              uint32_t paletteOffset, const AABB& poseBounds);
+
+    // submit a StaticBatcher chunk: merged geometry already in world space, drawn as is
+    // with one call and no instance upload (its identity instance is uploaded once).
+    // Counts as static and is not recorded by frame captures; revision changes
+    // whenever the chunk is rebuilt.
+    static void SubmitStaticChunk(Mesh* chunk, Shader* shader, uint64_t revision);
+
+    // submit an instance of an impostor in place of (or, while fade < 1, on top of)
+    // its model. All instances of an impostor draw with one call, in color and
+    // depth passes; frame captures do not record them. Only fully faded
+    // instances count as static, the rest change every frame.
+    static void SubmitImpostor(const Impostor* impostor, Shader* shader, const glm::mat4& modelMatrix, float fade,
+                               bool isStatic = false);
+
+    // joint palette for this frame's skinned submissions, must stay alive until EndScene
+    static void SetBonePalette(const glm::mat4* palette, size_t jointCount);
+
+    // draw the current submissions depth-only with the given shader,
+    // culled against viewProjection (used by shadow passes)
+    static void RenderDepth(const Shader& depthShader, const glm::mat4& viewProjection, CasterFilter filter);
+
+    // hash of this frame's static submissions, changes whenever the static set does
+    static uint64_t GetStaticSetHash();
+    // hash of the static casters a StaticOnly depth pass with viewProjection would draw,
+    // independent of submission order, so it only changes when that pass's output can
+    static uint64_t GetStaticCasterHash(const glm::mat4& viewProjection);
+
+    // what every pass since BeginScene sent to the GPU, read after EndScene
+    struct Stats {
+        uint32_t DrawCalls    = 0;
+        uint64_t Instances    = 0;
+        uint64_t Triangles    = 0; // before meshlet culling
+        uint32_t StateChanges = 0; // program and vertex array binds
+        uint64_t UploadBytes  = 0; // instance data
+    };
+    static const Stats& GetStats() { return s_Stats; }
+
+    static void EndScene();
+
+    // Submissions from worker threads. A job fills a context of its own through the
+    // same calls as the static Submit functions (skinned meshes and static chunks
+    // stay on the main thread). The first pass that needs the frame's submissions
+    // merges every context into the batches with a parallel sort: after the main
+    // thread's submissions and in context index order, so the draw order does not
+    // depend on which thread ran which job. One thread at a time per context.
+    class SubmissionContext
+    {
+    public:
+        SubmissionContext();
+
+        SubmissionContext(const SubmissionContext&) = delete;
+        SubmissionContext& operator=(const SubmissionContext&) = delete;
+
+        void Submit(Model* model, Shader* shader, const glm::mat4& modelMatrix, bool isStatic = false);
+        void Submit(Model* model, ShaderVariants* shaders, const glm::mat4& modelMatrix, bool isStatic = false,
+                    float fade = 0.0f);
+        void SubmitMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix, bool isStatic = false);
+        void SubmitImpostor(const Impostor* impostor, Shader* shader, const glm::mat4& modelMatrix, float fade,
+                            bool isStatic = false);
+
+        size_t GetCount() const { return m_Meshes.keys.size() + m_Impostors.keys.size(); }
+
+    private:
+        friend class Renderer;
+
+        // a run of equal keys in sorted order, copied into batch from offset on
+        struct Run {
+            Batch*   batch;
+            uint32_t first;  // into order
+            uint32_t count;
+            size_t   offset;
+        };
+
+        // one entry per submission, kept parallel like Batch
+        template <typename Key>
+        struct Entries {
+            FrameVector<Key>          keys;
+            FrameVector<InstanceData> instances;
+            FrameVector<AABB>         bounds;
+            FrameVector<uint8_t>      isStatic;
+            FrameVector<uint32_t>     order; // entries sorted by key, then submission order
+            FrameVector<Run>          runs;
+
+            explicit Entries(LinearArena& arena);
+            void Push(const Key& key, const glm::mat4& matrix, const AABB& worldBounds, bool isStatic);
+            void Clear();
+        };
+
+        // a variant not compiled yet when the context asked for it, resolved on the main thread
+        struct PendingVariant {
+            uint32_t        entry;
+            ShaderVariants* shaders;
+            uint32_t        features;
+        };
+
+        LinearArena                  m_Arena; // backs every vector below, any thread may fill it
+        Entries<BatchKey>            m_Meshes;
+        Entries<ImpostorKey>         m_Impostors;
+        FrameVector<PendingVariant>  m_Pending;
+        uint64_t                     m_StaticHash;
+
+        void Reset();
+    };
+
+    // make count contexts ready for this frame's jobs, on the main thread after BeginScene;
+    // may be called again after a merge, the merged contexts were emptied by it
+    static void BeginContexts(size_t count);
+    static SubmissionContext& GetContext(size_t index) { return *s_Contexts[index]; }
+
+private:
+    struct SkinnedInstance {
+        Mesh*     mesh;
+        Shader*   shader;
+        glm::mat4 model;
+        AABB      bounds;        // world space
+        uint32_t  paletteOffset;
+        uint32_t  outputVertex;  // first vertex in the skinning output, set by SkinMeshes
+    };
+
+    struct StaticChunk {
+        Mesh*    mesh;
+        Shader*  shader;
+        uint64_t revision;
+    };
+
     struct SceneData {
         glm::mat4 View;
         glm::mat4 Projection;
+        glm::vec3 CameraPosition;
     };
 
     static SceneData s_SceneData;
-    static std::map<BatchKey, std::vector<InstanceData>> s_Batches;
+    static FrameMap<BatchKey, Batch> s_Batches;
+    static FrameMap<ImpostorKey, Batch> s_Impostors;
+    static std::vector<InstanceData> s_Visible;
+    static uint64_t s_StaticHash;
+    static Stats s_Stats;
+
+    static std::vector<std::unique_ptr<SubmissionContext>> s_Contexts;
+    static size_t                       s_ContextCount;
+    static bool                         s_ContextsMerged;
+
+    static FrameVector<StaticChunk>     s_Chunks;
+    static FrameVector<SkinnedInstance> s_Skinned;
+    static std::vector<GLint>           s_VisibleBaseVertex;
+    static const glm::mat4*             s_Palette;
+    static size_t                       s_PaletteSize;
+    static bool                         s_SkinningDone;
 
     static void Flush();
+
+    // fold the contexts into s_Batches and s_Impostors, then empty them
+    static void MergeContexts();
+    template <typename Key>
+    static void MergeEntries(FrameMap<Key, Batch>& batches, SubmissionContext::Entries<Key> SubmissionContext::*entries);
+
+    static void SubmitSkinnedMesh(Mesh* mesh, Shader* shader, const glm::mat4& modelMatrix,
+                                  const glm::mat4& nodeTransform, uint32_t paletteOffset, const AABB& poseBounds);
+
+    // cull a batch into s_Visible, returns the number of surviving instances
+    static size_t CullBatch(const Batch& batch, const Frustum& frustum, CasterFilter filter);
+    // upload s_Visible into the mesh's instance buffer and draw it. Meshes with
+    // meshlets are culled per cluster against frustum, and against eye (w = 0 skips
+    // the back-face test) for one-sided materials.
+    static void DrawVisible(const Mesh& mesh, const Shader& shader, const Frustum& frustum, const glm::vec4& eye);
+    // draw the static chunks inside frustum, shader binding works like DrawSkinned
+    static void DrawChunks(const Frustum& frustum, Shader** lastShader, float pixelsPerUnitAtOne);
+    // draw the impostor instances inside frustum as seen from eye (a position, or a
+    // direction towards the viewer for orthographic passes). Color passes pass
+    // lastShader; depth passes pass null, this then binds the impostor shader itself.
+    static void DrawImpostors(const Frustum& frustum, const glm::mat4& viewProjection, const glm::vec4& eye,
+                              Shader** lastShader, CasterFilter filter);
+    // skin every skinned submission once, before the first pass that draws them
+    static void SkinMeshes();
+    // draw the skinned instances inside frustum. Color passes pass lastShader and bind
+    // materials; depth passes pass null and use whatever program is bound.
+    static void DrawSkinned(const Frustum& frustum, Shader** lastShader, float pixelsPerUnitAtOne);
+    // tell the texture streamer how much detail the visible instances of a mesh need
+    static void RequestTextureDetail(const Mesh& mesh, float pixelsPerUnitAtOne);
 };
 
-#endif
\ No newline at end of file
+#endif
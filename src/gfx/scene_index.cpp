@@ -0,0 +1,74 @@
+// scene_index.cpp
+#include "scene_index.h"
+
+SceneIndex::SceneIndex(entt::registry& registry, const BVHSettings& settings)
+    : m_Registry(registry), m_Tree(settings)
+{
+    m_Registry.on_construct<BoundsComponent>().connect<&SceneIndex::OnBoundsConstruct>(*this);
+    m_Registry.on_destroy<BoundsComponent>().connect<&SceneIndex::OnBoundsDestroy>(*this);
+    m_Registry.on_update<TransformComponent>().connect<&SceneIndex::OnMoved>(*this);
+    m_Registry.on_update<BoundsComponent>().connect<&SceneIndex::OnMoved>(*this);
+}
+
+SceneIndex::~SceneIndex()
+{
+    m_Registry.on_construct<BoundsComponent>().disconnect<&SceneIndex::OnBoundsConstruct>(*this);
+    m_Registry.on_destroy<BoundsComponent>().disconnect<&SceneIndex::OnBoundsDestroy>(*this);
+    m_Registry.on_update<TransformComponent>().disconnect<&SceneIndex::OnMoved>(*this);
+    m_Registry.on_update<BoundsComponent>().disconnect<&SceneIndex::OnMoved>(*this);
+}
+
+void SceneIndex::Update()
+{
+    // an entity patched several times this frame is refit once with its final transform
+    for (entt::entity entity : m_Moved)
+    {
+        if (!m_Registry.valid(entity))
+            continue;
+        BoundsComponent* bounds = m_Registry.try_get<BoundsComponent>(entity);
+        if (!bounds || bounds->Proxy == BVH::INVALID)
+            continue;
+
+        bounds->World = WorldBounds(entity, bounds->Local);
+        m_Tree.Move(bounds->Proxy, bounds->World);
+    }
+    m_Moved.clear();
+
+    m_Tree.Update();
+}
+
+entt::entity SceneIndex::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                                 float* distance) const
+{
+    BVH::RayHit hit = m_Tree.Raycast(origin, direction, maxDistance,
+                                     [](uint32_t, float boxDistance) { return boxDistance; });
+    if (distance)
+        *distance = hit.distance;
+    return hit.Hit() ? static_cast<entt::entity>(hit.userData) : entt::entity(entt::null);
+}
+
+void SceneIndex::OnBoundsConstruct(entt::registry&, entt::entity entity)
+{
+    BoundsComponent& bounds = m_Registry.get<BoundsComponent>(entity);
+    bounds.World = WorldBounds(entity, bounds.Local);
+    bounds.Proxy = m_Tree.Insert(bounds.World, static_cast<uint32_t>(entity));
+}
+
+void SceneIndex::OnBoundsDestroy(entt::registry&, entt::entity entity)
+{
+    BoundsComponent& bounds = m_Registry.get<BoundsComponent>(entity);
+    if (bounds.Proxy != BVH::INVALID)
+        m_Tree.Remove(bounds.Proxy);
+    bounds.Proxy = BVH::INVALID;
+}
+
+void SceneIndex::OnMoved(entt::registry&, entt::entity entity)
+{
+    m_Moved.push_back(entity);
+}
+
+AABB SceneIndex::WorldBounds(entt::entity entity, const AABB& local) const
+{
+    const TransformComponent* transform = m_Registry.try_get<TransformComponent>(entity);
+    return transform ? local.Transformed(transform->Matrix) : local;
+}
@@ -0,0 +1,58 @@
+#ifndef SCENE_INDEX_H
+#define SCENE_INDEX_H
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "bvh.h"
+#include "components.h"
+
+// Keeps a BVH over the world bounds of every entity with a BoundsComponent.
+// Listens to the registry: constructing or destroying BoundsComponent inserts or
+// removes the proxy, updating TransformComponent or BoundsComponent queues a refit. Update() applies
+// the queued moves once per frame, before any query.
+class SceneIndex
+{
+public:
+    explicit SceneIndex(entt::registry& registry, const BVHSettings& settings = BVHSettings());
+    ~SceneIndex();
+
+    SceneIndex(const SceneIndex&) = delete;
+    SceneIndex& operator=(const SceneIndex&) = delete;
+
+    void Update();
+
+    // visit(entity) for every entity intersecting any of the frusta, each once
+    template<typename F>
+    void Query(const Frustum* frusta, int count, F&& visit) const
+    {
+        m_Tree.QueryFrusta(frusta, count, [&](uint32_t id) { visit(static_cast<entt::entity>(id)); });
+    }
+
+    template<typename F>
+    void Query(const AABB& box, F&& visit) const
+    {
+        m_Tree.QueryBox(box, [&](uint32_t id) { visit(static_cast<entt::entity>(id)); });
+    }
+
+    // closest entity whose world box the ray hits, entt::null if none
+    entt::entity Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                         float* distance = nullptr) const;
+
+    const BVH& GetTree() const { return m_Tree; }
+
+private:
+    entt::registry&           m_Registry;
+    BVH                       m_Tree;
+    std::vector<entt::entity> m_Moved;
+
+    void OnBoundsConstruct(entt::registry& registry, entt::entity entity);
+    void OnBoundsDestroy(entt::registry& registry, entt::entity entity);
+    void OnMoved(entt::registry& registry, entt::entity entity);
+
+    AABB WorldBounds(entt::entity entity, const AABB& local) const;
+};
+
+#endif
@@ -0,0 +1,521 @@
+// scene_snapshot.cpp
+#include "scene_snapshot.h"
+#include "model.h"
+#include "../core/job_system.hpp"
+#include "../core/log.hpp"
+#include "../core/mapped_file.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[4] = { 'K', 'S', 'C', 'N' };
+    constexpr uint32_t NO_ASSET   = ~0u;
+    constexpr size_t   POOL_COUNT = static_cast<size_t>(SnapshotPool::Count);
+    // records decoded per job within a pool
+    constexpr size_t   DECODE_GRAIN = 16 * 1024;
+
+    struct PoolEntry {
+        uint32_t pool;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // fixed-size records of the component pools, see SnapshotPool
+    struct TransformRecord  { float affine[12]; };
+    struct RenderableRecord { uint32_t model, shaders, impostor, isStatic; };
+    struct AnimatorRecord   { uint32_t model, clip, blendClip; float time, blendTime, blendWeight, speed; uint32_t loop; };
+    struct BoundsRecord     { float local[6]; };
+
+    void PutBytes(std::vector<char>& out, const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void Put(std::vector<char>& out, const T& value)
+    {
+        PutBytes(out, &value, sizeof(T));
+    }
+
+    float Milliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    // pointer -> table index, for the save
+    struct AssetIndex
+    {
+        std::unordered_map<const void*, uint32_t> models, shaders, impostors, skeletons;
+        const SnapshotAssets& assets;
+
+        explicit AssetIndex(const SnapshotAssets& table) : assets(table)
+        {
+            for (uint32_t i = 0; i < table.Models.size(); ++i)
+            {
+                models.emplace(table.Models[i], i);
+                skeletons.emplace(&table.Models[i]->GetSkeleton(), i);
+            }
+            for (uint32_t i = 0; i < table.Shaders.size(); ++i)
+                shaders.emplace(table.Shaders[i], i);
+            for (uint32_t i = 0; i < table.Impostors.size(); ++i)
+                impostors.emplace(table.Impostors[i], i);
+        }
+
+        static uint32_t Find(const std::unordered_map<const void*, uint32_t>& map, const void* pointer)
+        {
+            auto it = map.find(pointer);
+            return it != map.end() ? it->second : NO_ASSET;
+        }
+
+        uint32_t Clip(uint32_t model, const AnimationClip* clip) const
+        {
+            if (model == NO_ASSET || !clip)
+                return NO_ASSET;
+            const auto& clips = assets.Models[model]->GetAnimations();
+            if (clip < clips.data() || clip >= clips.data() + clips.size())
+                return NO_ASSET;
+            return static_cast<uint32_t>(clip - clips.data());
+        }
+    };
+
+    // what entt::snapshot writes into: one pool's bytes
+    struct OutputArchive
+    {
+        std::vector<char>& out;
+        const AssetIndex&  index;
+        size_t&            unresolved; // references Load would reject
+
+        // a pointer that is set but not in the table
+        uint32_t Stored(uint32_t stored, const void* pointer)
+        {
+            if (stored == NO_ASSET && pointer)
+                ++unresolved;
+            return stored;
+        }
+
+        void operator()(std::uint32_t value) { Put(out, value); }
+        void operator()(entt::entity entity) { Put(out, static_cast<uint32_t>(entity)); }
+
+        void operator()(const TransformComponent& transform)
+        {
+            // transforms are affine, the last row is always (0, 0, 0, 1)
+            TransformRecord record;
+            for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 3; ++r)
+                    record.affine[c * 3 + r] = transform.Matrix[c][r];
+            Put(out, record);
+        }
+
+        void operator()(const RenderableComponent& renderable)
+        {
+            // a renderable always needs its model
+            if (!renderable.model)
+                ++unresolved;
+            Put(out, RenderableRecord{ Stored(AssetIndex::Find(index.models, renderable.model), renderable.model),
+                                       Stored(AssetIndex::Find(index.shaders, renderable.shaders), renderable.shaders),
+                                       Stored(AssetIndex::Find(index.impostors, renderable.impostor), renderable.impostor),
+                                       renderable.isStatic ? 1u : 0u });
+        }
+
+        void operator()(const AnimatorComponent& animator)
+        {
+            // and an animator its skeleton and clip
+            if (!animator.skeleton || !animator.clip)
+                ++unresolved;
+            uint32_t model = Stored(AssetIndex::Find(index.skeletons, animator.skeleton), animator.skeleton);
+            Put(out, AnimatorRecord{ model, Stored(index.Clip(model, animator.clip), animator.clip),
+                                     Stored(index.Clip(model, animator.blendClip), animator.blendClip),
+                                     animator.time, animator.blendTime, animator.blendWeight, animator.speed,
+                                     animator.loop ? 1u : 0u });
+        }
+
+        void operator()(const BoundsComponent& bounds)
+        {
+            BoundsRecord record = { { bounds.Local.Min.x, bounds.Local.Min.y, bounds.Local.Min.z,
+                                      bounds.Local.Max.x, bounds.Local.Max.y, bounds.Local.Max.z } };
+            Put(out, record);
+        }
+    };
+
+    // reads a pool front to back, running past the end yields zeros (caught by the size checks)
+    struct InputArchive
+    {
+        const unsigned char* data;
+        size_t               size;
+        size_t               offset = 0;
+
+        void GetBytes(void* dst, size_t bytes)
+        {
+            if (offset + bytes > size)
+            {
+                std::memset(dst, 0, bytes);
+                offset = size;
+                return;
+            }
+            std::memcpy(dst, data + offset, bytes);
+            offset += bytes;
+        }
+
+        void operator()(std::uint32_t& value) { GetBytes(&value, sizeof(value)); }
+        void operator()(entt::entity& entity)
+        {
+            uint32_t value;
+            GetBytes(&value, sizeof(value));
+            entity = static_cast<entt::entity>(value);
+        }
+    };
+
+    // a component pool decoded ahead of time, handed to the loader as its archive
+    template <typename Component>
+    struct StagedPool
+    {
+        std::vector<entt::entity> entities;
+        std::vector<Component>    components;
+        size_t                    next = 0;
+
+        void operator()(std::uint32_t& count) { count = static_cast<uint32_t>(entities.size()); }
+        void operator()(entt::entity& entity) { entity = entities[next]; }
+        void operator()(Component& component) { component = std::move(components[next++]); }
+    };
+
+    struct Staged
+    {
+        StagedPool<TransformComponent>  transforms;
+        StagedPool<RenderableComponent> renderables;
+        StagedPool<AnimatorComponent>   animators;
+        StagedPool<BoundsComponent>     bounds;
+    };
+
+    template <typename Asset>
+    bool Resolve(const std::vector<Asset*>& table, uint32_t index, Asset*& out)
+    {
+        if (index == NO_ASSET)
+        {
+            out = nullptr;
+            return true;
+        }
+        if (index >= table.size())
+            return false;
+        out = table[index];
+        return true;
+    }
+
+    // the entity pool as entt::snapshot writes it: u32 size, u32 in use, then the
+    // identifiers, the ones in use first. live gets each of those at its entity index,
+    // the rest of it entt::null.
+    bool DecodeEntities(const unsigned char* data, size_t size, std::vector<entt::entity>& live, uint32_t& inUse)
+    {
+        uint32_t count = 0;
+        inUse = 0;
+        if (size < 2 * sizeof(uint32_t))
+            return size == 0;
+        std::memcpy(&count, data, sizeof(count));
+        std::memcpy(&inUse, data + sizeof(count), sizeof(inUse));
+        if (inUse > count || size != 2 * sizeof(uint32_t) + size_t(count) * sizeof(uint32_t))
+            return false;
+
+        const unsigned char* ids = data + 2 * sizeof(uint32_t);
+        for (uint32_t i = 0; i < inUse; ++i)
+        {
+            uint32_t value;
+            std::memcpy(&value, ids + i * sizeof(value), sizeof(value));
+            entt::entity entity = static_cast<entt::entity>(value);
+            if (entity == entt::null)
+                return false;
+            size_t index = entt::to_entity(entity);
+            if (index >= live.size())
+                live.resize(index + 1, entt::null);
+            if (live[index] != entt::null)
+                return false;
+            live[index] = entity;
+        }
+        return true;
+    }
+
+    // decode one pool's { entity, record } pairs, in parallel over the records. Every
+    // entity has to be one of the live ones of the entity pool, and convert(record,
+    // component) returns false for records it cannot resolve.
+    template <typename Record, typename Component, typename Convert>
+    bool DecodePool(const unsigned char* data, size_t size, const std::vector<entt::entity>& live,
+                    StagedPool<Component>& staged, Convert convert)
+    {
+        constexpr size_t PAIR = sizeof(uint32_t) + sizeof(Record);
+        uint32_t count = 0;
+        if (size < sizeof(count))
+            return size == 0;
+        std::memcpy(&count, data, sizeof(count));
+        if (size != sizeof(count) + size_t(count) * PAIR)
+            return false;
+
+        staged.entities.resize(count);
+        staged.components.resize(count);
+        const unsigned char* pairs = data + sizeof(count);
+
+        std::atomic<bool> valid{ true };
+        JobSystem::ParallelFor(count, DECODE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint32_t entity;
+                Record   record;
+                std::memcpy(&entity, pairs + i * PAIR, sizeof(entity));
+                std::memcpy(&record, pairs + i * PAIR + sizeof(entity), sizeof(record));
+                staged.entities[i] = static_cast<entt::entity>(entity);
+                if (staged.entities[i] == entt::null)
+                {
+                    valid = false;
+                    continue;
+                }
+                size_t index = entt::to_entity(staged.entities[i]);
+                if (index >= live.size() || live[index] != staged.entities[i] || !convert(record, staged.components[i]))
+                    valid = false;
+            }
+        });
+        return valid;
+    }
+}
+
+size_t SceneSnapshot::Write(const entt::registry& registry, const SnapshotAssets& assets, std::vector<char>& out)
+{
+    AssetIndex index(assets);
+
+    // the storages are only read, every pool is written by its own job
+    std::vector<char> pools[POOL_COUNT];
+    size_t            unresolved[POOL_COUNT] = {};
+    JobSystem::ParallelFor(POOL_COUNT, 1, [&](size_t begin, size_t end) {
+        for (size_t pool = begin; pool < end; ++pool)
+        {
+            OutputArchive archive{ pools[pool], index, unresolved[pool] };
+            entt::snapshot snapshot{ registry };
+            switch (static_cast<SnapshotPool>(pool))
+            {
+            case SnapshotPool::Entities:    snapshot.get<entt::entity>(archive);        break;
+            case SnapshotPool::Transforms:  snapshot.get<TransformComponent>(archive);  break;
+            case SnapshotPool::Renderables: snapshot.get<RenderableComponent>(archive); break;
+            case SnapshotPool::Animators:   snapshot.get<AnimatorComponent>(archive);   break;
+            case SnapshotPool::Bounds:      snapshot.get<BoundsComponent>(archive);     break;
+            default: break;
+            }
+        }
+    });
+
+    uint32_t version   = SNAPSHOT_VERSION;
+    uint32_t poolCount = static_cast<uint32_t>(POOL_COUNT);
+    uint64_t offset    = sizeof(SNAPSHOT_MAGIC) + 2 * sizeof(uint32_t) + POOL_COUNT * sizeof(PoolEntry);
+
+    size_t total = offset;
+    for (const std::vector<char>& pool : pools)
+        total += pool.size();
+    out.clear();
+    out.reserve(total);
+
+    PutBytes(out, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    Put(out, version);
+    Put(out, poolCount);
+    for (uint32_t pool = 0; pool < poolCount; ++pool)
+    {
+        Put(out, PoolEntry{ pool, 0, offset, pools[pool].size() });
+        offset += pools[pool].size();
+    }
+    for (const std::vector<char>& pool : pools)
+        PutBytes(out, pool.data(), pool.size());
+
+    size_t missing = 0;
+    for (size_t count : unresolved)
+        missing += count;
+    return missing;
+}
+
+bool SceneSnapshot::Save(const entt::registry& registry, const SnapshotAssets& assets, const std::string& path)
+{
+    std::vector<char> data;
+    if (size_t unresolved = Write(registry, assets, data))
+    {
+        LOG_ERROR("ERROR::SNAPSHOT::%zu component references are missing from the asset table, %s not written",
+                  unresolved, path.c_str());
+        return false;
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        LOG_ERROR("ERROR::SNAPSHOT::Could not open %s", path.c_str());
+        return false;
+    }
+    bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok)
+        LOG_ERROR("ERROR::SNAPSHOT::Could not write %s", path.c_str());
+    return ok;
+}
+
+SceneLoader::SceneLoader(entt::registry& registry)
+    : m_Registry(registry), m_Loader(registry)
+{
+}
+
+bool SceneLoader::Load(const std::string& path, const SnapshotAssets& assets)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        LOG_ERROR("ERROR::SNAPSHOT::Could not read %s", path.c_str());
+        return false;
+    }
+    return Load(file.getData(), file.getSize(), assets);
+}
+
+bool SceneLoader::Load(const void* data, size_t size, const SnapshotAssets& assets)
+{
+    auto start = std::chrono::steady_clock::now();
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    // header and pool table
+    const size_t headerSize = sizeof(SNAPSHOT_MAGIC) + 2 * sizeof(uint32_t);
+    uint32_t version = 0, poolCount = 0;
+    if (size >= headerSize)
+    {
+        std::memcpy(&version,   bytes + sizeof(SNAPSHOT_MAGIC), sizeof(version));
+        std::memcpy(&poolCount, bytes + sizeof(SNAPSHOT_MAGIC) + sizeof(version), sizeof(poolCount));
+    }
+    if (size < headerSize || std::memcmp(bytes, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || version != SNAPSHOT_VERSION)
+    {
+        LOG_ERROR("ERROR::SNAPSHOT::Not a version %d scene snapshot", SNAPSHOT_VERSION);
+        return false;
+    }
+
+    const unsigned char* pools[POOL_COUNT] = {};
+    size_t               sizes[POOL_COUNT] = {};
+    for (uint32_t i = 0; i < poolCount; ++i)
+    {
+        PoolEntry entry;
+        if (headerSize + (i + 1) * sizeof(PoolEntry) > size)
+            break;
+        std::memcpy(&entry, bytes + headerSize + i * sizeof(PoolEntry), sizeof(entry));
+        if (entry.offset > size || entry.size > size - entry.offset)
+        {
+            LOG_ERROR("ERROR::SNAPSHOT::Pool %u runs past the end of the file", entry.pool);
+            return false;
+        }
+        // pools this version does not know are skipped
+        if (entry.pool < POOL_COUNT)
+        {
+            pools[entry.pool] = bytes + entry.offset;
+            sizes[entry.pool] = static_cast<size_t>(entry.size);
+        }
+    }
+
+    // 1. decode the entity pool, then every component pool against it, in parallel and
+    // nothing touching the registry yet. The loader reads the entity pool again itself.
+    const size_t entityPool = static_cast<size_t>(SnapshotPool::Entities);
+    std::vector<entt::entity> live;
+    uint32_t inUse = 0;
+    if (!DecodeEntities(pools[entityPool], sizes[entityPool], live, inUse))
+    {
+        LOG_ERROR("ERROR::SNAPSHOT::Pool %zu is malformed, nothing loaded", entityPool);
+        return false;
+    }
+
+    Staged staged;
+    bool   decoded[POOL_COUNT] = {};
+    decoded[entityPool] = true;
+    JobSystem::ParallelFor(POOL_COUNT, 1, [&](size_t begin, size_t end) {
+        for (size_t pool = begin; pool < end; ++pool)
+        {
+            const unsigned char* in = pools[pool];
+            const size_t         n  = sizes[pool];
+            switch (static_cast<SnapshotPool>(pool))
+            {
+            case SnapshotPool::Transforms:
+                decoded[pool] = DecodePool<TransformRecord>(in, n, live, staged.transforms,
+                    [](const TransformRecord& record, TransformComponent& transform) {
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            for (int r = 0; r < 3; ++r)
+                                transform.Matrix[c][r] = record.affine[c * 3 + r];
+                            transform.Matrix[c][3] = c == 3 ? 1.0f : 0.0f;
+                        }
+                        return true;
+                    });
+                break;
+            case SnapshotPool::Renderables:
+                decoded[pool] = DecodePool<RenderableRecord>(in, n, live, staged.renderables,
+                    [&assets](const RenderableRecord& record, RenderableComponent& renderable) {
+                        renderable.isStatic = record.isStatic != 0;
+                        return Resolve(assets.Models, record.model, renderable.model) && renderable.model
+                            && Resolve(assets.Shaders, record.shaders, renderable.shaders)
+                            && Resolve(assets.Impostors, record.impostor, renderable.impostor);
+                    });
+                break;
+            case SnapshotPool::Animators:
+                decoded[pool] = DecodePool<AnimatorRecord>(in, n, live, staged.animators,
+                    [&assets](const AnimatorRecord& record, AnimatorComponent& animator) {
+                        if (record.model >= assets.Models.size())
+                            return false;
+                        const Model& model = *assets.Models[record.model];
+                        const auto&  clips = model.GetAnimations();
+                        if (record.clip >= clips.size() || (record.blendClip != NO_ASSET && record.blendClip >= clips.size()))
+                            return false;
+                        animator.skeleton    = &model.GetSkeleton();
+                        animator.clip        = &clips[record.clip];
+                        animator.blendClip   = record.blendClip != NO_ASSET ? &clips[record.blendClip] : nullptr;
+                        animator.time        = record.time;
+                        animator.blendTime   = record.blendTime;
+                        animator.blendWeight = record.blendWeight;
+                        animator.speed       = record.speed;
+                        animator.loop        = record.loop != 0;
+                        return true;
+                    });
+                break;
+            case SnapshotPool::Bounds:
+                decoded[pool] = DecodePool<BoundsRecord>(in, n, live, staged.bounds,
+                    [](const BoundsRecord& record, BoundsComponent& bounds) {
+                        bounds.Local.Min = glm::vec3(record.local[0], record.local[1], record.local[2]);
+                        bounds.Local.Max = glm::vec3(record.local[3], record.local[4], record.local[5]);
+                        return true;
+                    });
+                break;
+            default:
+                break;
+            }
+        }
+    });
+
+    for (size_t pool = 0; pool < POOL_COUNT; ++pool)
+    {
+        if (!decoded[pool])
+        {
+            LOG_ERROR("ERROR::SNAPSHOT::Pool %zu is malformed or refers to unknown entities or assets, nothing loaded", pool);
+            return false;
+        }
+    }
+
+    auto decodedAt = std::chrono::steady_clock::now();
+
+    // 2. into the registry, the entities first so components can be mapped onto them
+    InputArchive entities{ pools[entityPool], sizes[entityPool] };
+    m_Loader.get<entt::entity>(entities)
+            .get<TransformComponent>(staged.transforms)
+            .get<RenderableComponent>(staged.renderables)
+            .get<AnimatorComponent>(staged.animators)
+            .get<BoundsComponent>(staged.bounds);
+
+    // the identifiers past the ones in use are released entities, not loaded
+    m_Stats.Entities   = inUse;
+    m_Stats.Components = staged.transforms.entities.size() + staged.renderables.entities.size()
+                       + staged.animators.entities.size() + staged.bounds.entities.size();
+    m_Stats.DecodeMs   = Milliseconds(decodedAt - start);
+    m_Stats.InsertMs   = Milliseconds(std::chrono::steady_clock::now() - decodedAt);
+    return true;
+}
+
+entt::entity SceneLoader::Map(entt::entity archived) const
+{
+    return m_Loader.contains(archived) ? m_Loader.map(archived) : entt::entity(entt::null);
+}
@@ -0,0 +1,91 @@
+#ifndef SCENE_SNAPSHOT_H
+#define SCENE_SNAPSHOT_H
+
+#include <entt/entt.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "components.h"
+
+// Binary level layout, native endianness:
+//   "KSCN" u32 version, u32 poolCount, {u32 pool, u32 reserved, u64 offset, u64 size}[poolCount], pools.
+// A pool holds what entt::snapshot writes for one storage, in its dense order: the
+// entity pool a u32 count, a u32 in-use count and the identifiers (those in use
+// first), a component pool a u32 count and then { u32 entity, record } pairs, every
+// entity one in use in the entity pool. Asset pointers are stored as their index in a
+// SnapshotAssets table (~0u for none). Derived state is not stored: SceneIndex
+// recomputes world bounds and proxies, StaticBatcher the batching.
+#define SNAPSHOT_VERSION 1
+
+enum class SnapshotPool : uint32_t {
+    Entities    = 0,
+    Transforms  = 1, // f32 affine[12]
+    Renderables = 2, // u32 model, u32 shaders, u32 impostor, u32 isStatic
+    Animators   = 3, // u32 model (owning the skeleton), u32 clip, u32 blendClip (clips of that model),
+                     // f32 time, f32 blendTime, f32 blendWeight, f32 speed, u32 loop
+    Bounds      = 4, // f32 local[6]
+    Count
+};
+
+// what the pointers in components refer to, a snapshot stores indices into these
+struct SnapshotAssets {
+    std::vector<Model*>          Models;
+    std::vector<ShaderVariants*> Shaders;
+    std::vector<Impostor*>       Impostors;
+};
+
+// Saving a registry's scene components. The pools are serialized in parallel.
+namespace SceneSnapshot
+{
+    // the whole file into out. Returns how many component references could not be
+    // stored: a pointer missing from the table, a renderable without a model or an
+    // animator without a clip. They are written as ~0u, which Load rejects, so out
+    // is only loadable when this is 0.
+    size_t Write(const entt::registry& registry, const SnapshotAssets& assets, std::vector<char>& out);
+    // false (and logged, nothing written) if a reference cannot be stored or the
+    // file cannot be written
+    bool Save(const entt::registry& registry, const SnapshotAssets& assets, const std::string& path);
+}
+
+// Loads snapshots into a registry through entt::continuous_loader: every archived
+// entity gets a local one, so a level loads next to whatever the registry holds
+// already, and loading the same level again (a hot restart) updates the entities
+// it created the first time instead of adding more. Files are memory mapped and
+// the component pools decoded in parallel; the decoded pools then go into the
+// registry one after another, in pool order, so construction listeners (SceneIndex,
+// StaticBatcher) see an entity's transform before its bounds.
+class SceneLoader
+{
+public:
+    struct Stats {
+        size_t Entities   = 0; // in use, by the last Load
+        size_t Components = 0;
+        float  DecodeMs   = 0.0f;
+        float  InsertMs   = 0.0f;
+    };
+
+    explicit SceneLoader(entt::registry& registry);
+
+    SceneLoader(const SceneLoader&) = delete;
+    SceneLoader& operator=(const SceneLoader&) = delete;
+
+    // false (and logged, nothing loaded) if the file is unreadable or malformed, or
+    // refers to entities outside its entity pool or assets outside the table
+    bool Load(const std::string& path, const SnapshotAssets& assets);
+    bool Load(const void* data, size_t size, const SnapshotAssets& assets);
+
+    // the local entity an archived one was loaded as, entt::null if none
+    entt::entity Map(entt::entity archived) const;
+
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    entt::registry&         m_Registry;
+    entt::continuous_loader m_Loader;
+    Stats                   m_Stats;
+};
+
+#endif
@@ -0,0 +1,397 @@
+// scene_target.cpp
+#include "scene_target.h"
+#include "gpu_memory.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // the controller ignores errors inside this band so the scale settles instead of hunting
+    constexpr float DEAD_BAND  = 0.05f;
+    // react quickly to overload, creep back up to avoid oscillating
+    constexpr float RATE_DOWN  = 0.5f;
+    constexpr float RATE_UP    = 0.1f;
+    constexpr float SCALE_STEP = 1.0f / 64.0f;
+
+    float Halton(unsigned index, unsigned base)
+    {
+        float result = 0.0f;
+        float f      = 1.0f;
+        while (index > 0)
+        {
+            f      /= (float)base;
+            result += f * (float)(index % base);
+            index  /= base;
+        }
+        return result;
+    }
+
+    unsigned int CreateTexture(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    void CheckComplete(const char* name)
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            LOG_ERROR("ERROR::SCENE_TARGET::%s framebuffer is not complete", name);
+    }
+}
+
+SceneTarget::SceneTarget(const SceneTargetSettings& settings, const std::string& shaderDirectory)
+    : m_PresentShader(shaderDirectory + "/post.vert", shaderDirectory + "/present.frag"),
+      m_FxaaShader(shaderDirectory + "/post.vert", shaderDirectory + "/fxaa.frag"),
+      m_TaaShader(shaderDirectory + "/post.vert", shaderDirectory + "/taa.frag")
+{
+    Configure(settings);
+
+    // the fullscreen triangle is generated from gl_VertexID, core profile still wants a VAO bound
+    glGenVertexArrays(1, &m_EmptyVAO);
+    glGenQueries(SCENE_TIMER_QUERIES, m_Queries);
+
+    m_PresentShader.use();
+    m_PresentShader.setInt("source", 0);
+    m_FxaaShader.use();
+    m_FxaaShader.setInt("source", 0);
+    m_TaaShader.use();
+    m_TaaShader.setInt("source", 0);
+    m_TaaShader.setInt("sourceDepth", 1);
+    m_TaaShader.setInt("history", 2);
+}
+
+SceneTarget::~SceneTarget()
+{
+    Release();
+    glDeleteQueries(SCENE_TIMER_QUERIES, m_Queries);
+    glDeleteVertexArrays(1, &m_EmptyVAO);
+    glDeleteProgram(m_PresentShader.ID);
+    glDeleteProgram(m_FxaaShader.ID);
+    glDeleteProgram(m_TaaShader.ID);
+}
+
+void SceneTarget::Configure(const SceneTargetSettings& settings)
+{
+    // only the TAA history is allocated here, the other targets follow the settings on their own
+    bool reallocate = settings.Mode != m_Settings.Mode;
+
+    m_Settings = settings;
+    m_Settings.MaxScale = std::clamp(m_Settings.MaxScale, 0.1f, 1.0f);
+    m_Settings.MinScale = std::clamp(m_Settings.MinScale, 0.1f, m_Settings.MaxScale);
+    m_Settings.TaaBlend = std::clamp(m_Settings.TaaBlend, 0.01f, 1.0f);
+
+    if (m_Settings.MsaaSamples > 1)
+    {
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        m_Settings.MsaaSamples = std::min(m_Settings.MsaaSamples, (int)maxSamples);
+    }
+
+    m_Scale = m_Settings.DynamicScale ? std::clamp(m_Scale, m_Settings.MinScale, m_Settings.MaxScale)
+                                      : m_Settings.MaxScale;
+    m_HistoryValid = false;
+
+    // the passes that write the backbuffer
+    m_PresentShader.use();
+    m_PresentShader.setBool("encodeSrgb", !m_Settings.SrgbBackbuffer);
+    m_FxaaShader.use();
+    m_FxaaShader.setBool("encodeSrgb", !m_Settings.SrgbBackbuffer);
+
+    if (reallocate && m_Width > 0)
+    {
+        int width = m_Width, height = m_Height;
+        Release();
+        Allocate(width, height);
+    }
+}
+
+void SceneTarget::Allocate(int width, int height)
+{
+    m_Width  = width;
+    m_Height = height;
+
+    if (m_Settings.Mode == AntiAliasing::TAA)
+    {
+        glGenFramebuffers(2, m_HistoryFBO);
+        for (int i = 0; i < 2; ++i)
+        {
+            m_History[i] = CreateTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_HistoryFBO[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_History[i], 0);
+            CheckComplete("history");
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        m_TrackedBytes = 2 * GpuMemory::TextureBytes(GL_RGBA16F, width, height);
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget, int64_t(m_TrackedBytes));
+    }
+
+    m_HistoryValid = false;
+}
+
+void SceneTarget::Release()
+{
+    glDeleteFramebuffers(2, m_HistoryFBO);
+    glDeleteTextures(2, m_History);
+
+    m_HistoryFBO[0] = m_HistoryFBO[1] = m_History[0] = m_History[1] = 0;
+    m_Width = m_Height = 0;
+
+    GpuMemory::Track(GpuMemoryCategory::RenderTarget, -int64_t(m_TrackedBytes));
+    m_TrackedBytes = 0;
+}
+
+void SceneTarget::ReadTimers()
+{
+    // oldest first, whatever has landed by now feeds the controller
+    for (int i = 1; i <= SCENE_TIMER_QUERIES; ++i)
+    {
+        int slot = (m_QueryIndex + i) % SCENE_TIMER_QUERIES;
+        if (!m_QueryPending[slot])
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &elapsed);
+        m_GpuMs = (float)(elapsed / 1.0e6);
+        m_QueryPending[slot] = false;
+        UpdateScale();
+    }
+}
+
+void SceneTarget::UpdateScale()
+{
+    if (!m_Settings.DynamicScale || m_GpuMs <= 0.0f)
+        return;
+
+    float ratio = m_Settings.TargetGpuMs / m_GpuMs;
+    if (std::fabs(ratio - 1.0f) < DEAD_BAND)
+        return;
+
+    // cost follows the pixel count, i.e. the square of the per-axis scale
+    float desired = m_Scale * std::sqrt(ratio);
+    float rate    = desired < m_Scale ? RATE_DOWN : RATE_UP;
+    float scale   = m_Scale + (desired - m_Scale) * rate;
+
+    scale   = std::round(scale / SCALE_STEP) * SCALE_STEP;
+    m_Scale = std::clamp(scale, m_Settings.MinScale, m_Settings.MaxScale);
+}
+
+glm::mat4 SceneTarget::Begin(int outputWidth, int outputHeight, const glm::mat4& view, const glm::mat4& projection)
+{
+    outputWidth  = std::max(outputWidth, 1);
+    outputHeight = std::max(outputHeight, 1);
+    if (outputWidth != m_Width || outputHeight != m_Height)
+    {
+        Release();
+        Allocate(outputWidth, outputHeight);
+    }
+
+    ReadTimers();
+
+    m_RenderWidth  = std::max(1, (int)std::lround(m_Width  * m_Scale));
+    m_RenderHeight = std::max(1, (int)std::lround(m_Height * m_Scale));
+
+    // the query still in flight from SCENE_TIMER_QUERIES frames ago is dropped, not waited on
+    m_QueryIndex = (m_QueryIndex + 1) % SCENE_TIMER_QUERIES;
+    glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_QueryIndex]);
+    m_QueryPending[m_QueryIndex] = true;
+
+    m_PreviousViewProjection = m_ViewProjection;
+    m_ViewProjection         = projection * view;
+
+    if (m_Settings.Mode != AntiAliasing::TAA)
+    {
+        m_Jitter = glm::vec2(0.0f);
+        return projection;
+    }
+
+    // Halton(2,3) sub-pixel offsets, centered on the pixel
+    unsigned index = (m_FrameIndex++ % 8) + 1;
+    m_Jitter = glm::vec2(Halton(index, 2) - 0.5f, Halton(index, 3) - 0.5f);
+
+    glm::mat4 jittered = projection;
+    jittered[2][0] += 2.0f * m_Jitter.x / (float)m_RenderWidth;
+    jittered[2][1] += 2.0f * m_Jitter.y / (float)m_RenderHeight;
+    return jittered;
+}
+
+void SceneTarget::DrawFullscreen(const Shader& shader, unsigned int source) const
+{
+    glm::vec2 size((float)m_Width, (float)m_Height);
+    glm::vec2 rendered((float)m_RenderWidth, (float)m_RenderHeight);
+
+    shader.setVec2("uvScale", rendered / size);
+    shader.setVec2("uvMax",   (rendered - glm::vec2(0.5f)) / size);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glBindVertexArray(m_EmptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void SceneTarget::SetupScenePass(FrameGraph::Builder& builder)
+{
+    m_Color = m_Depth = m_MsaaColor = m_MsaaDepth = FRAME_GRAPH_INVALID;
+
+    FrameGraphTextureDesc color;
+    color.Width  = m_Width;
+    color.Height = m_Height;
+    color.Format = GL_RGBA16F;
+
+    FrameGraphTextureDesc depth = color;
+    depth.Format = GL_DEPTH_COMPONENT32F;
+
+    m_Color = builder.Create("scene color", color);
+    // with MSAA the single sample depth only exists when TAA reads it back
+    bool msaa = m_Settings.MsaaSamples > 1;
+    if (!msaa || m_Settings.Mode == AntiAliasing::TAA)
+        m_Depth = builder.Create("scene depth", depth);
+
+    if (msaa)
+    {
+        color.Samples = depth.Samples = m_Settings.MsaaSamples;
+        m_MsaaColor = builder.Write(builder.Create("scene color msaa", color));
+        m_MsaaDepth = builder.Write(builder.Create("scene depth msaa", depth));
+    }
+    else
+    {
+        builder.Write(m_Color);
+        builder.Write(m_Depth);
+    }
+
+    FrameGraphPassState state;
+    state.Clear = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
+    builder.SetState(state);
+}
+
+void SceneTarget::BeginScenePass()
+{
+    // the graph sized the viewport to the whole target
+    glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+}
+
+void SceneTarget::EndScenePass()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void SceneTarget::AddPostPasses(FrameGraph& graph, FrameGraphResource backbuffer)
+{
+    const bool taa = m_Settings.Mode == AntiAliasing::TAA;
+
+    if (m_MsaaColor != FRAME_GRAPH_INVALID)
+    {
+        graph.AddPass("scene resolve",
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(m_MsaaColor, FrameGraphAccess::Transfer);
+                builder.Write(m_Color, FrameGraphAccess::Transfer);
+                // only TAA reads depth back
+                if (taa)
+                {
+                    builder.Read(m_MsaaDepth, FrameGraphAccess::Transfer);
+                    builder.Write(m_Depth, FrameGraphAccess::Transfer);
+                }
+            },
+            [this, taa](const FrameGraph::Context& context) {
+                GLuint source = taa ? context.Framebuffer({ m_MsaaColor, m_MsaaDepth }) : context.Framebuffer({ m_MsaaColor });
+                GLuint target = taa ? context.Framebuffer({ m_Color, m_Depth })         : context.Framebuffer({ m_Color });
+
+                GLbitfield mask = GL_COLOR_BUFFER_BIT;
+                if (taa)
+                    mask |= GL_DEPTH_BUFFER_BIT;
+
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+                glBlitFramebuffer(0, 0, m_RenderWidth, m_RenderHeight,
+                                  0, 0, m_RenderWidth, m_RenderHeight, mask, GL_NEAREST);
+            });
+    }
+
+    FrameGraphPassState post;
+    post.DepthTest  = false;
+    post.DepthWrite = false;
+
+    FrameGraphResource presented = m_Color;
+    if (taa)
+    {
+        FrameGraphTextureDesc desc;
+        desc.Width  = m_Width;
+        desc.Height = m_Height;
+        desc.Format = GL_RGBA16F;
+        m_HistoryIn  = graph.Import("taa history", desc, m_History[m_HistoryIndex]);
+        m_HistoryOut = graph.Import("taa history", desc, m_History[m_HistoryIndex ^ 1]);
+        presented    = m_HistoryOut;
+
+        graph.AddPass("taa",
+            [&](FrameGraph::Builder& builder) {
+                builder.Read(m_Color);
+                builder.Read(m_Depth);
+                builder.Read(m_HistoryIn);
+                // the history keeps its own framebuffers
+                builder.Write(m_HistoryOut, FrameGraphAccess::External);
+                builder.SetState(post);
+            },
+            [this](const FrameGraph::Context& context) {
+                int next = m_HistoryIndex ^ 1;
+                glm::vec2 size((float)m_Width, (float)m_Height);
+
+                glBindFramebuffer(GL_FRAMEBUFFER, m_HistoryFBO[next]);
+                glViewport(0, 0, m_Width, m_Height);
+
+                m_TaaShader.use();
+                m_TaaShader.setVec2("jitter", m_Jitter / size);
+                m_TaaShader.setMat4("reprojection", m_PreviousViewProjection * glm::inverse(m_ViewProjection));
+                m_TaaShader.setFloat("blend", m_Settings.TaaBlend);
+                m_TaaShader.setBool("historyValid", m_HistoryValid);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, context.Texture(m_Depth));
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, m_History[m_HistoryIndex]);
+                DrawFullscreen(m_TaaShader, context.Texture(m_Color));
+
+                m_HistoryIndex = next;
+                m_HistoryValid = true;
+            });
+    }
+
+    graph.AddPass("present",
+        [&](FrameGraph::Builder& builder) {
+            builder.Read(presented);
+            builder.Write(backbuffer);
+            builder.SetState(post);
+        },
+        [this, presented](const FrameGraph::Context& context) {
+            if (m_Settings.Mode == AntiAliasing::TAA)
+            {
+                // the resolve is already at output size, present copies it 1:1
+                m_PresentShader.use();
+                m_PresentShader.setVec2("uvScale", glm::vec2(1.0f));
+                m_PresentShader.setVec2("uvMax",   glm::vec2(1.0f));
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, context.Texture(presented));
+                glBindVertexArray(m_EmptyVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+            else
+            {
+                const Shader& shader = m_Settings.Mode == AntiAliasing::FXAA ? m_FxaaShader : m_PresentShader;
+                shader.use();
+                DrawFullscreen(shader, context.Texture(presented));
+            }
+            glBindVertexArray(0);
+        });
+}
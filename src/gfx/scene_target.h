@@ -0,0 +1,134 @@
+#ifndef SCENE_TARGET_H
+#define SCENE_TARGET_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "shader.h"
+#include "frame_graph.h"
+
+#define SCENE_TIMER_QUERIES 4
+
+enum class AntiAliasing {
+    None, // bilinear upscale only
+    FXAA,
+    TAA   // jittered projection, reprojected history with neighbourhood clamping
+};
+
+struct SceneTargetSettings {
+    // GPU time the scene (shadows + main pass) should take, the render scale follows it
+    float        TargetGpuMs  = 14.0f;
+    // render scale bounds per axis, the target is allocated at output size so 1 is the maximum
+    float        MinScale     = 0.5f;
+    float        MaxScale     = 1.0f;
+    bool         DynamicScale = true;
+    AntiAliasing Mode         = AntiAliasing::FXAA;
+    // MSAA samples for the offscreen scene target, 0 or 1 disables it
+    int          MsaaSamples  = 0;
+    // TAA: weight of the current frame in the history blend
+    float        TaaBlend     = 0.1f;
+    // whether the backbuffer encodes to sRGB on write (Window::isSrgbBackbuffer),
+    // otherwise the present pass encodes
+    bool         SrgbBackbuffer = true;
+};
+
+// Offscreen target the scene is rendered into at a fraction of the output size.
+// GPU time of the scene is measured with a ring of timer queries, and the scale
+// follows it to hold TargetGpuMs. The targets keep the output size and only the
+// viewport shrinks, so scale changes never reallocate. The color, depth and MSAA
+// targets are frame graph transients; only the TAA history is owned here since it
+// has to survive into the next frame.
+class SceneTarget
+{
+public:
+    SceneTarget(const SceneTargetSettings& settings = SceneTargetSettings(),
+                const std::string& shaderDirectory = "../res/shaders");
+    ~SceneTarget();
+
+    SceneTarget(const SceneTarget&) = delete;
+    SceneTarget& operator=(const SceneTarget&) = delete;
+
+    void Configure(const SceneTargetSettings& settings);
+    const SceneTargetSettings& GetSettings() const { return m_Settings; }
+
+    // pick this frame's scale, (re)allocating for a new output size, and start timing.
+    // Returns the projection to render with (jittered when TAA is on).
+    glm::mat4 Begin(int outputWidth, int outputHeight, const glm::mat4& view, const glm::mat4& projection);
+
+    // declare the scene pass, which runs draw() into the cleared target at the current
+    // scale (setup declares what else it reads), then the MSAA resolve, TAA and the
+    // upscale into backbuffer
+    template <typename Setup, typename Draw>
+    void AddPasses(FrameGraph& graph, FrameGraphResource backbuffer, Setup&& setup, Draw&& draw)
+    {
+        graph.AddPass("scene",
+            [&](FrameGraph::Builder& builder) {
+                setup(builder);
+                SetupScenePass(builder);
+            },
+            [this, draw](const FrameGraph::Context&) {
+                BeginScenePass();
+                draw();
+                EndScenePass();
+            });
+        AddPostPasses(graph, backbuffer);
+    }
+
+    float GetScale()        const { return m_Scale; }
+    float GetGpuTimeMs()    const { return m_GpuMs; }
+    int   GetRenderWidth()  const { return m_RenderWidth; }
+    int   GetRenderHeight() const { return m_RenderHeight; }
+
+private:
+    SceneTargetSettings m_Settings;
+
+    Shader m_PresentShader;
+    Shader m_FxaaShader;
+    Shader m_TaaShader;
+
+    int m_Width = 0, m_Height = 0;             // output size, textures are allocated at this size
+    int m_RenderWidth = 0, m_RenderHeight = 0; // scaled region actually rendered
+    float m_Scale = 1.0f;
+
+    // this frame's graph resources
+    FrameGraphResource m_Color     = FRAME_GRAPH_INVALID; // single sample, sampled by the post passes
+    FrameGraphResource m_Depth     = FRAME_GRAPH_INVALID; // only when something needs it past the scene pass
+    FrameGraphResource m_MsaaColor = FRAME_GRAPH_INVALID;
+    FrameGraphResource m_MsaaDepth = FRAME_GRAPH_INVALID;
+    FrameGraphResource m_HistoryIn  = FRAME_GRAPH_INVALID;
+    FrameGraphResource m_HistoryOut = FRAME_GRAPH_INVALID;
+
+    unsigned int m_HistoryFBO[2] = { 0, 0 };
+    unsigned int m_History[2]    = { 0, 0 };
+    unsigned int m_EmptyVAO     = 0;
+    size_t       m_TrackedBytes = 0; // history memory reported to GpuMemory
+    int          m_HistoryIndex = 0;
+    bool         m_HistoryValid = false;
+
+    // GPU timing, read back a few frames late so nothing stalls
+    unsigned int m_Queries[SCENE_TIMER_QUERIES] = {};
+    bool         m_QueryPending[SCENE_TIMER_QUERIES] = {};
+    int          m_QueryIndex = 0;
+    float        m_GpuMs      = 0.0f;
+
+    // TAA camera state
+    glm::mat4 m_ViewProjection         = glm::mat4(1.0f);
+    glm::mat4 m_PreviousViewProjection = glm::mat4(1.0f);
+    glm::vec2 m_Jitter                 = glm::vec2(0.0f); // in render pixels
+    unsigned  m_FrameIndex             = 0;
+
+    void Allocate(int width, int height);
+    void Release();
+    void ReadTimers();
+    void UpdateScale();
+    void DrawFullscreen(const Shader& shader, unsigned int source) const;
+
+    void SetupScenePass(FrameGraph::Builder& builder);
+    void BeginScenePass();
+    void EndScenePass();
+    void AddPostPasses(FrameGraph& graph, FrameGraphResource backbuffer);
+};
+
+#endif
@@ -0,0 +1,326 @@
+// screen_capture.cpp
+#include "screen_capture.h"
+#include "gpu_memory.h"
+#include "../core/log.hpp"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+    // how long shutdown waits for a readback still on the GPU
+    constexpr GLuint64 FINISH_TIMEOUT_NS = 1000000000ull;
+
+    bool Signalled(GLenum status)
+    {
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+}
+
+ScreenCapture::ScreenCapture(const ScreenCaptureSettings& settings)
+    : m_Settings(settings)
+{
+    m_Settings.Readbacks     = std::max(m_Settings.Readbacks, 2);
+    m_Settings.EncoderFrames = std::max(m_Settings.EncoderFrames, 1);
+    stbi_write_png_compression_level = std::clamp(m_Settings.PngCompression, 0, 9);
+
+    m_Readbacks.resize(m_Settings.Readbacks);
+    for (Readback& readback : m_Readbacks)
+        glGenBuffers(1, &readback.buffer);
+
+    m_Frames.resize(m_Settings.EncoderFrames);
+    m_Queue.resize(m_Frames.size());
+    m_FreeFrames.reserve(m_Frames.size());
+    for (size_t i = m_Frames.size(); i-- > 0;)
+        m_FreeFrames.push_back(i);
+
+    m_Encoder = std::thread(&ScreenCapture::EncoderLoop, this);
+}
+
+ScreenCapture::~ScreenCapture()
+{
+    StopRecording();
+    m_Screenshot.clear();
+
+    // map what is still on the GPU, then unmap once the encoder has copied it out
+    Collect(true);
+    Collect(true);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Quit = true;
+    }
+    m_Wake.notify_one();
+    m_Encoder.join();
+
+    for (Readback& readback : m_Readbacks)
+    {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        glDeleteBuffers(1, &readback.buffer);
+        GpuMemory::Track(GpuMemoryCategory::Readback, -int64_t(readback.bytes));
+    }
+}
+
+bool ScreenCapture::StartRecording(const std::string& directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        LOG_ERROR("ERROR::SCREEN_CAPTURE::Cannot create %s: %s", directory.c_str(), error.message().c_str());
+        return false;
+    }
+
+    m_Directory = directory;
+    m_Sequence  = 0;
+    m_Recording = true;
+    LOG_INFO("SCREEN_CAPTURE::Recording frames to %s", directory.c_str());
+    return true;
+}
+
+void ScreenCapture::StopRecording()
+{
+    if (!m_Recording)
+        return;
+    m_Recording = false;
+
+    // frames still in flight keep their paths and are written as usual
+    ScreenCaptureStats stats = GetStats();
+    LOG_INFO("SCREEN_CAPTURE::Stopped after %llu frames, %llu written, %llu dropped so far",
+             (unsigned long long)m_Sequence, (unsigned long long)stats.Written, (unsigned long long)stats.Dropped);
+}
+
+void ScreenCapture::Screenshot(const std::string& path)
+{
+    m_Screenshot = path;
+}
+
+ScreenCaptureStats ScreenCapture::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stats;
+}
+
+void ScreenCapture::Capture(int width, int height)
+{
+    Collect(false);
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (!m_Screenshot.empty())
+    {
+        Request(width, height, m_Screenshot.c_str(), ScreenCaptureFormat::PNG);
+        m_Screenshot.clear();
+    }
+
+    if (m_Recording)
+    {
+        // on the stack, a steady recording allocates nothing on this thread
+        char path[1024];
+        if (m_Settings.Format == ScreenCaptureFormat::PNG)
+            std::snprintf(path, sizeof(path), "%s/frame_%06llu.png", m_Directory.c_str(),
+                          (unsigned long long)m_Sequence);
+        else
+            std::snprintf(path, sizeof(path), "%s/frame_%06llu_%dx%d.rgba", m_Directory.c_str(),
+                          (unsigned long long)m_Sequence, width, height);
+        ++m_Sequence;
+        Request(width, height, path, m_Settings.Format);
+    }
+}
+
+void ScreenCapture::Request(int width, int height, const char* path, ScreenCaptureFormat format)
+{
+    Readback& readback = m_Readbacks[m_Next];
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        ++m_Stats.Requested;
+        // the oldest readback is still busy, so all of them are
+        if (readback.state != ReadbackState::Idle)
+        {
+            ++m_Stats.Dropped;
+            return;
+        }
+    }
+    m_Next = (m_Next + 1) % m_Readbacks.size();
+
+    const size_t bytes = size_t(width) * size_t(height) * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (bytes != readback.bytes)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        GpuMemory::Track(GpuMemoryCategory::Readback, int64_t(bytes) - int64_t(readback.bytes));
+        readback.bytes = bytes;
+    }
+
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+
+    // BGRA is what most drivers keep the backbuffer in, the encoder swizzles it
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+
+    readback.fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.state  = ReadbackState::Reading;
+    readback.width  = width;
+    readback.height = height;
+    readback.path.assign(path);
+    readback.format = format;
+}
+
+void ScreenCapture::Collect(bool wait)
+{
+    // oldest first: copies finish and fences signal in issue order
+    for (size_t i = 0; i < m_Readbacks.size(); ++i)
+    {
+        const size_t index    = (m_Next + i) % m_Readbacks.size();
+        Readback&    readback = m_Readbacks[index];
+
+        if (readback.state == ReadbackState::Copying)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                if (wait)
+                    m_Progress.wait(lock, [&readback] { return readback.copied; });
+                if (!readback.copied)
+                    break;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            readback.state = ReadbackState::Idle;
+            continue;
+        }
+
+        if (readback.state != ReadbackState::Reading)
+            continue;
+
+        GLenum status = wait ? glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, FINISH_TIMEOUT_NS)
+                             : glClientWaitSync(readback.fence, 0, 0);
+        if (!Signalled(status) && !wait)
+            break;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        size_t frame = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if (wait && Signalled(status))
+                m_Progress.wait(lock, [this] { return !m_FreeFrames.empty(); });
+            if (!Signalled(status) || m_FreeFrames.empty())
+            {
+                // the encoder is behind; dropping keeps the readbacks moving
+                ++m_Stats.Dropped;
+                readback.state = ReadbackState::Idle;
+                continue;
+            }
+            frame = m_FreeFrames.back();
+            m_FreeFrames.pop_back();
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback.bytes, GL_MAP_READ_BIT);
+        if (!mapped)
+        {
+            LOG_ERROR("ERROR::SCREEN_CAPTURE::Mapping a readback failed");
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_FreeFrames.push_back(frame);
+            ++m_Stats.Failed;
+            readback.state = ReadbackState::Idle;
+            continue;
+        }
+
+        // the frame is ours until it is queued
+        EncodeFrame& encode = m_Frames[frame];
+        encode.source   = static_cast<const unsigned char*>(mapped);
+        encode.readback = index;
+        encode.width    = readback.width;
+        encode.height   = readback.height;
+        encode.path.swap(readback.path);
+        encode.format   = readback.format;
+
+        readback.state = ReadbackState::Copying;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            readback.copied = false;
+            m_Queue[(m_QueueHead + m_QueueCount) % m_Queue.size()] = frame;
+            ++m_QueueCount;
+        }
+        m_Wake.notify_one();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ScreenCapture::EncoderLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_Wake.wait(lock, [this] { return m_QueueCount > 0 || m_Quit; });
+        // quitting only once the queue is drained
+        if (m_QueueCount == 0)
+            return;
+
+        const size_t index = m_Queue[m_QueueHead];
+        m_QueueHead = (m_QueueHead + 1) % m_Queue.size();
+        --m_QueueCount;
+        lock.unlock();
+
+        // copy out of the mapped buffer, flipped to top row first and swizzled to RGBA;
+        // the backbuffer's alpha is meaningless, so it is written opaque
+        EncodeFrame& frame = m_Frames[index];
+        const size_t row   = size_t(frame.width) * 4;
+        frame.pixels.resize(row * frame.height);
+        for (int y = 0; y < frame.height; ++y)
+        {
+            const unsigned char* source = frame.source + size_t(frame.height - 1 - y) * row;
+            unsigned char*       target = frame.pixels.data() + size_t(y) * row;
+            for (int x = 0; x < frame.width; ++x, source += 4, target += 4)
+            {
+                target[0] = source[2];
+                target[1] = source[1];
+                target[2] = source[0];
+                target[3] = 255;
+            }
+        }
+
+        lock.lock();
+        frame.source = nullptr;
+        m_Readbacks[frame.readback].copied = true;
+        m_Progress.notify_all();
+        lock.unlock();
+
+        bool written = Encode(frame);
+        if (!written)
+            LOG_ERROR("ERROR::SCREEN_CAPTURE::Cannot write %s", frame.path.c_str());
+
+        lock.lock();
+        if (written)
+            ++m_Stats.Written;
+        else
+            ++m_Stats.Failed;
+        m_FreeFrames.push_back(index);
+        m_Progress.notify_all();
+    }
+}
+
+bool ScreenCapture::Encode(EncodeFrame& frame) const
+{
+    if (frame.format == ScreenCaptureFormat::PNG)
+        return stbi_write_png(frame.path.c_str(), frame.width, frame.height, 4, frame.pixels.data(),
+                              frame.width * 4) != 0;
+
+    FILE* file = std::fopen(frame.path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), file) == frame.pixels.size();
+    return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,128 @@
+#ifndef SCREEN_CAPTURE_H
+#define SCREEN_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ScreenCaptureFormat {
+    PNG,
+    Raw  // RGBA8 rows top to bottom, the size is in the file name; cheap enough for every frame
+};
+
+struct ScreenCaptureSettings {
+    // of recorded frames, screenshots are always PNG
+    ScreenCaptureFormat Format = ScreenCaptureFormat::PNG;
+    // pixel pack buffers in flight. A readback stays busy from glReadPixels until
+    // the encoder has copied it out, a few frames, so 60 fps recording needs ~6
+    int Readbacks      = 6;
+    // frames the encoder may have queued; more are dropped rather than waited for
+    int EncoderFrames  = 8;
+    // stb_image_write zlib level, low keeps PNG recording close to frame rate
+    int PngCompression = 1;
+};
+
+struct ScreenCaptureStats {
+    uint64_t Requested = 0; // frames asked for (recorded or screenshots)
+    uint64_t Written   = 0;
+    uint64_t Dropped   = 0; // no free readback or encoder frame when one was needed
+    uint64_t Failed    = 0; // the file could not be written
+};
+
+// Reads the backbuffer back without stalling: glReadPixels goes into a ring of
+// pixel pack buffers, each fenced, and a buffer is only mapped once its fence has
+// signalled a few frames later. The encoder thread copies the mapped pixels out
+// (flipping and swizzling BGRA on the way) and the buffer is unmapped on a later
+// frame, so the render thread only issues the read, maps and unmaps. Encoding
+// runs on its own thread rather than the job system, since a continuous recording
+// would otherwise keep a worker busy every frame. Frames are never waited for:
+// if the GPU or the encoder falls behind, captures are dropped and counted.
+class ScreenCapture
+{
+public:
+    explicit ScreenCapture(const ScreenCaptureSettings& settings = ScreenCaptureSettings());
+    // finishes every frame still in flight
+    ~ScreenCapture();
+
+    ScreenCapture(const ScreenCapture&) = delete;
+    ScreenCapture& operator=(const ScreenCapture&) = delete;
+
+    // record every frame into directory as frame_000000.png (or .rgba), numbered from 0
+    bool StartRecording(const std::string& directory);
+    void StopRecording();
+    bool IsRecording() const { return m_Recording; }
+
+    // write the next captured frame to path, as a PNG
+    void Screenshot(const std::string& path);
+
+    // once per frame, after the last draw into the backbuffer that should be captured
+    // (before overlays such as the HUD) and before the swap: starts this frame's
+    // readback if one is wanted and moves finished ones along
+    void Capture(int width, int height);
+
+    ScreenCaptureStats GetStats() const;
+
+private:
+    enum class ReadbackState { Idle, Reading, Copying };
+
+    struct Readback {
+        unsigned int  buffer = 0;
+        size_t        bytes  = 0; // allocated
+        GLsync        fence  = nullptr;
+        ReadbackState state  = ReadbackState::Idle;
+        int           width  = 0;
+        int           height = 0;
+        std::string   path;           // capacity is reused, assigning does not allocate once warm
+        ScreenCaptureFormat format = ScreenCaptureFormat::PNG;
+        bool          copied = false; // guarded by m_Mutex
+    };
+
+    // a frame on its way to disk, owned by the encoder between queueing and release
+    struct EncodeFrame {
+        std::vector<unsigned char> pixels; // RGBA8, top row first
+        const unsigned char*       source = nullptr; // mapped readback, BGRA bottom row first
+        size_t                     readback = 0;
+        int                        width  = 0;
+        int                        height = 0;
+        std::string                path;
+        ScreenCaptureFormat        format = ScreenCaptureFormat::PNG;
+    };
+
+    ScreenCaptureSettings m_Settings;
+
+    // render thread only
+    std::vector<Readback> m_Readbacks;
+    size_t                m_Next = 0; // oldest readback, the next one to reuse
+    bool                  m_Recording = false;
+    std::string           m_Directory;
+    uint64_t              m_Sequence = 0;
+    std::string           m_Screenshot; // pending screenshot path, empty if none
+
+    // shared with the encoder thread
+    mutable std::mutex      m_Mutex;
+    std::condition_variable m_Wake;     // a frame was queued, or quit
+    std::condition_variable m_Progress; // a copy finished or a frame was released
+    std::vector<EncodeFrame> m_Frames;
+    std::vector<size_t>      m_FreeFrames;
+    std::vector<size_t>      m_Queue;     // ring of frame indices
+    size_t                   m_QueueHead  = 0;
+    size_t                   m_QueueCount = 0;
+    ScreenCaptureStats       m_Stats;
+    bool                     m_Quit = false;
+
+    std::thread m_Encoder;
+
+    void Request(int width, int height, const char* path, ScreenCaptureFormat format);
+    // map readbacks whose fence has signalled, unmap the ones the encoder is done with
+    void Collect(bool wait);
+    void EncoderLoop();
+    bool Encode(EncodeFrame& frame) const;
+};
+
+#endif
@@ -0,0 +1,82 @@
+// shader_variants.cpp
+#include "shader_variants.h"
+#include "model.h"
+
+namespace
+{
+    const char* const FEATURE_DEFINES[SHADER_FEATURE_COUNT] = {
+        "HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP", "ALPHA_TEST", "CROSSFADE"
+    };
+
+    constexpr uint32_t FEATURE_MASK = (1u << SHADER_FEATURE_COUNT) - 1;
+}
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+                               const std::string& defines)
+    : m_VertexPath(vertexPath), m_FragmentPath(fragmentPath), m_Defines(defines)
+{
+}
+
+ShaderVariants::~ShaderVariants()
+{
+    for (const auto& variant : m_Variants)
+        if (variant)
+            glDeleteProgram(variant->ID);
+}
+
+Shader* ShaderVariants::Get(uint32_t features)
+{
+    std::unique_ptr<Shader>& variant = m_Variants[features & FEATURE_MASK];
+    if (!variant)
+    {
+        variant.reset(new Shader(m_VertexPath, m_FragmentPath, m_Defines + Defines(features & FEATURE_MASK)));
+        LOG_DEBUG("SUCCESS::SHADER_VARIANTS::compiled %s variant 0x%x", m_FragmentPath.c_str(), features & FEATURE_MASK);
+
+        if (m_Initializer)
+        {
+            variant->use();
+            m_Initializer(*variant);
+        }
+    }
+    return variant.get();
+}
+
+Shader* ShaderVariants::Find(uint32_t features) const
+{
+    return m_Variants[features & FEATURE_MASK].get();
+}
+
+void ShaderVariants::Preload(const Model& model, uint32_t extraFeatures)
+{
+    for (const Mesh& mesh : model.GetMeshes())
+    {
+        Get(mesh.features);
+        if (extraFeatures)
+            Get(mesh.features | extraFeatures);
+    }
+}
+
+void ShaderVariants::SetInitializer(std::function<void(const Shader&)> initializer)
+{
+    m_Initializer = std::move(initializer);
+    ForEach([&](const Shader& shader) {
+        shader.use();
+        m_Initializer(shader);
+    });
+}
+
+size_t ShaderVariants::GetCount() const
+{
+    size_t count = 0;
+    ForEach([&](const Shader&) { ++count; });
+    return count;
+}
+
+std::string ShaderVariants::Defines(uint32_t features)
+{
+    std::string defines;
+    for (int i = 0; i < SHADER_FEATURE_COUNT; ++i)
+        if (features & (1u << i))
+            defines += std::string("#define ") + FEATURE_DEFINES[i] + "\n";
+    return defines;
+}
@@ -0,0 +1,75 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "shader.h"
+
+// material features a program can be specialized for, derived from the imported
+// material (see Mesh::features). Each set bit becomes a #define in the variant.
+#define SHADER_FEATURE_DIFFUSE_MAP  (1u << 0) // HAS_DIFFUSE_MAP
+#define SHADER_FEATURE_SPECULAR_MAP (1u << 1) // HAS_SPECULAR_MAP
+#define SHADER_FEATURE_NORMAL_MAP   (1u << 2) // HAS_NORMAL_MAP
+#define SHADER_FEATURE_ALPHA_TEST   (1u << 3) // ALPHA_TEST, cutout on the diffuse alpha
+#define SHADER_FEATURE_CROSSFADE    (1u << 4) // CROSSFADE, dithered out towards an impostor (see impostor.h)
+#define SHADER_FEATURE_COUNT        5
+
+class Model;
+
+// Specialized programs of one vertex/fragment pair, one per combination of feature
+// bits, so a material only runs the code paths it needs. The defines are injected
+// right after #version; variants compile on first use and are cached by their bits.
+class ShaderVariants
+{
+public:
+    // defines go into every variant ahead of the feature defines
+    ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+                   const std::string& defines = std::string());
+    ~ShaderVariants();
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // the variant for features, compiled if this is the first time it is asked for
+    Shader* Get(uint32_t features);
+    // the variant for features if it is compiled already, null otherwise. Compiles
+    // nothing, so unlike Get it is safe off the GL thread.
+    Shader* Find(uint32_t features) const;
+    // compile every variant the model's meshes use now rather than mid-frame,
+    // also with extraFeatures added when that is non-zero
+    void Preload(const Model& model, uint32_t extraFeatures = 0);
+
+    // runs once per variant right after it links (constant uniforms), and right
+    // away for the variants that already exist
+    void SetInitializer(std::function<void(const Shader&)> initializer);
+
+    // per-frame uniforms have to reach every compiled variant
+    template <typename Function>
+    void ForEach(Function&& function) const
+    {
+        for (const auto& variant : m_Variants)
+            if (variant)
+                function(*variant);
+    }
+
+    size_t GetCount() const;
+
+    // the #define block for a set of feature bits
+    static std::string Defines(uint32_t features);
+
+private:
+    std::string m_VertexPath;
+    std::string m_FragmentPath;
+    std::string m_Defines;
+    std::unique_ptr<Shader> m_Variants[1u << SHADER_FEATURE_COUNT];
+    std::function<void(const Shader&)> m_Initializer;
+};
+
+#endif
@@ -0,0 +1,268 @@
+// shadow_map.cpp
+#include "shadow_map.h"
+#include "renderer.h"
+#include "gpu_memory.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const char* const LIGHT_SPACE_NAMES[MAX_SHADOW_CASCADES] = {
+        "lightSpaceMatrices[0]", "lightSpaceMatrices[1]", "lightSpaceMatrices[2]", "lightSpaceMatrices[3]"
+    };
+    const char* const SPLIT_NAMES[MAX_SHADOW_CASCADES] = {
+        "cascadeSplits[0]", "cascadeSplits[1]", "cascadeSplits[2]", "cascadeSplits[3]"
+    };
+
+    unsigned int CreateDepthArray(int resolution, int layers, bool compare)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F,
+                     resolution, resolution, layers, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget,
+                         GpuMemory::TextureBytes(GL_DEPTH_COMPONENT32F, resolution, resolution, layers));
+
+        const float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+        if (compare)
+        {
+            // linear filtering + compare mode gives hardware 2x2 PCF
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        else
+        {
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+
+    unsigned int CreateDepthOnlyFBO()
+    {
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return fbo;
+    }
+}
+
+CascadedShadowMap::CascadedShadowMap(const ShadowSettings& settings)
+    : m_Settings(settings)
+{
+    m_Settings.CascadeCount       = std::clamp(m_Settings.CascadeCount, 1, MAX_SHADOW_CASCADES);
+    m_Settings.FirstCachedCascade = std::clamp(m_Settings.FirstCachedCascade, 0, m_Settings.CascadeCount);
+
+    m_DepthArray = CreateDepthArray(m_Settings.Resolution, m_Settings.CascadeCount, true);
+    m_FBO        = CreateDepthOnlyFBO();
+
+    int cachedLayers = m_Settings.CascadeCount - m_Settings.FirstCachedCascade;
+    if (cachedLayers > 0)
+    {
+        m_StaticArray = CreateDepthArray(m_Settings.Resolution, cachedLayers, false);
+        m_StaticFBO   = CreateDepthOnlyFBO();
+    }
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    int resolution = m_Settings.Resolution;
+    glDeleteFramebuffers(1, &m_FBO);
+    glDeleteTextures(1, &m_DepthArray);
+    GpuMemory::Track(GpuMemoryCategory::RenderTarget,
+                     -int64_t(GpuMemory::TextureBytes(GL_DEPTH_COMPONENT32F, resolution, resolution, m_Settings.CascadeCount)));
+    if (m_StaticArray)
+    {
+        int cachedLayers = m_Settings.CascadeCount - m_Settings.FirstCachedCascade;
+        glDeleteFramebuffers(1, &m_StaticFBO);
+        glDeleteTextures(1, &m_StaticArray);
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget,
+                         -int64_t(GpuMemory::TextureBytes(GL_DEPTH_COMPONENT32F, resolution, resolution, cachedLayers)));
+    }
+}
+
+void CascadedShadowMap::Update(const glm::mat4& view, float fovY, float aspect, float zNear, float zFar,
+                               const glm::vec3& lightDirection)
+{
+    m_LightDirection = glm::normalize(lightDirection);
+
+    glm::mat4 invView  = glm::inverse(view);
+    float     tanHalfY = std::tan(fovY * 0.5f);
+    float     tanHalfX = tanHalfY * aspect;
+
+    float splitNear = zNear;
+    for (int i = 0; i < m_Settings.CascadeCount; ++i)
+    {
+        // practical split scheme: blend of logarithmic and uniform distribution
+        float p        = float(i + 1) / float(m_Settings.CascadeCount);
+        float logSplit = zNear * std::pow(zFar / zNear, p);
+        float uniSplit = zNear + (zFar - zNear) * p;
+        float splitFar = m_Settings.SplitLambda * logSplit + (1.0f - m_Settings.SplitLambda) * uniSplit;
+
+        glm::vec3 corners[8];
+        int       c = 0;
+        for (float d : { splitNear, splitFar })
+        {
+            float x = d * tanHalfX;
+            float y = d * tanHalfY;
+            for (float sy : { -1.0f, 1.0f })
+                for (float sx : { -1.0f, 1.0f })
+                    corners[c++] = glm::vec3(invView * glm::vec4(sx * x, sy * y, -d, 1.0f));
+        }
+
+        FitCascade(i, corners);
+        m_Cascades[i].SplitFar = splitFar;
+        splitNear = splitFar;
+    }
+}
+
+void CascadedShadowMap::FitCascade(int index, const glm::vec3 corners[8])
+{
+    Cascade& cascade = m_Cascades[index];
+
+    // a bounding sphere keeps the projection size constant under camera rotation
+    glm::vec3 center(0.0f);
+    for (int i = 0; i < 8; ++i)
+        center += corners[i];
+    center /= 8.0f;
+
+    float radius = 0.0f;
+    for (int i = 0; i < 8; ++i)
+        radius = std::max(radius, glm::length(corners[i] - center));
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    if (IsCached(index))
+    {
+        // keep the previous placement while the slice still fits inside it,
+        // so the cached static depth stays valid while the camera moves a little
+        float padded = radius * m_Settings.CachePadding;
+        if (cascade.Radius != padded || glm::length(center - cascade.Center) + radius > padded)
+        {
+            cascade.Center = center;
+            cascade.Radius = padded;
+        }
+    }
+    else
+    {
+        cascade.Center = center;
+        cascade.Radius = radius;
+    }
+
+    const float r  = cascade.Radius;
+    glm::vec3   up = std::abs(m_LightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3   eye = cascade.Center - m_LightDirection * (r + m_Settings.CasterDistance);
+
+    glm::mat4 lightView = glm::lookAt(eye, cascade.Center, up);
+    glm::mat4 lightProj = glm::ortho(-r, r, -r, r, 0.0f, 2.0f * r + m_Settings.CasterDistance);
+
+    // snap the world origin to a shadow texel so the cascade only ever moves in whole texels
+    float     halfRes = m_Settings.Resolution * 0.5f;
+    glm::vec4 origin  = lightProj * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float     offsetX = (std::round(origin.x * halfRes) - origin.x * halfRes) / halfRes;
+    float     offsetY = (std::round(origin.y * halfRes) - origin.y * halfRes) / halfRes;
+    lightProj[3][0] += offsetX;
+    lightProj[3][1] += offsetY;
+
+    cascade.LightSpace = lightProj * lightView;
+}
+
+void CascadedShadowMap::Render(const Shader& depthShader)
+{
+    GLint viewport[4];
+    GLint previousFBO;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFBO);
+
+    const int res = m_Settings.Resolution;
+    glViewport(0, 0, res, res);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    m_StaticRedraws = 0;
+
+    for (int i = 0; i < m_Settings.CascadeCount; ++i)
+    {
+        Cascade& cascade = m_Cascades[i];
+
+        if (!IsCached(i))
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthArray, 0, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            Renderer::RenderDepth(depthShader, cascade.LightSpace, Renderer::CasterFilter::All);
+            continue;
+        }
+
+        const int layer = i - m_Settings.FirstCachedCascade;
+
+        // only the casters inside this cascade count, the camera turning or nearer
+        // cascades changing their sets leaves it alone
+        const uint64_t staticHash = Renderer::GetStaticCasterHash(cascade.LightSpace);
+        bool stale = !cascade.CacheValid
+                  || cascade.CachedMatrix != cascade.LightSpace
+                  || cascade.CachedHash   != staticHash;
+        if (stale)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, m_StaticFBO);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_StaticArray, 0, layer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            Renderer::RenderDepth(depthShader, cascade.LightSpace, Renderer::CasterFilter::StaticOnly);
+
+            cascade.CacheValid   = true;
+            cascade.CachedMatrix = cascade.LightSpace;
+            cascade.CachedHash   = staticHash;
+            ++m_StaticRedraws;
+        }
+
+        // start from the cached static depth, then composite dynamic casters on top
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_StaticFBO);
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_StaticArray, 0, layer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_FBO);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthArray, 0, i);
+        glBlitFramebuffer(0, 0, res, res, 0, 0, res, res, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+        Renderer::RenderDepth(depthShader, cascade.LightSpace, Renderer::CasterFilter::DynamicOnly);
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFBO);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+std::string CascadedShadowMap::ShaderDefines()
+{
+    return "#define MAX_CASCADES " + std::to_string(MAX_SHADOW_CASCADES) + "\n";
+}
+
+void CascadedShadowMap::BindForLighting(const Shader& shader, int textureUnit) const
+{
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthArray);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("shadowMap", textureUnit);
+    shader.setInt("cascadeCount", m_Settings.CascadeCount);
+    for (int i = 0; i < m_Settings.CascadeCount; ++i)
+    {
+        shader.setMat4(LIGHT_SPACE_NAMES[i], m_Cascades[i].LightSpace);
+        shader.setFloat(SPLIT_NAMES[i], m_Cascades[i].SplitFar);
+    }
+}
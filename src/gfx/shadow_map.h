@@ -0,0 +1,91 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+#include "shader.h"
+
+#define MAX_SHADOW_CASCADES 4
+
+struct ShadowSettings {
+    int   Resolution          = 2048;
+    int   CascadeCount        = 4;
+    // cascades from this index on keep a cached static depth layer
+    int   FirstCachedCascade  = 2;
+    // blend between logarithmic (1) and uniform (0) split distribution
+    float SplitLambda         = 0.75f;
+    // how far cached cascades over-fit the camera slice, so they recenter rarely
+    float CachePadding        = 1.5f;
+    // extra depth range towards the light so off-screen casters still cast
+    float CasterDistance      = 50.0f;
+};
+
+// Cascaded shadow maps for a single directional light.
+// Cascades are fit to bounding spheres and snapped to shadow texels so they do not shimmer.
+// Far cascades cache their static casters and only re-render them when the light,
+// the cascade placement or the static submission set changes; dynamic casters are
+// drawn over a copy of the cached depth every frame.
+class CascadedShadowMap
+{
+public:
+    CascadedShadowMap(const ShadowSettings& settings = ShadowSettings());
+    ~CascadedShadowMap();
+
+    CascadedShadowMap(const CascadedShadowMap&) = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+    // fit cascades to the camera frustum, call once per frame before Render
+    void Update(const glm::mat4& view, float fovY, float aspect, float zNear, float zFar,
+                const glm::vec3& lightDirection);
+
+    // render casters from the Renderer's current submissions (between BeginScene and EndScene)
+    void Render(const Shader& depthShader);
+
+    // bind the cascade array and upload the matrices/splits the lighting shader needs
+    void BindForLighting(const Shader& shader, int textureUnit) const;
+
+    // the #define block a lighting shader is compiled with, so its cascade arrays
+    // are sized by MAX_SHADOW_CASCADES
+    static std::string ShaderDefines();
+
+    int GetCascadeCount() const { return m_Settings.CascadeCount; }
+    int GetResolution()   const { return m_Settings.Resolution; }
+    // the GL_TEXTURE_2D_ARRAY the lighting pass samples, one layer per cascade
+    unsigned int GetDepthArray() const { return m_DepthArray; }
+    const glm::mat4& GetLightSpaceMatrix(int cascade) const { return m_Cascades[cascade].LightSpace; }
+
+    // how many cached cascades had to re-render their static casters last frame
+    int GetStaticRedrawCount() const { return m_StaticRedraws; }
+
+private:
+    struct Cascade {
+        glm::mat4 LightSpace = glm::mat4(1.0f);
+        glm::vec3 Center     = glm::vec3(0.0f);
+        float     Radius     = 0.0f;
+        float     SplitFar   = 0.0f;
+
+        // cache state (cached cascades only)
+        bool      CacheValid   = false;
+        glm::mat4 CachedMatrix = glm::mat4(1.0f);
+        uint64_t  CachedHash   = 0; // Renderer::GetStaticCasterHash of this cascade
+    };
+
+    ShadowSettings m_Settings;
+    Cascade        m_Cascades[MAX_SHADOW_CASCADES];
+    glm::vec3      m_LightDirection = glm::vec3(0.0f);
+    int            m_StaticRedraws  = 0;
+
+    unsigned int m_DepthArray  = 0; // sampled by the lighting pass
+    unsigned int m_StaticArray = 0; // cached static depth for far cascades
+    unsigned int m_FBO         = 0;
+    unsigned int m_StaticFBO   = 0;
+
+    bool IsCached(int cascade) const { return cascade >= m_Settings.FirstCachedCascade; }
+    void FitCascade(int index, const glm::vec3 corners[8]);
+};
+
+#endif
@@ -0,0 +1,132 @@
+// skinning.cpp
+#include "skinning.h"
+
+#include "gpu_memory.h"
+
+#include <algorithm>
+
+static_assert(sizeof(Vertex) == 22 * sizeof(float), "skinning.comp reads the Vertex layout as 22 floats");
+static_assert(sizeof(SkinnedVertex) == 14 * sizeof(float), "skinning.comp writes SkinnedVertex as 14 floats");
+
+GpuSkinning& GpuSkinning::Get()
+{
+    static GpuSkinning instance;
+    return instance;
+}
+
+bool GpuSkinning::Supported()
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+GpuSkinning::~GpuSkinning()
+{
+    // the context may already be gone at static destruction, only forget the accounting
+    GpuMemory::Track(GpuMemoryCategory::InstanceBuffer, -int64_t(m_PaletteCapacity + m_JobCapacity));
+    GpuMemory::Track(GpuMemoryCategory::VertexBuffer,   -int64_t(m_OutputCapacity));
+}
+
+void GpuSkinning::Init()
+{
+    m_Shader = std::make_unique<Shader>(m_ShaderDirectory + "/skinning.comp");
+    glGenBuffers(1, &m_Palette);
+    glGenBuffers(1, &m_Output);
+    glGenBuffers(1, &m_Jobs);
+}
+
+void GpuSkinning::Reserve(unsigned int buffer, size_t& capacity, size_t bytes, GpuMemoryCategory category)
+{
+    size_t required = std::max(capacity, bytes);
+    if (required > capacity)
+        required = std::max(required, capacity * 2);
+
+    // respecified every frame: the driver hands out fresh storage while the GPU may
+    // still be reading last frame's
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, required, nullptr, GL_STREAM_DRAW);
+
+    GpuMemory::Track(category, int64_t(required) - int64_t(capacity));
+    capacity = required;
+}
+
+void GpuSkinning::Begin(const glm::mat4* palette, size_t jointCount, size_t vertexCount)
+{
+    if (!m_Shader)
+        Init();
+
+    m_Pending.clear();
+    m_Stats = Stats();
+    m_Stats.Vertices = vertexCount;
+
+    size_t paletteBytes = std::max<size_t>(jointCount, 1) * sizeof(glm::mat4);
+    Reserve(m_Palette, m_PaletteCapacity, paletteBytes, GpuMemoryCategory::InstanceBuffer);
+    if (jointCount)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, jointCount * sizeof(glm::mat4), palette);
+
+    Reserve(m_Output, m_OutputCapacity, std::max<size_t>(vertexCount, 1) * sizeof(SkinnedVertex),
+            GpuMemoryCategory::VertexBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuSkinning::Add(const Mesh& mesh, uint32_t paletteOffset, uint32_t outputVertex)
+{
+    Job job;
+    job.sourceFloat   = static_cast<uint32_t>(mesh.VertexOffset() / sizeof(float));
+    job.vertexCount   = mesh.VertexCount();
+    job.paletteOffset = paletteOffset;
+    job.outputVertex  = outputVertex;
+    m_Pending.push_back(PendingJob{ mesh.VertexBuffer(), job });
+}
+
+void GpuSkinning::Dispatch()
+{
+    if (m_Pending.empty())
+        return;
+
+    // one run of dispatches per pool page, the page is bound whole as the source
+    std::stable_sort(m_Pending.begin(), m_Pending.end(), [](const PendingJob& a, const PendingJob& b) {
+        return a.sourceBuffer < b.sourceBuffer;
+    });
+
+    m_Batch.clear();
+    for (const PendingJob& pending : m_Pending)
+        m_Batch.push_back(pending.job);
+
+    Reserve(m_Jobs, m_JobCapacity, m_Batch.size() * sizeof(Job), GpuMemoryCategory::InstanceBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_Batch.size() * sizeof(Job), m_Batch.data());
+
+    m_Shader->use();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_Palette);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_Jobs);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_Output);
+    GLint jobOffsetLocation = glGetUniformLocation(m_Shader->ID, "jobOffset");
+
+    size_t first = 0;
+    while (first < m_Pending.size())
+    {
+        unsigned int source = m_Pending[first].sourceBuffer;
+        size_t       last   = first;
+        uint32_t     widest = 0;
+        while (last < m_Pending.size() && m_Pending[last].sourceBuffer == source && last - first < SKINNING_MAX_DISPATCH_Y)
+        {
+            widest = std::max(widest, m_Pending[last].job.vertexCount);
+            ++last;
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, source);
+        glUniform1ui(jobOffsetLocation, static_cast<GLuint>(first));
+        glDispatchCompute((widest + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE, static_cast<GLuint>(last - first), 1);
+        ++m_Stats.Dispatches;
+
+        first = last;
+    }
+
+    for (GLuint binding = 0; binding < 4; ++binding)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+
+    // every pass after this fetches the results as vertex attributes
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    m_Stats.Instances = m_Pending.size();
+    m_Pending.clear();
+}
@@ -0,0 +1,84 @@
+#ifndef SKINNING_H
+#define SKINNING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+#include "shader.h"
+
+#define SKINNING_GROUP_SIZE     64    // must match local_size_x in skinning.comp
+#define SKINNING_MAX_DISPATCH_Y 65535 // jobs per dispatch, the minimum every GL 4.3 driver allows
+
+// Compute pre-pass that skins every animated mesh instance of a frame once, into a
+// transient vertex buffer in SkinnedVertex layout. Depth, shadow and color passes
+// then all draw from that buffer instead of skinning in their vertex shaders.
+// Needs GL 4.3 (compute and storage buffers); see Supported().
+class GpuSkinning
+{
+public:
+    struct Stats {
+        size_t Instances  = 0;
+        size_t Vertices   = 0;
+        size_t Dispatches = 0;
+    };
+
+    static GpuSkinning& Get();
+    static bool Supported();
+
+    // start a frame: upload the joint palette and make room for vertexCount outputs
+    void Begin(const glm::mat4* palette, size_t jointCount, size_t vertexCount);
+    // skin mesh with the palette from paletteOffset into outputs [outputVertex, + VertexCount)
+    void Add(const Mesh& mesh, uint32_t paletteOffset, uint32_t outputVertex);
+    // run every job added since Begin, results are visible to vertex fetch afterwards
+    void Dispatch();
+
+    unsigned int GetOutputBuffer() const { return m_Output; }
+    const Stats& GetStats()        const { return m_Stats; }
+
+    void SetShaderDirectory(const std::string& directory) { m_ShaderDirectory = directory; }
+
+private:
+    GpuSkinning() = default;
+    ~GpuSkinning();
+
+    GpuSkinning(const GpuSkinning&) = delete;
+    GpuSkinning& operator=(const GpuSkinning&) = delete;
+
+    // one mesh instance, uvec4 in the shader
+    struct Job {
+        uint32_t sourceFloat;   // first float of the mesh's vertices in the source pool buffer
+        uint32_t vertexCount;
+        uint32_t paletteOffset;
+        uint32_t outputVertex;
+    };
+
+    struct PendingJob {
+        unsigned int sourceBuffer;
+        Job          job;
+    };
+
+    std::unique_ptr<Shader> m_Shader;
+    std::string             m_ShaderDirectory = "../res/shaders";
+    unsigned int            m_Palette = 0;
+    unsigned int            m_Output  = 0;
+    unsigned int            m_Jobs    = 0;
+    size_t                  m_PaletteCapacity = 0; // bytes
+    size_t                  m_OutputCapacity  = 0;
+    size_t                  m_JobCapacity     = 0;
+
+    std::vector<PendingJob> m_Pending;
+    std::vector<Job>        m_Batch;
+    Stats                   m_Stats;
+
+    void Init();
+    void Reserve(unsigned int buffer, size_t& capacity, size_t bytes, GpuMemoryCategory category);
+};
+
+#endif
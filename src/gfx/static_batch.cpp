@@ -0,0 +1,310 @@
+// static_batch.cpp
+#include "static_batch.h"
+#include "model.h"
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+StaticBatcher::StaticBatcher(entt::registry& registry, const StaticBatchSettings& settings)
+    : m_Registry(registry), m_Settings(settings)
+{
+    m_Registry.on_construct<RenderableComponent>().connect<&StaticBatcher::OnChanged>(*this);
+    m_Registry.on_update<RenderableComponent>().connect<&StaticBatcher::OnChanged>(*this);
+    m_Registry.on_update<TransformComponent>().connect<&StaticBatcher::OnChanged>(*this);
+    m_Registry.on_destroy<RenderableComponent>().connect<&StaticBatcher::OnRemoved>(*this);
+    m_Registry.on_destroy<TransformComponent>().connect<&StaticBatcher::OnRemoved>(*this);
+
+    // whatever exists already is batched at the first Update
+    for (entt::entity entity : m_Registry.view<TransformComponent, RenderableComponent>())
+        m_Pending.push_back(entity);
+}
+
+StaticBatcher::~StaticBatcher()
+{
+    m_Registry.on_construct<RenderableComponent>().disconnect<&StaticBatcher::OnChanged>(*this);
+    m_Registry.on_update<RenderableComponent>().disconnect<&StaticBatcher::OnChanged>(*this);
+    m_Registry.on_update<TransformComponent>().disconnect<&StaticBatcher::OnChanged>(*this);
+    m_Registry.on_destroy<RenderableComponent>().disconnect<&StaticBatcher::OnRemoved>(*this);
+    m_Registry.on_destroy<TransformComponent>().disconnect<&StaticBatcher::OnRemoved>(*this);
+}
+
+void StaticBatcher::OnChanged(entt::registry& registry, entt::entity entity)
+{
+    // moving dynamic entities is the common case and none of our business
+    const auto* renderable = registry.try_get<RenderableComponent>(entity);
+    bool member = m_Membership.count(entity) != 0;
+    if (member || (renderable && renderable->isStatic))
+        m_Pending.push_back(entity);
+}
+
+void StaticBatcher::OnRemoved(entt::registry&, entt::entity entity)
+{
+    // the components are about to go, so drop the entity from its chunks now
+    Detach(entity);
+}
+
+void StaticBatcher::Update()
+{
+    auto start = std::chrono::steady_clock::now();
+    m_Stats.RebuiltChunks = 0;
+
+    std::sort(m_Pending.begin(), m_Pending.end());
+    m_Pending.erase(std::unique(m_Pending.begin(), m_Pending.end()), m_Pending.end());
+
+    for (entt::entity entity : m_Pending)
+    {
+        Detach(entity);
+        if (!m_Registry.valid(entity))
+            continue;
+
+        if (Attach(entity))
+            m_Registry.emplace_or_replace<StaticBatchedComponent>(entity);
+        else if (m_Registry.all_of<StaticBatchedComponent>(entity))
+            m_Registry.remove<StaticBatchedComponent>(entity);
+    }
+    m_Pending.clear();
+
+    bool erased = false;
+    for (auto it = m_Chunks.begin(); it != m_Chunks.end();)
+    {
+        Chunk& chunk = it->second;
+        if (chunk.dirty && chunk.members.empty())
+        {
+            it = m_Chunks.erase(it);
+            erased = true;
+            continue;
+        }
+        if (chunk.dirty)
+        {
+            Rebuild(it->first, chunk);
+            ++m_Stats.RebuiltChunks;
+        }
+        ++it;
+    }
+    if (erased)
+        CompactMaterials();
+
+    m_Stats.Chunks   = m_Chunks.size();
+    m_Stats.Entities = m_Membership.size();
+    m_Stats.Vertices = 0;
+    for (const auto& pair : m_Chunks)
+        m_Stats.Vertices += pair.second.mesh ? pair.second.mesh->VertexCount() : 0;
+
+    if (m_Stats.RebuiltChunks > 0)
+        m_Stats.RebuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void StaticBatcher::Submit() const
+{
+    for (const auto& pair : m_Chunks)
+    {
+        const Chunk& chunk = pair.second;
+        if (chunk.mesh)
+            Renderer::SubmitStaticChunk(chunk.mesh.get(), m_Materials[pair.first.material].shader, chunk.revision);
+    }
+}
+
+void StaticBatcher::Forget(const Model& model)
+{
+    // another mesh may later be created at the same address
+    for (const Mesh& mesh : model.GetMeshes())
+        m_Geometry.erase(&mesh);
+}
+
+void StaticBatcher::Detach(entt::entity entity)
+{
+    auto it = m_Membership.find(entity);
+    if (it == m_Membership.end())
+        return;
+
+    for (const ChunkKey& key : it->second)
+    {
+        Chunk& chunk = m_Chunks[key];
+        chunk.members.erase(std::remove(chunk.members.begin(), chunk.members.end(), entity), chunk.members.end());
+        chunk.dirty = true;
+    }
+    m_Membership.erase(it);
+}
+
+bool StaticBatcher::Attach(entt::entity entity)
+{
+    if (!m_Registry.all_of<TransformComponent, RenderableComponent>(entity))
+        return false;
+
+    const auto& renderable = m_Registry.get<RenderableComponent>(entity);
+    if (!IsBatchable(renderable))
+        return false;
+
+    // the whole entity goes to the cell its center is in, chunks overlap a little instead of splitting meshes
+    const glm::mat4& matrix = m_Registry.get<TransformComponent>(entity).Matrix;
+    glm::vec3 center = renderable.model->GetBounds().Transformed(matrix).Center();
+    glm::ivec3 cell  = glm::ivec3(glm::floor(center / m_Settings.ChunkSize));
+
+    vector<ChunkKey>& keys = m_Membership[entity];
+    for (const Mesh& mesh : renderable.model->GetMeshes())
+    {
+        ChunkKey key{ FindMaterial(renderable.shaders->Get(mesh.features), mesh.textures), cell.x, cell.y, cell.z };
+        if (std::find_if(keys.begin(), keys.end(), [&](const ChunkKey& k) { return !(k < key) && !(key < k); }) != keys.end())
+            continue;
+
+        keys.push_back(key);
+        Chunk& chunk = m_Chunks[key];
+        chunk.members.push_back(entity);
+        chunk.dirty = true;
+    }
+    return true;
+}
+
+bool StaticBatcher::IsBatchable(const RenderableComponent& renderable) const
+{
+    if (!renderable.isStatic || !renderable.model || !renderable.shaders)
+        return false;
+    // a chunk draws all its members at full detail, so one with an impostor would never fade out
+    if (renderable.impostor)
+        return false;
+
+    // all or nothing, a half batched entity would have to be submitted too
+    for (const Mesh& mesh : renderable.model->GetMeshes())
+        if (mesh.skinned || mesh.VertexCount() > m_Settings.MaxMeshVertices)
+            return false;
+    return true;
+}
+
+uint32_t StaticBatcher::FindMaterial(Shader* shader, const vector<Texture>& textures)
+{
+    for (uint32_t i = 0; i < m_Materials.size(); ++i)
+    {
+        const Material& material = m_Materials[i];
+        if (material.shader != shader || material.textures.size() != textures.size())
+            continue;
+
+        bool same = true;
+        for (size_t t = 0; t < textures.size() && same; ++t)
+            same = material.textures[t].id == textures[t].id && material.textures[t].type == textures[t].type;
+        if (same)
+            return i;
+    }
+
+    m_Materials.push_back(Material{ shader, textures });
+    return static_cast<uint32_t>(m_Materials.size() - 1);
+}
+
+void StaticBatcher::CompactMaterials()
+{
+    vector<uint32_t> remap(m_Materials.size(), ~0u);
+    for (const auto& pair : m_Chunks)
+        remap[pair.first.material] = 0;
+
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < m_Materials.size(); ++i)
+    {
+        if (remap[i] == ~0u)
+            continue;
+        remap[i] = used;
+        if (used != i)
+            m_Materials[used] = std::move(m_Materials[i]);
+        ++used;
+    }
+    if (used == m_Materials.size())
+        return;
+    m_Materials.resize(used);
+
+    // keys embed the material index; the chunks themselves (mesh, revision) are unchanged
+    std::map<ChunkKey, Chunk> chunks;
+    for (auto& pair : m_Chunks)
+    {
+        ChunkKey key = pair.first;
+        key.material = remap[key.material];
+        chunks.emplace(key, std::move(pair.second));
+    }
+    m_Chunks.swap(chunks);
+
+    for (auto& pair : m_Membership)
+        for (ChunkKey& key : pair.second)
+            key.material = remap[key.material];
+}
+
+const StaticBatcher::Geometry& StaticBatcher::GetGeometry(const Mesh& mesh)
+{
+    auto it = m_Geometry.find(&mesh);
+    if (it != m_Geometry.end())
+        return it->second;
+
+    // meshes drop their CPU copy after upload; read it back once and keep it for rebuilds
+    Geometry& geometry = m_Geometry[&mesh];
+    mesh.ReadBackGeometry(geometry.vertices, geometry.indices);
+    return geometry;
+}
+
+void StaticBatcher::Rebuild(const ChunkKey& key, Chunk& chunk)
+{
+    // first the pieces of this material and their total size, so the merged buffers are allocated once
+    struct Part {
+        const Geometry* geometry;
+        glm::mat4       world;
+    };
+    vector<Part> parts;
+    size_t vertexCount = 0, indexCount = 0;
+    for (entt::entity entity : chunk.members)
+    {
+        const auto& renderable = m_Registry.get<RenderableComponent>(entity);
+        const glm::mat4& matrix = m_Registry.get<TransformComponent>(entity).Matrix;
+        const auto& meshes = renderable.model->GetMeshes();
+
+        for (const MeshInstance& instance : renderable.model->GetInstances())
+        {
+            const Mesh& mesh = meshes[instance.mesh];
+            if (FindMaterial(renderable.shaders->Get(mesh.features), mesh.textures) != key.material)
+                continue;
+
+            const Geometry& geometry = GetGeometry(mesh);
+            parts.push_back(Part{ &geometry, matrix * instance.transform });
+            vertexCount += geometry.vertices.size();
+            indexCount  += geometry.indices.size();
+        }
+    }
+
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vertices.reserve(vertexCount);
+    indices.reserve(indexCount);
+
+    for (const Part& part : parts)
+    {
+        const glm::mat4& world        = part.world;
+        glm::mat3        linear       = glm::mat3(world);
+        glm::mat3        normalMatrix = glm::transpose(glm::inverse(linear));
+        // mirrored placements flip the winding, undo it so front faces stay front faces
+        bool mirrored = glm::determinant(linear) < 0.0f;
+
+        const Geometry& geometry = *part.geometry;
+        unsigned int base = static_cast<unsigned int>(vertices.size());
+
+        for (const Vertex& source : geometry.vertices)
+        {
+            Vertex vertex    = source;
+            vertex.Position  = glm::vec3(world * glm::vec4(source.Position, 1.0f));
+            vertex.Normal    = glm::normalize(normalMatrix * source.Normal);
+            vertex.Tangent   = linear * source.Tangent;
+            vertex.Bitangent = linear * source.Bitangent;
+            vertices.push_back(vertex);
+        }
+
+        for (size_t i = 0; i + 2 < geometry.indices.size(); i += 3)
+        {
+            indices.push_back(base + geometry.indices[i]);
+            indices.push_back(base + geometry.indices[mirrored ? i + 2 : i + 1]);
+            indices.push_back(base + geometry.indices[mirrored ? i + 1 : i + 2]);
+        }
+    }
+
+    chunk.mesh.reset(new Mesh(std::move(vertices), std::move(indices), m_Materials[key.material].textures));
+    // the single instance slot holds the identity for good, chunks are already in world space
+    const glm::mat4 identity(1.0f);
+    chunk.mesh->UploadInstances(&identity, sizeof(identity));
+
+    chunk.revision = ++m_Revision;
+    chunk.dirty    = false;
+}
@@ -0,0 +1,116 @@
+#ifndef STATIC_BATCH_H
+#define STATIC_BATCH_H
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "components.h"
+#include "mesh.h"
+
+struct StaticBatchSettings {
+    // edge of the world-space grid cells geometry is chunked by
+    float  ChunkSize       = 32.0f;
+    // meshes above this stay instanced, baking many copies of them costs more memory than draws
+    size_t MaxMeshVertices = 4096;
+};
+
+// Bakes static entities into merged, world-space geometry. Entities whose
+// RenderableComponent is static (without an impostor, and whose meshes are all
+// small and unskinned) are grouped by material, then by the grid cell their bounds
+// center falls in; each group becomes one chunk mesh drawn with a single call and
+// no instance upload. Entities with an impostor stay instanced so they can fade.
+// Chunks keep their world bounds so they are still frustum culled. Adding,
+// removing or moving a static entity only rebuilds the chunks it touches, at the
+// next Update(). Batched entities get a StaticBatchedComponent.
+class StaticBatcher
+{
+public:
+    struct Stats {
+        size_t Chunks        = 0;
+        size_t Entities      = 0; // batched
+        size_t Vertices      = 0; // across all chunks
+        size_t RebuiltChunks = 0; // by the last Update
+        float  RebuildMs     = 0.0f;
+    };
+
+    explicit StaticBatcher(entt::registry& registry, const StaticBatchSettings& settings = StaticBatchSettings());
+    ~StaticBatcher();
+
+    StaticBatcher(const StaticBatcher&) = delete;
+    StaticBatcher& operator=(const StaticBatcher&) = delete;
+
+    // apply queued changes and rebuild the chunks they touched (uploads, call with the GL context current)
+    void Update();
+    // hand every chunk to the renderer, between BeginScene and EndScene
+    void Submit() const;
+    // drop what is cached about a model's meshes, before the model is destroyed
+    void Forget(const Model& model);
+
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    // what a chunk is drawn with: the resolved shader variant plus the mesh's textures
+    struct Material {
+        Shader*         shader;
+        vector<Texture> textures;
+    };
+
+    struct ChunkKey {
+        uint32_t material;
+        int      x, y, z;
+
+        bool operator<(const ChunkKey& other) const
+        {
+            if (material != other.material) return material < other.material;
+            if (x != other.x) return x < other.x;
+            if (y != other.y) return y < other.y;
+            return z < other.z;
+        }
+    };
+
+    struct Chunk {
+        vector<entt::entity>  members;
+        std::unique_ptr<Mesh> mesh;
+        uint64_t              revision = 0; // bumped per rebuild, feeds the renderer's static hash
+        bool                  dirty    = false;
+    };
+
+    // CPU copy of a source mesh, read back from the GPU pools once
+    struct Geometry {
+        vector<Vertex>       vertices;
+        vector<unsigned int> indices;
+    };
+
+    entt::registry&     m_Registry;
+    StaticBatchSettings m_Settings;
+
+    vector<Material>                 m_Materials;
+    std::map<ChunkKey, Chunk>        m_Chunks;
+    std::unordered_map<const Mesh*, Geometry> m_Geometry;
+    // chunks each batched entity contributes to
+    std::unordered_map<entt::entity, vector<ChunkKey>> m_Membership;
+    vector<entt::entity>             m_Pending; // to (re)evaluate at the next Update
+    uint64_t                         m_Revision = 0;
+    Stats                            m_Stats;
+
+    void OnChanged(entt::registry& registry, entt::entity entity);
+    void OnRemoved(entt::registry& registry, entt::entity entity);
+
+    void Detach(entt::entity entity);
+    bool Attach(entt::entity entity);
+    bool IsBatchable(const RenderableComponent& renderable) const;
+    uint32_t FindMaterial(Shader* shader, const vector<Texture>& textures);
+    // drop materials no chunk uses any more and renumber the keys that refer to them
+    void CompactMaterials();
+    const Geometry& GetGeometry(const Mesh& mesh);
+    void Rebuild(const ChunkKey& key, Chunk& chunk);
+};
+
+#endif
@@ -0,0 +1,285 @@
+// texture_processing.cpp
+#include "texture_processing.h"
+
+#include "../core/job_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_PROCESSING_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // rows per job, keeps small levels on one thread
+    constexpr size_t ROW_GRAIN = 16;
+
+    // half width of the Kaiser filter in destination texels, and its shape parameter
+    constexpr float KAISER_WIDTH = 3.0f;
+    constexpr float KAISER_ALPHA = 4.0f;
+
+    constexpr int LINEAR_TO_SRGB_STEPS = 4096;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    struct ColorTables {
+        float         toLinear[256];
+        unsigned char toSRGB[LINEAR_TO_SRGB_STEPS];
+
+        ColorTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < LINEAR_TO_SRGB_STEPS; ++i)
+            {
+                float l = i / float(LINEAR_TO_SRGB_STEPS - 1);
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                toSRGB[i] = static_cast<unsigned char>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    const ColorTables& Tables()
+    {
+        static const ColorTables tables;
+        return tables;
+    }
+
+    // taps of a 2:1 decimation filter, output texel x reads source texels 2x + first + j
+    struct Kernel {
+        int                first = 0;
+        std::vector<float> weights;
+    };
+
+    double BesselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum  += term;
+        }
+        return sum;
+    }
+
+    Kernel MakeKernel(MipFilter filter)
+    {
+        Kernel kernel;
+        if (filter == MipFilter::Box)
+        {
+            kernel.first   = 0;
+            kernel.weights = { 0.5f, 0.5f };
+            return kernel;
+        }
+
+        // source texel centers sit at k - 0.5 from the destination center (in source texels)
+        const int reach = static_cast<int>(std::ceil(2.0f * KAISER_WIDTH));
+        kernel.first = 1 - reach;
+
+        double total = 0.0;
+        std::vector<double> weights;
+        for (int k = 1 - reach; k <= reach; ++k)
+        {
+            double t = (k - 0.5) / 2.0; // in destination texels
+            double sinc = t == 0.0 ? 1.0 : std::sin(PI * t) / (PI * t);
+            double r = t / KAISER_WIDTH;
+            double window = std::abs(r) >= 1.0 ? 0.0
+                          : BesselI0(KAISER_ALPHA * std::sqrt(1.0 - r * r)) / BesselI0(KAISER_ALPHA);
+            weights.push_back(sinc * window);
+            total += sinc * window;
+        }
+        for (double w : weights)
+            kernel.weights.push_back(static_cast<float>(w / total));
+        return kernel;
+    }
+
+    // dst[i] += weight * src[i]
+    void AccumulateRow(float* dst, const float* src, float weight, size_t count)
+    {
+        size_t i = 0;
+#ifdef TEXTURE_PROCESSING_SSE
+        const __m128 w = _mm_set1_ps(weight);
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w, _mm_loadu_ps(src + i))));
+#endif
+        for (; i < count; ++i)
+            dst[i] += weight * src[i];
+    }
+
+    bool IsColorChannel(int channel, int components, bool srgb)
+    {
+        // alpha (4th channel) and 1/2 channel data are always linear
+        return srgb && components >= 3 && channel < 3;
+    }
+
+    void BytesToFloat(const unsigned char* src, float* dst, size_t texels, int components, bool srgb)
+    {
+        const ColorTables& tables = Tables();
+        JobSystem::ParallelFor(texels, ROW_GRAIN * 1024, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t)
+                for (int c = 0; c < components; ++c)
+                {
+                    size_t i = t * components + c;
+                    dst[i] = IsColorChannel(c, components, srgb) ? tables.toLinear[src[i]] : src[i] / 255.0f;
+                }
+        });
+    }
+
+    void FloatToBytes(const float* src, unsigned char* dst, size_t texels, int components, bool srgb)
+    {
+        const ColorTables& tables = Tables();
+        JobSystem::ParallelFor(texels, ROW_GRAIN * 1024, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t)
+                for (int c = 0; c < components; ++c)
+                {
+                    size_t i = t * components + c;
+                    float  v = std::clamp(src[i], 0.0f, 1.0f);
+                    dst[i] = IsColorChannel(c, components, srgb)
+                           ? tables.toSRGB[static_cast<int>(v * (LINEAR_TO_SRGB_STEPS - 1) + 0.5f)]
+                           : static_cast<unsigned char>(v * 255.0f + 0.5f);
+                }
+        });
+    }
+
+    // one 2:1 reduction in linear float, vertical pass first so the wide rows use SIMD
+    void Downsample(const std::vector<float>& src, int width, int height, int components, const Kernel& kernel,
+                    std::vector<float>& dst, int& outWidth, int& outHeight)
+    {
+        outWidth  = std::max(1, width / 2);
+        outHeight = std::max(1, height / 2);
+
+        const size_t rowFloats = size_t(width) * components;
+        const int    taps      = static_cast<int>(kernel.weights.size());
+
+        // vertical: width x outHeight
+        std::vector<float> vertical;
+        if (height > 1)
+        {
+            vertical.assign(rowFloats * outHeight, 0.0f);
+            JobSystem::ParallelFor(outHeight, ROW_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    float* row = vertical.data() + y * rowFloats;
+                    for (int j = 0; j < taps; ++j)
+                    {
+                        int sy = std::clamp(int(2 * y) + kernel.first + j, 0, height - 1);
+                        AccumulateRow(row, src.data() + size_t(sy) * rowFloats, kernel.weights[j], rowFloats);
+                    }
+                }
+            });
+        }
+        else
+        {
+            vertical = src;
+        }
+
+        // horizontal: outWidth x outHeight
+        if (width > 1)
+        {
+            dst.assign(size_t(outWidth) * outHeight * components, 0.0f);
+            JobSystem::ParallelFor(outHeight, ROW_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const float* in  = vertical.data() + y * rowFloats;
+                    float*       out = dst.data() + y * size_t(outWidth) * components;
+                    for (int x = 0; x < outWidth; ++x)
+                        for (int j = 0; j < taps; ++j)
+                        {
+                            int          sx = std::clamp(2 * x + kernel.first + j, 0, width - 1);
+                            const float  w  = kernel.weights[j];
+                            for (int c = 0; c < components; ++c)
+                                out[x * components + c] += w * in[sx * components + c];
+                        }
+                }
+            });
+        }
+        else
+        {
+            dst.swap(vertical);
+        }
+    }
+}
+
+MipChain TextureProcessing::GenerateMipChain(const unsigned char* pixels, int width, int height, int components,
+                                             bool srgb, MipFilter filter)
+{
+    MipChain chain;
+    chain.components = components;
+    chain.srgb       = srgb;
+
+    MipLevel base;
+    base.width  = width;
+    base.height = height;
+    base.pixels.assign(pixels, pixels + size_t(width) * height * components);
+    chain.levels.push_back(std::move(base));
+
+    const Kernel kernel = MakeKernel(filter);
+
+    // each level is filtered from the previous one in linear float
+    std::vector<float> current(size_t(width) * height * components);
+    std::vector<float> next;
+    BytesToFloat(pixels, current.data(), size_t(width) * height, components, srgb);
+
+    while (width > 1 || height > 1)
+    {
+        int outWidth, outHeight;
+        Downsample(current, width, height, components, kernel, next, outWidth, outHeight);
+
+        MipLevel level;
+        level.width  = outWidth;
+        level.height = outHeight;
+        level.pixels.resize(size_t(outWidth) * outHeight * components);
+        FloatToBytes(next.data(), level.pixels.data(), size_t(outWidth) * outHeight, components, srgb);
+        chain.levels.push_back(std::move(level));
+
+        current.swap(next);
+        width  = outWidth;
+        height = outHeight;
+    }
+
+    return chain;
+}
+
+GLenum TextureProcessing::InternalFormat(int components, bool srgb)
+{
+    switch (components)
+    {
+        case 1:  return GL_R8;
+        case 2:  return GL_RG8;
+        case 3:  return srgb ? GL_SRGB8 : GL_RGB8;
+        default: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+}
+
+GLenum TextureProcessing::PixelFormat(int components)
+{
+    switch (components)
+    {
+        case 1:  return GL_RED;
+        case 2:  return GL_RG;
+        case 3:  return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+void TextureProcessing::Upload(const MipLevel* levels, int count, int components, bool srgb)
+{
+    const GLenum internalFormat = InternalFormat(components, srgb);
+    const GLenum format         = PixelFormat(components);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < count; ++level)
+    {
+        glTexImage2D(GL_TEXTURE_2D, level, internalFormat, levels[level].width, levels[level].height, 0,
+                     format, GL_UNSIGNED_BYTE, levels[level].pixels.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
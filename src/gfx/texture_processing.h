@@ -0,0 +1,44 @@
+#ifndef TEXTURE_PROCESSING_H
+#define TEXTURE_PROCESSING_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+enum class MipFilter {
+    Box,    // 2x2 average, cheap
+    Kaiser  // Kaiser-windowed sinc, sharper mips without ringing
+};
+
+struct MipLevel {
+    int width  = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+struct MipChain {
+    int components = 0;
+    bool srgb      = false;
+    std::vector<MipLevel> levels; // levels[0] is the finest
+};
+
+// CPU texture preprocessing: mip chains are built here instead of with glGenerateMipmap,
+// so the result does not depend on the driver and color data is filtered in linear space.
+// Levels are split into row bands across the job system and the inner loops use SSE.
+// Nothing here touches GL except Upload / InternalFormat.
+namespace TextureProcessing
+{
+    // the full chain down to 1x1, level 0 is a copy of pixels
+    // srgb: color channels are sRGB encoded and get linearized before filtering (alpha never is)
+    MipChain GenerateMipChain(const unsigned char* pixels, int width, int height, int components,
+                              bool srgb, MipFilter filter = MipFilter::Kaiser);
+
+    // sRGB internal formats only exist for 3 and 4 channel data
+    GLenum InternalFormat(int components, bool srgb);
+    GLenum PixelFormat(int components);
+
+    // upload count levels to the bound GL_TEXTURE_2D as levels 0..count-1
+    void Upload(const MipLevel* levels, int count, int components, bool srgb);
+}
+
+#endif
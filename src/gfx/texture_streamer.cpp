@@ -0,0 +1,397 @@
+// texture_streamer.cpp
+#include "texture_streamer.h"
+
+#include "texture_processing.h"
+#include "gpu_memory.h"
+
+#include "../core/alloc_counter.hpp"
+#include "../core/job_system.hpp"
+#include "../core/log.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace
+{
+    int MipCount(int width, int height)
+    {
+        int levels = 1;
+        for (int size = std::max(width, height); size > 1; size >>= 1)
+            ++levels;
+        return levels;
+    }
+
+    size_t DecodedBytes(const MipChain& chain)
+    {
+        size_t bytes = 0;
+        for (const MipLevel& level : chain.levels)
+            bytes += level.pixels.size();
+        return bytes;
+    }
+}
+
+TextureStreamer& TextureStreamer::Get()
+{
+    static TextureStreamer instance;
+    return instance;
+}
+
+unsigned int TextureStreamer::Load(const std::string& filename, bool srgb)
+{
+    return Load(Prepare(filename, srgb));
+}
+
+PreparedTexture TextureStreamer::Prepare(const std::string& filename, bool srgb) const
+{
+    MemoryTagScope tag(MemoryTag::Texture);
+
+    PreparedTexture prepared;
+    prepared.path = filename;
+    prepared.srgb = srgb;
+
+    unsigned char *data = stbi_load(filename.c_str(), &prepared.width, &prepared.height, &prepared.components, 0);
+    if (!data)
+        return prepared;
+
+    int mipCount = MipCount(prepared.width, prepared.height);
+    while (prepared.floorMip < mipCount - 1 &&
+           std::max(prepared.width >> prepared.floorMip, prepared.height >> prepared.floorMip) > m_Settings.InitialMaxSize)
+        ++prepared.floorMip;
+
+    MipChain chain = TextureProcessing::GenerateMipChain(data, prepared.width, prepared.height, prepared.components, srgb);
+    stbi_image_free(data);
+    prepared.levels.assign(std::make_move_iterator(chain.levels.begin() + prepared.floorMip),
+                           std::make_move_iterator(chain.levels.end()));
+    return prepared;
+}
+
+unsigned int TextureStreamer::Load(PreparedTexture&& prepared)
+{
+    MemoryTagScope tag(MemoryTag::Texture);
+
+    if (prepared.levels.empty())
+    {
+        LOG_ERROR("ERROR::TEXTURE::Failed to load at path: %s", prepared.path.c_str());
+        return 0;
+    }
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    StreamedTexture texture;
+    texture.id         = textureID;
+    texture.path       = std::move(prepared.path);
+    texture.srgb       = prepared.srgb;
+    texture.width      = prepared.width;
+    texture.height     = prepared.height;
+    texture.components = prepared.components;
+    texture.mipCount   = MipCount(prepared.width, prepared.height);
+    texture.residentMip = texture.mipCount; // nothing resident yet
+    texture.floorMip   = prepared.floorMip;
+    texture.requestedMip = texture.floorMip;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    Upload(texture, texture.floorMip, prepared.levels.data(), static_cast<int>(prepared.levels.size()));
+
+    m_Index[textureID] = m_Textures.size();
+    m_Textures.push_back(std::move(texture));
+    return textureID;
+}
+
+void TextureStreamer::Unload(unsigned int textureId)
+{
+    auto it = m_Index.find(textureId);
+    if (it == m_Index.end())
+    {
+        // never streamed (e.g. the file failed to load)
+        glDeleteTextures(1, &textureId);
+        return;
+    }
+
+    StreamedTexture& texture = m_Textures[it->second];
+    if (texture.loading)
+        texture.unloaded = true;
+    else
+        Remove(it->second);
+}
+
+void TextureStreamer::Remove(size_t index)
+{
+    StreamedTexture& texture = m_Textures[index];
+    DropChain(texture);
+    size_t bytes = ChainBytes(texture, texture.residentMip);
+    m_ResidentBytes -= bytes;
+    GpuMemory::Track(GpuMemoryCategory::Texture, -int64_t(bytes));
+    glDeleteTextures(1, &texture.id);
+
+    // swap with the last slot, so only that one's index changes
+    m_Index.erase(texture.id);
+    if (index + 1 != m_Textures.size())
+    {
+        texture = std::move(m_Textures.back());
+        m_Index[texture.id] = index;
+    }
+    m_Textures.pop_back();
+}
+
+void TextureStreamer::RequestResolution(unsigned int textureId, float uvPerPixel)
+{
+    auto it = m_Index.find(textureId);
+    if (it == m_Index.end())
+        return;
+
+    StreamedTexture& texture = m_Textures[it->second];
+
+    float texelsPerPixel = std::max(texture.width, texture.height) * uvPerPixel;
+    int   mip = texelsPerPixel <= 1.0f ? 0 : static_cast<int>(std::floor(std::log2(texelsPerPixel)));
+    mip = std::clamp(mip, 0, texture.floorMip);
+
+    if (texture.lastNeededFrame != m_Frame)
+    {
+        texture.lastNeededFrame = m_Frame;
+        texture.requestedMip    = mip;
+    }
+    else
+    {
+        texture.requestedMip = std::min(texture.requestedMip, mip);
+    }
+}
+
+void TextureStreamer::Update()
+{
+    // 1. hand a bounded number of finished decodes to GL
+    std::vector<DecodedMip> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_CompletedMutex);
+        int count = std::min<int>(m_Settings.MaxUploadsPerFrame, static_cast<int>(m_Completed.size()));
+        for (int i = 0; i < count; ++i)
+        {
+            ready.push_back(std::move(m_Completed.back()));
+            m_Completed.pop_back();
+        }
+    }
+
+    for (DecodedMip& decoded : ready)
+    {
+        size_t           index   = m_Index[decoded.id];
+        StreamedTexture& texture = m_Textures[index];
+        texture.loading = false;
+        --m_LoadsInFlight;
+
+        if (texture.unloaded)
+        {
+            Remove(index);
+            continue;
+        }
+
+        // a chain that does not reach down to mip (the file changed on disk) is not used
+        const int levels = decoded.chain ? static_cast<int>(decoded.chain->levels.size()) : 0;
+        if (decoded.mip >= levels)
+            continue;
+        if (texture.chain != decoded.chain)
+        {
+            DropChain(texture);
+            texture.chain  = std::move(decoded.chain);
+            m_CachedBytes += DecodedBytes(*texture.chain);
+        }
+
+        if (decoded.mip >= texture.residentMip)
+            continue;
+
+        size_t extra = ChainBytes(texture, decoded.mip) - ChainBytes(texture, texture.residentMip);
+        if (!MakeRoom(extra, &texture))
+            continue; // everything resident is in use, try again once something goes out of view
+
+        Upload(texture, decoded.mip, texture.chain->levels.data() + decoded.mip, levels - decoded.mip);
+        ++m_StreamedIn;
+    }
+    TrimChainCache();
+
+    // 2. start decoding finer mips for textures that were visible this frame, most starved first
+    m_Candidates.clear();
+    for (size_t i = 0; i < m_Textures.size(); ++i)
+    {
+        const StreamedTexture& texture = m_Textures[i];
+        if (texture.lastNeededFrame == m_Frame && !texture.loading && texture.requestedMip < texture.residentMip)
+            m_Candidates.push_back(i);
+    }
+    std::sort(m_Candidates.begin(), m_Candidates.end(), [this](size_t a, size_t b) {
+        const StreamedTexture& ta = m_Textures[a];
+        const StreamedTexture& tb = m_Textures[b];
+        return ta.residentMip - ta.requestedMip > tb.residentMip - tb.requestedMip;
+    });
+
+    for (size_t index : m_Candidates)
+    {
+        if (m_LoadsInFlight >= m_Settings.MaxLoadsInFlight)
+            break;
+
+        StreamedTexture& texture = m_Textures[index];
+        texture.loading = true;
+        ++m_LoadsInFlight;
+
+        // decoded before, it lands with the next uploads without going back to the file
+        if (texture.chain)
+        {
+            std::lock_guard<std::mutex> lock(m_CompletedMutex);
+            m_Completed.push_back(DecodedMip{ texture.id, texture.requestedMip, texture.chain });
+            continue;
+        }
+
+        JobSystem::Submit([this, id = texture.id, path = texture.path, components = texture.components,
+                           srgb = texture.srgb, mip = texture.requestedMip]
+        {
+            MemoryTagScope tag(MemoryTag::Texture);
+            DecodedMip decoded{ id, mip, nullptr };
+
+            int width, height, fileComponents;
+            unsigned char* data = stbi_load(path.c_str(), &width, &height, &fileComponents, components);
+            if (data)
+            {
+                decoded.chain = std::make_shared<const MipChain>(
+                    TextureProcessing::GenerateMipChain(data, width, height, components, srgb));
+                stbi_image_free(data);
+            }
+
+            std::lock_guard<std::mutex> lock(m_CompletedMutex);
+            m_Completed.push_back(std::move(decoded));
+        });
+    }
+
+    // 3. requests may have shrunk, stay under budget
+    MakeRoom(0);
+
+    ++m_Frame;
+}
+
+StreamingStats TextureStreamer::GetStats() const
+{
+    StreamingStats stats;
+    stats.ResidentBytes = m_ResidentBytes;
+    stats.BudgetBytes   = m_Settings.BudgetBytes;
+    stats.Textures      = static_cast<unsigned>(m_Textures.size());
+    stats.PendingLoads  = static_cast<unsigned>(m_LoadsInFlight);
+    stats.CachedBytes   = m_CachedBytes;
+    stats.StreamedIn    = m_StreamedIn;
+    stats.Evicted       = m_Evicted;
+    for (const auto& texture : m_Textures)
+    {
+        if (texture.residentMip <= texture.requestedMip)
+            ++stats.FullyResident;
+    }
+    return stats;
+}
+
+void TextureStreamer::Upload(StreamedTexture& texture, int mip, const MipLevel* levels, int count)
+{
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    // respecifying from level 0 keeps the id stable while the storage behind it changes size
+    TextureProcessing::Upload(levels, count, texture.components, texture.srgb);
+
+    size_t previous = ChainBytes(texture, texture.residentMip);
+    texture.residentMip = mip;
+    size_t current  = ChainBytes(texture, texture.residentMip);
+
+    m_ResidentBytes += current - previous;
+    GpuMemory::Track(GpuMemoryCategory::Texture, int64_t(current) - int64_t(previous));
+}
+
+void TextureStreamer::Evict(StreamedTexture& texture, int targetMip)
+{
+    if (texture.chain && targetMip < static_cast<int>(texture.chain->levels.size()))
+    {
+        Upload(texture, targetMip, texture.chain->levels.data() + targetMip,
+               static_cast<int>(texture.chain->levels.size()) - targetMip);
+        ++m_Evicted;
+        return;
+    }
+
+    // the coarser levels are already on the GPU, read them back instead of going to disk.
+    // sRGB textures come back encoded, exactly as they were uploaded
+    std::vector<MipLevel> levels(texture.mipCount - targetMip);
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (int mip = targetMip; mip < texture.mipCount; ++mip)
+    {
+        MipLevel& level = levels[mip - targetMip];
+        level.width  = std::max(1, texture.width  >> mip);
+        level.height = std::max(1, texture.height >> mip);
+        level.pixels.resize(size_t(level.width) * level.height * texture.components);
+        glGetTexImage(GL_TEXTURE_2D, mip - texture.residentMip, TextureProcessing::PixelFormat(texture.components),
+                      GL_UNSIGNED_BYTE, level.pixels.data());
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    Upload(texture, targetMip, levels.data(), static_cast<int>(levels.size()));
+    ++m_Evicted;
+}
+
+bool TextureStreamer::MakeRoom(size_t bytes, const StreamedTexture* keep)
+{
+    while (m_ResidentBytes + bytes > m_Settings.BudgetBytes)
+    {
+        // least recently needed first, never below what is visible right now
+        StreamedTexture* victim = nullptr;
+        for (auto& texture : m_Textures)
+        {
+            if (&texture == keep || texture.residentMip >= texture.floorMip || texture.unloaded)
+                continue;
+            if (texture.lastNeededFrame == m_Frame && texture.residentMip >= texture.requestedMip)
+                continue;
+            if (!victim || texture.lastNeededFrame < victim->lastNeededFrame)
+                victim = &texture;
+        }
+
+        if (!victim)
+            return false;
+
+        int target = victim->residentMip + 1;
+        if (victim->lastNeededFrame == m_Frame)
+            target = std::max(target, victim->requestedMip);
+        Evict(*victim, target);
+    }
+    return true;
+}
+
+void TextureStreamer::DropChain(StreamedTexture& texture)
+{
+    if (!texture.chain)
+        return;
+    m_CachedBytes -= DecodedBytes(*texture.chain);
+    texture.chain.reset();
+}
+
+void TextureStreamer::TrimChainCache()
+{
+    // least recently needed first, like the evictions; a decode in flight holds its own reference
+    while (m_CachedBytes > m_Settings.ChainCacheBytes)
+    {
+        StreamedTexture* victim = nullptr;
+        for (auto& texture : m_Textures)
+        {
+            if (texture.chain && (!victim || texture.lastNeededFrame < victim->lastNeededFrame))
+                victim = &texture;
+        }
+        if (!victim)
+            return;
+        DropChain(*victim);
+    }
+}
+
+size_t TextureStreamer::ChainBytes(const StreamedTexture& texture, int firstMip) const
+{
+    // drivers pad 3 channel textures to 4 bytes per texel
+    size_t bytesPerTexel = texture.components == 3 ? 4 : texture.components;
+    size_t bytes = 0;
+    for (int mip = firstMip; mip < texture.mipCount; ++mip)
+        bytes += size_t(std::max(1, texture.width >> mip)) * std::max(1, texture.height >> mip) * bytesPerTexel;
+    return bytes;
+}
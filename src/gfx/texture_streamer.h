@@ -0,0 +1,145 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "texture_processing.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct StreamingSettings {
+    // VRAM the streamer may use for texture mips
+    size_t BudgetBytes        = size_t(512) * 1024 * 1024;
+    // textures are first uploaded with their largest mip clamped to this size
+    int    InitialMaxSize     = 128;
+    // decoded mips handed to GL per frame, bounds the upload hitch
+    int    MaxUploadsPerFrame = 2;
+    // background decodes in flight at once
+    int    MaxLoadsInFlight   = 4;
+    // system memory for decoded mip chains, so a texture streamed in again after an
+    // eviction takes its levels from there instead of decoding the file again
+    size_t ChainCacheBytes    = size_t(256) * 1024 * 1024;
+};
+
+struct StreamingStats {
+    size_t   ResidentBytes   = 0;
+    size_t   BudgetBytes     = 0;
+    unsigned Textures        = 0;
+    unsigned FullyResident   = 0; // resident mip is at least as fine as the last request
+    unsigned PendingLoads    = 0;
+    size_t   CachedBytes     = 0; // decoded mip chains held in system memory
+    uint64_t StreamedIn      = 0; // totals since startup
+    uint64_t Evicted         = 0;
+};
+
+// a texture decoded on the CPU, down to the mips Load uploads first (see TextureStreamer::Prepare)
+struct PreparedTexture {
+    std::string           path;
+    bool                  srgb       = false;
+    int                   width      = 0;   // of the full image
+    int                   height     = 0;
+    int                   components = 0;
+    int                   floorMip   = 0;   // levels[0] is this mip
+    std::vector<MipLevel> levels;           // empty if the file could not be read
+
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const MipLevel& level : levels)
+            bytes += level.pixels.size();
+        return bytes;
+    }
+};
+
+// Streams texture mip levels in and out under a VRAM budget.
+// Textures start with only their low mips resident. The renderer reports how
+// many uv units a pixel covers for each visible texture, the streamer turns that
+// into a required mip, decodes finer levels on the job system and evicts the least
+// recently needed mips when over budget. GL texture ids stay stable for the whole
+// lifetime of a texture, only the storage behind them is respecified.
+class TextureStreamer
+{
+public:
+    static TextureStreamer& Get();
+
+    void Configure(const StreamingSettings& settings) { m_Settings = settings; }
+
+    // synchronous load of the low mips, returns the GL texture id (0 on failure)
+    // srgb: the file holds color data, stored in an sRGB format so sampling linearizes it
+    unsigned int Load(const std::string& filename, bool srgb);
+
+    // the CPU half of Load: decode the file and build its low mips. Touches no GL
+    // and no streamer state, safe on any thread.
+    PreparedTexture Prepare(const std::string& filename, bool srgb) const;
+    // the GL half: upload a prepared texture's low mips and start streaming it
+    unsigned int Load(PreparedTexture&& prepared);
+
+    // delete the texture and stop streaming it. A decode still in flight is waited
+    // out first, the id is only given back to GL once it has landed.
+    void Unload(unsigned int textureId);
+
+    // note that the texture is visible with uvPerPixel uv units per screen pixel
+    void RequestResolution(unsigned int textureId, float uvPerPixel);
+
+    // finish uploads, kick off new loads and evict over budget, once per frame on the GL thread
+    void Update();
+
+    StreamingStats GetStats() const;
+
+private:
+    struct StreamedTexture {
+        unsigned int id = 0;
+        std::string  path;
+        bool         srgb       = false;
+        int          width      = 0;
+        int          height     = 0;
+        int          components = 0;
+        int          mipCount   = 1;
+        int          floorMip   = 0;       // coarsest mip we keep, set by InitialMaxSize
+        int          residentMip = 0;      // finest mip currently uploaded
+        int          requestedMip = 0;     // finest mip wanted during the last frame it was seen
+        uint64_t     lastNeededFrame = 0;
+        bool         loading    = false;
+        bool         unloaded   = false;   // deleted as soon as its decode in flight lands
+        std::shared_ptr<const MipChain> chain; // every level, kept from the last decode while the cache has room
+    };
+
+    struct DecodedMip {
+        unsigned int                    id;
+        int                             mip;
+        std::shared_ptr<const MipChain> chain; // null if the file could not be read, uploaded from mip on
+    };
+
+    StreamingSettings m_Settings;
+    std::vector<StreamedTexture>               m_Textures;
+    std::unordered_map<unsigned int, size_t>   m_Index; // GL id -> m_Textures slot
+    size_t   m_ResidentBytes = 0;
+    uint64_t m_Frame         = 1;
+    uint64_t m_StreamedIn    = 0;
+    uint64_t m_Evicted       = 0;
+    size_t   m_CachedBytes   = 0;
+    int      m_LoadsInFlight = 0;
+    std::vector<size_t> m_Candidates; // scratch, reused every frame
+
+    std::mutex              m_CompletedMutex;
+    std::vector<DecodedMip> m_Completed;
+
+    TextureStreamer() = default;
+    ~TextureStreamer() = default;
+
+    void   Upload(StreamedTexture& texture, int mip, const MipLevel* levels, int count);
+    void   Remove(size_t index);
+    void   Evict(StreamedTexture& texture, int targetMip);
+    bool   MakeRoom(size_t bytes, const StreamedTexture* keep = nullptr);
+    void   DropChain(StreamedTexture& texture);
+    void   TrimChainCache();
+    size_t ChainBytes(const StreamedTexture& texture, int firstMip) const;
+};
+
+#endif
@@ -0,0 +1,303 @@
+// world_streamer.cpp
+#include "world_streamer.h"
+#include "model.h"
+#include "static_batch.h"
+#include "../core/job_system.hpp"
+#include "../core/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    float DistanceToBox(const AABB& box, const glm::vec3& p)
+    {
+        glm::vec3 d = glm::max(glm::max(box.Min - p, p - box.Max), glm::vec3(0.0f));
+        return glm::length(d);
+    }
+
+    float Milliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+}
+
+WorldStreamer::WorldStreamer(entt::registry& registry, StaticBatcher* batcher, const WorldStreamingSettings& settings)
+    : m_Registry(registry), m_Batcher(batcher), m_Settings(settings)
+{
+}
+
+WorldStreamer::~WorldStreamer()
+{
+    // imports in flight write into m_Completed, wait them out
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_CompletedMutex);
+            if (static_cast<int>(m_Completed.size()) >= m_LoadsInFlight)
+                break;
+        }
+        std::this_thread::yield();
+    }
+
+    for (auto& pair : m_Cells)
+        Despawn(pair.second);
+    for (Asset& asset : m_Assets)
+        Unload(asset);
+}
+
+uint32_t WorldStreamer::AddAsset(const std::string& path, ShaderVariants* shaders, Impostor* impostor)
+{
+    Asset asset;
+    asset.path     = path;
+    asset.shaders  = shaders;
+    asset.impostor = impostor;
+    m_Assets.push_back(std::move(asset));
+    return static_cast<uint32_t>(m_Assets.size() - 1);
+}
+
+uint32_t WorldStreamer::AddResidentAsset(Model& model, ShaderVariants* shaders, Impostor* impostor)
+{
+    Asset asset;
+    asset.shaders  = shaders;
+    asset.impostor = impostor;
+    asset.model    = &model;
+    asset.state    = AssetState::Resident;
+    m_Assets.push_back(std::move(asset));
+    return static_cast<uint32_t>(m_Assets.size() - 1);
+}
+
+void WorldStreamer::AddPlacement(uint32_t asset, const glm::mat4& transform, bool isStatic)
+{
+    glm::vec3  origin = glm::vec3(transform[3]);
+    glm::ivec3 index  = glm::ivec3(glm::floor(origin / m_Settings.CellSize));
+
+    Cell& cell = m_Cells[CellKey{ index.x, index.y, index.z }];
+    if (cell.placements.empty())
+    {
+        cell.bounds.Min = glm::vec3(index) * m_Settings.CellSize;
+        cell.bounds.Max = cell.bounds.Min + glm::vec3(m_Settings.CellSize);
+    }
+    cell.placements.push_back(Placement{ asset, transform, isStatic });
+    if (std::find(cell.assets.begin(), cell.assets.end(), asset) == cell.assets.end())
+        cell.assets.push_back(asset);
+
+    // a placement added to a live cell shows up with the next load of the cell
+}
+
+void WorldStreamer::Update(const glm::vec3& eye, const glm::vec3& velocity)
+{
+    auto start = Clock::now();
+    ++m_Update;
+
+    // 1. pick the cells in range. Entering uses LoadRadius and leaving UnloadRadius,
+    //    both measured from whichever of the camera and its prediction is closer
+    const glm::vec3 predicted = eye + velocity * m_Settings.PrefetchSeconds;
+    m_Queue.clear();
+    for (auto& pair : m_Cells)
+    {
+        Cell& cell = pair.second;
+        cell.distance = std::min(DistanceToBox(cell.bounds, eye), DistanceToBox(cell.bounds, predicted));
+
+        if (cell.state == CellState::Unloaded)
+        {
+            if (cell.distance > m_Settings.LoadRadius)
+                continue;
+            for (uint32_t asset : cell.assets)
+                ++m_Assets[asset].refs;
+            cell.state = CellState::Waiting;
+        }
+        else if (cell.distance > m_Settings.UnloadRadius)
+        {
+            Release(cell);
+            continue;
+        }
+
+        if (cell.state == CellState::Waiting)
+            m_Queue.push_back(&cell);
+    }
+    std::sort(m_Queue.begin(), m_Queue.end(), [](const Cell* a, const Cell* b) { return a->distance < b->distance; });
+
+    // 2. create a bounded number of finished imports in GL, then queue more
+    Activate();
+    StartLoads();
+
+    // 3. cells whose assets are all resident come alive
+    for (Cell* cell : m_Queue)
+    {
+        bool ready = std::all_of(cell->assets.begin(), cell->assets.end(), [this](uint32_t asset) {
+            return m_Assets[asset].state == AssetState::Resident || m_Assets[asset].state == AssetState::Failed;
+        });
+        if (ready)
+            Spawn(*cell);
+    }
+
+    m_Stats.Cells          = m_Cells.size();
+    m_Stats.LoadedCells    = 0;
+    m_Stats.WaitingCells   = 0;
+    for (const auto& pair : m_Cells)
+    {
+        m_Stats.LoadedCells  += pair.second.state == CellState::Loaded;
+        m_Stats.WaitingCells += pair.second.state == CellState::Waiting;
+    }
+    m_Stats.ResidentAssets = 0;
+    for (const Asset& asset : m_Assets)
+        m_Stats.ResidentAssets += asset.state == AssetState::Resident;
+    m_Stats.ResidentBytes  = m_ResidentBytes;
+    m_Stats.PendingLoads   = static_cast<unsigned>(m_LoadsInFlight);
+
+    m_Stats.UpdateMs    = Milliseconds(Clock::now() - start);
+    m_Stats.MaxUpdateMs = std::max(m_Stats.MaxUpdateMs, m_Stats.UpdateMs);
+    if (m_Stats.UpdateMs > m_Settings.HitchMs)
+        ++m_Stats.Hitches;
+}
+
+void WorldStreamer::Activate()
+{
+    for (int i = 0; i < m_Settings.MaxActivationsPerFrame; ++i)
+    {
+        CompletedLoad load;
+        {
+            std::lock_guard<std::mutex> lock(m_CompletedMutex);
+            if (m_Completed.empty())
+                return;
+            load = std::move(m_Completed.back());
+            m_Completed.pop_back();
+        }
+        --m_LoadsInFlight;
+
+        // neither of these costs GL work, they do not count against the per-frame limit
+        Asset& asset = m_Assets[load.asset];
+        if (!load.import->Valid())
+        {
+            // logged by the import. Cells spawn without it from now on
+            asset.state = AssetState::Failed;
+            --i;
+            continue;
+        }
+        if (asset.refs == 0)
+        {
+            // every cell that wanted it went out of range meanwhile
+            asset.state = AssetState::Unloaded;
+            --i;
+            continue;
+        }
+
+        size_t bytes = load.import->Bytes();
+        asset.owned  = std::make_unique<Model>(*load.import);
+        asset.model  = asset.owned.get();
+        asset.bytes  = bytes;
+        asset.state  = AssetState::Resident;
+        m_ResidentBytes += bytes;
+
+        float latency = Milliseconds(Clock::now() - asset.requested);
+        ++m_Stats.Loads;
+        m_TotalLoadMs          += latency;
+        m_Stats.LastLoadMs      = latency;
+        m_Stats.AverageLoadMs   = static_cast<float>(m_TotalLoadMs / double(m_Stats.Loads));
+        m_Stats.MaxLoadMs       = std::max(m_Stats.MaxLoadMs, latency);
+    }
+}
+
+void WorldStreamer::StartLoads()
+{
+    // nearest cells first, each asset once however many cells wait on it
+    for (Cell* cell : m_Queue)
+    {
+        for (uint32_t index : cell->assets)
+        {
+            Asset& asset = m_Assets[index];
+            if (asset.state != AssetState::Unloaded)
+                continue;
+            if (m_LoadsInFlight >= m_Settings.MaxLoadsInFlight)
+                return;
+            if (!MakeRoom())
+            {
+                ++m_Stats.BudgetStalls;
+                return;
+            }
+
+            asset.state     = AssetState::Loading;
+            asset.requested = Clock::now();
+            ++m_LoadsInFlight;
+
+            JobSystem::Submit([this, index, path = asset.path]
+            {
+                CompletedLoad load{ index, Model::Import(path) };
+
+                std::lock_guard<std::mutex> lock(m_CompletedMutex);
+                m_Completed.push_back(std::move(load));
+            });
+        }
+    }
+}
+
+bool WorldStreamer::MakeRoom()
+{
+    // unused assets stay cached while there is room, least recently used go first
+    while (m_ResidentBytes >= m_Settings.BudgetBytes)
+    {
+        Asset* oldest = nullptr;
+        for (Asset& asset : m_Assets)
+        {
+            if (asset.owned && asset.refs == 0 && (!oldest || asset.lastUsed < oldest->lastUsed))
+                oldest = &asset;
+        }
+        if (!oldest)
+            return false; // everything resident is in use
+        Unload(*oldest);
+    }
+    return true;
+}
+
+void WorldStreamer::Spawn(Cell& cell)
+{
+    cell.entities.reserve(cell.placements.size());
+    for (const Placement& placement : cell.placements)
+    {
+        const Asset& asset = m_Assets[placement.asset];
+        if (!asset.model)
+            continue;
+
+        entt::entity entity = m_Registry.create();
+        m_Registry.emplace<TransformComponent>(entity, placement.transform);
+        m_Registry.emplace<RenderableComponent>(entity, asset.model, asset.shaders, placement.isStatic, asset.impostor);
+        m_Registry.emplace<BoundsComponent>(entity, asset.model->GetBounds());
+        cell.entities.push_back(entity);
+    }
+    cell.state = CellState::Loaded;
+}
+
+void WorldStreamer::Despawn(Cell& cell)
+{
+    m_Registry.destroy(cell.entities.begin(), cell.entities.end());
+    cell.entities.clear();
+}
+
+void WorldStreamer::Release(Cell& cell)
+{
+    Despawn(cell);
+    for (uint32_t index : cell.assets)
+    {
+        Asset& asset = m_Assets[index];
+        if (--asset.refs == 0)
+            asset.lastUsed = m_Update;
+    }
+    cell.state = CellState::Unloaded;
+}
+
+void WorldStreamer::Unload(Asset& asset)
+{
+    if (!asset.owned)
+        return;
+
+    if (m_Batcher)
+        m_Batcher->Forget(*asset.owned);
+    asset.owned.reset();
+    asset.model = nullptr;
+    asset.state = AssetState::Unloaded;
+    m_ResidentBytes -= asset.bytes;
+    asset.bytes = 0;
+    ++m_Stats.Unloads;
+}
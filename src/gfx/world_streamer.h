@@ -0,0 +1,175 @@
+#ifndef WORLD_STREAMER_H
+#define WORLD_STREAMER_H
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frustum.h"
+
+class Model;
+class ShaderVariants;
+class Impostor;
+class StaticBatcher;
+struct ModelImport;
+
+struct WorldStreamingSettings {
+    // edge of the world-space grid cells placements are grouped by
+    float  CellSize               = 32.0f;
+    // a cell is loaded once its bounds come this close to the camera. Keep it at
+    // least at the far plane, placements beyond it are not drawn at all (not even
+    // as impostors) and would pop out in view
+    float  LoadRadius             = 64.0f;
+    // and unloaded once farther than this, the gap keeps border cells from thrashing
+    float  UnloadRadius           = 96.0f;
+    // the camera is extrapolated this many seconds along its velocity, cells ahead load early
+    float  PrefetchSeconds        = 1.5f;
+    // estimated VRAM of streamed assets. Unused ones stay cached below it, loads wait above it
+    size_t BudgetBytes            = size_t(256) * 1024 * 1024;
+    // background imports in flight at once
+    int    MaxLoadsInFlight       = 2;
+    // finished imports turned into GL objects per frame, bounds the upload hitch
+    int    MaxActivationsPerFrame = 1;
+    // an Update slower than this counts as a hitch
+    float  HitchMs                = 2.0f;
+};
+
+// Streams the world in and out around the camera. The world is registered up
+// front as placements of model assets, which are grouped into grid cells. Every
+// Update, cells within LoadRadius of the camera, or of where its velocity takes it
+// within PrefetchSeconds, are queued nearest first; their assets are imported on
+// the job system (file parsing, mesh conversion, texture decoding) and created in
+// GL on the calling thread a bounded number per frame. Once all of a cell's assets
+// are resident its placements become registry entities, and they are destroyed
+// again when the cell falls behind UnloadRadius. Assets are shared between cells
+// and refcounted; unused ones stay cached until the budget needs their room.
+class WorldStreamer
+{
+public:
+    struct Stats {
+        size_t   Cells            = 0;
+        size_t   LoadedCells      = 0;
+        size_t   WaitingCells     = 0; // in range, assets still loading
+        size_t   ResidentAssets   = 0;
+        size_t   ResidentBytes    = 0; // streamed assets only, resident ones are not counted
+        unsigned PendingLoads     = 0;
+        // totals since startup
+        uint64_t Loads            = 0;
+        uint64_t Unloads          = 0;
+        uint64_t BudgetStalls     = 0; // Updates that held a load back for the budget
+        uint64_t Hitches          = 0; // Updates over HitchMs
+        // request to activation of an asset, and the time spent in Update
+        float    LastLoadMs       = 0.0f;
+        float    AverageLoadMs    = 0.0f;
+        float    MaxLoadMs        = 0.0f;
+        float    UpdateMs         = 0.0f;
+        float    MaxUpdateMs      = 0.0f;
+    };
+
+    // with a batcher given, it forgets the geometry of every model unloaded
+    explicit WorldStreamer(entt::registry& registry, StaticBatcher* batcher = nullptr,
+                           const WorldStreamingSettings& settings = WorldStreamingSettings());
+    ~WorldStreamer();
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    // a model asset placements can refer to, returns its id. Each entity is drawn
+    // with shaders, and switches over to impostor (if any) far away.
+    uint32_t AddAsset(const std::string& path, ShaderVariants* shaders, Impostor* impostor = nullptr);
+    // an asset that is already loaded and owned elsewhere, never unloaded
+    uint32_t AddResidentAsset(Model& model, ShaderVariants* shaders, Impostor* impostor = nullptr);
+
+    // place an asset in the world, in the cell its origin falls in
+    void AddPlacement(uint32_t asset, const glm::mat4& transform, bool isStatic);
+
+    // once per frame before the scene is queried, with the GL context current
+    void Update(const glm::vec3& eye, const glm::vec3& velocity);
+
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class AssetState { Unloaded, Loading, Resident, Failed };
+
+    struct Asset {
+        std::string            path;
+        ShaderVariants*        shaders  = nullptr;
+        Impostor*              impostor = nullptr;
+        Model*                 model    = nullptr;  // valid while Resident
+        std::unique_ptr<Model> owned;               // null for resident assets
+        AssetState             state    = AssetState::Unloaded;
+        uint32_t               refs     = 0;        // cells in range that use it
+        size_t                 bytes    = 0;
+        uint64_t               lastUsed = 0;        // Update the last cell let go of it
+        Clock::time_point      requested;
+    };
+
+    struct Placement {
+        uint32_t  asset;
+        glm::mat4 transform;
+        bool      isStatic;
+    };
+
+    struct CellKey {
+        int x, y, z;
+
+        bool operator<(const CellKey& other) const
+        {
+            if (x != other.x) return x < other.x;
+            if (y != other.y) return y < other.y;
+            return z < other.z;
+        }
+    };
+
+    enum class CellState { Unloaded, Waiting, Loaded };
+
+    struct Cell {
+        AABB                      bounds;     // the grid cell, distances are measured to it
+        std::vector<Placement>    placements;
+        std::vector<uint32_t>     assets;     // unique
+        std::vector<entt::entity> entities;   // while Loaded
+        CellState                 state    = CellState::Unloaded;
+        float                     distance = 0.0f; // to the nearer of camera and prediction
+    };
+
+    struct CompletedLoad {
+        uint32_t                     asset;
+        std::unique_ptr<ModelImport> import;
+    };
+
+    entt::registry&        m_Registry;
+    StaticBatcher*         m_Batcher;
+    WorldStreamingSettings m_Settings;
+
+    std::vector<Asset>        m_Assets;
+    std::map<CellKey, Cell>   m_Cells;
+    std::vector<Cell*>        m_Queue;        // scratch: waiting cells, nearest first
+    uint64_t                  m_Update        = 0;
+    int                       m_LoadsInFlight = 0;
+    size_t                    m_ResidentBytes = 0;
+    double                    m_TotalLoadMs   = 0.0;
+    Stats                     m_Stats;
+
+    std::mutex                 m_CompletedMutex;
+    std::vector<CompletedLoad> m_Completed;
+
+    void Activate();
+    void StartLoads();
+    bool MakeRoom();
+    void Spawn(Cell& cell);
+    void Despawn(Cell& cell);
+    void Release(Cell& cell);
+    void Unload(Asset& asset);
+};
+
+#endif
@@ -1,2 +1,40 @@
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+// decoded images go through operator new so they are counted under the caller's memory tag
+static void* StbMalloc(size_t size)
+{
+    return ::operator new(size, std::nothrow);
+}
+
+static void StbFree(void* p)
+{
+    ::operator delete(p);
+}
+
+static void* StbRealloc(void* p, size_t oldSize, size_t newSize)
+{
+    void* grown = StbMalloc(newSize);
+    if (!grown)
+        return nullptr; // stb keeps (and later frees) the old block
+    if (p)
+        std::memcpy(grown, p, oldSize < newSize ? oldSize : newSize);
+    StbFree(p);
+    return grown;
+}
+
+#define STBI_MALLOC(size)                        StbMalloc(size)
+#define STBI_REALLOC_SIZED(p, oldSize, newSize)  StbRealloc(p, oldSize, newSize)
+#define STBI_FREE(p)                             StbFree(p)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+
+// encoded images (screen captures) are counted the same way
+#define STBIW_MALLOC(size)                       StbMalloc(size)
+#define STBIW_REALLOC_SIZED(p, oldSize, newSize) StbRealloc(p, oldSize, newSize)
+#define STBIW_FREE(p)                            StbFree(p)
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
@@ -0,0 +1,262 @@
+// bench_import.cpp: mesh conversion and CPU mip chains
+#include "harness.h"
+
+#include "gfx/mesh_import.h"
+#include "gfx/texture_processing.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // side x side vertex grid, two triangles per cell, every attribute the importer reads
+    std::unique_ptr<aiMesh> MakeGrid(unsigned int side)
+    {
+        auto mesh = std::make_unique<aiMesh>();
+        const unsigned int count = side * side;
+
+        mesh->mPrimitiveTypes    = aiPrimitiveType_TRIANGLE;
+        mesh->mNumVertices       = count;
+        mesh->mVertices          = new aiVector3D[count];
+        mesh->mNormals           = new aiVector3D[count];
+        mesh->mTangents          = new aiVector3D[count];
+        mesh->mBitangents        = new aiVector3D[count];
+        mesh->mTextureCoords[0]  = new aiVector3D[count];
+        mesh->mNumUVComponents[0] = 2;
+        for (unsigned int y = 0; y < side; ++y)
+        {
+            for (unsigned int x = 0; x < side; ++x)
+            {
+                unsigned int i = y * side + x;
+                float u = float(x) / float(side - 1);
+                float v = float(y) / float(side - 1);
+                mesh->mVertices[i]         = aiVector3D(u * 100.0f, std::sin(u * 20.0f) * std::cos(v * 20.0f), v * 100.0f);
+                mesh->mNormals[i]          = aiVector3D(0.0f, 1.0f, 0.0f);
+                mesh->mTangents[i]         = aiVector3D(1.0f, 0.0f, 0.0f);
+                mesh->mBitangents[i]       = aiVector3D(0.0f, 0.0f, 1.0f);
+                mesh->mTextureCoords[0][i] = aiVector3D(u, v, 0.0f);
+            }
+        }
+
+        mesh->mNumFaces = 2 * (side - 1) * (side - 1);
+        mesh->mFaces    = new aiFace[mesh->mNumFaces];
+        unsigned int face = 0;
+        for (unsigned int y = 0; y + 1 < side; ++y)
+        {
+            for (unsigned int x = 0; x + 1 < side; ++x)
+            {
+                unsigned int i = y * side + x;
+                const unsigned int triangles[2][3] = { { i, i + side, i + 1 }, { i + 1, i + side, i + side + 1 } };
+                for (const auto& triangle : triangles)
+                {
+                    aiFace& f     = mesh->mFaces[face++];
+                    f.mNumIndices = 3;
+                    f.mIndices    = new unsigned int[3]{ triangle[0], triangle[1], triangle[2] };
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // the conversion loop Model::processMesh ran before MeshImport
+    void LegacyConvert(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex vertex{};
+            glm::vec3 vector;
+
+            vector.x = mesh->mVertices[i].x;
+            vector.y = mesh->mVertices[i].y;
+            vector.z = mesh->mVertices[i].z;
+            vertex.Position = vector;
+
+            if (mesh->HasNormals())
+            {
+                vector.x = mesh->mNormals[i].x;
+                vector.y = mesh->mNormals[i].y;
+                vector.z = mesh->mNormals[i].z;
+                vertex.Normal = vector;
+            }
+
+            if (mesh->mTextureCoords[0])
+            {
+                glm::vec2 vec;
+                vec.x = mesh->mTextureCoords[0][i].x;
+                vec.y = mesh->mTextureCoords[0][i].y;
+                vertex.TexCoords = vec;
+
+                vector.x = mesh->mTangents[i].x;
+                vector.y = mesh->mTangents[i].y;
+                vector.z = mesh->mTangents[i].z;
+                vertex.Tangent = vector;
+
+                vector.x = mesh->mBitangents[i].x;
+                vector.y = mesh->mBitangents[i].y;
+                vector.z = mesh->mBitangents[i].z;
+                vertex.Bitangent = vector;
+            }
+            else
+            {
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            }
+
+            for (int b = 0; b < MAX_BONE_INFLUENCE; ++b) {
+                vertex.m_BoneIDs[b] = 0;
+                vertex.m_Weights[b] = 0.0f;
+            }
+
+            vertices.push_back(vertex);
+        }
+
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            aiFace face = mesh->mFaces[i];
+            for (unsigned int j = 0; j < face.mNumIndices; j++)
+                indices.push_back(face.mIndices[j]);
+        }
+    }
+
+    bool SameVertex(const Vertex& a, const Vertex& b)
+    {
+        if (a.Position != b.Position || a.Normal != b.Normal || a.TexCoords != b.TexCoords ||
+            a.Tangent != b.Tangent || a.Bitangent != b.Bitangent)
+            return false;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+        {
+            if (a.m_BoneIDs[i] != b.m_BoneIDs[i] || a.m_Weights[i] != b.m_Weights[i])
+                return false;
+        }
+        return true;
+    }
+
+    void MeshImportBenchmarks(BenchmarkRunner& runner)
+    {
+        const bool quick = runner.GetOptions().Quick;
+        for (unsigned int side : { quick ? 256u : 1024u, quick ? 512u : 1448u })
+        {
+            // built on first use and shared by the three cases, dropped before the next size
+            std::unique_ptr<aiMesh> mesh;
+            std::vector<Vertex>       reference;
+            std::vector<unsigned int> referenceIndices;
+            auto prepare = [&]() {
+                if (mesh)
+                    return;
+                mesh = MakeGrid(side);
+                LegacyConvert(mesh.get(), reference, referenceIndices);
+            };
+
+            const std::string suffix = "/vertices:" + std::to_string(side * side);
+
+            runner.Run("MeshImport/PerVertexLoop" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(mesh->mNumVertices));
+                while (state.Running())
+                {
+                    std::vector<Vertex>       vertices;
+                    std::vector<unsigned int> indices;
+                    LegacyConvert(mesh.get(), vertices, indices);
+                    KeepAlive(vertices);
+                    KeepAlive(indices);
+
+                    state.Pause();
+                    vertices = std::vector<Vertex>();
+                    indices  = std::vector<unsigned int>();
+                    state.Resume();
+                }
+            });
+
+            // the bulk kernels on one thread
+            runner.Run("MeshImport/ConvertVertices" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(mesh->mNumVertices));
+                while (state.Running())
+                {
+                    std::vector<Vertex>       vertices(mesh->mNumVertices);
+                    std::vector<unsigned int> indices(MeshImport::CountIndices(mesh.get()));
+                    MeshImport::ConvertVertices(mesh.get(), vertices.data(), 0, vertices.size());
+                    MeshImport::ConvertIndices(mesh.get(), indices.data());
+                    KeepAlive(vertices);
+                    KeepAlive(indices);
+
+                    state.Pause();
+                    vertices = std::vector<Vertex>();
+                    indices  = std::vector<unsigned int>();
+                    state.Resume();
+                }
+            });
+
+            // parallel conversion plus meshlet building, checked against the legacy loop
+            runner.Run("MeshImport/Import" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(mesh->mNumVertices));
+                while (state.Running())
+                {
+                    ImportedMesh imported = MeshImport::Import(mesh.get());
+
+                    state.Pause();
+                    if (state.Iterations() == 1)
+                    {
+                        state.SetCounter("meshlets", double(imported.meshlets.size()));
+                        bool same = imported.vertices.size() == reference.size() && imported.indices == referenceIndices;
+                        for (size_t i = 0; same && i < reference.size(); ++i)
+                            same = SameVertex(imported.vertices[i], reference[i]);
+                        if (!same)
+                            state.Fail("bulk conversion differs from the per-vertex loop");
+                    }
+                    imported = ImportedMesh();
+                    state.Resume();
+                }
+            });
+        }
+    }
+
+    void MipChainBenchmarks(BenchmarkRunner& runner)
+    {
+        const int size = runner.GetOptions().Quick ? 512 : 2048;
+
+        std::vector<unsigned char> pixels;
+        for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser })
+        {
+            for (bool srgb : { false, true })
+            {
+                std::string name = std::string("Texture/GenerateMipChain/") + (filter == MipFilter::Box ? "box" : "kaiser")
+                                 + (srgb ? "/srgb" : "/linear") + "/size:" + std::to_string(size);
+                runner.Run(name, [&](BenchmarkState& state) {
+                    if (pixels.empty())
+                    {
+                        // smooth gradient with some noise, RGBA8
+                        pixels.resize(size_t(size) * size * 4);
+                        uint32_t seed = 1;
+                        for (size_t i = 0; i < pixels.size(); ++i)
+                        {
+                            seed = seed * 1664525u + 1013904223u;
+                            pixels[i] = static_cast<unsigned char>(((i / 4) % size) * 255 / size / 2 + (seed >> 25));
+                        }
+                    }
+
+                    state.SetItems(double(size) * size);
+                    while (state.Running())
+                    {
+                        MipChain chain = TextureProcessing::GenerateMipChain(pixels.data(), size, size, 4, srgb, filter);
+                        KeepAlive(chain);
+
+                        state.Pause();
+                        if (state.Iterations() == 1)
+                            state.SetCounter("levels", double(chain.levels.size()));
+                        chain = MipChain();
+                        state.Resume();
+                    }
+                });
+            }
+        }
+    }
+}
+
+void RunImportBenchmarks(BenchmarkRunner& runner)
+{
+    MeshImportBenchmarks(runner);
+    MipChainBenchmarks(runner);
+}
@@ -0,0 +1,386 @@
+// bench_renderer.cpp: submission, uniforms, texture binding, the camera and a steady-state frame
+#include "harness.h"
+
+#include "gfx/camera.h"
+#include "gfx/mesh.h"
+#include "gfx/renderer.h"
+#include "gfx/shader.h"
+#include "gfx/shader_variants.h"
+#include "gfx/shadow_map.h"
+#include "core/alloc_counter.hpp"
+#include "core/job_system.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const glm::mat4 VIEW       = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 PROJECTION = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+    // unit cube, 24 vertices so every face has its own normal
+    std::unique_ptr<Mesh> MakeCube(std::vector<Texture> textures = {})
+    {
+        std::vector<Vertex>       vertices;
+        std::vector<unsigned int> indices;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (float side : { -0.5f, 0.5f })
+            {
+                glm::vec3 normal(0.0f);
+                normal[axis] = side * 2.0f;
+                glm::vec3 u(0.0f), v(0.0f);
+                u[(axis + 1) % 3] = 1.0f;
+                v[(axis + 2) % 3] = 1.0f;
+
+                unsigned int first = static_cast<unsigned int>(vertices.size());
+                for (int corner = 0; corner < 4; ++corner)
+                {
+                    Vertex vertex{};
+                    float  du = corner & 1 ? 0.5f : -0.5f;
+                    float  dv = corner & 2 ? 0.5f : -0.5f;
+                    vertex.Position  = normal * 0.5f + u * du + v * dv;
+                    vertex.Normal    = normal;
+                    vertex.TexCoords = glm::vec2(du + 0.5f, dv + 0.5f);
+                    vertex.Tangent   = u;
+                    vertex.Bitangent = v;
+                    vertices.push_back(vertex);
+                }
+                for (unsigned int index : { 0u, 1u, 3u, 0u, 3u, 2u })
+                    indices.push_back(first + index);
+            }
+        }
+        return std::make_unique<Mesh>(std::move(vertices), std::move(indices), std::move(textures));
+    }
+
+    // scattered in front of the camera, most of them inside the frustum
+    std::vector<glm::mat4> MakeTransforms(size_t count)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> depth(-200.0f, -2.0f);
+
+        std::vector<glm::mat4> transforms(count);
+        for (glm::mat4& transform : transforms)
+            transform = glm::translate(glm::mat4(1.0f), glm::vec3(spread(random), spread(random) * 0.5f, depth(random)));
+        return transforms;
+    }
+
+    // what BindTextures did before the sampler names were cached on the mesh
+    void LegacyBindTextures(const Mesh& mesh, const Shader& shader)
+    {
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+
+        for (unsigned int i = 0; i < mesh.textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+
+            std::string number;
+            std::string name = mesh.textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++);
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++);
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++);
+
+            int loc = glGetUniformLocation(shader.ID, (name + number).c_str());
+            if (loc != -1)
+                glUniform1i(loc, i);
+
+            glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void SubmissionBenchmarks(BenchmarkRunner& runner, Shader& shader)
+    {
+        const size_t instances = runner.GetOptions().Quick ? 8192 : 65536;
+
+        for (size_t batches : { 1, 16, 256, 4096 })
+        {
+            // meshes and transforms are shared by both cases, built only if either runs
+            std::vector<std::unique_ptr<Mesh>> meshes;
+            std::vector<glm::mat4>             transforms;
+            auto prepare = [&]() {
+                if (!meshes.empty())
+                    return;
+                for (size_t i = 0; i < batches; ++i)
+                    meshes.push_back(MakeCube());
+                transforms = MakeTransforms(instances);
+            };
+            auto submit = [&]() {
+                for (size_t i = 0; i < instances; ++i)
+                    Renderer::SubmitMesh(meshes[i % batches].get(), &shader, transforms[i], (i & 3) == 0);
+            };
+
+            const std::string suffix = "/batches:" + std::to_string(batches);
+            runner.Run("Renderer/SubmitMesh" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(instances));
+                while (state.Running())
+                {
+                    state.Pause();
+                    Renderer::BeginScene(VIEW, PROJECTION);
+                    state.Resume();
+
+                    submit();
+
+                    state.Pause();
+                    Renderer::EndScene();
+                    state.Resume();
+                }
+            });
+
+            // culling, sorting by shader and the (stubbed) GL calls of a frame
+            runner.Run("Renderer/EndScene" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(instances));
+                while (state.Running())
+                {
+                    state.Pause();
+                    Renderer::BeginScene(VIEW, PROJECTION);
+                    submit();
+                    state.Resume();
+
+                    Renderer::EndScene();
+                }
+            });
+        }
+    }
+
+    void ContextBenchmarks(BenchmarkRunner& runner, Shader& shader)
+    {
+        const size_t instances = runner.GetOptions().Quick ? 32768 : 262144;
+        const size_t batches   = 256;
+
+        std::vector<size_t> counts = { 1, 2, 4, 8 };
+        counts.push_back(JobSystem::WorkerCount() + 1);
+        std::sort(counts.begin(), counts.end());
+        counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+
+        std::vector<std::unique_ptr<Mesh>> meshes;
+        std::vector<glm::mat4>             transforms;
+
+        for (size_t contexts : counts)
+        {
+            // one context per slice, submitted in parallel and merged by GetStaticSetHash.
+            // The merge is deterministic, so every frame must hash the same.
+            runner.Run("Renderer/SubmissionContexts/contexts:" + std::to_string(contexts), [&](BenchmarkState& state) {
+                if (meshes.empty())
+                {
+                    for (size_t i = 0; i < batches; ++i)
+                        meshes.push_back(MakeCube());
+                    transforms = MakeTransforms(instances);
+                }
+
+                state.SetItems(double(instances));
+                uint64_t expected = 0;
+                while (state.Running())
+                {
+                    state.Pause();
+                    Renderer::BeginScene(VIEW, PROJECTION);
+                    state.Resume();
+
+                    Renderer::BeginContexts(contexts);
+                    JobSystem::ParallelFor(contexts, 1, [&](size_t begin, size_t end) {
+                        for (size_t c = begin; c < end; ++c)
+                        {
+                            Renderer::SubmissionContext& context = Renderer::GetContext(c);
+                            for (size_t i = instances * c / contexts; i < instances * (c + 1) / contexts; ++i)
+                                context.SubmitMesh(meshes[i % batches].get(), &shader, transforms[i], (i & 3) == 0);
+                        }
+                    });
+                    uint64_t hash = Renderer::GetStaticSetHash();
+
+                    state.Pause();
+                    if (state.Iterations() == 1)
+                        expected = hash;
+                    else if (hash != expected)
+                        state.Fail("static set hash differs between identical frames");
+                    Renderer::EndScene();
+                    state.Resume();
+                }
+            });
+        }
+    }
+
+    void UniformBenchmarks(BenchmarkRunner& runner, Shader& shader)
+    {
+        // longer than the small string buffer, so a temporary std::string allocates
+        const char* const name = "lightSpaceMatrices[0]";
+        glm::mat4 matrix(1.0f);
+
+        runner.Run("Shader/setMat4/const char*", [&](BenchmarkState& state) {
+            state.SetItems(1.0);
+            while (state.Running())
+                shader.setMat4(name, matrix);
+        });
+
+        runner.Run("Shader/setMat4/temporary std::string", [&](BenchmarkState& state) {
+            state.SetItems(1.0);
+            while (state.Running())
+                shader.setMat4(std::string(name), matrix);
+        });
+
+        // the floor: a location looked up once
+        runner.Run("Shader/setMat4/cached location", [&](BenchmarkState& state) {
+            GLint location = glGetUniformLocation(shader.ID, name);
+            state.SetItems(1.0);
+            while (state.Running())
+                glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]);
+        });
+    }
+
+    void TextureBindingBenchmarks(BenchmarkRunner& runner, Shader& shader, Shader& other)
+    {
+        std::unique_ptr<Mesh> mesh;
+        auto prepare = [&]() {
+            if (!mesh)
+                mesh = MakeCube({ { 1, "texture_diffuse", "" }, { 2, "texture_specular", "" },
+                                  { 3, "texture_normal", "" },  { 4, "texture_height", "" } });
+        };
+
+        runner.Run("Mesh/BindTextures/same program", [&](BenchmarkState& state) {
+            prepare();
+            state.SetItems(double(mesh->textures.size()));
+            while (state.Running())
+                mesh->BindTextures(shader);
+        });
+
+        // every bind refills the sampler location cache
+        runner.Run("Mesh/BindTextures/program switch", [&](BenchmarkState& state) {
+            prepare();
+            state.SetItems(double(mesh->textures.size()));
+            while (state.Running())
+                mesh->BindTextures(state.Iterations() & 1 ? shader : other);
+        });
+
+        runner.Run("Mesh/BindTextures/legacy name building", [&](BenchmarkState& state) {
+            prepare();
+            state.SetItems(double(mesh->textures.size()));
+            while (state.Running())
+                LegacyBindTextures(*mesh, shader);
+        });
+    }
+
+    void CameraBenchmarks(BenchmarkRunner& runner)
+    {
+        runner.Run("Camera/GetViewMatrix", [&](BenchmarkState& state) {
+            Camera camera(glm::vec3(0.0f, 2.0f, 10.0f));
+            state.SetItems(1.0);
+            while (state.Running())
+            {
+                camera.Position.x += 1e-6f;
+                glm::mat4 view = camera.GetViewMatrix();
+                KeepAlive(view);
+            }
+        });
+
+        // recomputes Front/Right/Up through updateCameraVectors
+        runner.Run("Camera/ProcessMouseMovement", [&](BenchmarkState& state) {
+            Camera camera(glm::vec3(0.0f, 2.0f, 10.0f));
+            state.SetItems(1.0);
+            while (state.Running())
+            {
+                camera.ProcessMouseMovement(state.Iterations() & 1 ? 1.0f : -1.0f, 0.5f);
+                KeepAlive(camera.Front);
+            }
+        });
+    }
+
+    // the render thread's part of an app frame: main thread and context submissions,
+    // shadow depth passes and the scene pass. Once warmed up a frame must not touch
+    // the heap on this thread, the same check the app makes after STEADY_STATE_FRAME.
+    void FrameBenchmarks(BenchmarkRunner& runner, Shader& shader, Shader& depthShader)
+    {
+        const size_t instances = runner.GetOptions().Quick ? 8192 : 65536;
+        const size_t batches   = 64;
+        const size_t slices    = JobSystem::WorkerCount() + 1;
+        const int    warmup    = 120;
+
+        runner.Run("Frame/SteadyState", [&](BenchmarkState& state) {
+            std::vector<std::unique_ptr<Mesh>> meshes;
+            for (size_t i = 0; i < batches; ++i)
+                meshes.push_back(MakeCube());
+            std::vector<glm::mat4> transforms = MakeTransforms(instances);
+
+            // the job captures one reference, like the app's, so std::function keeps it inline
+            struct FrameInputs {
+                const std::vector<std::unique_ptr<Mesh>>& meshes;
+                const std::vector<glm::mat4>&             transforms;
+                Shader&                                   shader;
+                size_t                                    slices;
+            } inputs{meshes, transforms, shader, slices};
+
+            auto frame = [&]() {
+                Renderer::BeginScene(VIEW, PROJECTION);
+                // a quarter from the main thread, the rest in parallel
+                for (size_t i = 0; i < instances / 4; ++i)
+                    Renderer::SubmitMesh(meshes[i % batches].get(), &shader, transforms[i], (i & 3) == 0);
+
+                Renderer::BeginContexts(slices);
+                JobSystem::ParallelFor(slices, 1, [&inputs](size_t begin, size_t end) {
+                    const size_t first = inputs.transforms.size() / 4;
+                    const size_t count = inputs.transforms.size() - first;
+                    for (size_t c = begin; c < end; ++c)
+                    {
+                        Renderer::SubmissionContext& context = Renderer::GetContext(c);
+                        for (size_t i = first + count * c / inputs.slices; i < first + count * (c + 1) / inputs.slices; ++i)
+                            context.SubmitMesh(inputs.meshes[i % inputs.meshes.size()].get(), &inputs.shader,
+                                               inputs.transforms[i], (i & 3) == 0);
+                    }
+                });
+
+                const glm::mat4 viewProjection = PROJECTION * VIEW;
+                Renderer::RenderDepth(depthShader, viewProjection, Renderer::CasterFilter::All);
+                Renderer::RenderDepth(depthShader, viewProjection, Renderer::CasterFilter::StaticOnly);
+                Renderer::RenderDepth(depthShader, viewProjection, Renderer::CasterFilter::DynamicOnly);
+                Renderer::EndScene();
+            };
+
+            // before the first Running(), so untimed
+            for (int i = 0; i < warmup; ++i)
+                frame();
+
+            state.SetItems(double(instances));
+            uint64_t worst = 0;
+            while (state.Running())
+            {
+                uint64_t before = AllocationCounter::getThreadAllocations();
+                frame();
+                worst = std::max(worst, AllocationCounter::getThreadAllocations() - before);
+            }
+
+            state.SetCounter("allocs_per_frame", double(worst));
+            if (worst != 0)
+                state.Fail(std::to_string(worst) + " heap allocations in a steady-state frame");
+        });
+    }
+}
+
+void RunRendererBenchmarks(BenchmarkRunner& runner)
+{
+    const std::string& shaders = runner.GetOptions().Shaders;
+    Shader shader(shaders + "/model.vert", shaders + "/model.frag", CascadedShadowMap::ShaderDefines());
+    Shader other(shaders + "/model.vert", shaders + "/model.frag",
+                 CascadedShadowMap::ShaderDefines() + ShaderVariants::Defines(SHADER_FEATURE_NORMAL_MAP));
+    Shader depth(shaders + "/shadow_depth.vert", shaders + "/shadow_depth.frag");
+
+    SubmissionBenchmarks(runner, shader);
+    ContextBenchmarks(runner, shader);
+    UniformBenchmarks(runner, shader);
+    TextureBindingBenchmarks(runner, shader, other);
+    CameraBenchmarks(runner);
+    FrameBenchmarks(runner, shader, depth);
+}
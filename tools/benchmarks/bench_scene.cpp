@@ -0,0 +1,459 @@
+// bench_scene.cpp: culling, animation and scene snapshots
+#include "harness.h"
+
+#include "gfx/animation.h"
+#include "gfx/bvh.h"
+#include "gfx/components.h"
+#include "gfx/frustum.h"
+#include "gfx/model.h"
+#include "gfx/scene_snapshot.h"
+
+#include <entt/entt.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // the camera turns between queries so no single answer is learned
+    constexpr int CULL_FRUSTA = 8;
+
+    void CullingBenchmarks(BenchmarkRunner& runner)
+    {
+        const bool quick = runner.GetOptions().Quick;
+
+        Frustum frusta[CULL_FRUSTA];
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+        for (int i = 0; i < CULL_FRUSTA; ++i)
+        {
+            float     yaw  = glm::radians(360.0f * i / CULL_FRUSTA);
+            glm::vec3 eye  = glm::vec3(0.0f, 20.0f, 0.0f);
+            glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::sin(yaw), -0.2f, -std::cos(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+            frusta[i] = Frustum::FromMatrix(projection * view);
+        }
+
+        for (size_t count : { size_t(10000), size_t(100000), size_t(1000000) })
+        {
+            if (quick && count > 100000)
+                continue;
+
+            // boxes of 1 to 4 units spread over a 2x2 km world, shared by the cases
+            std::vector<AABB>   boxes;
+            std::unique_ptr<BVH> tree;
+            size_t expected[CULL_FRUSTA] = {};
+            auto prepare = [&]() {
+                if (tree)
+                    return;
+                std::mt19937 random(7);
+                std::uniform_real_distribution<float> ground(-1000.0f, 1000.0f);
+                std::uniform_real_distribution<float> height(0.0f, 40.0f);
+                std::uniform_real_distribution<float> size(0.5f, 2.0f);
+
+                boxes.resize(count);
+                tree = std::make_unique<BVH>();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    glm::vec3 center(ground(random), height(random), ground(random));
+                    glm::vec3 extents(size(random), size(random), size(random));
+                    boxes[i].Min = center - extents;
+                    boxes[i].Max = center + extents;
+                    tree->Insert(boxes[i], static_cast<uint32_t>(i));
+                }
+                tree->Rebuild();
+
+                for (int f = 0; f < CULL_FRUSTA; ++f)
+                {
+                    for (const AABB& box : boxes)
+                        expected[f] += frusta[f].Intersects(box);
+                }
+            };
+
+            const std::string suffix = "/entities:" + std::to_string(count);
+
+            runner.Run("Culling/Flat" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(count));
+                while (state.Running())
+                {
+                    const Frustum& frustum = frusta[state.Iterations() % CULL_FRUSTA];
+                    size_t visible = 0;
+                    for (const AABB& box : boxes)
+                        visible += frustum.Intersects(box);
+                    KeepAlive(visible);
+                }
+                state.SetCounter("visible", double(expected[0]));
+            });
+
+            runner.Run("Culling/BVH" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(count));
+                while (state.Running())
+                {
+                    size_t f       = state.Iterations() % CULL_FRUSTA;
+                    size_t visible = 0;
+                    tree->QueryFrustum(frusta[f], [&](uint32_t) { ++visible; });
+                    if (visible != expected[f])
+                        state.Fail("BVH query and flat test disagree on the visible set");
+                }
+                state.SetCounter("visible", double(expected[0]));
+                state.SetCounter("depth", double(tree->GetStats().Depth));
+            });
+
+            runner.Run("Culling/BVHRebuild" + suffix, [&](BenchmarkState& state) {
+                prepare();
+                state.SetItems(double(count));
+                while (state.Running())
+                    tree->Rebuild();
+            });
+        }
+    }
+
+    // a 64 joint skeleton (binary tree, parents first) and two looping one-second clips
+    struct AnimationRig {
+        Skeleton                   skeleton;
+        std::vector<AnimationClip> clips;
+    };
+
+    AnimationRig MakeRig()
+    {
+        const int joints = 64;
+
+        AnimationRig rig;
+        Skeleton& skeleton = rig.skeleton;
+        skeleton.BindPose.Resize(joints);
+        for (int j = 0; j < joints; ++j)
+        {
+            skeleton.Names.push_back("joint" + std::to_string(j));
+            skeleton.Index[skeleton.Names.back()] = j;
+            skeleton.Parents.push_back(j == 0 ? -1 : (j - 1) / 2);
+            skeleton.InverseBind.push_back(glm::mat4(1.0f));
+            skeleton.BindPositions.push_back(glm::vec3(0.0f, 0.1f * j, 0.0f));
+            skeleton.Radius.push_back(0.1f);
+            skeleton.BindPose.Get(Pose::TY)[j] = j ? 0.1f : 0.0f;
+        }
+
+        for (int c = 0; c < 2; ++c)
+        {
+            AnimationClip clip;
+            clip.Name       = c ? "sway" : "bend";
+            clip.Duration   = 1.0f;
+            clip.FrameRate  = ANIMATION_SAMPLE_RATE;
+            clip.FrameCount = static_cast<int>(ANIMATION_SAMPLE_RATE) + 1;
+            clip.JointCount = skeleton.BindPose.JointCount;
+
+            Pose pose;
+            for (int f = 0; f < clip.FrameCount; ++f)
+            {
+                pose = skeleton.BindPose;
+                float angle = 0.3f * std::sin(6.2831853f * f / (clip.FrameCount - 1) + c);
+                for (int j = 0; j < joints; ++j)
+                {
+                    // half the angle about x or z, as a quaternion
+                    pose.Get(c ? Pose::RX : Pose::RZ)[j] = std::sin(0.5f * angle);
+                    pose.Get(Pose::RW)[j]                = std::cos(0.5f * angle);
+                }
+                clip.Frames.insert(clip.Frames.end(), pose.Data.begin(), pose.Data.end());
+            }
+            rig.clips.push_back(std::move(clip));
+        }
+        return rig;
+    }
+
+    void AnimationBenchmarks(BenchmarkRunner& runner)
+    {
+        const bool  quick = runner.GetOptions().Quick;
+        AnimationRig rig;
+
+        for (size_t instances : { size_t(1000), size_t(4000), size_t(16000) })
+        {
+            if (quick && instances > 1000)
+                continue;
+
+            // every other instance blends towards the second clip
+            runner.Run("Animation/Update/instances:" + std::to_string(instances), [&](BenchmarkState& state) {
+                if (rig.clips.empty())
+                    rig = MakeRig();
+
+                entt::registry registry;
+                std::mt19937 random(3);
+                std::uniform_real_distribution<float> phase(0.0f, 1.0f);
+                for (size_t i = 0; i < instances; ++i)
+                {
+                    AnimatorComponent animator;
+                    animator.skeleton    = &rig.skeleton;
+                    animator.clip        = &rig.clips[0];
+                    animator.blendClip   = i & 1 ? &rig.clips[1] : nullptr;
+                    animator.blendWeight = 0.5f;
+                    animator.time        = phase(random);
+                    animator.blendTime   = phase(random);
+                    registry.emplace<AnimatorComponent>(registry.create(), animator);
+                }
+
+                AnimationSystem system(registry);
+                state.SetItems(double(instances));
+                while (state.Running())
+                    system.Update(1.0f / 60.0f);
+                state.SetCounter("joints", double(system.GetStats().Joints));
+            });
+        }
+    }
+
+    bool SameMatrix(const glm::mat4& a, const glm::mat4& b)
+    {
+        return std::memcmp(&a, &b, sizeof(glm::mat4)) == 0;
+    }
+
+    bool SameBox(const AABB& a, const AABB& b)
+    {
+        return a.Min == b.Min && a.Max == b.Max;
+    }
+
+    // every component of every source entity arrived unchanged in target
+    bool RoundTrips(const entt::registry& source, const entt::registry& target, const SceneLoader& loader)
+    {
+        for (entt::entity entity : source.view<TransformComponent>())
+        {
+            entt::entity local = loader.Map(entity);
+            if (local == entt::null || !target.valid(local))
+                return false;
+
+            const TransformComponent* transform = source.try_get<TransformComponent>(entity);
+            const TransformComponent* loadedTransform = target.try_get<TransformComponent>(local);
+            if (!transform != !loadedTransform || (transform && !SameMatrix(transform->Matrix, loadedTransform->Matrix)))
+                return false;
+
+            const RenderableComponent* renderable = source.try_get<RenderableComponent>(entity);
+            const RenderableComponent* loadedRenderable = target.try_get<RenderableComponent>(local);
+            if (!renderable != !loadedRenderable)
+                return false;
+            if (renderable && (renderable->model != loadedRenderable->model || renderable->shaders != loadedRenderable->shaders ||
+                               renderable->isStatic != loadedRenderable->isStatic || renderable->impostor != loadedRenderable->impostor))
+                return false;
+
+            const BoundsComponent* bounds = source.try_get<BoundsComponent>(entity);
+            const BoundsComponent* loadedBounds = target.try_get<BoundsComponent>(local);
+            if (!bounds != !loadedBounds || (bounds && !SameBox(bounds->Local, loadedBounds->Local)))
+                return false;
+
+            const AnimatorComponent* animator = source.try_get<AnimatorComponent>(entity);
+            const AnimatorComponent* loadedAnimator = target.try_get<AnimatorComponent>(local);
+            if (!animator != !loadedAnimator)
+                return false;
+            if (animator && (animator->skeleton != loadedAnimator->skeleton || animator->clip != loadedAnimator->clip ||
+                             animator->blendClip != loadedAnimator->blendClip || animator->time != loadedAnimator->time ||
+                             animator->blendTime != loadedAnimator->blendTime || animator->blendWeight != loadedAnimator->blendWeight ||
+                             animator->speed != loadedAnimator->speed || animator->loop != loadedAnimator->loop))
+                return false;
+        }
+        return true;
+    }
+
+    void SnapshotBenchmarks(BenchmarkRunner& runner)
+    {
+        const size_t count = runner.GetOptions().Quick ? 100000 : 1000000;
+
+        // an asset without meshes that owns the rig, like an imported animated model
+        ModelImport nothing;
+        Model       model(nothing);
+        AnimationRig rig = MakeRig();
+        model.skeleton   = std::move(rig.skeleton);
+        model.animations = std::move(rig.clips);
+        SnapshotAssets assets{ { &model }, {}, {} };
+
+        // static props with bounds, every 16th one animated
+        entt::registry    source;
+        std::vector<char> data;
+        auto prepare = [&]() {
+            if (!data.empty())
+                return;
+            std::mt19937 random(11);
+            std::uniform_real_distribution<float> ground(-1000.0f, 1000.0f);
+            std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+            for (size_t i = 0; i < count; ++i)
+            {
+                entt::entity entity = source.create();
+                glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(ground(random), 0.0f, ground(random))),
+                                                  angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+                source.emplace<TransformComponent>(entity, transform);
+                source.emplace<RenderableComponent>(entity, &model, nullptr, (i & 15) != 0, nullptr);
+                source.emplace<BoundsComponent>(entity, BoundsComponent{ AABB{ glm::vec3(-1.0f), glm::vec3(1.0f) } });
+                if ((i & 15) == 0)
+                {
+                    AnimatorComponent animator;
+                    animator.skeleton  = &model.skeleton;
+                    animator.clip      = &model.animations[i & 16 ? 1 : 0];
+                    animator.time      = angle(random);
+                    source.emplace<AnimatorComponent>(entity, animator);
+                }
+            }
+            if (SceneSnapshot::Write(source, assets, data) != 0)
+                data.clear();
+        };
+
+        const std::string suffix = "/entities:" + std::to_string(count);
+
+        runner.Run("Snapshot/Write" + suffix, [&](BenchmarkState& state) {
+            prepare();
+            if (data.empty())
+                return state.Fail("the source registry has references outside the asset table");
+            std::vector<char> out;
+            state.SetItems(double(count));
+            while (state.Running())
+                SceneSnapshot::Write(source, assets, out);
+            state.SetCounter("bytes", double(out.size()));
+            if (out != data)
+                state.Fail("writing the same registry twice gave different bytes");
+        });
+
+        // into an empty registry each time, the first load is compared entity by entity
+        runner.Run("Snapshot/Load" + suffix, [&](BenchmarkState& state) {
+            prepare();
+            state.SetItems(double(count));
+            while (state.Running())
+            {
+                state.Pause();
+                auto target = std::make_unique<entt::registry>();
+                auto loader = std::make_unique<SceneLoader>(*target);
+                state.Resume();
+
+                bool loaded = loader->Load(data.data(), data.size(), assets);
+
+                state.Pause();
+                if (!loaded)
+                    state.Fail("snapshot did not load");
+                else if (state.Iterations() == 1 && !RoundTrips(source, *target, *loader))
+                    state.Fail("loaded registry differs from the saved one");
+                else if (loader->GetStats().Entities != count)
+                    state.Fail("loaded entity count differs from the saved one");
+                state.SetCounter("decode_ms", loader->GetStats().DecodeMs);
+                state.SetCounter("insert_ms", loader->GetStats().InsertMs);
+                loader.reset();
+                target.reset();
+                state.Resume();
+            }
+        });
+
+        // through a file: Save, then Load(path) maps it back in
+        const std::string path = (std::filesystem::temp_directory_path() / "bench_snapshot.kscn").string();
+        runner.Run("Snapshot/SaveLoadFile" + suffix, [&](BenchmarkState& state) {
+            prepare();
+            state.SetItems(double(count));
+            while (state.Running())
+            {
+                state.Pause();
+                auto target = std::make_unique<entt::registry>();
+                auto loader = std::make_unique<SceneLoader>(*target);
+                state.Resume();
+
+                bool saved  = SceneSnapshot::Save(source, assets, path);
+                bool loaded = saved && loader->Load(path, assets);
+
+                state.Pause();
+                if (!saved)
+                    state.Fail("snapshot could not be saved");
+                else if (!loaded)
+                    state.Fail("saved snapshot did not load");
+                else if (state.Iterations() == 1 && !RoundTrips(source, *target, *loader))
+                    state.Fail("registry loaded from the file differs from the saved one");
+                loader.reset();
+                target.reset();
+                state.Resume();
+            }
+            std::remove(path.c_str());
+        });
+
+        // a hot restart: the same level into the same loader updates its entities instead of adding more
+        runner.Run("Snapshot/Reload" + suffix, [&](BenchmarkState& state) {
+            prepare();
+            entt::registry target;
+            SceneLoader    loader(target);
+            if (!loader.Load(data.data(), data.size(), assets))
+                return state.Fail("snapshot did not load");
+            const size_t entities = target.view<TransformComponent>().size();
+
+            state.SetItems(double(count));
+            while (state.Running())
+            {
+                bool loaded = loader.Load(data.data(), data.size(), assets);
+
+                state.Pause();
+                if (!loaded)
+                    state.Fail("snapshot did not load again");
+                else if (target.view<TransformComponent>().size() != entities)
+                    state.Fail("loading again duplicated entities");
+                else if (state.Iterations() == 1 && !RoundTrips(source, target, loader))
+                    state.Fail("reloaded registry differs from the saved one");
+                state.Resume();
+            }
+        });
+
+        // damaged files are turned away before anything reaches the registry. The truncated
+        // ones are checked once up front, the timed part is an index only found while decoding.
+        runner.Run("Snapshot/Reject" + suffix, [&](BenchmarkState& state) {
+            prepare();
+            entt::registry target;
+            SceneLoader    loader(target);
+
+            for (size_t size : { size_t(0), size_t(6), size_t(64), data.size() / 2, data.size() - 1 })
+            {
+                if (loader.Load(data.data(), size, assets) || !target.view<TransformComponent>().empty())
+                    return state.Fail("a truncated snapshot of " + std::to_string(size) + " bytes was loaded");
+            }
+
+            // a transform of an entity the entity pool does not have
+            std::vector<char> orphan = data;
+            const size_t transforms = 12 + size_t(SnapshotPool::Transforms) * 24;
+            uint64_t transformsAt = 0;
+            std::memcpy(&transformsAt, orphan.data() + transforms + 8, sizeof(transformsAt));
+            const uint32_t missing = static_cast<uint32_t>(count);
+            std::memcpy(orphan.data() + transformsAt + sizeof(uint32_t), &missing, sizeof(missing));
+            if (loader.Load(orphan.data(), orphan.size(), assets) || !target.view<TransformComponent>().empty())
+                return state.Fail("a snapshot with a component of an unknown entity was loaded");
+
+            // the first renderable's model, past the header (magic, version, pool count) and
+            // the pool table {u32 pool, u32 reserved, u64 offset, u64 size}
+            std::vector<char> damaged = data;
+            const size_t entry = 12 + size_t(SnapshotPool::Renderables) * 24;
+            uint64_t offset = 0;
+            std::memcpy(&offset, damaged.data() + entry + 8, sizeof(offset));
+            const uint32_t unknown = static_cast<uint32_t>(assets.Models.size());
+            std::memcpy(damaged.data() + offset + 2 * sizeof(uint32_t), &unknown, sizeof(unknown));
+
+            // and a registry Save has to refuse: its model is not in the table
+            entt::registry unresolved;
+            ModelImport    stray;
+            Model          strayModel(stray);
+            unresolved.emplace<RenderableComponent>(unresolved.create(), &strayModel, nullptr, true, nullptr);
+            if (SceneSnapshot::Save(unresolved, assets, path))
+            {
+                std::remove(path.c_str());
+                return state.Fail("a snapshot with an unknown model was saved");
+            }
+
+            state.SetItems(double(count));
+            while (state.Running())
+            {
+                bool loaded = loader.Load(damaged.data(), damaged.size(), assets);
+
+                state.Pause();
+                if (loaded || !target.view<TransformComponent>().empty())
+                    state.Fail("a snapshot with an unknown model index was loaded");
+                state.Resume();
+            }
+        });
+    }
+}
+
+void RunSceneBenchmarks(BenchmarkRunner& runner)
+{
+    CullingBenchmarks(runner);
+    AnimationBenchmarks(runner);
+    SnapshotBenchmarks(runner);
+}
@@ -0,0 +1,181 @@
+// gl_stub.cpp
+#include "gl_stub.h"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    // single threaded like a real context, jobs never call GL
+    GLuint g_NextName = 1;
+    int    g_Fence    = 0;
+
+    template<typename R, typename... Args>
+    struct Noop
+    {
+        static R APIENTRY Call(Args...) { return R(); }
+    };
+
+    template<typename R, typename... Args>
+    void Stub(R (APIENTRYP& function)(Args...))
+    {
+        function = &Noop<R, Args...>::Call;
+    }
+
+    void APIENTRY GenNames(GLsizei n, GLuint* names)
+    {
+        for (GLsizei i = 0; i < n; ++i)
+            names[i] = g_NextName++;
+    }
+
+    GLuint APIENTRY CreateProgram()
+    {
+        return g_NextName++;
+    }
+
+    GLuint APIENTRY CreateShader(GLenum)
+    {
+        return g_NextName++;
+    }
+
+    // compile/link status, query availability
+    void APIENTRY GetTrue(GLuint, GLenum, GLint* params)
+    {
+        *params = GL_TRUE;
+    }
+
+    void APIENTRY GetIntegerv(GLenum pname, GLint* data)
+    {
+        if (pname == GL_VIEWPORT)
+        {
+            data[0] = 0;
+            data[1] = 0;
+            data[2] = 1920;
+            data[3] = 1080;
+            return;
+        }
+        *data = 0;
+    }
+
+    void APIENTRY GetFloatv(GLenum, GLfloat* data)
+    {
+        *data = 0.0f;
+    }
+
+    // FNV-1a over the name, what a driver pays at least before its table lookup
+    GLint APIENTRY GetUniformLocation(GLuint program, const GLchar* name)
+    {
+        uint32_t hash = 2166136261u ^ program;
+        for (const GLchar* c = name; *c; ++c)
+        {
+            hash ^= static_cast<unsigned char>(*c);
+            hash *= 16777619u;
+        }
+        return static_cast<GLint>(hash & 1023);
+    }
+
+    GLenum APIENTRY CheckFramebufferStatus(GLenum)
+    {
+        return GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    GLsync APIENTRY FenceSync(GLenum, GLbitfield)
+    {
+        return reinterpret_cast<GLsync>(&g_Fence);
+    }
+
+    GLenum APIENTRY ClientWaitSync(GLsync, GLbitfield, GLuint64)
+    {
+        return GL_ALREADY_SIGNALED;
+    }
+
+    void APIENTRY GetBufferSubData(GLenum, GLintptr, GLsizeiptr size, void* data)
+    {
+        std::memset(data, 0, static_cast<size_t>(size));
+    }
+
+    void APIENTRY GetQueryObjectui64v(GLuint, GLenum, GLuint64* params)
+    {
+        *params = 0;
+    }
+
+    void APIENTRY GetTexLevelParameteriv(GLenum, GLint, GLenum, GLint* params)
+    {
+        *params = 1;
+    }
+
+    void APIENTRY GetTexParameteriv(GLenum, GLenum, GLint* params)
+    {
+        *params = 0;
+    }
+
+    const GLubyte* APIENTRY GetString(GLenum)
+    {
+        return reinterpret_cast<const GLubyte*>("stub");
+    }
+}
+
+void GLStub::Install()
+{
+    GLAD_GL_VERSION_3_3 = 1;
+    GLAD_GL_VERSION_4_2 = 0;
+    GLAD_GL_VERSION_4_3 = 0;
+
+    // state
+    Stub(glEnable); Stub(glDisable); Stub(glIsEnabled); Stub(glViewport); Stub(glClear); Stub(glClearColor);
+    Stub(glBlendFunc); Stub(glDepthFunc); Stub(glDepthMask); Stub(glPolygonOffset); Stub(glPixelStorei);
+    Stub(glMemoryBarrier);
+
+    // buffers and vertex arrays
+    Stub(glBindBuffer); Stub(glBindBufferBase); Stub(glBindBufferRange); Stub(glBufferData); Stub(glBufferSubData);
+    Stub(glClearBufferData); Stub(glClearBufferSubData); Stub(glDeleteBuffers); Stub(glBindVertexArray);
+    Stub(glDeleteVertexArrays); Stub(glEnableVertexAttribArray); Stub(glVertexAttribPointer);
+    Stub(glVertexAttribIPointer); Stub(glVertexAttribDivisor); Stub(glDeleteSync);
+    Stub(glMapBufferRange); Stub(glUnmapBuffer);
+
+    // textures and framebuffers
+    Stub(glActiveTexture); Stub(glBindTexture); Stub(glDeleteTextures); Stub(glTexImage2D); Stub(glTexImage3D);
+    Stub(glTexImage2DMultisample); Stub(glTexParameteri); Stub(glTexParameterfv); Stub(glGenerateMipmap);
+    Stub(glGetTexImage); Stub(glBindFramebuffer); Stub(glDeleteFramebuffers); Stub(glFramebufferTexture2D);
+    Stub(glFramebufferTextureLayer); Stub(glFramebufferRenderbuffer); Stub(glBindRenderbuffer);
+    Stub(glDeleteRenderbuffers); Stub(glRenderbufferStorage); Stub(glBlitFramebuffer); Stub(glDrawBuffer);
+    Stub(glDrawBuffers); Stub(glReadBuffer); Stub(glReadPixels);
+
+    // programs and uniforms
+    Stub(glShaderSource); Stub(glCompileShader); Stub(glAttachShader); Stub(glLinkProgram); Stub(glDeleteShader);
+    Stub(glDeleteProgram); Stub(glGetShaderInfoLog); Stub(glGetProgramInfoLog); Stub(glUseProgram);
+    Stub(glUniform1i); Stub(glUniform1ui); Stub(glUniform1f); Stub(glUniform2f); Stub(glUniform2fv);
+    Stub(glUniform3f); Stub(glUniform3fv); Stub(glUniform4f); Stub(glUniform4fv); Stub(glUniformMatrix2fv);
+    Stub(glUniformMatrix3fv); Stub(glUniformMatrix4fv);
+
+    // draws, dispatches and queries
+    Stub(glDrawArrays); Stub(glDrawArraysInstanced); Stub(glDrawElements); Stub(glDrawElementsInstanced);
+    Stub(glDrawElementsInstancedBaseVertexBaseInstance); Stub(glMultiDrawElementsIndirect);
+    Stub(glDispatchCompute); Stub(glBeginQuery); Stub(glEndQuery); Stub(glDeleteQueries);
+
+    // calls whose results the engine reads
+    glGenBuffers                = GenNames;
+    glGenVertexArrays           = GenNames;
+    glGenTextures               = GenNames;
+    glGenFramebuffers           = GenNames;
+    glGenRenderbuffers          = GenNames;
+    glGenQueries                = GenNames;
+    glCreateProgram             = CreateProgram;
+    glCreateShader              = CreateShader;
+    glGetShaderiv               = GetTrue;
+    glGetProgramiv              = GetTrue;
+    glGetQueryObjectiv          = GetTrue;
+    glGetQueryObjectui64v       = GetQueryObjectui64v;
+    glGetIntegerv               = GetIntegerv;
+    glGetFloatv                 = GetFloatv;
+    glGetUniformLocation        = GetUniformLocation;
+    glCheckFramebufferStatus    = CheckFramebufferStatus;
+    glFenceSync                 = FenceSync;
+    glClientWaitSync            = ClientWaitSync;
+    glGetBufferSubData          = GetBufferSubData;
+    glGetTexLevelParameteriv    = GetTexLevelParameteriv;
+    glGetTexParameteriv         = GetTexParameteriv;
+    glGetString                 = GetString;
+}
@@ -0,0 +1,15 @@
+#ifndef GL_STUB_H
+#define GL_STUB_H
+
+// Points every GL function the engine calls at a stub, so the CPU side of code
+// that talks to GL runs without a context. glGen*/glCreate* hand out names,
+// status queries report success and the viewport is 1920x1080. glGetUniformLocation
+// hashes the name like a driver's lookup has to, so the cost of looking names up
+// per call stays visible. Everything else does nothing.
+// GL 4.2+ paths (meshlet culling, compute skinning) report themselves unsupported.
+namespace GLStub
+{
+    void Install();
+}
+
+#endif
@@ -0,0 +1,194 @@
+// harness.cpp
+#include "harness.h"
+
+#include "core/alloc_counter.hpp"
+#include "core/job_system.hpp"
+#include "core/log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    std::string Escape(const std::string& text)
+    {
+        std::string result;
+        result.reserve(text.size());
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+    // 12.3M style, for the console only
+    std::string Rate(double perSecond)
+    {
+        const char* units[] = { "", "k", "M", "G" };
+        int unit = 0;
+        while (perSecond >= 1000.0 && unit < 3)
+        {
+            perSecond /= 1000.0;
+            ++unit;
+        }
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f%s", perSecond, units[unit]);
+        return text;
+    }
+}
+
+bool BenchmarkState::Running()
+{
+    if (!m_Started)
+    {
+        m_Started = true;
+        m_Paused  = true;
+        Resume();
+    }
+    if (m_Iterations < m_Target && m_Error.empty())
+    {
+        ++m_Iterations;
+        return true;
+    }
+
+    double seconds = m_Seconds;
+    if (!m_Paused)
+        seconds += std::chrono::duration<double>(Clock::now() - m_Start).count();
+    if (!m_Error.empty() || seconds >= m_Options.MinSeconds || m_Iterations >= m_Options.MaxIterations)
+    {
+        Pause();
+        return false;
+    }
+
+    // aim a little past MinSeconds at the rate so far, growing at most tenfold per step
+    double scale = seconds > 0.0 ? std::min(10.0, std::max(1.5, 1.4 * m_Options.MinSeconds / seconds)) : 10.0;
+    m_Target = std::min(m_Options.MaxIterations, static_cast<uint64_t>(double(m_Iterations) * scale) + 1);
+    ++m_Iterations;
+    return true;
+}
+
+void BenchmarkState::Pause()
+{
+    if (m_Paused)
+        return;
+    m_Seconds     += std::chrono::duration<double>(Clock::now() - m_Start).count();
+    m_Allocations += AllocationCounter::getTotalAllocations() - m_AllocStart;
+    m_Paused       = true;
+}
+
+void BenchmarkState::Resume()
+{
+    if (!m_Paused)
+        return;
+    m_Paused     = false;
+    m_AllocStart = AllocationCounter::getTotalAllocations();
+    m_Start      = Clock::now();
+}
+
+void BenchmarkState::SetCounter(const std::string& name, double value)
+{
+    for (auto& counter : m_Counters)
+    {
+        if (counter.first == name)
+        {
+            counter.second = value;
+            return;
+        }
+    }
+    m_Counters.emplace_back(name, value);
+}
+
+void BenchmarkState::Fail(const std::string& reason)
+{
+    if (m_Error.empty())
+        m_Error = reason;
+}
+
+void BenchmarkRunner::Run(const std::string& name, const std::function<void(BenchmarkState&)>& fn)
+{
+    if (!m_Options.Filter.empty() && name.find(m_Options.Filter) == std::string::npos)
+        return;
+
+    BenchmarkState state(m_Options);
+    fn(state);
+    state.Pause();
+
+    Result result;
+    result.name       = name;
+    result.iterations = state.m_Iterations;
+    result.error      = state.m_Error;
+    result.counters   = state.m_Counters;
+    if (state.m_Iterations > 0)
+    {
+        double iterations     = double(state.m_Iterations);
+        result.nsPerOp        = state.m_Seconds * 1e9 / iterations;
+        result.allocsPerOp    = double(state.m_Allocations) / iterations;
+        result.itemsPerSecond = state.m_Seconds > 0.0 ? state.m_Items * iterations / state.m_Seconds : 0.0;
+    }
+
+    FILE* console = m_Options.Json == "-" ? stderr : stdout;
+    if (!result.error.empty())
+    {
+        m_Failed = true;
+        std::fprintf(console, "%-56s FAILED: %s\n", name.c_str(), result.error.c_str());
+    }
+    else
+    {
+        std::fprintf(console, "%-56s %10llu %14.1f ns/op %10s items/s %8.2f allocs/op\n", name.c_str(),
+                     static_cast<unsigned long long>(result.iterations), result.nsPerOp,
+                     Rate(result.itemsPerSecond).c_str(), result.allocsPerOp);
+    }
+    std::fflush(console);
+
+    m_Results.push_back(std::move(result));
+}
+
+bool BenchmarkRunner::WriteJson() const
+{
+    const std::string& path = m_Options.Json;
+    FILE* file = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        LOG_ERROR("ERROR::BENCHMARKS::Cannot write %s", path.c_str());
+        return false;
+    }
+
+    std::fprintf(file, "{\n  \"context\": {\n");
+    std::fprintf(file, "    \"threads\": %u,\n", JobSystem::WorkerCount() + 1);
+#ifdef NDEBUG
+    std::fprintf(file, "    \"build\": \"release\",\n");
+#else
+    std::fprintf(file, "    \"build\": \"debug\",\n");
+#endif
+    std::fprintf(file, "    \"gl\": \"stub\",\n");
+    std::fprintf(file, "    \"quick\": %s\n  },\n", m_Options.Quick ? "true" : "false");
+
+    std::fprintf(file, "  \"benchmarks\": [");
+    for (size_t i = 0; i < m_Results.size(); ++i)
+    {
+        const Result& result = m_Results[i];
+        std::fprintf(file, "%s\n    {\n", i ? "," : "");
+        std::fprintf(file, "      \"name\": \"%s\",\n", Escape(result.name).c_str());
+        std::fprintf(file, "      \"iterations\": %llu,\n", static_cast<unsigned long long>(result.iterations));
+        std::fprintf(file, "      \"ns_per_op\": %.6g,\n", result.nsPerOp);
+        std::fprintf(file, "      \"items_per_second\": %.6g,\n", result.itemsPerSecond);
+        std::fprintf(file, "      \"allocs_per_op\": %.6g,\n", result.allocsPerOp);
+        if (!result.error.empty())
+            std::fprintf(file, "      \"error\": \"%s\",\n", Escape(result.error).c_str());
+        std::fprintf(file, "      \"counters\": {");
+        for (size_t c = 0; c < result.counters.size(); ++c)
+            std::fprintf(file, "%s \"%s\": %.6g", c ? "," : "", Escape(result.counters[c].first).c_str(),
+                         result.counters[c].second);
+        std::fprintf(file, "%s}\n    }", result.counters.empty() ? "" : " ");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+
+    bool ok = !std::ferror(file);
+    if (file != stdout)
+        ok = std::fclose(file) == 0 && ok;
+    if (!ok)
+        LOG_ERROR("ERROR::BENCHMARKS::Writing %s failed", path.c_str());
+    return ok;
+}
@@ -0,0 +1,114 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchmarkOptions {
+    // a benchmark repeats until its timed part took this long
+    double      MinSeconds    = 0.25;
+    uint64_t    MaxIterations = 1000000000ull;
+    // smaller problem sizes, for a quick check that everything still runs
+    bool        Quick         = false;
+    // only benchmarks whose name contains this
+    std::string Filter;
+    std::string Shaders       = "../res/shaders";
+    // where WriteJson goes, "-" for stdout (the console lines then go to stderr)
+    std::string Json;
+};
+
+// Passed to a benchmark function, which loops on Running() around the code it
+// measures. Iterations are added in growing batches until MinSeconds of timed
+// work have passed; Pause/Resume keep setup and cleanup out of the time.
+// Heap allocations are counted over the timed part only.
+class BenchmarkState
+{
+public:
+    explicit BenchmarkState(const BenchmarkOptions& options) : m_Options(options) {}
+
+    bool Running();
+
+    void Pause();
+    void Resume();
+
+    // work done per iteration, reported as a rate
+    void SetItems(double items) { m_Items = items; }
+    void SetCounter(const std::string& name, double value);
+    // the result is wrong, the benchmark stops and the run fails
+    void Fail(const std::string& reason);
+
+    uint64_t Iterations() const { return m_Iterations; }
+    bool     Quick()      const { return m_Options.Quick; }
+
+private:
+    friend class BenchmarkRunner;
+    using Clock = std::chrono::steady_clock;
+
+    const BenchmarkOptions& m_Options;
+    uint64_t          m_Iterations  = 0;
+    uint64_t          m_Target      = 1;
+    bool              m_Started     = false;
+    bool              m_Paused      = false;
+    Clock::time_point m_Start;
+    double            m_Seconds     = 0.0;
+    uint64_t          m_AllocStart  = 0;
+    uint64_t          m_Allocations = 0;
+    double            m_Items       = 0.0;
+    std::string       m_Error;
+    std::vector<std::pair<std::string, double>> m_Counters;
+};
+
+// Runs benchmarks one after another on the calling thread, prints one line each
+// and collects the results for the JSON report.
+class BenchmarkRunner
+{
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions& options) : m_Options(options) {}
+
+    // name is "Group/Case/param:value", fn loops on state.Running()
+    void Run(const std::string& name, const std::function<void(BenchmarkState&)>& fn);
+
+    // to BenchmarkOptions::Json, false (and logged) if it cannot be written
+    bool WriteJson() const;
+
+    const BenchmarkOptions& GetOptions() const { return m_Options; }
+    bool Failed() const { return m_Failed; }
+
+private:
+    struct Result {
+        std::string name;
+        uint64_t    iterations     = 0;
+        double      nsPerOp        = 0.0;
+        double      itemsPerSecond = 0.0;
+        double      allocsPerOp    = 0.0;
+        std::string error;
+        std::vector<std::pair<std::string, double>> counters;
+    };
+
+    BenchmarkOptions    m_Options;
+    std::vector<Result> m_Results;
+    bool                m_Failed = false;
+};
+
+// keeps the compiler from dropping a computation whose result is never read
+template<typename T>
+inline void KeepAlive(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static const void* volatile sink;
+    sink = &value;
+#endif
+}
+
+// the benchmark groups, one file each
+void RunRendererBenchmarks(BenchmarkRunner& runner);
+void RunImportBenchmarks(BenchmarkRunner& runner);
+void RunSceneBenchmarks(BenchmarkRunner& runner);
+
+#endif
@@ -0,0 +1,72 @@
+// benchmarks: CPU microbenchmarks of the engine's hot paths, GL stubbed out
+// (see gl_stub.h), so the numbers are what the CPU side costs without a driver.
+//
+//   benchmarks [--filter <text>] [--json <file|->] [--min-time <seconds>] [--quick] [--shaders <dir>]
+//
+// One line per benchmark goes to the console; --json also writes every result
+// (ns/op, items/s, heap allocations/op, extra counters) for regression tracking.
+// The exit code is 1 if a benchmark's correctness check failed.
+#include "harness.h"
+#include "gl_stub.h"
+
+#include "core/job_system.hpp"
+#include "core/log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+                options.Filter = argv[++i];
+            else if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+                options.Json = argv[++i];
+            else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc)
+                options.MinSeconds = std::max(0.0, std::atof(argv[++i]));
+            else if (!std::strcmp(argv[i], "--quick"))
+                options.Quick = true;
+            else if (!std::strcmp(argv[i], "--shaders") && i + 1 < argc)
+                options.Shaders = argv[++i];
+            else
+                return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: benchmarks [--filter <text>] [--json <file|->] [--min-time <seconds>] "
+                             "[--quick] [--shaders <dir>]\n");
+        return 1;
+    }
+    if (options.Quick)
+        options.MinSeconds = std::min(options.MinSeconds, 0.05);
+
+    Log::Init();
+    Log::SetLevel(Log::Level::Warn);
+    JobSystem::Init();
+    GLStub::Install();
+
+    BenchmarkRunner runner(options);
+    RunRendererBenchmarks(runner);
+    RunImportBenchmarks(runner);
+    RunSceneBenchmarks(runner);
+
+    int status = runner.Failed() ? 1 : 0;
+    if (!options.Json.empty() && !runner.WriteJson())
+        status = 1;
+
+    JobSystem::Shutdown();
+    Log::Shutdown();
+    return status;
+}
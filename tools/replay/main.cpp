@@ -0,0 +1,371 @@
+// replay: plays a frame capture (see gfx/frame_capture.h) back headlessly,
+// as fast as possible, and reports CPU and GPU time per frame.
+//
+//   replay <trace.ktrc> [--shaders <dir>] [--loops <n>] [--quiet] [--budgets <file>]
+//
+// With --budgets the memory high-water marks are checked after the run and the
+// exit code is 2 on any overrun (see gfx/memory_report.h for the file format).
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "gfx/frame_capture.h"
+#include "gfx/renderer.h"
+#include "gfx/shader.h"
+#include "gfx/shadow_map.h"
+#include "gfx/gpu_memory.h"
+#include "gfx/memory_report.h"
+#include "core/frame_pacer.hpp"
+#include "core/log.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct Options {
+        std::string trace;
+        std::string shaders = "../res/shaders";
+        int         loops   = 1;
+        bool        quiet   = false;
+        std::string budgets;
+    };
+
+    bool ParseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (!std::strcmp(argv[i], "--shaders") && i + 1 < argc)
+                options.shaders = argv[++i];
+            else if (!std::strcmp(argv[i], "--loops") && i + 1 < argc)
+                options.loops = std::max(1, std::atoi(argv[++i]));
+            else if (!std::strcmp(argv[i], "--quiet"))
+                options.quiet = true;
+            else if (!std::strcmp(argv[i], "--budgets") && i + 1 < argc)
+                options.budgets = argv[++i];
+            else if (argv[i][0] != '-' && options.trace.empty())
+                options.trace = argv[i];
+            else
+                return false;
+        }
+        return !options.trace.empty();
+    }
+
+    GLenum PixelFormatFor(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+            case GL_R8:                          return GL_RED;
+            case GL_RG8:                         return GL_RG;
+            case GL_RGB8: case GL_SRGB8:         return GL_RGB;
+            default:                             return GL_RGBA;
+        }
+    }
+
+    // same size and format as captured, contents are irrelevant for timing
+    GLuint CreateTexture(const TraceTexture& texture)
+    {
+        GLuint id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        for (int level = 0; level < texture.levels; ++level)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat,
+                         std::max(1, texture.width >> level), std::max(1, texture.height >> level), 0,
+                         PixelFormatFor(texture.internalFormat), GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+        GpuMemory::Track(GpuMemoryCategory::Texture,
+                         GpuMemory::TextureBytes(texture.internalFormat, texture.width, texture.height, 1, texture.levels));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return id;
+    }
+
+    std::unique_ptr<Mesh> CreateMesh(TraceMesh& traced, const std::unordered_map<uint32_t, GLuint>& textures)
+    {
+        // captured without geometry: scatter the right number of vertices over the bounds
+        if (traced.vertices.empty())
+        {
+            traced.vertices.resize(traced.vertexCount);
+            traced.indices.resize(traced.indexCount);
+            uint32_t seed = traced.id * 2654435761u + 1;
+            for (Vertex& v : traced.vertices)
+            {
+                v = Vertex{};
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    float t = (seed >> 8) / float(1 << 24);
+                    v.Position[axis] = traced.bounds.Min[axis] + t * (traced.bounds.Max[axis] - traced.bounds.Min[axis]);
+                }
+                v.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            }
+            for (uint32_t i = 0; i < traced.indexCount; ++i)
+                traced.indices[i] = traced.vertexCount ? i % traced.vertexCount : 0;
+        }
+
+        std::vector<Texture> meshTextures;
+        for (size_t i = 0; i < traced.textures.size(); ++i)
+        {
+            auto it = textures.find(traced.textures[i]);
+            meshTextures.push_back(Texture{ it != textures.end() ? it->second : 0u,
+                                            TraceTextureTypeName(traced.roles[i]), "" });
+        }
+
+        return std::make_unique<Mesh>(std::move(traced.vertices), std::move(traced.indices), std::move(meshTextures));
+    }
+
+    struct RenderTarget {
+        GLuint framebuffer = 0;
+        GLuint color       = 0;
+        GLuint depth       = 0;
+    };
+
+    RenderTarget CreateTarget(int width, int height, bool withColor)
+    {
+        RenderTarget target;
+        glGenFramebuffers(1, &target.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+
+        if (withColor)
+        {
+            glGenRenderbuffers(1, &target.color);
+            glBindRenderbuffer(GL_RENDERBUFFER, target.color);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, width, height);
+            GpuMemory::Track(GpuMemoryCategory::RenderTarget, GpuMemory::TextureBytes(GL_SRGB8_ALPHA8, width, height));
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color);
+        }
+        else
+        {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+
+        glGenRenderbuffers(1, &target.depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+        GLenum depthFormat = withColor ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT32F;
+        glRenderbufferStorage(GL_RENDERBUFFER, depthFormat, width, height);
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget, GpuMemory::TextureBytes(depthFormat, width, height));
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, withColor ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, target.depth);
+        return target;
+    }
+
+    void PrintSummary(const char* name, const Histogram& histogram)
+    {
+        std::printf("%-4s mean %7.3f ms  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f\n", name,
+                    histogram.getMean(), histogram.getPercentile(0.50), histogram.getPercentile(0.95),
+                    histogram.getPercentile(0.99), histogram.getMax());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "usage: replay <trace.ktrc> [--shaders <dir>] [--loops <n>] [--quiet] [--budgets <file>]\n");
+        return 1;
+    }
+
+    if (!glfwInit())
+        return 1;
+
+    // an invisible window is the portable way to get a context without a display surface
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+#else
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+#endif
+    GLFWwindow* window = glfwCreateWindow(64, 64, "replay", nullptr, nullptr);
+    if (!window)
+    {
+        std::fprintf(stderr, "replay: could not create a GL context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    glfwSwapInterval(0);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_FRAMEBUFFER_SRGB);
+
+    int status = 0;
+    {
+        Shader modelShader(options.shaders + "/model.vert", options.shaders + "/model.frag",
+                           CascadedShadowMap::ShaderDefines());
+        Shader depthShader(options.shaders + "/shadow_depth.vert", options.shaders + "/shadow_depth.frag");
+
+        // every captured shader replays with the model shader, the draw and state
+        // change pattern is what matters here
+        std::unordered_map<uint32_t, Shader*>               shaders;
+        std::unordered_map<uint32_t, GLuint>                textures;
+        std::unordered_map<uint32_t, std::unique_ptr<Mesh>> meshes;
+        std::map<std::pair<int, int>, RenderTarget>         depthTargets;
+        std::map<std::pair<int, int>, RenderTarget>         colorTargets;
+
+        GLuint timer;
+        glGenQueries(1, &timer);
+
+        Histogram cpuTimes(0.05, 200.0);
+        Histogram gpuTimes(0.05, 200.0);
+        TraceFrame frame;
+        auto wallStart = std::chrono::steady_clock::now();
+
+        for (int loop = 0; loop < options.loops && status == 0; ++loop)
+        {
+            TraceReader reader(options.trace);
+            if (!reader.Valid())
+            {
+                status = 1;
+                break;
+            }
+
+            TraceChunk chunk;
+            while (reader.Next(chunk))
+            {
+                switch (chunk)
+                {
+                    case TraceChunk::Texture:
+                    {
+                        TraceTexture texture = reader.ReadTexture();
+                        if (!textures.count(texture.id))
+                            textures[texture.id] = CreateTexture(texture);
+                        break;
+                    }
+                    case TraceChunk::Mesh:
+                    {
+                        TraceMesh mesh = reader.ReadMesh();
+                        if (!meshes.count(mesh.id))
+                            meshes[mesh.id] = CreateMesh(mesh, textures);
+                        break;
+                    }
+                    case TraceChunk::Shader:
+                        shaders[reader.ReadShader()] = &modelShader;
+                        break;
+                    case TraceChunk::Frame:
+                    {
+                        reader.ReadFrame(frame);
+
+                        auto cpuStart = std::chrono::steady_clock::now();
+                        glBeginQuery(GL_TIME_ELAPSED, timer);
+
+                        Renderer::BeginScene(frame.view, frame.projection);
+                        size_t instances = 0;
+                        for (const TraceBatch& batch : frame.batches)
+                        {
+                            Mesh*   mesh   = meshes[batch.mesh].get();
+                            Shader* shader = shaders.count(batch.shader) ? shaders[batch.shader] : &modelShader;
+                            if (!mesh)
+                                continue;
+                            for (size_t i = 0; i < batch.instances.size(); ++i)
+                            {
+                                // crossfading instances carry their fade in the bottom row,
+                                // the replay draws every instance whole
+                                glm::mat4 instance = batch.instances[i];
+                                instance[0][3] = 0.0f;
+                                Renderer::SubmitMesh(mesh, shader, instance, batch.isStatic[i] != 0);
+                            }
+                            instances += batch.instances.size();
+                        }
+
+                        for (const TracePass& pass : frame.passes)
+                        {
+                            auto key = std::make_pair(pass.viewport[2], pass.viewport[3]);
+                            if (!depthTargets.count(key))
+                                depthTargets[key] = CreateTarget(key.first, key.second, false);
+                            glBindFramebuffer(GL_FRAMEBUFFER, depthTargets[key].framebuffer);
+                            glViewport(0, 0, key.first, key.second);
+                            glClear(GL_DEPTH_BUFFER_BIT);
+                            Renderer::RenderDepth(depthShader, pass.viewProjection,
+                                                  static_cast<Renderer::CasterFilter>(pass.filter));
+                        }
+
+                        auto key = std::make_pair(std::max(1, frame.viewport[2]), std::max(1, frame.viewport[3]));
+                        if (!colorTargets.count(key))
+                            colorTargets[key] = CreateTarget(key.first, key.second, true);
+                        glBindFramebuffer(GL_FRAMEBUFFER, colorTargets[key].framebuffer);
+                        glViewport(0, 0, key.first, key.second);
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                        Renderer::EndScene();
+
+                        glEndQuery(GL_TIME_ELAPSED);
+                        double cpuMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - cpuStart).count();
+
+                        GpuMemory::EndFrame();
+
+                        GLuint64 gpuNs = 0;
+                        glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &gpuNs);
+                        double gpuMs = gpuNs / 1.0e6;
+
+                        cpuTimes.record(cpuMs);
+                        gpuTimes.record(gpuMs);
+                        if (!options.quiet)
+                        {
+                            std::printf("frame %6llu  cpu %7.3f ms  gpu %7.3f ms  batches %4zu  instances %6zu  passes %zu\n",
+                                        (unsigned long long)frame.index, cpuMs, gpuMs,
+                                        frame.batches.size(), instances, frame.passes.size());
+                        }
+                        break;
+                    }
+                    default:
+                        break; // newer chunk types are skipped
+                }
+            }
+        }
+
+        double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+        if (cpuTimes.getCount())
+        {
+            std::printf("\n%llu frames in %.1f ms\n", (unsigned long long)cpuTimes.getCount(), wallMs);
+            PrintSummary("cpu", cpuTimes);
+            PrintSummary("gpu", gpuTimes);
+        }
+
+        if (!options.budgets.empty())
+        {
+            MemoryBudgets  budgets;
+            MemorySnapshot memory = MemoryReport::Capture();
+            MemoryReport::Log(memory);
+            if (!MemoryReport::LoadBudgets(options.budgets, budgets) || !MemoryReport::CheckBudgets(memory, budgets))
+                status = status ? status : 2;
+        }
+
+        glDeleteQueries(1, &timer);
+        for (auto& pair : textures)
+            glDeleteTextures(1, &pair.second);
+        for (auto* targets : { &depthTargets, &colorTargets })
+        {
+            for (auto& pair : *targets)
+            {
+                glDeleteFramebuffers(1, &pair.second.framebuffer);
+                glDeleteRenderbuffers(1, &pair.second.color);
+                glDeleteRenderbuffers(1, &pair.second.depth);
+            }
+        }
+        // every texture and target in this process was created above
+        GpuMemory::Track(GpuMemoryCategory::Texture,      -int64_t(GpuMemory::GetBytes(GpuMemoryCategory::Texture)));
+        GpuMemory::Track(GpuMemoryCategory::RenderTarget, -int64_t(GpuMemory::GetBytes(GpuMemoryCategory::RenderTarget)));
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    Log::Shutdown();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return status;
+}